@@ -0,0 +1,120 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef DEVICE_DRIVE_CACHE_H_
+#define DEVICE_DRIVE_CACHE_H_
+
+#include "sos/dev/drive.h"
+#include "sos/fs/devfs.h"
+
+/*! \details drive_cache wraps another drive device with a set associative,
+ * write-back block cache.
+ *
+ * - reads and writes are served from cache blocks of `block_size` bytes (a
+ *   multiple of the wrapped drive's addressable size)
+ * - written blocks are marked dirty and written to the drive when they are
+ *   evicted, on I_DRIVE_SETATTR with DRIVE_FLAG_SYNC and on close
+ * - sequential reads prefetch `read_ahead_count` blocks
+ * - hit and miss counts are reported by I_DRIVE_GETINFO
+ *
+ * Misses, write backs and read ahead are transferred to and from the wrapped
+ * drive in the background: each transfer is started from the completion of the
+ * previous one and the caller's request completes when its last block is in
+ * the cache. Read ahead stops as soon as a new request arrives.
+ *
+ * The cache doesn't wait for the wrapped drive to become ready. If the drive is
+ * still busy (a flash page program after a write back), a read or write is
+ * short (or fails with EBUSY if no bytes were transferred); poll I_DRIVE_ISBUSY
+ * and try again for the rest.
+ *
+ * I_DRIVE_SETATTR with only DRIVE_FLAG_SYNC starts the write back and returns;
+ * I_DRIVE_ISBUSY reports 1 until it is done (continuing it each time the drive
+ * is ready) and then returns any write back error. Other I_DRIVE_SETATTR flags
+ * are passed to the drive once the write back is done (until then they fail
+ * with EBUSY). A close waits for the write back before it closes the drive.
+ *
+ */
+
+enum {
+  DRIVE_CACHE_LINE_FLAG_IS_VALID = (1 << 0),
+  DRIVE_CACHE_LINE_FLAG_IS_DIRTY = (1 << 1)
+};
+
+enum {
+  DRIVE_CACHE_OP_NONE,
+  DRIVE_CACHE_OP_READ,
+  DRIVE_CACHE_OP_WRITE,
+  DRIVE_CACHE_OP_READ_AHEAD,
+  DRIVE_CACHE_OP_SYNC
+};
+
+enum {
+  DRIVE_CACHE_FLAG_IS_STARTING /*! The drive's read() or write() hasn't returned */ =
+    (1 << 0),
+  DRIVE_CACHE_FLAG_IS_COMPLETE /*! The transfer completed before it returned */ =
+    (1 << 1),
+  DRIVE_CACHE_FLAG_IS_WRITE_BACK /*! The line is written to the drive (else filled) */ =
+    (1 << 2),
+  DRIVE_CACHE_FLAG_IS_MISS /*! The current block was counted as a miss */ = (1 << 3),
+  DRIVE_CACHE_FLAG_IS_SYNC_PENDING /*! Dirty lines are to be written back */ = (1 << 4),
+  DRIVE_CACHE_FLAG_IS_RESUME /*! The line's write back stopped part way */ = (1 << 5)
+};
+
+typedef struct {
+  u32 block /*! The cached block number (location / block_size) */;
+  u32 access /*! Access stamp used for least recently used replacement */;
+  u32 o_flags /*! DRIVE_CACHE_LINE_FLAG_IS_VALID | DRIVE_CACHE_LINE_FLAG_IS_DIRTY */;
+} drive_cache_line_t;
+
+typedef struct {
+  devfs_transfer_handler_t transfer_handler /*! The caller's read and write requests */;
+  devfs_async_t async /*! The transfer issued to the cached drive */;
+  u32 hit_count;
+  u32 miss_count;
+  u32 access_count;
+  u32 next_block /*! Block following the last read (for read ahead) */;
+  u32 drive_size /*! Size of the drive in addressable units */;
+  u32 block /*! Next block to read ahead (or next line to write back) */;
+  u32 count /*! Blocks left to read ahead */;
+  int bytes /*! Bytes of the current request that are done */;
+  int result /*! Result of the operation that just finished */;
+  int sync_result /*! Error from a write back that finished in the background */;
+  u16 addressable_size;
+  u16 line /*! Line that is being transferred */;
+  u16 line_bytes /*! Bytes of the line that have been transferred */;
+  u8 op /*! DRIVE_CACHE_OP_* in progress */;
+  u8 o_flags /*! DRIVE_CACHE_FLAG_* */;
+  u8 close_count /*! Closes that wait for the write back to finish */;
+  u8 resd[3];
+} drive_cache_state_t;
+
+typedef struct {
+  devfs_device_t device /*! The drive that is cached */;
+  drive_cache_line_t *line_array /*! set_count * way_count lines */;
+  u8 *buffer /*! set_count * way_count * block_size bytes */;
+  u16 block_size /*! Bytes per cache block */;
+  u16 set_count;
+  u8 way_count;
+  u8 read_ahead_count /*! Blocks to prefetch for sequential reads (0 to disable) */;
+  u16 resd;
+} drive_cache_config_t;
+
+DEVFS_DRIVER_DECLARTION(drive_cache);
+
+#define DRIVE_CACHE_DECLARE_CONFIG_STATE(                                                \
+  cache_name, device_value, block_size_value, set_count_value, way_count_value,          \
+  read_ahead_value)                                                                      \
+  drive_cache_state_t cache_name##_state MCU_SYS_MEM;                                    \
+  drive_cache_line_t cache_name##_line_array[(set_count_value) * (way_count_value)]      \
+    MCU_SYS_MEM;                                                                         \
+  u8 cache_name##_buffer[(set_count_value) * (way_count_value) * (block_size_value)]     \
+    MCU_ALIGN(32);                                                                       \
+  const drive_cache_config_t cache_name##_config = {                                     \
+    .device = device_value,                                                              \
+    .line_array = cache_name##_line_array,                                               \
+    .buffer = cache_name##_buffer,                                                       \
+    .block_size = block_size_value,                                                      \
+    .set_count = set_count_value,                                                        \
+    .way_count = way_count_value,                                                        \
+    .read_ahead_count = read_ahead_value}
+
+#endif /* DEVICE_DRIVE_CACHE_H_ */
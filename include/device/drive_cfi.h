@@ -40,9 +40,23 @@ typedef struct {
     u8 erase_size3;
 } drive_cfi_sfdp_t;
 
+#define DRIVE_CFI_RANGE_COUNT 4
+
+//Range of erase blocks [start, end) by address
+typedef struct {
+	u32 start;
+	u32 end;
+} drive_cfi_range_t;
+
 typedef struct {
     mcu_event_handler_t handler;
 	 u8 is_initialized;
+	u8 is_erasing /*! An erase has been started and erasing_address to erasing_end is not yet on erased_list */;
+	u8 is_foreground /*! A read, write or attribute was requested since I_DRIVE_ISBUSY last reported idle */;
+	u32 erasing_address;
+	u32 erasing_end;
+	drive_cfi_range_t discard_list[DRIVE_CFI_RANGE_COUNT] /*! Discarded blocks that still need to be erased */;
+	drive_cfi_range_t erased_list[DRIVE_CFI_RANGE_COUNT] /*! Blocks that are erased and haven't been written */;
 } drive_cfi_state_t;
 
 typedef struct {
@@ -0,0 +1,81 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef DEVICE_DRIVE_QUEUE_H_
+#define DEVICE_DRIVE_QUEUE_H_
+
+#include "sos/dev/drive.h"
+#include "sos/fs/devfs.h"
+
+/*! \details drive_queue wraps another drive device with a request queue so
+ * several tasks can have reads and writes outstanding at the same time.
+ *
+ * - requests are queued (up to `depth`) while the drive is busy rather than
+ *   failing with EBUSY
+ * - the next transfer is chosen in location order (one-way elevator starting
+ *   from where the last transfer ended)
+ * - requests in the same direction that continue the chosen request are merged
+ *   into one transfer (up to `buffer_size` bytes) through `buffer` so the drive
+ *   can use a multi-block command
+ *
+ * I_DRIVE_SETATTR is only passed to the drive when the queue is empty
+ * (otherwise it fails with EBUSY).
+ *
+ */
+
+enum {
+  DRIVE_QUEUE_REQUEST_FLAG_IS_READ = (1 << 0),
+  DRIVE_QUEUE_REQUEST_FLAG_IS_ACTIVE = (1 << 1)
+};
+
+enum {
+  DRIVE_QUEUE_FLAG_IS_STARTING /*! The drive's read() or write() hasn't returned */ =
+    (1 << 0),
+  DRIVE_QUEUE_FLAG_IS_COMPLETE /*! The transfer completed before it returned */ =
+    (1 << 1)
+};
+
+typedef struct {
+  devfs_async_t *async /*! The caller's request (NULL if the slot is free or the
+                          caller gave up on it) */
+    ;
+  u32 offset /*! Offset of the request in the merged transfer */;
+  u16 o_flags /*! DRIVE_QUEUE_REQUEST_FLAG_IS_READ | DRIVE_QUEUE_REQUEST_FLAG_IS_ACTIVE */;
+  u16 resd;
+} drive_queue_request_t;
+
+typedef struct {
+  devfs_async_t async /*! The transfer issued to the drive */;
+  u32 position /*! Location following the last transfer */;
+  u32 transfer_count;
+  u32 merge_count /*! Requests that were merged into another transfer */;
+  u16 addressable_size;
+  u16 active_count /*! Requests in the transfer in progress */;
+  u8 is_read;
+  u8 o_flags /*! DRIVE_QUEUE_FLAG_IS_STARTING | DRIVE_QUEUE_FLAG_IS_COMPLETE */;
+  u8 resd[2];
+} drive_queue_state_t;
+
+typedef struct {
+  devfs_device_t device /*! The drive that is queued */;
+  drive_queue_request_t *request_array /*! depth requests */;
+  u8 *buffer /*! Buffer for merged transfers */;
+  u32 buffer_size;
+  u16 depth;
+  u16 resd;
+} drive_queue_config_t;
+
+DEVFS_DRIVER_DECLARTION(drive_queue);
+
+#define DRIVE_QUEUE_DECLARE_CONFIG_STATE(                                                \
+  queue_name, device_value, depth_value, buffer_size_value)                              \
+  drive_queue_state_t queue_name##_state MCU_SYS_MEM;                                    \
+  drive_queue_request_t queue_name##_request_array[depth_value] MCU_SYS_MEM;             \
+  u8 queue_name##_buffer[buffer_size_value] MCU_ALIGN(32);                               \
+  const drive_queue_config_t queue_name##_config = {                                     \
+    .device = device_value,                                                              \
+    .request_array = queue_name##_request_array,                                         \
+    .buffer = queue_name##_buffer,                                                       \
+    .buffer_size = buffer_size_value,                                                    \
+    .depth = depth_value}
+
+#endif /* DEVICE_DRIVE_QUEUE_H_ */
@@ -14,6 +14,8 @@ typedef struct {
   int *nbyte;
   int count;
   int timeout;
+  int block /*! Block of a multi-block transfer in progress */;
+  int block_count;
   uint8_t cmd[16];
   devfs_async_t op;
   mcu_event_handler_t handler;
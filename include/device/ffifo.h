@@ -8,7 +8,11 @@
 #include "sos/fs/devfs.h"
 
 typedef struct {
-  volatile fifo_atomic_position_t atomic_position;
+  union {
+    ring_t ring;
+    // deprecated -- the same word as ring (indices run over [0, 2*frame_count))
+    volatile fifo_atomic_position_t atomic_position;
+  };
   devfs_transfer_handler_t transfer_handler;
   volatile u32 o_flags;
 } ffifo_state_t;
@@ -34,6 +38,14 @@ int ffifo_ioctl_local(
   ffifo_state_t *state,
   int request,
   void *ctl) MCU_ROOT_EXEC_CODE;
+// acquire/release frames in place (I_FFIFO_ACQUIREREAD, I_FFIFO_RELEASEREAD,
+// I_FFIFO_ACQUIREWRITE, I_FFIFO_RELEASEWRITE)
+int ffifo_access_frames_local(
+  const ffifo_config_t *config,
+  ffifo_state_t *state,
+  int request,
+  ffifo_frames_t *frames,
+  int allow_callback) MCU_ROOT_EXEC_CODE;
 int ffifo_write_local(
   const ffifo_config_t *config,
   ffifo_state_t *state,
@@ -69,6 +81,10 @@ void ffifo_flush(ffifo_state_t *state) MCU_ROOT_EXEC_CODE;
 int ffifo_getinfo(ffifo_info_t *info, const ffifo_config_t *config, ffifo_state_t *state)
   MCU_ROOT_EXEC_CODE;
 
+// returns DEVFS_POLL_FLAG values for I_DEVFS_POLL
+int ffifo_poll(const ffifo_config_t *config, ffifo_state_t *state) MCU_ROOT_EXEC_CODE;
+
+// deprecated -- use ffifo_write_buffer(), ffifo_access_frames_local() or device/ring.h
 void ffifo_inc_head(ffifo_state_t *state, u16 count) MCU_ROOT_EXEC_CODE;
 void ffifo_inc_tail(ffifo_state_t *state, u16 count) MCU_ROOT_EXEC_CODE;
 int ffifo_is_write_ok(ffifo_state_t *state, u16 count, int writeblock) MCU_ROOT_EXEC_CODE;
@@ -3,6 +3,7 @@
 #ifndef DEVICE_FIFO_H_
 #define DEVICE_FIFO_H_
 
+#include "device/ring.h"
 #include "sos/dev/fifo.h"
 #include "sos/fs/devfs.h"
 
@@ -17,9 +18,13 @@ typedef union {
 } fifo_atomic_position_t;
 
 typedef struct {
-  volatile fifo_atomic_position_t atomic_position; // 4 bytes
-  devfs_transfer_handler_t transfer_handler;       // 8 bytes
-  volatile u32 o_flags;                            // 4 bytes
+  union {
+    ring_t ring; // 4 bytes
+    // deprecated -- the same word as ring (indices run over [0, 2*size))
+    volatile fifo_atomic_position_t atomic_position;
+  };
+  devfs_transfer_handler_t transfer_handler; // 8 bytes
+  volatile u32 o_flags;                      // 4 bytes
 } fifo_state_t;
 
 typedef struct MCU_PACK {
@@ -56,6 +61,10 @@ void fifo_flush(fifo_state_t *state) MCU_ROOT_EXEC_CODE;
 void fifo_getinfo(fifo_info_t *info, const fifo_config_t *cfgp, fifo_state_t *state)
   MCU_ROOT_EXEC_CODE;
 
+// returns DEVFS_POLL_FLAG values for I_DEVFS_POLL
+int fifo_poll(const fifo_config_t *cfgp, fifo_state_t *state) MCU_ROOT_EXEC_CODE;
+
+// deprecated -- use fifo_write_buffer(), fifo_push_buffer() or device/ring.h
 void fifo_inc_head(fifo_state_t *state, int size) MCU_ROOT_EXEC_CODE;
 void fifo_inc_tail(fifo_state_t *state, int size) MCU_ROOT_EXEC_CODE;
 int fifo_is_write_ok(fifo_state_t *state, u16 size, int writeblock) MCU_ROOT_EXEC_CODE;
@@ -84,6 +93,14 @@ int fifo_write_buffer(
   int nbyte,
   int non_blocking) MCU_ROOT_EXEC_CODE;
 
+// copies received data into the FIFO (used by drivers in the receive
+// callback) -- like fifo_inc_head() the oldest data is overwritten when full
+int fifo_push_buffer(
+  const fifo_config_t *cfgp,
+  fifo_state_t *state,
+  const char *buf,
+  int nbyte) MCU_ROOT_EXEC_CODE;
+
 int fifo_data_transmitted(const fifo_config_t *cfgp, fifo_state_t *state)
   MCU_ROOT_EXEC_CODE;
 void fifo_data_received(const fifo_config_t *cfgp, fifo_state_t *state)
@@ -0,0 +1,341 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef DEVICE_RING_H_
+#define DEVICE_RING_H_
+
+#include <sdk/types.h>
+#include <string.h>
+
+/*! \details Single producer, single consumer ring used by fifo, ffifo and cfifo.
+ *
+ * - `head` is written only by the producer and `tail` only by the consumer
+ * - both indices run freely over [0, 2*capacity) so a full ring (head - tail ==
+ *   capacity) and an empty ring (head == tail) are distinct without a sentinel
+ * - the producer publishes `head` with release ordering after the data is copied
+ *   and the consumer reads it with acquire ordering before copying (and the
+ *   reverse for `tail`)
+ *
+ * The capacity is the number of elements (bytes for a fifo, frames for an ffifo)
+ * and must be less than or equal to 32768. It does not need to be a power of 2.
+ *
+ * Drivers where hardware moves the data (stream_ffifo, i2s_ffifo) may need to
+ * resynchronize the other side's index from their interrupt: ring_drop() on a
+ * receive overflow or ring_produce() of zero filled frames on a transmit
+ * underflow. Both indices share one 32-bit word and every update is a 32-bit
+ * compare-and-swap of that word (LDREX/STREX on Cortex-M) so a resync that
+ * happens during a copy is detected (and the copy is retried) rather than
+ * overwritten.
+ *
+ */
+typedef union {
+  struct {
+    volatile u16 head /*! Next element to produce (low half of position) */;
+    volatile u16 tail /*! Next element to consume (high half of position) */;
+  };
+  volatile u32 position /*! Head and tail read or updated in one access */;
+} ring_t;
+
+#define RING_HEAD_SHIFT 0
+#define RING_TAIL_SHIFT 16
+
+/*! \cond */
+// the indices are always accessed through the 32-bit position (mixed size atomic
+// accesses aren't ordered by the C11 memory model) -- relaxed loads are for the
+// side that owns the index
+static inline u32 ring_load_relaxed(const ring_t *ring, u32 shift) {
+  return (__atomic_load_n(&ring->position, __ATOMIC_RELAXED) >> shift) & 0xffff;
+}
+
+static inline u32 ring_load_head(const ring_t *ring) {
+  return (__atomic_load_n(&ring->position, __ATOMIC_ACQUIRE) >> RING_HEAD_SHIFT) & 0xffff;
+}
+
+static inline u32 ring_load_tail(const ring_t *ring) {
+  return (__atomic_load_n(&ring->position, __ATOMIC_ACQUIRE) >> RING_TAIL_SHIFT) & 0xffff;
+}
+
+static inline u32 ring_wrap(u32 index, u32 capacity) {
+  return index >= (capacity << 1) ? index - (capacity << 1) : index;
+}
+
+static inline u32 ring_distance(u32 head, u32 tail, u32 capacity) {
+  const s32 distance = (s32)head - (s32)tail;
+  return distance < 0 ? distance + (capacity << 1) : distance;
+}
+
+// replaces the head or tail (\a shift) with \a value if it is still \a expected --
+// the other index may change at any time and doesn't cause a failure
+static inline int ring_publish(ring_t *ring, u32 shift, u32 expected, u32 value) {
+  u32 position = __atomic_load_n(&ring->position, __ATOMIC_RELAXED);
+  u32 next;
+  do {
+    if (((position >> shift) & 0xffff) != expected) {
+      return 0;
+    }
+    next = (position & ~(0xffffUL << shift)) | (value << shift);
+  } while (!__atomic_compare_exchange_n(
+    &ring->position, &position, next, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+  return 1;
+}
+/*! \endcond */
+
+/*! \details Returns the element offset in the buffer of \a index. */
+static inline u32 ring_offset(u32 index, u32 capacity) {
+  return index >= capacity ? index - capacity : index;
+}
+
+/*! \details Returns the number of elements ready to be consumed. */
+static inline u32 ring_count(const ring_t *ring, u32 capacity) {
+  return ring_distance(ring_load_head(ring), ring_load_tail(ring), capacity);
+}
+
+/*! \details Returns the number of elements that can be produced. */
+static inline u32 ring_free(const ring_t *ring, u32 capacity) {
+  return capacity - ring_count(ring, capacity);
+}
+
+static inline int ring_is_empty(const ring_t *ring) {
+  return ring_load_head(ring) == ring_load_tail(ring);
+}
+
+static inline int ring_is_full(const ring_t *ring, u32 capacity) {
+  return ring_count(ring, capacity) == capacity;
+}
+
+/*! \details Returns the offset of the next element to produce. */
+static inline u32 ring_head_offset(const ring_t *ring, u32 capacity) {
+  return ring_offset(ring_load_relaxed(ring, RING_HEAD_SHIFT), capacity);
+}
+
+/*! \details Returns the offset of the next element to consume. */
+static inline u32 ring_tail_offset(const ring_t *ring, u32 capacity) {
+  return ring_offset(ring_load_relaxed(ring, RING_TAIL_SHIFT), capacity);
+}
+
+/*! \details Resets the ring to empty. Both sides must be idle. */
+static inline void ring_init(ring_t *ring) {
+  __atomic_store_n(&ring->position, 0, __ATOMIC_RELEASE);
+}
+
+/*! \details Discards everything that is ready (consumer side flush). */
+static inline void ring_flush(ring_t *ring) {
+  u32 tail;
+  do {
+    tail = ring_load_tail(ring);
+  } while (!ring_publish(ring, RING_TAIL_SHIFT, tail, ring_load_head(ring)));
+}
+
+/*! \details Publishes \a count elements that the producer has already placed
+ * in the buffer (for example by DMA). The caller must not exceed ring_free().
+ */
+static inline void ring_produce(ring_t *ring, u32 capacity, u32 count) {
+  const u32 head = ring_load_relaxed(ring, RING_HEAD_SHIFT);
+  ring_publish(ring, RING_HEAD_SHIFT, head, ring_wrap(head + count, capacity));
+}
+
+/*! \details Releases \a count elements the consumer has finished with. The
+ * caller must not exceed ring_count().
+ */
+static inline void ring_consume(ring_t *ring, u32 capacity, u32 count) {
+  const u32 tail = ring_load_relaxed(ring, RING_TAIL_SHIFT);
+  ring_publish(ring, RING_TAIL_SHIFT, tail, ring_wrap(tail + count, capacity));
+}
+
+/*! \details Discards up to \a count of the oldest elements and returns the
+ * number discarded.
+ *
+ * The producer may call this to recover from an overflow (or to make room
+ * for new data). A copy the consumer has in progress sees the tail move and
+ * is retried.
+ */
+static inline u32 ring_drop(ring_t *ring, u32 capacity, u32 count) {
+  u32 tail;
+  u32 dropped;
+  do {
+    tail = ring_load_tail(ring);
+    dropped = ring_distance(ring_load_head(ring), tail, capacity);
+    if (dropped > count) {
+      dropped = count;
+    }
+  } while (!ring_publish(
+    ring, RING_TAIL_SHIFT, tail, ring_wrap(tail + dropped, capacity)));
+  return dropped;
+}
+
+/*! \details Returns the number of contiguous elements ready at the tail (up to
+ * \a count, 0 for no limit) so the consumer can use them in place. \a index is
+ * assigned the tail to pass to ring_release_read().
+ */
+static inline u32
+ring_acquire_read(const ring_t *ring, u32 capacity, u32 count, u32 *index) {
+  const u32 tail = ring_load_relaxed(ring, RING_TAIL_SHIFT);
+  u32 ready = ring_distance(ring_load_head(ring), tail, capacity);
+  const u32 contiguous = capacity - ring_offset(tail, capacity);
+  if (ready > contiguous) {
+    ready = contiguous;
+  }
+  if (count && (ready > count)) {
+    ready = count;
+  }
+  *index = tail;
+  return ready;
+}
+
+/*! \details Consumes \a count elements acquired with ring_acquire_read().
+ *
+ * Returns 1 on success, 0 if the tail was moved by a resync while the elements
+ * were held (nothing is consumed) or -1 if \a count is more than was ready.
+ */
+static inline int ring_release_read(ring_t *ring, u32 capacity, u32 index, u32 count) {
+  if (
+    (index >= (capacity << 1))
+    || (count > ring_distance(ring_load_head(ring), index, capacity))) {
+    return ring_load_relaxed(ring, RING_TAIL_SHIFT) == index ? -1 : 0;
+  }
+  return ring_publish(ring, RING_TAIL_SHIFT, index, ring_wrap(index + count, capacity));
+}
+
+/*! \details Returns the number of contiguous free elements at the head (up to
+ * \a count, 0 for no limit) so the producer can fill them in place. \a index is
+ * assigned the head to pass to ring_release_write().
+ */
+static inline u32
+ring_acquire_write(const ring_t *ring, u32 capacity, u32 count, u32 *index) {
+  const u32 head = ring_load_relaxed(ring, RING_HEAD_SHIFT);
+  u32 available = capacity - ring_distance(head, ring_load_tail(ring), capacity);
+  const u32 contiguous = capacity - ring_offset(head, capacity);
+  if (available > contiguous) {
+    available = contiguous;
+  }
+  if (count && (available > count)) {
+    available = count;
+  }
+  *index = head;
+  return available;
+}
+
+/*! \details Produces \a count elements acquired with ring_acquire_write().
+ *
+ * Returns 1 on success, 0 if the head was moved by a resync while the elements
+ * were held (nothing is produced) or -1 if \a count is more than was free.
+ */
+static inline int
+ring_release_write(ring_t *ring, u32 capacity, u32 index, u32 count) {
+  if (
+    (index >= (capacity << 1))
+    || (count > capacity - ring_distance(index, ring_load_tail(ring), capacity))) {
+    return ring_load_relaxed(ring, RING_HEAD_SHIFT) == index ? -1 : 0;
+  }
+  return ring_publish(ring, RING_HEAD_SHIFT, index, ring_wrap(index + count, capacity));
+}
+
+/*! \details Copies up to \a count elements of \a element_size bytes from \a src
+ * into the ring with at most two memcpy() calls and publishes the head once.
+ *
+ * Returns the number of elements written. When \a element_size is a constant,
+ * the copy is specialized at compile time because this function is inlined.
+ */
+static inline u32 ring_write(
+  ring_t *ring,
+  u32 capacity,
+  u32 element_size,
+  char *buffer,
+  const void *src,
+  u32 count) {
+  const char *src_buffer = src;
+  u32 head;
+  do {
+    head = ring_load_relaxed(ring, RING_HEAD_SHIFT);
+    const u32 available =
+      capacity - ring_distance(head, ring_load_tail(ring), capacity);
+    if (count > available) {
+      count = available;
+    }
+    if (count == 0) {
+      return 0;
+    }
+
+    const u32 offset = ring_offset(head, capacity);
+    u32 first = capacity - offset;
+    if (first > count) {
+      first = count;
+    }
+    memcpy(buffer + offset * element_size, src_buffer, first * element_size);
+    memcpy(buffer, src_buffer + first * element_size, (count - first) * element_size);
+  } while (
+    !ring_publish(ring, RING_HEAD_SHIFT, head, ring_wrap(head + count, capacity)));
+  return count;
+}
+
+/*! \details Copies \a count elements into the ring like ring_write() but drops the
+ * oldest elements to make room (only the newest \a capacity elements are kept if
+ * \a count is larger than the ring).
+ *
+ * Returns the number of elements that were lost (0 if everything fit).
+ */
+static inline u32 ring_write_overwrite(
+  ring_t *ring,
+  u32 capacity,
+  u32 element_size,
+  char *buffer,
+  const void *src,
+  u32 count) {
+  const char *src_buffer = src;
+  u32 lost = 0;
+  if (count > capacity) {
+    lost = count - capacity;
+    src_buffer += lost * element_size;
+    count = capacity;
+  }
+
+  while (count) {
+    const u32 available = ring_free(ring, capacity);
+    if (count > available) {
+      lost += ring_drop(ring, capacity, count - available);
+    }
+    const u32 written =
+      ring_write(ring, capacity, element_size, buffer, src_buffer, count);
+    src_buffer += written * element_size;
+    count -= written;
+  }
+  return lost;
+}
+
+/*! \details Copies up to \a count elements of \a element_size bytes out of the
+ * ring into \a dest with at most two memcpy() calls and publishes the tail once.
+ *
+ * Returns the number of elements read.
+ */
+static inline u32 ring_read(
+  ring_t *ring,
+  u32 capacity,
+  u32 element_size,
+  const char *buffer,
+  void *dest,
+  u32 count) {
+  char *dest_buffer = dest;
+  u32 tail;
+  do {
+    tail = ring_load_relaxed(ring, RING_TAIL_SHIFT);
+    const u32 ready = ring_distance(ring_load_head(ring), tail, capacity);
+    if (count > ready) {
+      count = ready;
+    }
+    if (count == 0) {
+      return 0;
+    }
+
+    const u32 offset = ring_offset(tail, capacity);
+    u32 first = capacity - offset;
+    if (first > count) {
+      first = count;
+    }
+    memcpy(dest_buffer, buffer + offset * element_size, first * element_size);
+    memcpy(
+      dest_buffer + first * element_size, buffer, (count - first) * element_size);
+  } while (
+    !ring_publish(ring, RING_TAIL_SHIFT, tail, ring_wrap(tail + count, capacity)));
+  return count;
+}
+
+#endif /* DEVICE_RING_H_ */
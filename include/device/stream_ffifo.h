@@ -28,6 +28,15 @@ typedef struct {
   u32 tx_loc;
 } stream_ffifo_config_t;
 
+// D-cache line size of the Cortex-M7 -- each half of a stream buffer must start on a
+// line and span whole lines so DMA halves can be invalidated independently
+#define STREAM_FFIFO_CACHE_LINE_SIZE 32
+
+// rounds the buffer up to whole cache lines so it doesn't share a line with other data
+#define STREAM_FFIFO_BUFFER_SIZE(count_value, frame_size_value)                          \
+  ((((count_value) * (frame_size_value)) + STREAM_FFIFO_CACHE_LINE_SIZE - 1)             \
+   & ~(STREAM_FFIFO_CACHE_LINE_SIZE - 1))
+
 int stream_ffifo_open(const devfs_handle_t *handle) MCU_ROOT_EXEC_CODE;
 int stream_ffifo_ioctl(const devfs_handle_t *handle, int request, void *ctl)
   MCU_ROOT_EXEC_CODE;
@@ -39,7 +48,8 @@ int stream_ffifo_close(const devfs_handle_t *handle) MCU_ROOT_EXEC_CODE;
 
 #define STREAM_FFIFO_DECLARE_CONFIG_STATE_RX_ONLY(                                       \
   name, frame_size_value, count_value, device_value, loc_value)                          \
-  char name##_rx_buffer[count_value * frame_size_value] MCU_ALIGN(32);                   \
+  char name##_rx_buffer[STREAM_FFIFO_BUFFER_SIZE(count_value, frame_size_value)]         \
+    MCU_ALIGN(STREAM_FFIFO_CACHE_LINE_SIZE);                                             \
   stream_ffifo_state_t name##_state MCU_SYS_MEM;                                         \
   const stream_ffifo_config_t name##_config = {                                          \
     .device = device_value,                                                              \
@@ -53,7 +63,8 @@ int stream_ffifo_close(const devfs_handle_t *handle) MCU_ROOT_EXEC_CODE;
 
 #define STREAM_FFIFO_DECLARE_CONFIG_STATE_TX_ONLY(                                       \
   name, frame_size_value, count_value, device_value, loc_value)                          \
-  char name##_tx_buffer[count_value * frame_size_value] MCU_ALIGN(32);                   \
+  char name##_tx_buffer[STREAM_FFIFO_BUFFER_SIZE(count_value, frame_size_value)]         \
+    MCU_ALIGN(STREAM_FFIFO_CACHE_LINE_SIZE);                                             \
   stream_ffifo_state_t name##_state MCU_SYS_MEM;                                         \
   const stream_ffifo_config_t name##_config = {                                          \
     .device = device_value,                                                              \
@@ -67,8 +78,10 @@ int stream_ffifo_close(const devfs_handle_t *handle) MCU_ROOT_EXEC_CODE;
 
 #define STREAM_FFIFO_DECLARE_CONFIG_STATE(                                               \
   name, frame_size_value, count_value, device_value, tx_loc_value, rx_loc_value)         \
-  char name##_rx_buffer[count_value * frame_size_value] MCU_ALIGN(32);                   \
-  char name##_tx_buffer[count_value * frame_size_value] MCU_ALIGN(32);                   \
+  char name##_rx_buffer[STREAM_FFIFO_BUFFER_SIZE(count_value, frame_size_value)]         \
+    MCU_ALIGN(STREAM_FFIFO_CACHE_LINE_SIZE);                                             \
+  char name##_tx_buffer[STREAM_FFIFO_BUFFER_SIZE(count_value, frame_size_value)]         \
+    MCU_ALIGN(STREAM_FFIFO_CACHE_LINE_SIZE);                                             \
   stream_ffifo_state_t name##_state MCU_SYS_MEM;                                         \
   stream_ffifo_config_t name##_config = {                                                \
     .device = device_value,                                                              \
@@ -6,21 +6,38 @@
 #include "sos/fs/types.h"
 #include "sos/dev/switchboard.h"
 
+#define SWITCHBOARD_OUTPUT_COUNT 4 //max outputs per connection (fan out)
+#define SWITCHBOARD_BUFFER_COUNT_MAX 8 //max buffers in a connection ring
+
+struct switchboard_state;
+
 typedef struct {
     const devfs_device_t * device;
     devfs_async_t async;
     u32 bytes_transferred;
+    struct switchboard_state * connection; //connection the terminal belongs to
+    u16 stall_count; //times the terminal was ready but the ring was full (input) or empty (output)
+    u8 buffer_index; //ring buffer the terminal reads or writes next
+    u8 is_stalled;
+    u8 is_async; //waiting for an asynchronous write to complete (outputs only)
+    u8 resd[3];
 } switchboard_state_terminal_t;
 
-typedef struct {
+typedef struct switchboard_state {
     u32 o_flags;
     switchboard_state_terminal_t input;
-    switchboard_state_terminal_t output;
+    switchboard_state_terminal_t output[SWITCHBOARD_OUTPUT_COUNT];
     s32 nbyte; //total number of bytes -- set to 0 for persistent connections
-    void * buffer[2]; //circular buffer pointers
-    u16 bytes_in_buffer[2];
+    u8 * buffer; //first buffer in the ring
+    u16 bytes_in_buffer[SWITCHBOARD_BUFFER_COUNT_MAX];
+    u8 o_pending[SWITCHBOARD_BUFFER_COUNT_MAX]; //outputs that still need to write each buffer
+    u16 buffer_size;
+    u8 buffer_count;
+    u8 output_count;
     u16 transaction_limit;
     u16 packet_size;
+    u32 start_ms;
+    u32 duration_ms; //set when the connection stops
     mcu_event_handler_t event_handler;
 } switchboard_state_t;
 
@@ -29,8 +46,8 @@ typedef struct {
     u16 connection_count; //max number of connections allowed
     u16 connection_buffer_size; //actual bytes available per transaction
     u16 transaction_limit; //max 65535 means users can't make this so high it triggers the WDT
-    u16 resd;
-    void * buffer; //array of buffers (connection_count * 2 * connection_buffer_size)
+    u16 buffer_count; //buffers per connection (0 is the same as 2)
+    void * buffer; //array of buffers (connection_count * buffer_count * connection_buffer_size)
 } switchboard_config_t;
 
 #ifdef __cplusplus
@@ -43,18 +60,24 @@ int switchboard_read(const devfs_handle_t * handle, devfs_async_t * rop);
 int switchboard_write(const devfs_handle_t * handle, devfs_async_t * wop);
 int switchboard_close(const devfs_handle_t * handle);
 
-#define SWITCHBOARD_DECLARE_CONFIG_STATE(switchboard_name, devfs_list_value, connection_count_value, connection_buffer_size_value, \
-    transaction_limit_value ) \
-    char switchboard_name##_buffer[connection_count_value*connection_buffer_size_value*2]; \
+#define SWITCHBOARD_DECLARE_CONFIG_STATE_RING(switchboard_name, devfs_list_value, connection_count_value, connection_buffer_size_value, \
+    transaction_limit_value, buffer_count_value ) \
+    char switchboard_name##_buffer[connection_count_value*connection_buffer_size_value*buffer_count_value]; \
     switchboard_state_t switchboard_name##_state[connection_count_value] MCU_SYS_MEM; \
     const switchboard_config_t switchboard_name##_config = { \
       .devfs_list = devfs_list_value, \
       .connection_count = connection_count_value, \
       .connection_buffer_size = connection_buffer_size_value, \
       .transaction_limit = transaction_limit_value, \
+      .buffer_count = buffer_count_value, \
       .buffer = switchboard_name##_buffer \
     }
 
+#define SWITCHBOARD_DECLARE_CONFIG_STATE(switchboard_name, devfs_list_value, connection_count_value, connection_buffer_size_value, \
+    transaction_limit_value ) \
+    SWITCHBOARD_DECLARE_CONFIG_STATE_RING(switchboard_name, devfs_list_value, connection_count_value, connection_buffer_size_value, \
+    transaction_limit_value, 2)
+
 
 #ifdef __cplusplus
 }
@@ -12,6 +12,7 @@
 #include <sys/signal.h>
 #include <sys/types.h>
 #include "sos/fs/types.h"
+#include "device/ring.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -45,6 +46,30 @@ struct aiocb {
 #define LIO_WAIT 7
 #define LIO_WRITE 8
 
+/*! \brief AIO Ring
+ * \details Submission and completion queues that are shared between the
+ * application and the kernel (Stratify OS extension).
+ *
+ * The application queues aiocb's with aio_ring_put() and starts all of them
+ * with aio_ring_submit(). Completed aiocb's are posted to the completion queue
+ * by the kernel and are retrieved with aio_ring_get(). Neither aio_ring_put()
+ * nor aio_ring_get() needs a system call. aio_ring_wait() blocks until a
+ * completion is ready.
+ *
+ * Both queues are arrays of \a capacity pointers provided by the application.
+ *
+ */
+typedef struct aio_ring {
+	ring_t submit /*! \brief Produced by aio_ring_put() and consumed by aio_ring_submit() */;
+	ring_t complete /*! \brief Produced by the kernel and consumed by aio_ring_get() */;
+	struct aiocb ** submit_queue /*! \brief The submission queue */;
+	struct aiocb ** complete_queue /*! \brief The completion queue */;
+	u16 capacity /*! \brief The number of entries in each queue */;
+	volatile u16 pending /*! \brief Operations that are started but not complete */;
+	volatile u8 is_waiting /*! \brief Set when a thread is blocked in aio_ring_wait() */;
+	u8 resd[3];
+} aio_ring_t;
+
 int aio_cancel(int fildes, struct aiocb * aiocbp);
 int aio_error(const struct aiocb * aiocbp);
 int aio_fsync(int, struct aiocb * aiocbp);
@@ -54,6 +79,12 @@ int aio_suspend(struct aiocb *const list[], int nent, const struct timespec * ti
 int aio_write(struct aiocb * aiocbp);
 int lio_listio(int mode, struct aiocb * const list[], int nent, struct sigevent * sig);
 
+int aio_ring_init(aio_ring_t * ring, struct aiocb ** submit_queue, struct aiocb ** complete_queue, u16 capacity);
+int aio_ring_put(aio_ring_t * ring, struct aiocb * aiocbp);
+int aio_ring_submit(aio_ring_t * ring);
+struct aiocb * aio_ring_get(aio_ring_t * ring);
+int aio_ring_wait(aio_ring_t * ring, const struct timespec * timeout);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,53 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+/*! \addtogroup poll
+ * @{
+ */
+
+/*! \file */
+
+#ifndef POLL_H_
+#define POLL_H_
+
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// the values match lwIP (LWIP_SOCKET_POLL) so the definitions can be shared
+#if !defined POLLIN
+#define POLLIN 0x1
+#define POLLOUT 0x2
+#define POLLERR 0x4
+#define POLLNVAL 0x8
+#define POLLRDNORM 0x10
+#define POLLRDBAND 0x20
+#define POLLPRI 0x40
+#define POLLWRNORM 0x80
+#define POLLWRBAND 0x100
+#define POLLHUP 0x200
+
+typedef unsigned int nfds_t;
+
+/*! \brief Poll Data Structure
+ * \details This is the data structure used
+ * to describe a file descriptor to poll().
+ *
+ */
+struct pollfd {
+  int fd /*! \brief The file descriptor (negative values are ignored) */;
+  short events /*! \brief The events to wait for */;
+  short revents /*! \brief The events that occurred */;
+};
+#endif
+
+int poll(struct pollfd fds[], nfds_t nfds, int timeout);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* POLL_H_ */
+
+/*! @} */
@@ -0,0 +1,22 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SYS_SENDFILE_H_
+#define SYS_SENDFILE_H_
+
+#if !defined __link
+
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+ssize_t sendfile(int out_fd, int in_fd, off_t *offset, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+#endif /* SYS_SENDFILE_H_ */
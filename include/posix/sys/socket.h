@@ -59,8 +59,7 @@ int sendto(
   socklen_t tolen);
 int socket(int domain, int type, int protocol);
 
-// these functions are currently only for sockets but should be supported on non-sockets
-// as well
+// these functions also work with regular file descriptors (see sys/uio.h and poll.h)
 int writev(int s, const struct iovec *iov, int iovcnt);
 int select(
   int maxfdp1,
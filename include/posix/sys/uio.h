@@ -0,0 +1,37 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SYS_UIO_H_
+#define SYS_UIO_H_
+
+#if !defined __link
+
+#include <sys/types.h>
+
+// lwIP defines struct iovec (SOS_BOOTSTRAP_SOCKETS only declares it)
+#include "sys/socket.h"
+
+#if SOS_BOOTSTRAP_SOCKETS
+struct iovec {
+  void *iov_base;
+  size_t iov_len;
+};
+#endif
+
+#if !defined IOV_MAX
+#define IOV_MAX 16
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int readv(int fildes, const struct iovec *iov, int iovcnt);
+int writev(int fildes, const struct iovec *iov, int iovcnt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+#endif /* SYS_UIO_H_ */
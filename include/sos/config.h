@@ -244,6 +244,8 @@ typedef struct MCU_PACK {
   devfs_handle_t flash_handle;
   int (*flash_erase_page)(const devfs_handle_t *handle, void *ctl);
   int (*flash_write_page)(const devfs_handle_t *handle, void *ctl);
+  // optional: flash_pageinfo_t with page set (needed for delta updates)
+  int (*flash_get_page_info)(const devfs_handle_t *handle, void *ctl);
   link_transport_driver_t *link_transport_driver;
 } sos_boot_config_t;
 
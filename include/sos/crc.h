@@ -0,0 +1,41 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SOS_CRC_H
+#define SOS_CRC_H
+
+#include <sdk/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! \details Kernel CRC functions.
+ *
+ * Each function continues from \a crc (the value returned by a previous call
+ * or 0 to start) so a buffer can be checked in pieces.
+ *
+ * - sos_crc7(): polynomial 0x09, 7-bit result (SD commands send `(crc << 1) | 1`)
+ * - sos_crc16_ccitt(): polynomial 0x1021, no reflection or final xor (XMODEM,
+ *   SD data blocks)
+ * - sos_crc32(): IEEE 802.3 (reflected 0xEDB88320), as used by zlib
+ * - sos_crc32c(): Castagnoli (reflected 0x82F63B78)
+ *
+ * The implementation is selected at build time: CONFIG_CRC_SLICE_COUNT is 1
+ * for byte-wise tables or 4 or 8 for slicing tables (faster but 4 or 8 times
+ * the flash). When CONFIG_CRC_IS_MCU is set, sos_crc16_ccitt() uses
+ * mcu_calc_crc16() from the MCU port (which may use a CRC peripheral).
+ *
+ * Check values of "123456789": 0x75, 0x31C3, 0xCBF43926 and 0xE3069283.
+ *
+ */
+
+u8 sos_crc7(u8 crc, const void *buffer, u32 nbyte);
+u16 sos_crc16_ccitt(u16 crc, const void *buffer, u32 nbyte);
+u32 sos_crc32(u32 crc, const void *buffer, u32 nbyte);
+u32 sos_crc32c(u32 crc, const void *buffer, u32 nbyte);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SOS_CRC_H */
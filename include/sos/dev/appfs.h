@@ -11,7 +11,7 @@
 #define APPFS_RAM_USAGE_WORDS(x) (((x) * 2 + 31) / 32)
 #define APPFS_IOC_IDENT_CHAR 'a'
 
-#define APPFS_DEV_VERSION 0x400
+#define APPFS_DEV_VERSION 0x402
 
 enum appfs_flags {
   APPFS_FLAG_IS_FLASH /*! Application is stored in flash */ = (1 << 0),
@@ -40,6 +40,9 @@ enum appfs_flags {
   = (1 << 10),
   APPFS_FLAG_IS_HASHED /*! Application binary has SHA256 hash appended to the end */ =
     (1 << 11),
+  APPFS_FLAG_IS_RELOCATION_TABLE /*! Application binary has a relocation table (installed
+                                    using \ref APPFS_INSTALL_LOC_RELOCATION) */
+  = (1 << 12),
 };
 
 #define APPFS_PAGE_SIZE 256
@@ -51,6 +54,32 @@ typedef struct {
 
 typedef appfs_installattr_t appfs_createattr_t;
 
+/*! \details When an application has \ref APPFS_FLAG_IS_RELOCATION_TABLE set, the
+ * words that hold addresses are listed in a bitmap (one bit per 32-bit word of
+ * the code and data, LSB first) that follows the image. Only listed words are
+ * translated when installing.
+ *
+ * The bitmap is installed one page at a time by OR'ing the image location with
+ * APPFS_INSTALL_LOC_RELOCATION. One page of the bitmap covers
+ * APPFS_RELOCATION_PAGE_SIZE bytes of the image starting at that location (which
+ * must be a multiple of APPFS_RELOCATION_PAGE_SIZE) and is sent just before the
+ * image page at the same location so the install stream (and its hash) is the
+ * same for every installer.
+ */
+#define APPFS_INSTALL_LOC_RELOCATION 0x80000000
+#define APPFS_RELOCATION_PAGE_SIZE (APPFS_PAGE_SIZE * 8 * 4)
+
+/*! \details An application can be installed from a compressed image (see
+ * sos/lz.h) by OR'ing the location in the compressed data with
+ * APPFS_INSTALL_LOC_COMPRESSED. The compressed data is sent in order starting
+ * at zero. It is decompressed one page at a time and installed the same as the
+ * uncompressed image (the signature is calculated on the uncompressed image).
+ *
+ * Applications with \ref APPFS_FLAG_IS_RELOCATION_TABLE must be installed
+ * uncompressed.
+ */
+#define APPFS_INSTALL_LOC_COMPRESSED 0x40000000
+
 typedef struct MCU_PACK {
   u16 mode;
   u16 version;
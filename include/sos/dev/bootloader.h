@@ -72,6 +72,31 @@ typedef struct MCU_PACK {
   u8 buf[BOOTLOADER_WRITEPAGESIZE] /*! \brief A buffer for writing to the flash */;
 } bootloader_writepage_t;
 
+/*! \brief The maximum number of pages in a bootloader_page_hash_t.
+ */
+#define BOOTLOADER_PAGE_HASH_MAX 64
+
+/*! \brief See details below.
+ * \details This structure is used with \ref I_BOOTLOADER_GET_PAGE_HASH to
+ * compare the pages in the flash with a new image.
+ */
+typedef struct MCU_PACK {
+  u32 addr /*! \brief The address of the first page */;
+  u32 count /*! \brief The number of pages (up to BOOTLOADER_PAGE_HASH_MAX) */;
+  u32 crc[BOOTLOADER_PAGE_HASH_MAX] /*! \brief CRC-32 of each BOOTLOADER_WRITEPAGESIZE
+                                       page (written by the bootloader) */;
+} bootloader_page_hash_t;
+
+/*! \brief See details below.
+ * \details This structure is used with \ref I_BOOTLOADER_ERASE_RANGE.
+ */
+typedef struct MCU_PACK {
+  u32 addr /*! \brief The address to erase (the bootloader writes the start of
+              the erased range) */;
+  u32 nbyte /*! \brief The number of bytes to erase (the bootloader writes the
+               size of the erased range) */;
+} bootloader_erase_range_t;
+
 typedef struct {
   u8 * result;
   const u8 * auth_data;
@@ -146,6 +171,14 @@ extern void boot_invoke_bootloader(void *args);
 /*! \brief See below for details.
  * \details This request writes a page to the flash memory.
  *
+ * The bootloader replies as soon as the page is received and then hashes
+ * and writes it while the host sends the next page. If the page can't be
+ * written, the error is returned by the next page (or by
+ * \ref I_BOOTLOADER_GET_WRITE_STATUS or \ref I_BOOTLOADER_VERIFY_SIGNATURE)
+ * and no more pages are written until the flash is erased. The host issues
+ * \ref I_BOOTLOADER_GET_WRITE_STATUS after the last page (bootloader version
+ * 0x401 and higher).
+ *
  * \code
  * bootloader_writepage_t attr;
  * attr.loc = 0x1000;
@@ -163,6 +196,62 @@ extern void boot_invoke_bootloader(void *args);
 #define I_BOOTLOADER_IS_SIGNATURE_REQUIRED _IOCTL(BOOTLOADER_IOC_IDENT_CHAR, 5)
 #define I_BOOTLOADER_GET_PUBLIC_KEY _IOCTLR(BOOTLOADER_IOC_IDENT_CHAR, 6, auth_public_key_t)
 
+/*! \brief See below for details.
+ * \details This request writes part of a compressed image (see sos/lz.h).
+ * attr.addr is the location of attr.buf in the compressed data (starting at
+ * zero and written in order). The bootloader decompresses the data and writes
+ * it to the flash starting at the program start address the same as
+ * I_BOOTLOADER_WRITEPAGE (so the signature is calculated on the uncompressed
+ * image).
+ *
+ * Use link_writeflash_compressed() to compress and write an image.
+ */
+#define I_BOOTLOADER_WRITEPAGE_COMPRESSED                                                \
+  _IOCTLW(BOOTLOADER_IOC_IDENT_CHAR, 7, bootloader_writepage_t)
+
+/*! \brief See below for details.
+ * \details This request calculates the CRC-32 of each page in a range of the
+ * flash so the host can find the pages that differ from a new image.
+ *
+ * Delta updates use this request with \ref I_BOOTLOADER_ERASE_RANGE
+ * instead of \ref I_BOOTLOADER_ERASE (see link_writeflash_delta()):
+ * - the host compares the page hashes to the new image
+ * - the sectors that have changed pages are erased (the first range must
+ *   start at the program start address so the application can't run until
+ *   the signature is verified)
+ * - every page in the erased ranges plus the last page of the image are
+ *   written (in order) with \ref I_BOOTLOADER_WRITEPAGE
+ *
+ * Pages that aren't written are hashed from the flash when the signature is
+ * verified. Bootloaders that don't support these requests (or that don't
+ * provide sos_config.boot.flash_get_page_info) return an error.
+ */
+#define I_BOOTLOADER_GET_PAGE_HASH                                                       \
+  _IOCTLRW(BOOTLOADER_IOC_IDENT_CHAR, 8, bootloader_page_hash_t)
+
+/*! \brief See below for details.
+ * \details This request erases the flash sectors that overlap
+ * attr.addr to attr.addr + attr.nbyte. The bootloader writes the range that
+ * was erased (whole sectors) back to attr.
+ *
+ * A range that starts at the program start address begins a new update.
+ * Other ranges are only erased until the update ends with
+ * \ref I_BOOTLOADER_VERIFY_SIGNATURE.
+ */
+#define I_BOOTLOADER_ERASE_RANGE                                                         \
+  _IOCTLRW(BOOTLOADER_IOC_IDENT_CHAR, 9, bootloader_erase_range_t)
+
+/*! \brief See below for details.
+ * \details This request waits for the last page sent with
+ * \ref I_BOOTLOADER_WRITEPAGE (or \ref I_BOOTLOADER_WRITEPAGE_COMPRESSED) to be
+ * written. It returns zero if every page since the flash was erased was
+ * written or -1 with the error of the page that failed.
+ *
+ * Bootloaders before version 0x401 reply to each page after it is written and
+ * don't support this request.
+ */
+#define I_BOOTLOADER_GET_WRITE_STATUS _IOCTL(BOOTLOADER_IOC_IDENT_CHAR, 10)
+
 #define I_BOOTLOADER_TOTAL 4
 
 #ifdef __cplusplus
@@ -32,7 +32,7 @@
 
 #include <sdk/types.h>
 
-#define DRIVE_VERSION (0x030000)
+#define DRIVE_VERSION (0x030100)
 #define DRIVE_IOC_IDENT_CHAR 'd'
 
 enum {
@@ -44,7 +44,9 @@ enum {
 	DRIVE_FLAG_POWERDOWN /*! Puts the drive in power down mode. */ = (1<<4),
 	DRIVE_FLAG_POWERUP /*! Powers up the driver (after power down). */ = (1<<5),
 	DRIVE_FLAG_INIT /*! Initializes the drive. */ = (1<<6),
-	DRIVE_FLAG_RESET /*! Issue a reset to the drive. */ = (1<<7)
+	DRIVE_FLAG_RESET /*! Issue a reset to the drive. */ = (1<<7),
+	DRIVE_FLAG_SYNC /*! Writes any cached data to the drive. */ = (1<<8),
+	DRIVE_FLAG_DISCARD_BLOCKS /*! Marks the blocks from start to end as unused (the contents are undefined afterwards). Drives that support it erase one discarded block each time \ref I_DRIVE_ISBUSY is polled with no read, write or attribute request since it last reported idle, so a later \ref DRIVE_FLAG_ERASE_BLOCKS returns without waiting. While such an erase is in progress, requests return EBUSY and \ref I_DRIVE_ISBUSY reports busy until the erase is done. */ = (1<<9)
 } drive_flags_t;
 
 /*! \brief Drive Info
@@ -64,7 +66,9 @@ typedef struct MCU_PACK {
 	u32 bitrate /*! Max bitrate */;
 	u32 page_program_size /*! The maximum number of bytes that can be program as one page */;
 	u32 partition_start /*! The starting address of the partition */;
-	u32 resd[6];
+	u32 cache_hit_count /*! Number of blocks served from a cache (if the drive is cached) */;
+	u32 cache_miss_count /*! Number of blocks read from the drive by a cache (if the drive is cached) */;
+	u32 resd[4];
 } drive_info_t;
 
 
@@ -74,8 +78,8 @@ typedef struct MCU_PACK {
  */
 typedef struct MCU_PACK {
 	u32 o_flags /*! Drive flags such as \ref DRIVE_FLAG_INIT */;
-	u32 start /*! Start block (used with \ref DRIVE_FLAG_ERASE_BLOCKS). This should be the address divided by drive_info_t->address_size. */;
-	u32 end /*! End block (used with \ref DRIVE_FLAG_ERASE_BLOCKS). This should be the address divided by drive_info_t->address_size. */;
+	u32 start /*! Start block (used with \ref DRIVE_FLAG_ERASE_BLOCKS and \ref DRIVE_FLAG_DISCARD_BLOCKS). This should be the address divided by drive_info_t->address_size. */;
+	u32 end /*! End block (used with \ref DRIVE_FLAG_ERASE_BLOCKS and \ref DRIVE_FLAG_DISCARD_BLOCKS). This should be the address divided by drive_info_t->address_size. */;
 	u32 resd[8];
 } drive_attr_t;
 
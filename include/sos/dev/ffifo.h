@@ -22,7 +22,7 @@
 #include "fifo.h"
 #include <sdk/types.h>
 
-#define FFIFO_VERSION (0x030000)
+#define FFIFO_VERSION (0x030100)
 #define FFIFO_IOC_CHAR 'F'
 
 enum {
@@ -53,10 +53,59 @@ typedef struct MCU_PACK {
   u32 resd[8];
 } ffifo_attr_t;
 
+/*! \brief FIFO Frame Access
+ * \details This structure is used with I_FFIFO_ACQUIREREAD, I_FFIFO_RELEASEREAD,
+ * I_FFIFO_ACQUIREWRITE and I_FFIFO_RELEASEWRITE to process frames in place
+ * rather than copying them with read() and write().
+ *
+ * \code
+ * ffifo_frames_t frames;
+ * frames.frame_count = 0; //as many as are ready
+ * if( ioctl(fd, I_FFIFO_ACQUIREREAD, &frames) > 0 ){
+ *   process(frames.buffer, frames.frame_count);
+ *   ioctl(fd, I_FFIFO_RELEASEREAD, &frames);
+ * }
+ * \endcode
+ *
+ */
+typedef struct MCU_PACK {
+  void *buffer /*! Pointer to the first frame (set by acquire) */;
+  u16 frame_count /*! Acquire: the maximum number of frames (0 for no limit) updated to
+                     the number of contiguous frames available; Release: the number of
+                     frames that are done */
+    ;
+  u16 position /*! Set by acquire and must be passed back to release */;
+  u32 resd[4];
+} ffifo_frames_t;
+
 #define I_FFIFO_GETVERSION _IOCTL(FFIFO_IOC_IDENT_CHAR, I_MCU_GETVERSION)
 #define I_FFIFO_GETINFO _IOCTLR(FIFO_IOC_CHAR, 0, ffifo_info_t)
 #define I_FFIFO_SETATTR _IOCTLW(FIFO_IOC_CHAR, 1, ffifo_attr_t)
 
+/*! \brief Acquires the next contiguous ready frames for reading in place.
+ * \details The return value is the number of frames acquired (0 if none are
+ * ready).
+ */
+#define I_FFIFO_ACQUIREREAD _IOCTLRW(FIFO_IOC_CHAR, 6, ffifo_frames_t)
+
+/*! \brief Releases frames acquired with I_FFIFO_ACQUIREREAD.
+ * \details If the FIFO was resynchronized (for example, a stream overflow)
+ * while the frames were held, the request fails with errno set to ECANCELED.
+ */
+#define I_FFIFO_RELEASEREAD _IOCTLW(FIFO_IOC_CHAR, 7, ffifo_frames_t)
+
+/*! \brief Acquires the next contiguous free frames for writing in place.
+ * \details The return value is the number of frames acquired (0 if the FIFO is
+ * full).
+ */
+#define I_FFIFO_ACQUIREWRITE _IOCTLRW(FIFO_IOC_CHAR, 8, ffifo_frames_t)
+
+/*! \brief Commits frames acquired with I_FFIFO_ACQUIREWRITE.
+ * \details If the FIFO was resynchronized (for example, a stream underflow)
+ * while the frames were held, the request fails with errno set to ECANCELED.
+ */
+#define I_FFIFO_RELEASEWRITE _IOCTLW(FIFO_IOC_CHAR, 9, ffifo_frames_t)
+
 #define I_FFIFO_FLUSH I_FIFO_FLUSH
 #define I_FFIFO_INIT I_FIFO_INIT
 #define I_FFIFO_EXIT I_FIFO_EXIT
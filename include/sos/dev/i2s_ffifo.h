@@ -40,7 +40,7 @@ typedef struct MCU_PACK {
 } i2s_ffifo_info_t;
 
 
-#define I2S_FFIFO_VERSION (0x030000)
+#define I2S_FFIFO_VERSION (0x030100)
 #define I2S_FFIFO_IOC_IDENT_CHAR 'j'
 
 #define I_I2S_FFIFO_GETVERSION _IOCTL(I2S_FFIFO_IOC_IDENT_CHAR, I_MCU_GETVERSION)
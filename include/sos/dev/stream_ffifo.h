@@ -58,7 +58,7 @@ typedef struct MCU_PACK {
   u32 o_status;
 } stream_ffifo_info_t;
 
-#define STREAM_FFIFO_VERSION (0x030000)
+#define STREAM_FFIFO_VERSION (0x030100)
 #define STREAM_FFIFO_IOC_IDENT_CHAR 'S'
 
 #define I_STREAM_FFIFO_GETVERSION _IOCTL(STREAM_FFIFO_IOC_IDENT_CHAR, I_MCU_GETVERSION)
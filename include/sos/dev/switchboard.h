@@ -77,6 +77,25 @@
  *
  * Using this scheme all USB channels are executed at the same priority level.
  *
+ * Each connection moves data through a ring of buffers (two by default, see
+ * SWITCHBOARD_DECLARE_CONFIG_STATE_RING()). The input is read into the next free
+ * buffer while earlier buffers are still being written so a slow write doesn't
+ * hold up the next read until the ring is full.
+ *
+ * A connection can have more than one output (fan out). Use
+ * SWITCHBOARD_FLAG_ADD_OUTPUT with the id of an existing connection to add
+ * attr.output. Every output writes the same ring buffers (there is no copy) and
+ * a buffer is reused once all outputs have written it. An added output receives
+ * the data that is read after it is added. The connection runs at the speed of
+ * the slowest output.
+ *
+ * The status of a connection reports the bytes transferred and the stall count
+ * of the input and the first output (I_SWITCHBOARD_GETOUTPUT reports any
+ * output). The input stalls when the ring is full and
+ * an output stalls when the ring is empty. duration_ms is the time the
+ * connection has been (or was) running so the throughput is
+ * bytes_transferred / duration_ms.
+ *
  *
  *
  *
@@ -97,7 +116,7 @@
 extern "C" {
 #endif
 
-#define SWITCHBOARD_VERSION (0x030600)
+#define SWITCHBOARD_VERSION (0x030700)
 #define SWITCHBOARD_IOC_IDENT_CHAR 'W'
 
 /*! \details Switchboard flags used with
@@ -162,7 +181,10 @@ typedef enum {
   SWITCHBOARD_FLAG_CLEAN /*! Cleanup connectections that have stopped on an error */ =
     (1 << 16),
   SWITCHBOARD_FLAG_IS_CANCELED /*! Set if a connection operation was cancelled */ =
-    (1 << 17)
+    (1 << 17),
+  SWITCHBOARD_FLAG_ADD_OUTPUT /*! Adds the output of switchboard_attr_t to an existing
+                                 connection (fan out) */
+  = (1 << 18)
 } switchboard_flag_t;
 
 typedef struct MCU_PACK {
@@ -174,7 +196,9 @@ typedef struct MCU_PACK {
   u32 transaction_limit /*! The maximum number of synchronous transactions that are
                            allowed before the connection is aborted */
     ;
-  u32 resd[8];
+  u16 buffer_count /*! The number of buffers in each connection's ring */;
+  u16 output_count /*! The maximum number of outputs per connection */;
+  u32 resd[7];
 } switchboard_info_t;
 
 /*! \brief Switchboard Terminal
@@ -189,7 +213,9 @@ typedef struct MCU_PACK {
   u32 bytes_transferred /*! Number of bytes transferred on the terminal */;
   s8 priority /*! Hardware interrupt priority elevation */;
   u8 device_type /*! Block or character device */;
-  s16 resd; // alignment
+  u16 stall_count /*! Number of times the terminal had to wait because the connection
+                     buffers were full (input) or empty (output) */
+    ;
 } switchboard_terminal_t;
 
 /*! \brief Switchboard Connection
@@ -212,6 +238,10 @@ typedef struct MCU_PACK {
   s32 nbyte /*! Number of bytes to transfer (packet size for persisent connections); will
                be negative when reading to indicate an error */
     ;
+  u32 duration_ms /*! Milliseconds since the connection was made (or until it stopped) */;
+  u8 output_count /*! Number of outputs (output describes the first one) */;
+  u8 buffer_count /*! Number of buffers in the connection ring */;
+  u16 resd;
 } switchboard_connection_t;
 
 /*!
@@ -230,6 +260,18 @@ typedef struct MCU_PACK {
  */
 typedef switchboard_connection_t switchboard_status_t;
 
+/*! \brief Switchboard Output
+ * \details Used with I_SWITCHBOARD_GETOUTPUT to get the status of any output
+ * of a connection.
+ *
+ */
+typedef struct MCU_PACK {
+  u16 id /*! Connection id (set by the caller) */;
+  u8 output_index /*! Output to report from 0 to output_count - 1 (set by the caller) */;
+  u8 resd;
+  switchboard_terminal_t output /*! The status of the output */;
+} switchboard_output_t;
+
 /*! \brief Switchboard Attributes
  * \details Switchboard attributes are used with I_SWITCHBOARD_SETATTR
  * to connect and disconnect terminals.
@@ -277,6 +319,28 @@ typedef switchboard_connection_t switchboard_attr_t;
 #define I_SWITCHBOARD_SETACTION                                                          \
   _IOCTLW(SWITCHBOARD_IOC_IDENT_CHAR, I_MCU_SETACTION, mcu_action_t)
 
+/*! \brief Gets the status of one output of a connection.
+ * \hideinitializer
+ *
+ * \details Reading the switchboard reports the first output of each
+ * connection. This request reports the output at output_index of the
+ * connection id. It fails with EINVAL if the connection isn't in use or the
+ * connection doesn't have that output.
+ *
+ * \code
+ * switchboard_output_t output;
+ * output.id = status.id;
+ * for(output.output_index = 0; output.output_index < status.output_count;
+ *   output.output_index++){
+ *   ioctl(fd, I_SWITCHBOARD_GETOUTPUT, &output);
+ *   printf("%s:%ld\n", output.output.name, output.output.bytes_transferred);
+ * }
+ * \endcode
+ *
+ */
+#define I_SWITCHBOARD_GETOUTPUT                                                          \
+  _IOCTLRW(SWITCHBOARD_IOC_IDENT_CHAR, I_MCU_TOTAL + 0, switchboard_output_t)
+
 #define I_SWITCHBOARD_TOTAL 1
 
 #ifdef __cplusplus
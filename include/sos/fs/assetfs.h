@@ -13,6 +13,7 @@ int assetfs_init(const void *cfg);
 int assetfs_startup(const void *cfg);
 int assetfs_open(const void *cfg, void **handle, const char *path, int flags, int mode);
 int assetfs_read(const void *cfg, void *handle, int flags, int loc, void *buf, int nbyte);
+int assetfs_map(const void *cfg, void *handle, int loc, const void **addr);
 int assetfs_ioctl(const void *cfg, void *handle, int request, void *ctl);
 int assetfs_close(const void *cfg, void **handle);
 int assetfs_fstat(const void *cfg, void *handle, struct stat *st);
@@ -21,6 +22,8 @@ int assetfs_opendir(const void *cfg, void **handle, const char *path);
 int assetfs_readdir_r(const void *cfg, void *handle, int loc, struct dirent *entry);
 int assetfs_closedir(const void *cfg, void **handle);
 
+// A file that is compressed (see sos/lz.h) and added with ASSETFS_COMPRESSED_ENTRY()
+// is decompressed as it is read
 #define ASSETFS_FILE(name, file)                                                         \
   __asm__(                                                                               \
     ".section .rodata\n"                                                                 \
@@ -54,6 +57,13 @@ int assetfs_closedir(const void *cfg, void **handle);
     .end = ASSETFS_END(object_name), .mode = mode_value, .uid = uid_value                \
   }
 
+// Set in assetfs_dirent_t.mode for an entry that holds a compressed container
+#define ASSETFS_MODE_COMPRESSED 0x8000
+
+#define ASSETFS_COMPRESSED_ENTRY(file_name, object_name, mode_value, uid_value)          \
+  ASSETFS_ENTRY(                                                                         \
+    file_name, object_name, (mode_value) | ASSETFS_MODE_COMPRESSED, uid_value)
+
 typedef struct MCU_PACK {
   char name[ASSETFS_NAME_MAX + 1];
   u32 start;
@@ -73,7 +83,8 @@ typedef struct {
     .owner = owner_value, .mount = assetfs_init, .unmount = SYSFS_NOTSUP,                \
     .ismounted = sysfs_always_mounted, .startup = assetfs_startup, .mkfs = SYSFS_NOTSUP, \
     .open = assetfs_open, .aio = SYSFS_NOTSUP, .read = assetfs_read,                     \
-    .write = SYSFS_NOTSUP, .close = assetfs_close, .ioctl = assetfs_ioctl,               \
+    .write = SYSFS_NOTSUP, .map = assetfs_map, .close = assetfs_close,                  \
+    .ioctl = assetfs_ioctl,                                                              \
     .rename = SYSFS_NOTSUP, .fsync = SYSFS_NOTSUP, .unlink = SYSFS_NOTSUP,               \
     .mkdir = SYSFS_NOTSUP, .rmdir = SYSFS_NOTSUP, .remove = SYSFS_NOTSUP,                \
     .opendir = assetfs_opendir, .closedir = assetfs_closedir,                            \
@@ -236,6 +236,16 @@ void devfs_execute_cancel_handler(
   int nbyte,
   u32 o_flags) MCU_ROOT_EXEC_CODE;
 
+// wakes threads blocked in poll() or select() -- drivers call this when a device
+// that answers I_DEVFS_POLL may have become ready
+void devfs_poll_notify() MCU_ROOT_EXEC_CODE;
+
+// starts an asynchronous transfer on a device from root (used by aio_ring_submit()
+// to start a batch in one svcall) -- completion is reported to
+// sysfs_aio_data_transfer_callback()
+int devfs_aio_root_data_transfer(const devfs_device_t *device, struct aiocb *aiocbp)
+  MCU_ROOT_EXEC_CODE;
+
 int devfs_init(const void *cfg);
 int devfs_open(const void *cfg, void **handle, const char *path, int flags, int mode);
 int devfs_read(const void *cfg, void *handle, int flags, int loc, void *buf, int nbyte);
@@ -246,6 +256,20 @@ int devfs_write(
   int loc,
   const void *buf,
   int nbyte);
+int devfs_readv(
+  const void *cfg,
+  void *handle,
+  int flags,
+  int loc,
+  const struct iovec *iov,
+  int iovcnt);
+int devfs_writev(
+  const void *cfg,
+  void *handle,
+  int flags,
+  int loc,
+  const struct iovec *iov,
+  int iovcnt);
 int devfs_aio(const void *cfg, void *handle, struct aiocb *aio);
 int devfs_ioctl(const void *cfg, void *handle, int request, void *ctl);
 int devfs_close(const void *cfg, void **handle);
@@ -261,7 +285,8 @@ int devfs_closedir(const void *cfg, void **handle);
     .owner = owner_value, .mount = devfs_init, .unmount = SYSFS_NOTSUP,                  \
     .ismounted = sysfs_always_mounted, .startup = SYSFS_NOTSUP, .mkfs = SYSFS_NOTSUP,    \
     .open = devfs_open, .aio = devfs_aio, .ioctl = devfs_ioctl, .fsync = SYSFS_NOTSUP,   \
-    .read = devfs_read, .write = devfs_write, .close = devfs_close,                      \
+    .read = devfs_read, .write = devfs_write, .readv = devfs_readv,                      \
+    .writev = devfs_writev, .close = devfs_close,                                        \
     .rename = SYSFS_NOTSUP, .unlink = SYSFS_NOTSUP, .mkdir = SYSFS_NOTSUP,               \
     .rmdir = SYSFS_NOTSUP, .remove = SYSFS_NOTSUP, .opendir = devfs_opendir,             \
     .closedir = devfs_closedir, .readdir_r = devfs_readdir_r, .link = SYSFS_NOTSUP,      \
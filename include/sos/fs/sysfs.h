@@ -11,6 +11,7 @@
 #include <sys/types.h>
 
 struct dirent;
+struct iovec;
 
 #if !defined __link
 #include "aio.h"
@@ -69,6 +70,13 @@ typedef struct {
   int (*ioctl)(const void *, void *, int, void *);
   int (*read)(const void *, void *, int, int, void *, int);
   int (*write)(const void *, void *, int, int, const void *, int);
+  // optional (NULL to transfer one iovec at a time with read/write)
+  int (*readv)(const void *, void *, int, int, const struct iovec *, int);
+  int (*writev)(const void *, void *, int, int, const struct iovec *, int);
+  // optional (NULL if the data isn't memory mapped): assigns the address of the
+  // data at loc and returns the number of contiguous bytes (0 at the end of file)
+  // or ENOTSUP if the open file isn't mapped (use read)
+  int (*map)(const void *, void *, int, const void **);
   int (*fsync)(const void *, void *);
   int (*close)(const void *, void **);
   int (*fstat)(const void *, void *, struct stat *);
@@ -148,6 +156,11 @@ int sysfs_file_ioctl(sysfs_file_t *file, int request, void *ctl);
 int sysfs_file_fsync(sysfs_file_t *file);
 int sysfs_file_read(sysfs_file_t *file, void *buf, int nbyte);
 int sysfs_file_write(sysfs_file_t *file, const void *buf, int nbyte);
+int sysfs_file_readv(sysfs_file_t *file, const struct iovec *iov, int iovcnt);
+int sysfs_file_writev(sysfs_file_t *file, const struct iovec *iov, int iovcnt);
+int sysfs_file_map(sysfs_file_t *file, int loc, const void **addr);
+int sysfs_file_pread(sysfs_file_t *file, int loc, void *buf, int nbyte);
+int sysfs_file_pwrite(sysfs_file_t *file, int loc, const void *buf, int nbyte);
 int sysfs_file_aio(sysfs_file_t *file, void *aio);
 int sysfs_file_close(sysfs_file_t *file);
 
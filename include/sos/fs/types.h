@@ -71,4 +71,22 @@ typedef char devfs_get_name_t[DEVFS_NAME_MAX + 1];
 
 #define I_DEVFS_GETNAME _IOCTLW(DEVFS_IOC_IDENT_CHAR, I_MCU_TOTAL, devfs_get_name_t)
 
+/*! \details Flags returned by I_DEVFS_POLL.
+ *
+ * Drivers that answer I_DEVFS_POLL always set DEVFS_POLL_FLAG_IS_SUPPORTED so
+ * that "nothing is ready" can be told apart from a driver that ignores the
+ * request. Descriptors that don't answer are treated as always ready (like
+ * regular files).
+ *
+ */
+enum devfs_poll_flags {
+  DEVFS_POLL_FLAG_IS_READ_READY = (1 << 0) /*! A read won't block */,
+  DEVFS_POLL_FLAG_IS_WRITE_READY = (1 << 1) /*! A write won't block */,
+  DEVFS_POLL_FLAG_IS_ERROR = (1 << 2) /*! The device has an error (eg overflow) */,
+  DEVFS_POLL_FLAG_IS_SUPPORTED = (1 << 3) /*! The driver answered the request */
+};
+
+// returns the DEVFS_POLL_FLAG values for the device -- used by poll() and select()
+#define I_DEVFS_POLL _IOCTL(DEVFS_IOC_IDENT_CHAR, I_MCU_TOTAL + 1)
+
 #endif /* SOS_FS_TYPES_H_ */
@@ -164,6 +164,36 @@ int link_writeflash(
   int nbyte);
 int link_eraseflash(link_transport_mdriver_t *driver);
 
+/*! \details Compresses \a buf (see sos/lz.h) and writes it to the program
+ * start address using I_BOOTLOADER_WRITEPAGE_COMPRESSED. Bootloaders that
+ * don't support the request return an error (use link_writeflash()).
+ */
+int link_writeflash_compressed(
+  link_transport_mdriver_t *driver,
+  const void *buf,
+  int nbyte);
+
+/*! \details Writes \a buf to \a addr (the program start address) like
+ * link_writeflash() but only erases and writes the sectors that have changed
+ * pages (see I_BOOTLOADER_GET_PAGE_HASH). Don't call link_eraseflash() first.
+ * Bootloaders that don't support delta updates return an error (use
+ * link_eraseflash() and link_writeflash()).
+ */
+int link_writeflash_delta(
+  link_transport_mdriver_t *driver,
+  int addr,
+  const void *buf,
+  int nbyte);
+
+/*! \details Compresses \a nbyte bytes of \a src to \a dest (see sos/lz.h).
+ * \a dest_size must be at least LINK_LZ_COMPRESS_BOUND(nbyte) to hold data
+ * that doesn't compress.
+ *
+ * \return The number of bytes written to \a dest or -1
+ */
+int link_lz_compress(const void *src, int nbyte, void *dest, int dest_size);
+#define LINK_LZ_COMPRESS_BOUND(nbyte) ((nbyte) + (nbyte) / 255 + 16)
+
 #if defined(__cplusplus)
 }
 #endif
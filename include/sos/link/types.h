@@ -243,6 +243,11 @@ struct link_tm {
 /*! \hideinitializer \details Fatal event -- data is a string (associate with a crash) */
 #define LINK_POSIX_TRACE_FATAL 12
 
+/*! \hideinitializer \details Process launch event -- data is the number of
+ * microseconds (u32) from when the process was created until main() is called
+ */
+#define LINK_POSIX_TRACE_LAUNCH 13
+
 typedef struct MCU_PACK {
   u32 pid;
   u32 tid;
@@ -0,0 +1,85 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SOS_LZ_H
+#define SOS_LZ_H
+
+#include <sdk/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! \details Compressed image container.
+ *
+ * A compressed image is a sos_lz_header_t followed by LZ4 style sequences:
+ * - token: literal count (high nibble) and match length minus
+ *   SOS_LZ_MATCH_MIN (low nibble)
+ * - more literal count bytes if the nibble is 15 (each is added, a byte of
+ *   255 means another follows)
+ * - the literals
+ * - match offset (2 bytes, little endian, 1 to SOS_LZ_WINDOW_SIZE)
+ * - more match length bytes if the nibble is 15 (same as the literal count)
+ *
+ * The stream ends when sos_lz_header_t.size bytes have been decoded (the last
+ * sequence usually has no match).
+ *
+ * Matches only reach back SOS_LZ_WINDOW_SIZE bytes so sos_lz_decode() can
+ * decompress into a small buffer (such as a flash page) that is reused. The
+ * input can also be split anywhere. The bootloader and appfs use this to
+ * install compressed images and assetfs uses it for compressed entries.
+ *
+ * The compressor is part of the link library (link_lz_compress()).
+ *
+ */
+
+#define SOS_LZ_SIGNATURE 0x315a4c53 // "SLZ1"
+#define SOS_LZ_WINDOW_SIZE 1024
+#define SOS_LZ_MATCH_MIN 4
+
+typedef struct {
+  u32 signature /*! SOS_LZ_SIGNATURE */;
+  u32 size /*! The number of bytes after decompression */;
+} sos_lz_header_t;
+
+typedef struct {
+  sos_lz_header_t header;
+  u32 total /*! The number of bytes that have been decoded */;
+  u32 literal_count;
+  u32 match_count;
+  u16 offset;
+  u16 window_loc;
+  u8 state;
+  u8 count;
+  u8 resd[2];
+  u8 window[SOS_LZ_WINDOW_SIZE];
+} sos_lz_decoder_t;
+
+void sos_lz_decoder_init(sos_lz_decoder_t *decoder);
+
+/*! \details Decodes up to \a *src_size bytes of \a src into \a dest.
+ *
+ * Decoding stops when \a dest is full, all of \a src is used or the stream is
+ * complete. \a *src_size is written with the number of bytes used.
+ *
+ * \return The number of bytes written to \a dest or -1 if the data is not
+ * valid
+ */
+int sos_lz_decode(
+  sos_lz_decoder_t *decoder,
+  const void *src,
+  u32 *src_size,
+  void *dest,
+  u32 dest_size);
+
+int sos_lz_is_complete(const sos_lz_decoder_t *decoder);
+
+/*! \details Returns true if \a buffer (at least sizeof(sos_lz_header_t) bytes)
+ * starts with a compressed image header.
+ */
+int sos_lz_is_compressed(const void *buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SOS_LZ_H */
@@ -163,7 +163,10 @@ extern u32 __aeabi_atexit();
 #include "device/mem.h"
 #include "device/sys.h"
 #include "mqueue.h"
+#include "poll.h"
 #include "semaphore.h"
+#include "sys/sendfile.h"
+#include "sys/uio.h"
 #include "sos/dev/sys.h"
 #include "sos/sos.h"
 #include "trace.h"
@@ -191,6 +194,8 @@ extern void __div0();
 useconds_t _EXFUN(ualarm, (useconds_t __useconds, useconds_t __interval));
 extern void crt_load_data(void * global_reent, int code_size, int data_size);
 extern char ** const crt_import_argv(int argc, char * const argv[]);
+extern void crt_zero_data(void * dest, int size);
+extern void crt_trace_launch();
 
 #include "sys/socket.h"
 
@@ -443,6 +443,10 @@
 #define mq_receive 0
 #define mq_timedsend 0
 #define mq_send 0
+#define mq_loan 0
+#define mq_commit 0
+#define mq_receive_borrow 0
+#define mq_release 0
 #endif
 
 #if !defined SYMBOLS_IGNORE_POSIX_TRACE
@@ -212,7 +212,11 @@ u32 const symbols_table[] = {
   (u32)__aeabi_unwind_cpp_pr1, (u32)__cxa_atexit, (u32)getuid, (u32)setuid, (u32)geteuid,
   (u32)seteuid, (u32)sos_trace_stack, (u32)__assert_func, (u32)setenv, (u32)pthread_exit,
   (u32)pthread_testcancel, (u32)pthread_setcancelstate, (u32)pthread_setcanceltype,
-  (u32)__aeabi_atexit, (u32)settimeofday, (u32)getppid, (u32)pthread_mutex_timedlock, 1};
+  (u32)__aeabi_atexit, (u32)settimeofday, (u32)getppid, (u32)pthread_mutex_timedlock, (u32)mq_loan,
+  (u32)mq_commit, (u32)mq_receive_borrow, (u32)mq_release, (u32)poll, (u32)readv, (u32)writev, (u32)pread,
+  (u32)pwrite, (u32)aio_ring_init, (u32)aio_ring_put, (u32)aio_ring_submit,
+  (u32)aio_ring_get, (u32)aio_ring_wait, (u32)sendfile,
+  (u32)crt_zero_data, (u32)crt_trace_launch, 1};
 
 u32 symbols_total();
 
@@ -4,7 +4,8 @@
 #include "sos/boot/bootloader.h"
 
 //version 4 will store the first page and write it after verification
-#define BCDVERSION 0x400
+//version 0x401 replies to each page before writing it (see I_BOOTLOADER_GET_WRITE_STATUS)
+#define BCDVERSION 0x401
 
 //Un-comment to use UART for debugging
 #if defined ___debug
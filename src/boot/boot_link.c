@@ -37,15 +37,33 @@
 #include "cortexm/cortexm.h"
 #include "cortexm/util.h"
 #include "sos/arch.h"
+#include "sos/crc.h"
 #include "sos/debug.h"
+#include "sos/dev/flash.h"
 #include "sos/led.h"
+#include "sos/lz.h"
 #include "sos/sos.h"
 
-static bool is_erased = false;
+// an update session starts when the program's first page is erased and ends when the
+// signature is verified -- ranges past the first page are only erased during a session
+static bool is_update_session = false;
 
 static u8 first_page[256];
 
 static u32 hash_size = 0;
+// the next address to hash (pages skipped by a delta update are hashed from flash)
+static u32 hash_loc = 0;
+
+static boot_event_flash_t event_args;
+
+// pages are written after the reply is sent so the host can send the next page
+// -- a failure is reported to the next request
+static int write_errno = 0;
+
+// the decompressed page for I_BOOTLOADER_WRITEPAGE_COMPRESSED
+static sos_lz_decoder_t lz_decoder;
+static bootloader_writepage_t lz_page;
+static u32 lz_loc;
 
 #if CONFIG_BOOT_IS_VERIFY_SIGNATURE
 static u8 ecc_context_buffer[256];
@@ -58,6 +76,11 @@ const devfs_handle_t flash_dev = {.port = 0};
 
 static int read_flash(link_transport_driver_t *driver, int loc, int nbyte);
 static int read_flash_callback(void *context, void *buf, int nbyte);
+static int write_page(bootloader_writepage_t *wattr);
+static int write_compressed(const bootloader_writepage_t *wattr);
+static int get_page_hash(bootloader_page_hash_t *hash);
+static int erase_range(bootloader_erase_range_t *range);
+static int find_flash_page(u32 addr, flash_pageinfo_t *info);
 
 typedef struct {
   int err;
@@ -76,6 +99,8 @@ static void
 boot_link_cmd_reset_bootloader(link_transport_driver_t *driver, link_data_t *args);
 static void erase_flash(link_transport_driver_t *driver);
 static void boot_link_cmd_reset(link_transport_driver_t *driver, link_data_t *args);
+static int reply_before_write(link_transport_driver_t *driver, link_data_t *args);
+static void start_update_session();
 
 static const u8 *get_public_key() {
   return (const u8 *)((u32)sos_config.sys.secret_key_address & ~0x01);
@@ -160,7 +185,7 @@ void boot_link_cmd_readserialno(link_transport_driver_t *driver, link_data_t *ar
     }
   }
 
-  args->reply.err = strnlen(serialno, 256);
+  args->reply.err = strnlen(serialno, sizeof(serialno));
   args->reply.err_number = 0;
 
   if (
@@ -183,7 +208,6 @@ void boot_link_cmd_ioctl(link_transport_driver_t *driver, link_data_t *args) {
   const int size = _IOCTL_SIZE(args->op.ioctl.request);
   bootloader_attr_t attr;
   bootloader_writepage_t wattr;
-  static boot_event_flash_t event_args;
 
 #if CONFIG_BOOT_IS_VERIFY_SIGNATURE
   const crypt_ecc_api_t *ecc_api =
@@ -205,11 +229,7 @@ void boot_link_cmd_ioctl(link_transport_driver_t *driver, link_data_t *args) {
     args->op.cmd = 0;
 
     erase_flash(driver);
-    is_erased = true;
-
-    event_args.abort = 0;
-    event_args.bytes = 0;
-    event_args.total = -1;
+    start_update_session();
 
     dstr("erd\n");
     return;
@@ -258,73 +278,67 @@ void boot_link_cmd_ioctl(link_transport_driver_t *driver, link_data_t *args) {
     break;
 
   case I_BOOTLOADER_WRITEPAGE:
-
     err = link_transport_slaveread(driver, &wattr, size, NULL, NULL);
     if (err < 0) {
       dstr("failed to read data\n");
       break;
     }
-
-    dstr("w:");
-    dhex(wattr.addr);
-    dstr(":");
-    dint(wattr.nbyte);
-    dstr("\n");
-
-    if (wattr.addr == sos_config.boot.program_start_address) {
-
-      if (wattr.nbyte < sizeof(first_page)) {
-        dstr("first page too small\n");
-        // this is an error
-        args->reply.err = -1;
-        args->reply.err_number = EINVAL;
-        return;
+    if (reply_before_write(driver, args) == 0) {
+      if (write_page(&wattr) < 0) {
+        write_errno = errno ? errno : EIO;
       }
+    }
+    return;
 
-#if CONFIG_BOOT_IS_VERIFY_SIGNATURE
-      ecc_api = sos_config.sys.kernel_request_api(CRYPT_ECC_ROOT_API_REQUEST);
-      sha_api = sos_config.sys.kernel_request_api(CRYPT_SHA256_ROOT_API_REQUEST);
-
-      ecc_api->init(&ecc_context);
-      sha_api->init(&sha_context);
-
-      sha_api->start(sha_context);
-      sha_api->update(sha_context, wattr.buf, wattr.nbyte);
-      hash_size = wattr.nbyte;
-#endif
-
-      //use a page size of 256, 512, or 1024
-
-      memcpy(first_page, wattr.buf, sizeof(first_page));
-      wattr.addr += sizeof(first_page);
-      wattr.nbyte = wattr.nbyte - sizeof(first_page);
-      memcpy(wattr.buf, wattr.buf + sizeof(first_page), wattr.nbyte);
-      memset(wattr.buf + wattr.nbyte, 0xff, sizeof(first_page));
-
-      args->reply.err =
-        sos_config.boot.flash_write_page(&sos_config.boot.flash_handle, &wattr);
-
-    } else {
-#if CONFIG_BOOT_IS_VERIFY_SIGNATURE
-      sha_api->update(sha_context, wattr.buf, wattr.nbyte);
-      hash_size += wattr.nbyte;
-#endif
-
-      args->reply.err =
-        sos_config.boot.flash_write_page(&sos_config.boot.flash_handle, &wattr);
-
-      if (args->reply.err < 0) {
-        dstr("Failed to write flash:");
-        dhex(args->reply.err);
-        dstr("\n");
+  case I_BOOTLOADER_WRITEPAGE_COMPRESSED:
+    err = link_transport_slaveread(driver, &wattr, size, NULL, NULL);
+    if (err < 0) {
+      dstr("failed to read data\n");
+      break;
+    }
+    if (reply_before_write(driver, args) == 0) {
+      if (write_compressed(&wattr) < 0) {
+        write_errno = errno ? errno : EIO;
       }
     }
+    return;
 
-    event_args.increment = wattr.nbyte;
-    event_args.bytes += event_args.increment;
-    sos_handle_event(SOS_EVENT_BOOT_WRITE_FLASH, &event_args);
+  case I_BOOTLOADER_GET_WRITE_STATUS:
+    // each page is written before the next request is read so the last page is done
+    if (write_errno) {
+      args->reply.err = -1;
+      args->reply.err_number = write_errno;
+      return;
+    }
+    args->reply.err = 0;
     break;
 
+  case I_BOOTLOADER_GET_PAGE_HASH: {
+    bootloader_page_hash_t hash;
+    err = link_transport_slaveread(driver, &hash, size, NULL, NULL);
+    if (err < 0) {
+      dstr("failed to read data\n");
+      break;
+    }
+    args->reply.err = get_page_hash(&hash);
+    if (args->reply.err == 0) {
+      link_transport_slavewrite(driver, &hash, size, NULL, NULL);
+    }
+  } break;
+
+  case I_BOOTLOADER_ERASE_RANGE: {
+    bootloader_erase_range_t range;
+    err = link_transport_slaveread(driver, &range, size, NULL, NULL);
+    if (err < 0) {
+      dstr("failed to read data\n");
+      break;
+    }
+    args->reply.err = erase_range(&range);
+    if (args->reply.err == 0) {
+      link_transport_slavewrite(driver, &range, size, NULL, NULL);
+    }
+  } break;
+
   case I_BOOTLOADER_GET_PUBLIC_KEY: {
     auth_public_key_t key;
 #if CONFIG_BOOT_IS_VERIFY_SIGNATURE
@@ -344,6 +358,18 @@ void boot_link_cmd_ioctl(link_transport_driver_t *driver, link_data_t *args) {
       dstr("failed to receive signature\n");
       return;
     }
+
+    // the image is complete -- another update must erase the first page again
+    is_update_session = false;
+
+    if (write_errno) {
+      // the image wasn't written correctly so the first page isn't written
+      dstr("image write failed\n");
+      args->reply.err = -1;
+      args->reply.err_number = write_errno;
+      return;
+    }
+
 #if CONFIG_BOOT_IS_VERIFY_SIGNATURE
     u8 hash[32];
     sha_api->finish(sha_context, hash, sizeof(hash));
@@ -400,6 +426,271 @@ void boot_link_cmd_ioctl(link_transport_driver_t *driver, link_data_t *args) {
   }
 }
 
+int write_page(bootloader_writepage_t *wattr) {
+  int result;
+
+  dstr("w:");
+  dhex(wattr->addr);
+  dstr(":");
+  dint(wattr->nbyte);
+  dstr("\n");
+
+  if (wattr->addr == sos_config.boot.program_start_address) {
+
+    if (wattr->nbyte < sizeof(first_page)) {
+      dstr("first page too small\n");
+      // this is an error
+      errno = EINVAL;
+      return -1;
+    }
+
+#if CONFIG_BOOT_IS_VERIFY_SIGNATURE
+    const crypt_ecc_api_t *ecc_api =
+      sos_config.sys.kernel_request_api(CRYPT_ECC_ROOT_API_REQUEST);
+    const crypt_hash_api_t *sha_api =
+      sos_config.sys.kernel_request_api(CRYPT_SHA256_ROOT_API_REQUEST);
+
+    ecc_api->init(&ecc_context);
+    sha_api->init(&sha_context);
+
+    sha_api->start(sha_context);
+    sha_api->update(sha_context, wattr->buf, wattr->nbyte);
+    hash_size = wattr->nbyte;
+    hash_loc = wattr->addr + wattr->nbyte;
+#endif
+
+    //use a page size of 256, 512, or 1024
+
+    memcpy(first_page, wattr->buf, sizeof(first_page));
+    wattr->addr += sizeof(first_page);
+    wattr->nbyte = wattr->nbyte - sizeof(first_page);
+    memmove(wattr->buf, wattr->buf + sizeof(first_page), wattr->nbyte);
+    memset(wattr->buf + wattr->nbyte, 0xff, sizeof(first_page));
+
+    result = sos_config.boot.flash_write_page(&sos_config.boot.flash_handle, wattr);
+
+  } else {
+#if CONFIG_BOOT_IS_VERIFY_SIGNATURE
+    const crypt_hash_api_t *sha_api =
+      sos_config.sys.kernel_request_api(CRYPT_SHA256_ROOT_API_REQUEST);
+    if (wattr->addr > hash_loc) {
+      // a delta update didn't send these pages because they are already in the flash
+      sha_api->update(sha_context, (const void *)hash_loc, wattr->addr - hash_loc);
+      hash_size += wattr->addr - hash_loc;
+    }
+    sha_api->update(sha_context, wattr->buf, wattr->nbyte);
+    hash_size += wattr->nbyte;
+    hash_loc = wattr->addr + wattr->nbyte;
+#endif
+
+    result = sos_config.boot.flash_write_page(&sos_config.boot.flash_handle, wattr);
+
+    if (result < 0) {
+      dstr("Failed to write flash:");
+      dhex(result);
+      dstr("\n");
+    }
+  }
+
+  event_args.increment = wattr->nbyte;
+  event_args.bytes += event_args.increment;
+  sos_handle_event(SOS_EVENT_BOOT_WRITE_FLASH, &event_args);
+  return result;
+}
+
+int write_compressed(const bootloader_writepage_t *wattr) {
+  if (wattr->nbyte > BOOTLOADER_WRITEPAGESIZE) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (wattr->addr == 0) {
+    // a new image
+    sos_lz_decoder_init(&lz_decoder);
+    lz_page.addr = sos_config.boot.program_start_address;
+    lz_page.nbyte = 0;
+    lz_loc = 0;
+  } else if (wattr->addr != lz_loc) {
+    dstr("compressed data out of order\n");
+    errno = EINVAL;
+    return -1;
+  }
+
+  const u8 *src = wattr->buf;
+  u32 src_size = wattr->nbyte;
+  lz_loc += wattr->nbyte;
+
+  // decompressed data is written one page at a time like I_BOOTLOADER_WRITEPAGE
+  while ((src_size > 0) && !sos_lz_is_complete(&lz_decoder)) {
+    u32 used = src_size;
+    const int bytes = sos_lz_decode(
+      &lz_decoder, src, &used, lz_page.buf + lz_page.nbyte,
+      BOOTLOADER_WRITEPAGESIZE - lz_page.nbyte);
+    if (bytes < 0) {
+      dstr("bad compressed data\n");
+      errno = EINVAL;
+      return -1;
+    }
+    src += used;
+    src_size -= used;
+    lz_page.nbyte += bytes;
+
+    if (
+      (lz_page.nbyte == BOOTLOADER_WRITEPAGESIZE)
+      || (sos_lz_is_complete(&lz_decoder) && lz_page.nbyte)) {
+      const u32 addr = lz_page.addr;
+      const u32 nbyte = lz_page.nbyte;
+      memset(lz_page.buf + nbyte, 0xff, BOOTLOADER_WRITEPAGESIZE - nbyte);
+      if (write_page(&lz_page) < 0) {
+        return -1;
+      }
+      lz_page.addr = addr + nbyte;
+      lz_page.nbyte = 0;
+    }
+  }
+
+  return 0;
+}
+
+int reply_before_write(link_transport_driver_t *driver, link_data_t *args) {
+  // the page is hashed and written while the host sends the next one
+  if (write_errno) {
+    args->reply.err = -1;
+    args->reply.err_number = write_errno;
+  }
+  link_transport_slavewrite(driver, &args->reply, sizeof(args->reply), NULL, NULL);
+  // set this to zero so caller doesn't execute the slavewrite again
+  args->op.cmd = 0;
+  if (write_errno) {
+    // nothing else is written until the flash is erased
+    return -1;
+  }
+  errno = 0;
+  return 0;
+}
+
+int get_page_hash(bootloader_page_hash_t *hash) {
+  flash_pageinfo_t info;
+
+  if (
+    (hash->count == 0) || (hash->count > BOOTLOADER_PAGE_HASH_MAX)
+    || (hash->addr < sos_config.boot.program_start_address)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  const u32 size = hash->count * BOOTLOADER_WRITEPAGESIZE;
+  if (hash->addr > (u32)-1 - size) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // the whole range must be in the flash
+  if (
+    (find_flash_page(hash->addr, &info) < 0)
+    || (find_flash_page(hash->addr + size - 1, &info) < 0)) {
+    return -1;
+  }
+
+  for (u32 i = 0; i < hash->count; i++) {
+    hash->crc[i] = sos_crc32(
+      0, (const void *)(hash->addr + i * BOOTLOADER_WRITEPAGESIZE),
+      BOOTLOADER_WRITEPAGESIZE);
+  }
+  return 0;
+}
+
+int erase_range(bootloader_erase_range_t *range) {
+  flash_pageinfo_t info;
+  const u32 end = range->addr + range->nbyte;
+
+  if ((range->nbyte == 0) || (range->addr < sos_config.boot.program_start_address)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (range->addr > (u32)-1 - range->nbyte) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  const bool is_first_range = range->addr == sos_config.boot.program_start_address;
+  if ((is_update_session == false) && (is_first_range == false)) {
+    // the first page is erased first so a partial update can't run
+    dstr("first range must start at the program\n");
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (find_flash_page(range->addr, &info) < 0) {
+    return -1;
+  }
+
+  if (is_first_range) {
+    // a new update -- even if the previous one wasn't finished
+    start_update_session();
+  }
+
+  boot_event_flash_t erase_args = {.abort = 0, .total = -1, .increment = -1};
+  range->addr = info.addr;
+  u32 erased_end = info.addr;
+  while (erased_end < end) {
+    sos_led_root_enable();
+    const int result =
+      sos_config.boot.flash_erase_page(&sos_config.boot.flash_handle, (void *)info.page);
+    sos_led_root_disable();
+    if (result != 0) {
+      dstr("failed to erase:");
+      dint(info.page);
+      dstr("\n");
+      errno = EIO;
+      return -1;
+    }
+
+    erased_end = info.addr + info.size;
+    erase_args.bytes = info.page;
+    sos_handle_event(SOS_EVENT_BOOT_ERASE_FLASH, &erase_args);
+
+    info.page++;
+    if (erased_end < end) {
+      if (sos_config.boot.flash_get_page_info(&sos_config.boot.flash_handle, &info) < 0) {
+        errno = EINVAL;
+        return -1;
+      }
+    }
+  }
+
+  range->nbyte = erased_end - range->addr;
+  return 0;
+}
+
+void start_update_session() {
+  is_update_session = true;
+  // a failed write only fails the session it was sent in
+  write_errno = 0;
+  event_args.abort = 0;
+  event_args.bytes = 0;
+  event_args.total = -1;
+}
+
+int find_flash_page(u32 addr, flash_pageinfo_t *info) {
+  if (sos_config.boot.flash_get_page_info == NULL) {
+    errno = ENOTSUP;
+    return -1;
+  }
+
+  info->page = 0;
+  while (sos_config.boot.flash_get_page_info(&sos_config.boot.flash_handle, info) >= 0) {
+    if ((addr >= info->addr) && (addr - info->addr < info->size)) {
+      return 0;
+    }
+    info->page++;
+  }
+
+  errno = EINVAL;
+  return -1;
+}
+
 void boot_link_cmd_read(link_transport_driver_t *driver, link_data_t *args) {
   args->reply.err = read_flash(driver, args->op.read.addr, args->op.read.nbyte);
   dint(args->reply.err);
@@ -35,6 +35,10 @@
 #if !defined CONFIG_PTHREAD_DEFAULT_STACK_SIZE
 #define CONFIG_PTHREAD_DEFAULT_STACK_SIZE 1536
 #endif
+// lock and unlock uncontended mutexes without an SVCall
+#if !defined CONFIG_PTHREAD_MUTEX_FAST_PATH
+#define CONFIG_PTHREAD_MUTEX_FAST_PATH 1
+#endif
 
 // SCHED CONFIGURATION OPTIONS
 #if !defined CONFIG_SCHED_LOWEST_PRIORITY
@@ -51,6 +55,11 @@
 #define CONFIG_SCHED_RR_DURATION 10
 #endif
 
+// number of hashed wait queues for blocking objects (must be a power of 2)
+#if !defined CONFIG_SCHED_WAIT_QUEUE_COUNT
+#define CONFIG_SCHED_WAIT_QUEUE_COUNT 16
+#endif
+
 //If the chip has double precision floating point and only 8 sections
 //this needs to be set to zero
 #if !defined CONFIG_TASK_MPU_REGION_OFFSET
@@ -103,6 +112,38 @@
 #define CONFIG_USE_STDIO 1
 #endif
 
+// CRC tables: 1 for byte-wise, 4 or 8 for slicing (faster, 4 or 8 times the flash)
+#if !defined CONFIG_CRC_SLICE_COUNT
+#define CONFIG_CRC_SLICE_COUNT 1
+#endif
+// compute CRC-16 with mcu_calc_crc16() from the MCU port (CRC peripheral)
+#if !defined CONFIG_CRC_IS_MCU
+#define CONFIG_CRC_IS_MCU 0
+#endif
+
+// readv()/writev() on devices copy up to this many bytes to the stack so they are
+// one transfer (0 transfers each buffer separately)
+#if !defined CONFIG_DEVFS_VECTOR_BUFFER_SIZE
+#define CONFIG_DEVFS_VECTOR_BUFFER_SIZE 64
+#endif
+
+// number of aio_ring_submit() operations that can be in progress system wide
+#if !defined CONFIG_AIO_RING_ENTRY_COUNT
+#define CONFIG_AIO_RING_ENTRY_COUNT 8
+#endif
+
+// sendfile() allocates two buffers of this size when the source can't be memory
+// mapped (one is read while the other is written)
+#if !defined CONFIG_SENDFILE_BUFFER_SIZE
+#define CONFIG_SENDFILE_BUFFER_SIZE 256
+#endif
+
+// process_start() remembers the validated headers of this many applications so
+// relaunching one doesn't read the file (0 to disable)
+#if !defined CONFIG_PROCESS_LAUNCH_CACHE_SIZE
+#define CONFIG_PROCESS_LAUNCH_CACHE_SIZE 4
+#endif
+
 #define TASK_MPU_REGION_OFFSET (sos_config.mcu.task_mpu_region_offset)
 
 // higher numbers take precedence over lower numbers
@@ -81,6 +81,7 @@ void cortexm_fault_event_handler(fault_t *fault) {
     for (int i = 1; i < task_get_total(); i++) {
       if (task_get_pid(i) == pid) {
         // stop running the task
+        scheduler_root_wait_queue_remove(i);
         task_root_delete(i);
       }
     }
@@ -28,10 +28,10 @@ void crt_common(char *path_arg, int *ret, const char *name) {
   int argc;
   char **argv;
 
-  // Zero out the BSS section
-  memset(
-    &_bss, 0,
-    (uint32_t)((char *)&_ebss - (char *)&_bss) // cppcheck-suppress[comparePointers]
+  // Zero out the BSS section (the kernel zeroes a word at a time)
+  crt_zero_data(
+    &_bss,
+    (int)((char *)&_ebss - (char *)&_bss) // cppcheck-suppress[comparePointers]
   );
 
   _REENT->procmem_base = (proc_mem_t *)&_ebss;
@@ -43,10 +43,8 @@ void crt_common(char *path_arg, int *ret, const char *name) {
   //u32 * value = 0;
   //*value = 100;
 
-  const open_file_t init_open_file = {0};
-  for (int i = 0; i < OPEN_MAX; i++) {
-    _REENT->procmem_base->open_file[i] = init_open_file;
-  }
+  // all descriptors start closed
+  crt_zero_data(_REENT->procmem_base->open_file, sizeof(open_file_t) * OPEN_MAX);
 
   // Initialize the global mutexes
   __lock_init_recursive_global(__malloc_lock_object);
@@ -73,6 +71,7 @@ void crt_common(char *path_arg, int *ret, const char *name) {
 
   // Execute main
   constructors();
+  crt_trace_launch();
   *ret = main(argc, argv);
   destructors();
 }
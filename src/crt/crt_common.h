@@ -29,6 +29,8 @@ void crt_common(char *path_arg, int *ret, const char *name)
 void crt_exit(int exit_code);
 
 void crt_load_data(void * global_reent, int code_size, int data_size);
+void crt_zero_data(void * dest, int size);
+void crt_trace_launch();
 char ** const crt_import_argv(const char * path_arg, int * argc);
 
 #endif /* CRT_COMMON_H_ */
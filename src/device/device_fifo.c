@@ -37,16 +37,12 @@ int event_data_ready(void *context, const mcu_event_t *event) {
 
   int result = state->async.result;
   u8 *source_buffer = config->read_buffer;
-  u8 *dest_buffer = (u8*)config->fifo.buffer;
   fifo_state_t *fifo_state = &state->fifo;
 
   do {
 
     if (result > 0) {
-      for (int i = 0; i < result; i++) {
-        dest_buffer[fifo_state->atomic_position.access.head] = source_buffer[i];
-        fifo_inc_head(fifo_state, config->fifo.size);
-      }
+      fifo_push_buffer(&(config->fifo), fifo_state, (const char *)source_buffer, result);
 
       // see if any functions are blocked waiting for data to arrive
       fifo_data_received(&(config->fifo), fifo_state);
@@ -105,6 +101,9 @@ int device_fifo_ioctl(const devfs_handle_t *handle, int request, void *ctl) {
   case I_FIFO_GETINFO:
     fifo_getinfo(info, &(config->fifo), &(state->fifo));
     return 0;
+  case I_DEVFS_POLL:
+    // writes go straight to the device
+    return fifo_poll(&(config->fifo), &(state->fifo)) | DEVFS_POLL_FLAG_IS_WRITE_READY;
   case I_MCU_SETACTION:
     if (action->handler.callback == 0) {
       fifo_cancel_async_read(&(state->fifo));
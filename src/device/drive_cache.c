@@ -0,0 +1,764 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+
+#include "sos/sos.h"
+
+#include "cortexm/cortexm.h"
+#include "cortexm/task.h"
+#include "device/drive_cache.h"
+#include "sos/debug.h"
+
+static u32
+block_units(const drive_cache_config_t *config, const drive_cache_state_t *state);
+static int block_bytes(
+  const drive_cache_config_t *config,
+  const drive_cache_state_t *state,
+  u32 block);
+static u8 *line_buffer(const drive_cache_config_t *config, int line);
+static int is_busy(int result);
+static int find_line(const drive_cache_config_t *config, u32 block);
+static int find_replacement(const drive_cache_config_t *config, u32 block);
+static int claim(const devfs_handle_t *handle, devfs_async_t *async, int op);
+static int start_operation(const devfs_handle_t *handle);
+static void execute_operations(const devfs_handle_t *handle);
+static int run_operation(const devfs_handle_t *handle);
+static int run_request(const devfs_handle_t *handle, int is_read);
+static int run_read_ahead(const devfs_handle_t *handle);
+static int run_sync(const devfs_handle_t *handle);
+static void finish_operation(const devfs_handle_t *handle, int is_notify);
+static void select_next(const devfs_handle_t *handle, int is_read_ahead, int is_sync);
+static int load_line(
+  const devfs_handle_t *handle,
+  u32 block,
+  int is_fill,
+  int is_counted,
+  int *line);
+static int start_transfer(const devfs_handle_t *handle, int line, int is_write);
+static int continue_transfer(const devfs_handle_t *handle);
+static int finish_transfer(const devfs_handle_t *handle, int result);
+static int handle_complete(void *context, const mcu_event_t *event);
+
+int drive_cache_open(const devfs_handle_t *handle) {
+  const drive_cache_config_t *config = handle->config;
+  drive_cache_state_t *state = handle->state;
+  drive_info_t info;
+
+  int result = config->device.driver.open(&config->device.handle);
+  if (result < 0) {
+    return result;
+  }
+
+  result =
+    config->device.driver.ioctl(&config->device.handle, I_DRIVE_GETINFO, &info);
+  if (result < 0) {
+    return result;
+  }
+
+  if (
+    (info.addressable_size == 0) || (config->block_size % info.addressable_size)
+    || (config->set_count == 0) || (config->way_count == 0)) {
+    sos_debug_log_error(
+      SOS_DEBUG_DEVICE, "cache block size %d incompatible with %d", config->block_size,
+      info.addressable_size);
+    return SYSFS_SET_RETURN(EINVAL);
+  }
+
+  if (state->addressable_size == 0) {
+    // first open -- the cache is empty (later opens keep cached blocks)
+    memset(
+      config->line_array, 0,
+      sizeof(drive_cache_line_t) * config->set_count * config->way_count);
+    memset(state, 0, sizeof(drive_cache_state_t));
+  }
+
+  state->addressable_size = info.addressable_size;
+  state->drive_size =
+    (u64)info.num_write_blocks * info.write_block_size / info.addressable_size;
+  return 0;
+}
+
+int drive_cache_read(const devfs_handle_t *handle, devfs_async_t *async) {
+  drive_cache_state_t *state = handle->state;
+
+  if (state->addressable_size == 0) {
+    return SYSFS_SET_RETURN(EIO);
+  }
+
+  if (async->nbyte == 0) {
+    return 0;
+  }
+
+  const int result = claim(handle, async, DRIVE_CACHE_OP_READ);
+  if (result != 0) {
+    // another read is in progress (< 0) or the read waits for the current operation
+    return result < 0 ? result : 0;
+  }
+  return start_operation(handle);
+}
+
+int drive_cache_write(const devfs_handle_t *handle, devfs_async_t *async) {
+  drive_cache_state_t *state = handle->state;
+
+  if (state->addressable_size == 0) {
+    return SYSFS_SET_RETURN(EIO);
+  }
+
+  if (async->nbyte == 0) {
+    return 0;
+  }
+
+  const int result = claim(handle, async, DRIVE_CACHE_OP_WRITE);
+  if (result != 0) {
+    return result < 0 ? result : 0;
+  }
+  return start_operation(handle);
+}
+
+int drive_cache_ioctl(const devfs_handle_t *handle, int request, void *ctl) {
+  const drive_cache_config_t *config = handle->config;
+  drive_cache_state_t *state = handle->state;
+  drive_info_t *info = ctl;
+  drive_attr_t *attr = ctl;
+  const mcu_action_t *action = ctl;
+  int result;
+
+  switch (request) {
+  case I_DRIVE_SETATTR: {
+    const int is_sync_only = (attr->o_flags & ~DRIVE_FLAG_SYNC) == 0;
+    if (claim(handle, NULL, DRIVE_CACHE_OP_SYNC) || run_operation(handle)) {
+      // the write back continues in the background
+      return is_sync_only ? 0 : SYSFS_SET_RETURN(EBUSY);
+    }
+
+    result = state->result;
+    if ((result == 0) && (is_sync_only == 0)) {
+      // erase, init, reset, etc change the drive behind the cache
+      const int count = config->set_count * config->way_count;
+      for (int line = 0; line < count; line++) {
+        config->line_array[line].o_flags = 0;
+      }
+      result = config->device.driver.ioctl(&config->device.handle, request, ctl);
+    }
+
+    finish_operation(handle, 0);
+    execute_operations(handle);
+    if (is_sync_only && is_busy(result)) {
+      // the drive is still busy -- polling I_DRIVE_ISBUSY finishes the write back
+      return 0;
+    }
+    return result;
+  }
+
+  case I_DRIVE_ISBUSY:
+    if (
+      (state->o_flags & DRIVE_CACHE_FLAG_IS_SYNC_PENDING)
+      && (claim(handle, NULL, DRIVE_CACHE_OP_SYNC) == 0)) {
+      // continue the write back that was waiting for the drive
+      result = start_operation(handle);
+      if ((result < 0) && (is_busy(result) == 0)) {
+        return result;
+      }
+    }
+
+    if (
+      (state->op != DRIVE_CACHE_OP_NONE)
+      || (state->o_flags & DRIVE_CACHE_FLAG_IS_SYNC_PENDING)) {
+      return 1;
+    }
+
+    if (state->sync_result < 0) {
+      result = state->sync_result;
+      state->sync_result = 0;
+      return result;
+    }
+    break;
+
+  case I_DRIVE_GETINFO:
+    result = config->device.driver.ioctl(&config->device.handle, request, ctl);
+    if (result < 0) {
+      return result;
+    }
+    info->o_flags |= DRIVE_FLAG_SYNC;
+    info->cache_hit_count = state->hit_count;
+    info->cache_miss_count = state->miss_count;
+    return result;
+
+  case I_MCU_SETACTION:
+    if (action->handler.callback == 0) {
+      // the caller was interrupted and its async object is about to go out of
+      // scope -- the drive's transfer (to the cache buffer) is left to finish
+      const u32 primask = __get_PRIMASK();
+      cortexm_disable_interrupts();
+      devfs_async_t **async = (action->o_events & MCU_EVENT_FLAG_DATA_READY)
+                                ? &state->transfer_handler.read
+                                : &state->transfer_handler.write;
+      if ((*async != NULL) && ((*async)->tid == task_get_current())) {
+        *async = NULL;
+      }
+      __set_PRIMASK(primask);
+      return 0;
+    }
+    break;
+  }
+
+  return config->device.driver.ioctl(&config->device.handle, request, ctl);
+}
+
+int drive_cache_close(const devfs_handle_t *handle) {
+  const drive_cache_config_t *config = handle->config;
+  drive_cache_state_t *state = handle->state;
+  if (state->addressable_size) {
+    if (claim(handle, NULL, DRIVE_CACHE_OP_SYNC) == 0) {
+      const int result = start_operation(handle);
+      if ((result < 0) && (is_busy(result) == 0)) {
+        return result;
+      }
+    }
+
+    const u32 primask = __get_PRIMASK();
+    cortexm_disable_interrupts();
+    const int is_deferred = (state->op != DRIVE_CACHE_OP_NONE)
+                            || (state->o_flags & DRIVE_CACHE_FLAG_IS_SYNC_PENDING);
+    if (is_deferred) {
+      state->close_count++;
+    }
+    __set_PRIMASK(primask);
+
+    if (is_deferred) {
+      // the drive is closed when the write back finishes
+      return 0;
+    }
+  }
+  return config->device.driver.close(&config->device.handle);
+}
+
+u32 block_units(const drive_cache_config_t *config, const drive_cache_state_t *state) {
+  return config->block_size / state->addressable_size;
+}
+
+int block_bytes(
+  const drive_cache_config_t *config,
+  const drive_cache_state_t *state,
+  u32 block) {
+  // the last block of the drive may be partial
+  const u32 units = block_units(config, state);
+  const u32 start = block * units;
+  if ((start / units != block) || (start >= state->drive_size)) {
+    return 0;
+  }
+  u32 count = state->drive_size - start;
+  if (count > units) {
+    count = units;
+  }
+  return count * state->addressable_size;
+}
+
+u8 *line_buffer(const drive_cache_config_t *config, int line) {
+  return config->buffer + line * config->block_size;
+}
+
+int is_busy(int result) {
+  return (result < 0) && (SYSFS_GET_RETURN_ERRNO(result) == EBUSY);
+}
+
+int find_line(const drive_cache_config_t *config, u32 block) {
+  const int first = (block % config->set_count) * config->way_count;
+  for (int line = first; line < first + config->way_count; line++) {
+    const drive_cache_line_t *entry = config->line_array + line;
+    if ((entry->o_flags & DRIVE_CACHE_LINE_FLAG_IS_VALID) && (entry->block == block)) {
+      return line;
+    }
+  }
+  return -1;
+}
+
+int find_replacement(const drive_cache_config_t *config, u32 block) {
+  // an empty line, else the least recently used clean line, else the least
+  // recently used dirty line (which has to be written back first)
+  const int first = (block % config->set_count) * config->way_count;
+  int clean = -1;
+  int dirty = -1;
+  for (int line = first; line < first + config->way_count; line++) {
+    const drive_cache_line_t *entry = config->line_array + line;
+    if ((entry->o_flags & DRIVE_CACHE_LINE_FLAG_IS_VALID) == 0) {
+      return line;
+    }
+    int *oldest = (entry->o_flags & DRIVE_CACHE_LINE_FLAG_IS_DIRTY) ? &dirty : &clean;
+    if ((*oldest < 0) || (entry->access < config->line_array[*oldest].access)) {
+      *oldest = line;
+    }
+  }
+  return clean >= 0 ? clean : dirty;
+}
+
+int claim(const devfs_handle_t *handle, devfs_async_t *async, int op) {
+  drive_cache_state_t *state = handle->state;
+  int result = 0;
+
+  // operations finish (and the next one starts) from the drive's interrupt
+  const u32 primask = __get_PRIMASK();
+  cortexm_disable_interrupts();
+  if (op == DRIVE_CACHE_OP_SYNC) {
+    if (
+      (state->op != DRIVE_CACHE_OP_NONE) || state->transfer_handler.read
+      || state->transfer_handler.write) {
+      // write back when the current operation finishes
+      state->o_flags |= DRIVE_CACHE_FLAG_IS_SYNC_PENDING;
+      result = 1;
+    } else {
+      state->o_flags &= ~DRIVE_CACHE_FLAG_IS_SYNC_PENDING;
+      state->block = 0;
+    }
+  } else {
+    devfs_async_t **request = op == DRIVE_CACHE_OP_READ ? &state->transfer_handler.read
+                                                        : &state->transfer_handler.write;
+    if ((*request != NULL) || (state->op == op)) {
+      // (the slot is cleared while an interrupted request finishes)
+      result = SYSFS_SET_RETURN(EBUSY);
+    } else {
+      *request = async;
+      if (state->op != DRIVE_CACHE_OP_NONE) {
+        // the request is started when the current operation finishes
+        result = 1;
+      }
+    }
+  }
+
+  if (result == 0) {
+    state->op = op;
+    state->bytes = 0;
+    state->o_flags &= ~DRIVE_CACHE_FLAG_IS_MISS;
+  }
+  __set_PRIMASK(primask);
+  return result;
+}
+
+int start_operation(const devfs_handle_t *handle) {
+  drive_cache_state_t *state = handle->state;
+  if (run_operation(handle)) {
+    // handle_complete() finishes the operation
+    return 0;
+  }
+
+  // finished without waiting for the drive -- the caller gets the result directly
+  const int result = state->result;
+  finish_operation(handle, 0);
+  execute_operations(handle);
+  return result;
+}
+
+void execute_operations(const devfs_handle_t *handle) {
+  drive_cache_state_t *state = handle->state;
+  while (state->op != DRIVE_CACHE_OP_NONE) {
+    if (run_operation(handle)) {
+      return;
+    }
+    finish_operation(handle, 1);
+  }
+}
+
+int run_operation(const devfs_handle_t *handle) {
+  drive_cache_state_t *state = handle->state;
+  switch (state->op) {
+  case DRIVE_CACHE_OP_READ:
+    return run_request(handle, 1);
+  case DRIVE_CACHE_OP_WRITE:
+    return run_request(handle, 0);
+  case DRIVE_CACHE_OP_READ_AHEAD:
+    return run_read_ahead(handle);
+  case DRIVE_CACHE_OP_SYNC:
+    return run_sync(handle);
+  }
+  return 0;
+}
+
+int run_request(const devfs_handle_t *handle, int is_read) {
+  const drive_cache_config_t *config = handle->config;
+  drive_cache_state_t *state = handle->state;
+  const u32 units = block_units(config, state);
+
+  for (;;) {
+    const devfs_async_t *async =
+      is_read ? state->transfer_handler.read : state->transfer_handler.write;
+    if (async == NULL) {
+      // the caller gave up on the request
+      state->result = SYSFS_SET_RETURN(EINTR);
+      return 0;
+    }
+
+    if (state->bytes == async->nbyte) {
+      break;
+    }
+
+    const u32 position = (async->loc % units) * state->addressable_size + state->bytes;
+    const u32 block = async->loc / units + position / config->block_size;
+    const int offset = position % config->block_size;
+    const int size = block_bytes(config, state, block);
+    if (offset >= size) {
+      // end of the drive
+      break;
+    }
+
+    int page = size - offset;
+    if (page > async->nbyte - state->bytes) {
+      page = async->nbyte - state->bytes;
+    }
+
+    // a write that covers the whole block doesn't need to read it first
+    int line;
+    const int result =
+      load_line(handle, block, is_read || (offset != 0) || (page != size), 1, &line);
+    if (result > 0) {
+      return 1;
+    }
+    if (result < 0) {
+      if (is_busy(result) && state->bytes) {
+        // the caller gets the bytes that are done and tries again for the rest
+        break;
+      }
+      state->result = result;
+      return 0;
+    }
+
+    if (is_read) {
+      memcpy((u8 *)async->buf + state->bytes, line_buffer(config, line) + offset, page);
+    } else {
+      memcpy(
+        line_buffer(config, line) + offset, (const u8 *)async->buf_const + state->bytes,
+        page);
+      config->line_array[line].o_flags |= DRIVE_CACHE_LINE_FLAG_IS_DIRTY;
+      if (line == state->line) {
+        // the part that was written back has changed
+        state->o_flags &= ~DRIVE_CACHE_FLAG_IS_RESUME;
+      }
+    }
+    state->bytes += page;
+    state->o_flags &= ~DRIVE_CACHE_FLAG_IS_MISS;
+  }
+
+  state->result = state->bytes ? state->bytes : SYSFS_SET_RETURN(EINVAL);
+  return 0;
+}
+
+int run_read_ahead(const devfs_handle_t *handle) {
+  const drive_cache_config_t *config = handle->config;
+  drive_cache_state_t *state = handle->state;
+
+  for (; state->count > 0; state->count--, state->block++) {
+    if (state->transfer_handler.read || state->transfer_handler.write) {
+      // a request is waiting
+      break;
+    }
+    if (block_bytes(config, state, state->block) == 0) {
+      break;
+    }
+    if (find_line(config, state->block) < 0) {
+      int line;
+      const int result = load_line(handle, state->block, 1, 0, &line);
+      if (result > 0) {
+        return 1;
+      }
+      if (result < 0) {
+        // errors are reported when the block is actually read
+        break;
+      }
+    }
+  }
+
+  state->result = 0;
+  return 0;
+}
+
+int run_sync(const devfs_handle_t *handle) {
+  const drive_cache_config_t *config = handle->config;
+  drive_cache_state_t *state = handle->state;
+  const int count = config->set_count * config->way_count;
+  const u32 mask = DRIVE_CACHE_LINE_FLAG_IS_VALID | DRIVE_CACHE_LINE_FLAG_IS_DIRTY;
+
+  for (; state->block < (u32)count; state->block++) {
+    if ((config->line_array[state->block].o_flags & mask) == mask) {
+      const int result = start_transfer(handle, state->block, 1);
+      if (result > 0) {
+        return 1;
+      }
+      if (result < 0) {
+        state->result = result;
+        return 0;
+      }
+    }
+  }
+
+  state->result = 0;
+  return 0;
+}
+
+void finish_operation(const devfs_handle_t *handle, int is_notify) {
+  const drive_cache_config_t *config = handle->config;
+  drive_cache_state_t *state = handle->state;
+  const int result = state->result;
+  int is_read_ahead = 0;
+
+  switch (state->op) {
+  case DRIVE_CACHE_OP_READ:
+    if ((result > 0) && (state->transfer_handler.read != NULL)) {
+      const devfs_async_t *async = state->transfer_handler.read;
+      const u32 units = block_units(config, state);
+      const u32 first_block = async->loc / units;
+      const u32 end_block =
+        first_block
+        + ((async->loc % units) * state->addressable_size + result - 1)
+            / config->block_size
+        + 1;
+      is_read_ahead =
+        (config->read_ahead_count != 0)
+        && ((first_block == state->next_block) || (first_block + 1 == state->next_block));
+      state->next_block = end_block;
+    }
+    if (is_notify) {
+      devfs_execute_read_handler(
+        &state->transfer_handler, 0, result, MCU_EVENT_FLAG_DATA_READY);
+    } else {
+      state->transfer_handler.read = NULL;
+    }
+    break;
+
+  case DRIVE_CACHE_OP_WRITE:
+    if (is_notify) {
+      devfs_execute_write_handler(
+        &state->transfer_handler, 0, result, MCU_EVENT_FLAG_WRITE_COMPLETE);
+    } else {
+      state->transfer_handler.write = NULL;
+    }
+    break;
+
+  case DRIVE_CACHE_OP_SYNC:
+    if (is_busy(result)) {
+      // the drive is busy with the last write back -- I_DRIVE_ISBUSY continues
+      state->o_flags |= DRIVE_CACHE_FLAG_IS_SYNC_PENDING;
+    } else if (is_notify && (result < 0)) {
+      state->sync_result = result;
+    }
+    break;
+  }
+
+  select_next(handle, is_read_ahead, state->op != DRIVE_CACHE_OP_SYNC);
+}
+
+void select_next(const devfs_handle_t *handle, int is_read_ahead, int is_sync) {
+  const drive_cache_config_t *config = handle->config;
+  drive_cache_state_t *state = handle->state;
+  int close_count = 0;
+
+  const u32 primask = __get_PRIMASK();
+  cortexm_disable_interrupts();
+  state->bytes = 0;
+  state->o_flags &= ~DRIVE_CACHE_FLAG_IS_MISS;
+  if (state->transfer_handler.read) {
+    state->op = DRIVE_CACHE_OP_READ;
+  } else if (state->transfer_handler.write) {
+    state->op = DRIVE_CACHE_OP_WRITE;
+  } else if (is_sync && (state->o_flags & DRIVE_CACHE_FLAG_IS_SYNC_PENDING)) {
+    state->op = DRIVE_CACHE_OP_SYNC;
+    state->o_flags &= ~DRIVE_CACHE_FLAG_IS_SYNC_PENDING;
+    state->block = 0;
+  } else if (is_read_ahead) {
+    state->op = DRIVE_CACHE_OP_READ_AHEAD;
+    state->block = state->next_block;
+    state->count = config->read_ahead_count;
+  } else {
+    state->op = DRIVE_CACHE_OP_NONE;
+    if ((state->o_flags & DRIVE_CACHE_FLAG_IS_SYNC_PENDING) == 0) {
+      close_count = state->close_count;
+      state->close_count = 0;
+    }
+  }
+  __set_PRIMASK(primask);
+
+  // closes that waited for the write back
+  for (int i = 0; i < close_count; i++) {
+    config->device.driver.close(&config->device.handle);
+  }
+}
+
+int load_line(
+  const devfs_handle_t *handle,
+  u32 block,
+  int is_fill,
+  int is_counted,
+  int *line) {
+  const drive_cache_config_t *config = handle->config;
+  drive_cache_state_t *state = handle->state;
+
+  for (;;) {
+    int result = find_line(config, block);
+    if (result >= 0) {
+      if (is_counted && ((state->o_flags & DRIVE_CACHE_FLAG_IS_MISS) == 0)) {
+        state->hit_count++;
+      }
+      config->line_array[result].access = ++state->access_count;
+      *line = result;
+      return 0;
+    }
+
+    const int replace = find_replacement(config, block);
+    drive_cache_line_t *entry = config->line_array + replace;
+    if (entry->o_flags & DRIVE_CACHE_LINE_FLAG_IS_DIRTY) {
+      result = start_transfer(handle, replace, 1);
+      if (result != 0) {
+        return result;
+      }
+      continue;
+    }
+
+    if (is_counted && ((state->o_flags & DRIVE_CACHE_FLAG_IS_MISS) == 0)) {
+      state->miss_count++;
+      state->o_flags |= DRIVE_CACHE_FLAG_IS_MISS;
+    }
+
+    entry->block = block;
+    if (is_fill) {
+      entry->o_flags = 0;
+      result = start_transfer(handle, replace, 0);
+      if (result != 0) {
+        return result;
+      }
+    } else {
+      entry->o_flags = DRIVE_CACHE_LINE_FLAG_IS_VALID;
+    }
+  }
+}
+
+int start_transfer(const devfs_handle_t *handle, int line, int is_write) {
+  drive_cache_state_t *state = handle->state;
+  if (
+    (is_write == 0) || (state->line != line)
+    || ((state->o_flags & DRIVE_CACHE_FLAG_IS_RESUME) == 0)) {
+    state->line = line;
+    state->line_bytes = 0;
+  }
+  state->o_flags &= ~DRIVE_CACHE_FLAG_IS_RESUME;
+  if (is_write) {
+    state->o_flags |= DRIVE_CACHE_FLAG_IS_WRITE_BACK;
+  } else {
+    state->o_flags &= ~DRIVE_CACHE_FLAG_IS_WRITE_BACK;
+  }
+  return continue_transfer(handle);
+}
+
+int continue_transfer(const devfs_handle_t *handle) {
+  // returns 1 while the drive is transferring the line, else finish_transfer()
+  const drive_cache_config_t *config = handle->config;
+  drive_cache_state_t *state = handle->state;
+  const devfs_device_t *device = &config->device;
+  const drive_cache_line_t *entry = config->line_array + state->line;
+  const int size = block_bytes(config, state, entry->block);
+  const int is_write = (state->o_flags & DRIVE_CACHE_FLAG_IS_WRITE_BACK) != 0;
+
+  while (state->line_bytes < size) {
+    // flash drives stay busy after a write -- don't wait here
+    if (device->driver.ioctl(&device->handle, I_DRIVE_ISBUSY, NULL) > 0) {
+      if (is_write && state->line_bytes) {
+        // a line that is written a page at a time picks up where it stopped
+        state->o_flags |= DRIVE_CACHE_FLAG_IS_RESUME;
+      }
+      return finish_transfer(handle, SYSFS_SET_RETURN(EBUSY));
+    }
+
+    memset(&state->async, 0, sizeof(devfs_async_t));
+    state->async.tid = task_get_current();
+    state->async.flags = O_RDWR;
+    state->async.loc =
+      entry->block * block_units(config, state) + state->line_bytes / state->addressable_size;
+    state->async.buf = line_buffer(config, state->line) + state->line_bytes;
+    state->async.nbyte = size - state->line_bytes;
+    state->async.handler.callback = handle_complete;
+    state->async.handler.context = (void *)handle;
+
+    state->o_flags |= DRIVE_CACHE_FLAG_IS_STARTING;
+    state->o_flags &= ~DRIVE_CACHE_FLAG_IS_COMPLETE;
+    int result = is_write ? device->driver.write(&device->handle, &state->async)
+                          : device->driver.read(&device->handle, &state->async);
+
+    const u32 primask = __get_PRIMASK();
+    cortexm_disable_interrupts();
+    state->o_flags &= ~DRIVE_CACHE_FLAG_IS_STARTING;
+    const int is_pending =
+      (result == 0) && ((state->o_flags & DRIVE_CACHE_FLAG_IS_COMPLETE) == 0);
+    __set_PRIMASK(primask);
+
+    if (is_pending) {
+      // handle_complete() continues from the drive's interrupt
+      return 1;
+    }
+
+    if (result == 0) {
+      // the handler was executed before read() or write() returned
+      result = state->async.result ? state->async.result : state->async.nbyte;
+    }
+    if (result <= 0) {
+      return finish_transfer(handle, result ? result : SYSFS_SET_RETURN(EIO));
+    }
+    state->line_bytes += result;
+  }
+
+  return finish_transfer(handle, 0);
+}
+
+int finish_transfer(const devfs_handle_t *handle, int result) {
+  const drive_cache_config_t *config = handle->config;
+  drive_cache_state_t *state = handle->state;
+  drive_cache_line_t *entry = config->line_array + state->line;
+
+  if (state->o_flags & DRIVE_CACHE_FLAG_IS_WRITE_BACK) {
+    if (result == 0) {
+      entry->o_flags &= ~DRIVE_CACHE_LINE_FLAG_IS_DIRTY;
+    }
+  } else {
+    // a line that failed to fill doesn't hold the block
+    entry->o_flags = result == 0 ? DRIVE_CACHE_LINE_FLAG_IS_VALID : 0;
+  }
+  return result;
+}
+
+int handle_complete(void *context, const mcu_event_t *event) {
+  const devfs_handle_t *handle = context;
+  drive_cache_state_t *state = handle->state;
+
+  const u32 primask = __get_PRIMASK();
+  cortexm_disable_interrupts();
+  const int is_starting = (state->o_flags & DRIVE_CACHE_FLAG_IS_STARTING) != 0;
+  if (is_starting) {
+    // continue_transfer() picks up the result when read() or write() returns
+    state->o_flags |= DRIVE_CACHE_FLAG_IS_COMPLETE;
+  }
+  __set_PRIMASK(primask);
+  if (is_starting) {
+    return 0;
+  }
+
+  int result = state->async.result ? state->async.result : state->async.nbyte;
+  if ((event != NULL) && (event->o_events & MCU_EVENT_FLAG_CANCELED) && (result >= 0)) {
+    result = SYSFS_SET_RETURN(EAGAIN);
+  }
+
+  if (result > 0) {
+    state->line_bytes += result;
+    result = continue_transfer(handle);
+    if (result > 0) {
+      return 0;
+    }
+  } else {
+    result = finish_transfer(handle, result ? result : SYSFS_SET_RETURN(EIO));
+  }
+
+  if (result < 0) {
+    // the drive failed -- the operation fails with its error
+    state->result = result;
+    finish_operation(handle, 1);
+  }
+  execute_operations(handle);
+  return 0;
+}
@@ -1,5 +1,7 @@
 // Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
 
+#include <string.h>
+
 #include "sos/config.h"
 #include "sos/debug.h"
 #include "sos/dev/pio.h"
@@ -70,6 +72,14 @@ static void drive_cfi_spi_initialize_cs(const devfs_handle_t *handle);
 static void drive_cfi_spi_assert_cs(const devfs_handle_t *handle);
 static void drive_cfi_spi_deassert_cs(const devfs_handle_t *handle);
 static int drive_cfi_spi_handle_complete(void *context, const mcu_event_t *event);
+static void drive_cfi_spi_erase_block(const devfs_handle_t *handle, u32 address);
+static int drive_cfi_spi_is_busy(const devfs_handle_t *handle);
+static void drive_cfi_spi_start_erase(const devfs_handle_t *handle, u32 start, u32 end);
+static int drive_cfi_spi_start_background_erase(const devfs_handle_t *handle);
+static void drive_cfi_spi_discard(const devfs_handle_t *handle, u32 start, u32 end);
+static void range_add(drive_cfi_range_t *list, u32 start, u32 end);
+static void range_remove(drive_cfi_range_t *list, u32 start, u32 end);
+static int range_contains(const drive_cfi_range_t *list, u32 start, u32 end);
 static int drive_initialize(const devfs_handle_t *handle);
 
 int drive_cfi_spi_open(const devfs_handle_t *handle) {
@@ -118,9 +128,9 @@ int drive_initialize(const devfs_handle_t *handle) {
 
 int drive_cfi_spi_ioctl(const devfs_handle_t *handle, int request, void *ctl) {
   const drive_cfi_config_t *config = handle->config;
+  drive_cfi_state_t *state = handle->state;
   drive_attr_t *attr = ctl;
   drive_info_t *info = ctl;
-  u8 status;
 
   switch (request) {
   case I_DRIVE_GETVERSION:
@@ -131,6 +141,13 @@ int drive_cfi_spi_ioctl(const devfs_handle_t *handle, int request, void *ctl) {
       return SYSFS_SET_RETURN(EINVAL);
     }
     u32 o_flags = attr->o_flags;
+    state->is_foreground = 1;
+
+    // the flash ignores commands while it is programming or erasing (a reset is
+    // always sent)
+    if (((o_flags & DRIVE_FLAG_RESET) == 0) && drive_cfi_spi_is_busy(handle)) {
+      return SYSFS_SET_RETURN(EBUSY);
+    }
 
     if (o_flags & DRIVE_FLAG_INIT) {
       int result;
@@ -164,21 +181,32 @@ int drive_cfi_spi_ioctl(const devfs_handle_t *handle, int request, void *ctl) {
       drive_cfi_spi_write_instruction_with_cs(handle, config->opcode.power_down, 0, 0);
     }
 
+    if (o_flags & DRIVE_FLAG_DISCARD_BLOCKS) {
+      drive_cfi_spi_discard(handle, attr->start, attr->end);
+    }
+
     if (o_flags & DRIVE_FLAG_ERASE_BLOCKS) {
-      // erase the smallest possible section size
-      u8 address[3];
-      address[0] = attr->start >> 16;
-      address[1] = attr->start >> 8;
-      address[2] = attr->start;
-      drive_cfi_spi_write_instruction_with_cs(handle, config->opcode.write_enable, 0, 0);
-      drive_cfi_spi_write_instruction_with_cs(
-        handle, config->opcode.block_erase, address, sizeof(address));
+      // erase the smallest possible section size (the block that contains start)
+      const u32 size = config->info.erase_block_size;
+      const u32 start = attr->start / size * size;
+      const u32 end = start + size;
+      // the block is in use again so it must not be erased in the background later
+      range_remove(state->discard_list, start, end);
+      if (range_contains(state->erased_list, start, end) == 0) {
+        // added to erased_list when I_DRIVE_ISBUSY sees the erase is done
+        drive_cfi_spi_erase_block(handle, start);
+        drive_cfi_spi_start_erase(handle, start, end);
+      }
       return config->info.erase_block_size;
     }
 
     if (o_flags & DRIVE_FLAG_ERASE_DEVICE) {
       drive_cfi_spi_write_instruction_with_cs(handle, config->opcode.write_enable, 0, 0);
       drive_cfi_spi_write_instruction_with_cs(handle, config->opcode.device_erase, 0, 0);
+      memset(state->discard_list, 0, sizeof(state->discard_list));
+      memset(state->erased_list, 0, sizeof(state->erased_list));
+      drive_cfi_spi_start_erase(
+        handle, 0, config->info.num_write_blocks * config->info.write_block_size);
     }
 
   } break;
@@ -187,7 +215,7 @@ int drive_cfi_spi_ioctl(const devfs_handle_t *handle, int request, void *ctl) {
     info->o_flags = DRIVE_FLAG_INIT | DRIVE_FLAG_RESET | DRIVE_FLAG_PROTECT
                     | DRIVE_FLAG_UNPROTECT | DRIVE_FLAG_ERASE_BLOCKS
                     | DRIVE_FLAG_ERASE_DEVICE | DRIVE_FLAG_POWERUP | DRIVE_FLAG_POWERDOWN
-                    | 0;
+                    | DRIVE_FLAG_DISCARD_BLOCKS;
 
     info->o_events = MCU_EVENT_FLAG_WRITE_COMPLETE | MCU_EVENT_FLAG_DATA_READY;
     info->addressable_size =
@@ -203,10 +231,18 @@ int drive_cfi_spi_ioctl(const devfs_handle_t *handle, int request, void *ctl) {
     break;
 
   case I_DRIVE_ISBUSY:
-    status = drive_cfi_spi_read_status_with_cs(handle);
-    if ((status & config->opcode.busy_status_mask) != 0) {
-      // device is busy
-      return 1;
+    if (drive_cfi_spi_is_busy(handle)) {
+      // a background erase is only started when the caller has nothing in progress
+      return state->is_foreground;
+    }
+
+    if (state->is_foreground) {
+      // the caller's operation is done
+      state->is_foreground = 0;
+    } else if (state->handler.callback == 0) {
+      // the caller polled again without any other requests -- erase one discarded
+      // block (the next request returns EBUSY until it is done)
+      drive_cfi_spi_start_background_erase(handle);
     }
     break;
   }
@@ -223,9 +259,11 @@ int drive_cfi_spi_handle_complete(void *context, const mcu_event_t *event) {
   // deassert the cs
   drive_cfi_spi_deassert_cs(handle);
 
-  devfs_execute_event_handler(
-    &state->handler, MCU_EVENT_FLAG_WRITE_COMPLETE | MCU_EVENT_FLAG_DATA_READY, 0);
+  // the driver is idle before the callback so the callback can start another transfer
+  mcu_event_handler_t handler = state->handler;
   state->handler.callback = 0;
+  devfs_execute_event_handler(
+    &handler, MCU_EVENT_FLAG_WRITE_COMPLETE | MCU_EVENT_FLAG_DATA_READY, 0);
   return 0;
 }
 
@@ -244,8 +282,9 @@ int drive_cfi_spi_read(const devfs_handle_t *handle, devfs_async_t *async) {
     async->nbyte = num_blocks * config->info.addressable_size;
   }
 
-  // is device already busy?
-  if (state->handler.callback != 0) {
+  // is device already busy? (the caller polls I_DRIVE_ISBUSY until it is idle)
+  state->is_foreground = 1;
+  if ((state->handler.callback != 0) || drive_cfi_spi_is_busy(handle)) {
     return SYSFS_SET_RETURN(EBUSY);
   }
 
@@ -289,8 +328,9 @@ int drive_cfi_spi_write(const devfs_handle_t *handle, devfs_async_t *async) {
     async->nbyte = num_blocks * config->info.addressable_size;
   }
 
-  // is device already busy?
-  if (state->handler.callback != 0) {
+  // is device already busy? (the caller polls I_DRIVE_ISBUSY until it is idle)
+  state->is_foreground = 1;
+  if ((state->handler.callback != 0) || drive_cfi_spi_is_busy(handle)) {
     return SYSFS_SET_RETURN(EBUSY);
   }
 
@@ -302,6 +342,14 @@ int drive_cfi_spi_write(const devfs_handle_t *handle, devfs_async_t *async) {
     async->nbyte = page_size - (async->loc & page_program_mask);
   }
 
+  // the data is no longer erased and the blocks that hold it must not be erased in
+  // the background later
+  const u32 size = config->info.erase_block_size;
+  range_remove(state->erased_list, async->loc, async->loc + async->nbyte);
+  range_remove(
+    state->discard_list, async->loc / size * size,
+    (async->loc + async->nbyte + size - 1) / size * size);
+
   // write enable instruction
   drive_cfi_spi_write_instruction_with_cs(handle, config->opcode.write_enable, 0, 0);
 
@@ -407,3 +455,138 @@ int drive_cfi_spi_write_instruction(
 
   return 0;
 }
+
+void drive_cfi_spi_erase_block(const devfs_handle_t *handle, u32 address) {
+  const drive_cfi_config_t *config = handle->config;
+  u8 address_bytes[3];
+  address_bytes[0] = address >> 16;
+  address_bytes[1] = address >> 8;
+  address_bytes[2] = address;
+  drive_cfi_spi_write_instruction_with_cs(handle, config->opcode.write_enable, 0, 0);
+  drive_cfi_spi_write_instruction_with_cs(
+    handle, config->opcode.block_erase, address_bytes, sizeof(address_bytes));
+}
+
+// returns 1 while the flash is programming or erasing
+int drive_cfi_spi_is_busy(const devfs_handle_t *handle) {
+  const drive_cfi_config_t *config = handle->config;
+  drive_cfi_state_t *state = handle->state;
+
+  if (drive_cfi_spi_read_status_with_cs(handle) & config->opcode.busy_status_mask) {
+    return 1;
+  }
+
+  if (state->is_erasing) {
+    // the range is only known to be erased once the flash is idle
+    state->is_erasing = 0;
+    range_add(state->erased_list, state->erasing_address, state->erasing_end);
+  }
+  return 0;
+}
+
+void drive_cfi_spi_start_erase(const devfs_handle_t *handle, u32 start, u32 end) {
+  drive_cfi_state_t *state = handle->state;
+  state->erasing_address = start;
+  state->erasing_end = end;
+  state->is_erasing = 1;
+}
+
+int drive_cfi_spi_start_background_erase(const devfs_handle_t *handle) {
+  const drive_cfi_config_t *config = handle->config;
+  drive_cfi_state_t *state = handle->state;
+  const u32 size = config->info.erase_block_size;
+
+  for (u32 i = 0; i < DRIVE_CFI_RANGE_COUNT; i++) {
+    const drive_cfi_range_t *range = state->discard_list + i;
+    while (range->end > range->start) {
+      const u32 address = range->start;
+      range_remove(state->discard_list, address, address + size);
+      if (range_contains(state->erased_list, address, address + size) == 0) {
+        drive_cfi_spi_erase_block(handle, address);
+        drive_cfi_spi_start_erase(handle, address, address + size);
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+void drive_cfi_spi_discard(const devfs_handle_t *handle, u32 start, u32 end) {
+  const drive_cfi_config_t *config = handle->config;
+  drive_cfi_state_t *state = handle->state;
+  const u32 size = config->info.erase_block_size;
+
+  // only whole erase blocks can be erased ahead of time
+  start = (start + size - 1) / size * size;
+  end = end / size * size;
+  if (start < end) {
+    // erased later when I_DRIVE_ISBUSY is polled while the caller is idle
+    range_add(state->discard_list, start, end);
+  }
+}
+
+// the lists are hints -- a range that doesn't fit is dropped
+void range_add(drive_cfi_range_t *list, u32 start, u32 end) {
+  if (start >= end) {
+    return;
+  }
+
+  // merge with ranges that overlap or touch
+  for (u32 i = 0; i < DRIVE_CFI_RANGE_COUNT; i++) {
+    drive_cfi_range_t *range = list + i;
+    if ((range->end > range->start) && (range->start <= end) && (start <= range->end)) {
+      start = range->start < start ? range->start : start;
+      end = range->end > end ? range->end : end;
+      range->start = 0;
+      range->end = 0;
+      i = (u32)-1;
+    }
+  }
+
+  for (u32 i = 0; i < DRIVE_CFI_RANGE_COUNT; i++) {
+    drive_cfi_range_t *range = list + i;
+    if (range->end <= range->start) {
+      range->start = start;
+      range->end = end;
+      return;
+    }
+  }
+}
+
+void range_remove(drive_cfi_range_t *list, u32 start, u32 end) {
+  for (u32 i = 0; i < DRIVE_CFI_RANGE_COUNT; i++) {
+    drive_cfi_range_t *range = list + i;
+    if ((range->end <= range->start) || (range->start >= end) || (start >= range->end)) {
+      continue;
+    }
+
+    if ((start > range->start) && (end < range->end)) {
+      // keep both sides (the upper side is lost if there is no room)
+      const u32 upper_end = range->end;
+      range->end = start;
+      for (u32 j = 0; j < DRIVE_CFI_RANGE_COUNT; j++) {
+        if (list[j].end <= list[j].start) {
+          list[j].start = end;
+          list[j].end = upper_end;
+          break;
+        }
+      }
+    } else if (start > range->start) {
+      range->end = start;
+    } else if (end < range->end) {
+      range->start = end;
+    } else {
+      range->start = 0;
+      range->end = 0;
+    }
+  }
+}
+
+int range_contains(const drive_cfi_range_t *list, u32 start, u32 end) {
+  for (u32 i = 0; i < DRIVE_CFI_RANGE_COUNT; i++) {
+    if ((list[i].end > list[i].start) && (list[i].start <= start) && (end <= list[i].end)) {
+      return 1;
+    }
+  }
+  return 0;
+}
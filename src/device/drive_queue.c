@@ -0,0 +1,407 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <errno.h>
+#include <string.h>
+
+#include "sos/sos.h"
+
+#include "cortexm/cortexm.h"
+#include "cortexm/task.h"
+#include "device/drive_queue.h"
+#include "sos/debug.h"
+
+static int enqueue(const devfs_handle_t *handle, devfs_async_t *async, int is_read);
+static int find_next(const drive_queue_config_t *config, const drive_queue_state_t *state);
+static int find_merge(
+  const drive_queue_config_t *config,
+  const drive_queue_state_t *state,
+  u32 loc,
+  int is_read,
+  u32 available);
+static int is_pending(const drive_queue_request_t *request);
+static int is_empty(const drive_queue_config_t *config, const drive_queue_state_t *state);
+static int select_next(const devfs_handle_t *handle);
+static void execute(const devfs_handle_t *handle);
+static int start_transfer(const devfs_handle_t *handle, int *result);
+static int complete(const devfs_handle_t *handle, int result, u32 o_events);
+static void cancel(const devfs_handle_t *handle, const mcu_action_t *action);
+static int handle_complete(void *context, const mcu_event_t *event);
+
+int drive_queue_open(const devfs_handle_t *handle) {
+  const drive_queue_config_t *config = handle->config;
+  drive_queue_state_t *state = handle->state;
+  drive_info_t info;
+
+  int result = config->device.driver.open(&config->device.handle);
+  if (result < 0) {
+    return result;
+  }
+
+  result =
+    config->device.driver.ioctl(&config->device.handle, I_DRIVE_GETINFO, &info);
+  if (result < 0) {
+    return result;
+  }
+
+  if (info.addressable_size == 0) {
+    return SYSFS_SET_RETURN(EINVAL);
+  }
+
+  // requests from other open descriptors stay queued
+  state->addressable_size = info.addressable_size;
+  return 0;
+}
+
+int drive_queue_read(const devfs_handle_t *handle, devfs_async_t *async) {
+  return enqueue(handle, async, 1);
+}
+
+int drive_queue_write(const devfs_handle_t *handle, devfs_async_t *async) {
+  return enqueue(handle, async, 0);
+}
+
+int drive_queue_ioctl(const devfs_handle_t *handle, int request, void *ctl) {
+  const drive_queue_config_t *config = handle->config;
+  drive_queue_state_t *state = handle->state;
+  const mcu_action_t *action = ctl;
+
+  switch (request) {
+  case I_DRIVE_SETATTR:
+    // erase, init, etc can't be ordered with the queued requests
+    if (is_empty(config, state) == 0) {
+      return SYSFS_SET_RETURN(EBUSY);
+    }
+    break;
+
+  case I_DRIVE_ISBUSY:
+    if (is_empty(config, state) == 0) {
+      return 1;
+    }
+    break;
+
+  case I_MCU_SETACTION:
+    if (action->handler.callback == 0) {
+      // the caller was interrupted and won't wait for its request
+      cancel(handle, action);
+      return 0;
+    }
+    break;
+  }
+
+  return config->device.driver.ioctl(&config->device.handle, request, ctl);
+}
+
+int drive_queue_close(const devfs_handle_t *handle) {
+  const drive_queue_config_t *config = handle->config;
+  return config->device.driver.close(&config->device.handle);
+}
+
+int enqueue(const devfs_handle_t *handle, devfs_async_t *async, int is_read) {
+  const drive_queue_config_t *config = handle->config;
+  drive_queue_state_t *state = handle->state;
+  int result = SYSFS_SET_RETURN(EBUSY);
+  int is_start = 0;
+
+  if (state->addressable_size == 0) {
+    return SYSFS_SET_RETURN(EIO);
+  }
+
+  // the drive completes requests (and selects the next one) from its interrupt
+  const u32 primask = __get_PRIMASK();
+  cortexm_disable_interrupts();
+  for (u32 i = 0; i < config->depth; i++) {
+    drive_queue_request_t *request = config->request_array + i;
+    if ((request->async == NULL) && (request->o_flags == 0)) {
+      request->async = async;
+      request->offset = 0;
+      request->o_flags = is_read ? DRIVE_QUEUE_REQUEST_FLAG_IS_READ : 0;
+      result = 0;
+      break;
+    }
+  }
+
+  if ((result == 0) && (state->active_count == 0)) {
+    is_start = select_next(handle);
+  }
+  __set_PRIMASK(primask);
+
+  if (is_start) {
+    execute(handle);
+  }
+
+  // the request completes when its handler is executed
+  return result;
+}
+
+int is_pending(const drive_queue_request_t *request) {
+  return (request->async != NULL)
+         && ((request->o_flags & DRIVE_QUEUE_REQUEST_FLAG_IS_ACTIVE) == 0);
+}
+
+int is_empty(const drive_queue_config_t *config, const drive_queue_state_t *state) {
+  if (state->active_count) {
+    return 0;
+  }
+  for (u32 i = 0; i < config->depth; i++) {
+    if (is_pending(config->request_array + i)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+int find_next(const drive_queue_config_t *config, const drive_queue_state_t *state) {
+  // the lowest location at or after the last transfer -- else start over
+  int next = -1;
+  int lowest = -1;
+  for (u32 i = 0; i < config->depth; i++) {
+    const drive_queue_request_t *request = config->request_array + i;
+    if (is_pending(request)) {
+      const u32 loc = request->async->loc;
+      if (
+        (loc >= state->position)
+        && ((next < 0) || (loc < (u32)config->request_array[next].async->loc))) {
+        next = i;
+      }
+      if ((lowest < 0) || (loc < (u32)config->request_array[lowest].async->loc)) {
+        lowest = i;
+      }
+    }
+  }
+  return next >= 0 ? next : lowest;
+}
+
+int find_merge(
+  const drive_queue_config_t *config,
+  const drive_queue_state_t *state,
+  u32 loc,
+  int is_read,
+  u32 available) {
+  for (u32 i = 0; i < config->depth; i++) {
+    const drive_queue_request_t *request = config->request_array + i;
+    if (
+      is_pending(request) && ((u32)request->async->loc == loc)
+      && (((request->o_flags & DRIVE_QUEUE_REQUEST_FLAG_IS_READ) != 0) == is_read)
+      && (request->async->nbyte > 0) && ((u32)request->async->nbyte <= available)
+      && (request->async->nbyte % state->addressable_size == 0)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+int select_next(const devfs_handle_t *handle) {
+  // called with interrupts disabled -- whoever selects the transfer starts it
+  const drive_queue_config_t *config = handle->config;
+  drive_queue_state_t *state = handle->state;
+
+  const int first = find_next(config, state);
+  if (first < 0) {
+    return 0;
+  }
+
+  drive_queue_request_t *request = config->request_array + first;
+  const int is_read = (request->o_flags & DRIVE_QUEUE_REQUEST_FLAG_IS_READ) != 0;
+  u32 nbyte = request->async->nbyte;
+  u32 end = request->async->loc + nbyte / state->addressable_size;
+
+  request->o_flags |= DRIVE_QUEUE_REQUEST_FLAG_IS_ACTIVE;
+  request->offset = 0;
+  state->active_count = 1;
+
+  // merge requests that continue where this one ends
+  if ((nbyte % state->addressable_size == 0) && (nbyte < config->buffer_size)) {
+    int next;
+    while ((next = find_merge(config, state, end, is_read, config->buffer_size - nbyte))
+           >= 0) {
+      drive_queue_request_t *merged = config->request_array + next;
+      merged->o_flags |= DRIVE_QUEUE_REQUEST_FLAG_IS_ACTIVE;
+      merged->offset = nbyte;
+      nbyte += merged->async->nbyte;
+      end += merged->async->nbyte / state->addressable_size;
+      state->active_count++;
+      state->merge_count++;
+    }
+  }
+
+  memset(&state->async, 0, sizeof(devfs_async_t));
+  state->async.tid = request->async->tid;
+  state->async.flags = request->async->flags;
+  state->async.loc = request->async->loc;
+  state->async.nbyte = nbyte;
+  state->async.handler.callback = handle_complete;
+  state->async.handler.context = (void *)handle;
+  state->async.buf =
+    state->active_count == 1 ? request->async->buf : (void *)config->buffer;
+
+  state->is_read = is_read;
+  state->position = end;
+  state->transfer_count++;
+  return 1;
+}
+
+void execute(const devfs_handle_t *handle) {
+  // a drive that completes synchronously continues the loop rather than
+  // starting the next transfer from inside complete()
+  int result;
+  while (start_transfer(handle, &result) == 0) {
+    if (complete(handle, result, 0) == 0) {
+      return;
+    }
+  }
+}
+
+int start_transfer(const devfs_handle_t *handle, int *result) {
+  // returns 1 while the drive is busy with the transfer (handle_complete() finishes it)
+  const drive_queue_config_t *config = handle->config;
+  drive_queue_state_t *state = handle->state;
+
+  if ((state->active_count > 1) && (state->is_read == 0)) {
+    // requests that are active are owned by the transfer so this is done with
+    // interrupts enabled
+    for (u32 i = 0; i < config->depth; i++) {
+      const drive_queue_request_t *active = config->request_array + i;
+      if ((active->o_flags & DRIVE_QUEUE_REQUEST_FLAG_IS_ACTIVE) && active->async) {
+        memcpy(
+          config->buffer + active->offset, active->async->buf_const,
+          active->async->nbyte);
+      }
+    }
+  }
+
+  state->o_flags |= DRIVE_QUEUE_FLAG_IS_STARTING;
+  state->o_flags &= ~DRIVE_QUEUE_FLAG_IS_COMPLETE;
+  *result =
+    state->is_read ? config->device.driver.read(&config->device.handle, &state->async)
+                   : config->device.driver.write(&config->device.handle, &state->async);
+
+  const u32 primask = __get_PRIMASK();
+  cortexm_disable_interrupts();
+  state->o_flags &= ~DRIVE_QUEUE_FLAG_IS_STARTING;
+  const int is_pending =
+    (*result == 0) && ((state->o_flags & DRIVE_QUEUE_FLAG_IS_COMPLETE) == 0);
+  __set_PRIMASK(primask);
+
+  if (is_pending) {
+    return 1;
+  }
+
+  if (*result == 0) {
+    // the handler was executed before read() or write() returned
+    *result = state->async.result ? state->async.result : state->async.nbyte;
+  }
+  return 0;
+}
+
+int complete(const devfs_handle_t *handle, int result, u32 o_events) {
+  // returns 1 if the next transfer was selected (the caller starts it)
+  const drive_queue_config_t *config = handle->config;
+  drive_queue_state_t *state = handle->state;
+  const int is_merged = state->active_count > 1;
+
+  o_events |= state->is_read ? MCU_EVENT_FLAG_DATA_READY : MCU_EVENT_FLAG_WRITE_COMPLETE;
+
+  // the active requests belong to the transfer so they are completed (and merged
+  // reads are copied) with interrupts enabled
+  for (u32 i = 0; i < config->depth; i++) {
+    drive_queue_request_t *request = config->request_array + i;
+    if ((request->o_flags & DRIVE_QUEUE_REQUEST_FLAG_IS_ACTIVE) == 0) {
+      continue;
+    }
+
+    devfs_async_t *async = request->async;
+    const u32 offset = request->offset;
+    request->async = NULL;
+    request->o_flags = 0;
+    if (async == NULL) {
+      // the caller was interrupted
+      continue;
+    }
+
+    if (result < 0) {
+      async->result = result;
+    } else {
+      // a transfer that ran past the end of the drive is short
+      int bytes = result - (int)offset;
+      if (bytes > async->nbyte) {
+        bytes = async->nbyte;
+      }
+      if (bytes > 0) {
+        if (is_merged && state->is_read) {
+          memcpy(async->buf, config->buffer + offset, bytes);
+        }
+        async->nbyte = bytes;
+        async->result = bytes;
+      } else {
+        async->result = SYSFS_RETURN_EOF;
+      }
+    }
+    devfs_execute_event_handler(&async->handler, o_events, 0);
+  }
+
+  const u32 primask = __get_PRIMASK();
+  cortexm_disable_interrupts();
+  state->active_count = 0;
+  const int is_start = select_next(handle);
+  __set_PRIMASK(primask);
+  return is_start;
+}
+
+void cancel(const devfs_handle_t *handle, const mcu_action_t *action) {
+  const drive_queue_config_t *config = handle->config;
+  drive_queue_state_t *state = handle->state;
+  const int is_read = (action->o_events & MCU_EVENT_FLAG_DATA_READY) != 0;
+  const int tid = task_get_current();
+  int is_active_single = 0;
+
+  const u32 primask = __get_PRIMASK();
+  cortexm_disable_interrupts();
+  for (u32 i = 0; i < config->depth; i++) {
+    drive_queue_request_t *request = config->request_array + i;
+    if (
+      (request->async != NULL) && (request->async->tid == tid)
+      && (((request->o_flags & DRIVE_QUEUE_REQUEST_FLAG_IS_READ) != 0) == is_read)) {
+      // the caller's async object is about to go out of scope
+      request->async = NULL;
+      if (request->o_flags & DRIVE_QUEUE_REQUEST_FLAG_IS_ACTIVE) {
+        is_active_single = state->active_count == 1;
+      } else {
+        request->o_flags = 0;
+      }
+    }
+  }
+  __set_PRIMASK(primask);
+
+  if (is_active_single) {
+    // the drive is using the caller's buffer directly -- stop it (a merged
+    // transfer uses the queue buffer and is left to finish for the other requests)
+    mcu_action_t drive_action = *action;
+    config->device.driver.ioctl(
+      &config->device.handle, I_MCU_SETACTION, &drive_action);
+  }
+}
+
+int handle_complete(void *context, const mcu_event_t *event) {
+  const devfs_handle_t *handle = context;
+  drive_queue_state_t *state = handle->state;
+
+  const u32 primask = __get_PRIMASK();
+  cortexm_disable_interrupts();
+  const int is_starting = (state->o_flags & DRIVE_QUEUE_FLAG_IS_STARTING) != 0;
+  if (is_starting) {
+    // start_transfer() picks up the result when read() or write() returns
+    state->o_flags |= DRIVE_QUEUE_FLAG_IS_COMPLETE;
+  }
+  __set_PRIMASK(primask);
+  if (is_starting) {
+    return 0;
+  }
+
+  const int result = state->async.result ? state->async.result : state->async.nbyte;
+  if (complete(
+        handle, result,
+        event != NULL ? (event->o_events & MCU_EVENT_FLAG_CANCELED) : 0)) {
+    execute(handle);
+  }
+  return 0;
+}
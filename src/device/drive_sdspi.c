@@ -6,7 +6,7 @@
 #include "sos/sos.h"
 #include "cortexm/cortexm.h"
 #include "drive_sdspi_local.h"
-#include "mcu/crc.h"
+#include "sos/crc.h"
 #include "sos/debug.h"
 #include "mcu/pio.h"
 #include "mcu/spi.h"
@@ -22,6 +22,9 @@
 #define LONG_DELAY 500
 #define SHORT_DELAY 100
 
+// polls (CMD_FRAME_SIZE bytes each) to wait for the card to finish programming a block
+#define BUSY_TIMEOUT (250000 / CMD_FRAME_SIZE)
+
 #define FLAG_PROTECTED (1 << 0)
 #define FLAG_SDSC (1 << 1)
 
@@ -30,6 +33,14 @@ static int is_sdsc(const devfs_handle_t *handle);
 static int
 erase_blocks(const devfs_handle_t *handle, uint32_t block_num, uint32_t end_block);
 static int is_busy(const devfs_handle_t *handle);
+static int poll_ready(const devfs_handle_t *handle);
+static void stop_transmission(const devfs_handle_t *handle);
+static char *block_buffer(const drive_sdspi_state_t *state);
+static int start_transfer(
+  const devfs_handle_t *handle,
+  devfs_async_t *async,
+  u8 single_cmd,
+  u8 multiple_cmd);
 static int get_status(const devfs_handle_t *handle, uint8_t *buf);
 static int exec_csd(const devfs_handle_t *handle, uint8_t *buf);
 
@@ -61,8 +72,11 @@ static int spi_transfer(
   int nbyte);
 
 static int try_read(const devfs_handle_t *handle, int first);
+static int write_block(const devfs_handle_t *handle);
 static int continue_spi_read(void *handle, const mcu_event_t *ignore);
 static int continue_spi_write(void *handle, const mcu_event_t *ignore);
+static int continue_spi_ready(void *handle, const mcu_event_t *ignore);
+static int finish_write(const devfs_handle_t *handle, int err);
 
 static void deassert_chip_select(const devfs_handle_t *handle) {
   const drive_sdspi_config_t *config = handle->config;
@@ -104,13 +118,15 @@ int drive_sdspi_open(const devfs_handle_t *handle) {
 void state_callback(const devfs_handle_t *handle, int err, int nbyte) {
   drive_sdspi_state_t *state = handle->state;
   if (state->handler.callback) {
+    // the driver is idle before the callback so the callback can start another transfer
+    mcu_event_handler_t handler = state->handler;
+    state->handler.callback = 0;
     *(state->nbyte) = nbyte;
     if (nbyte < 0) {
       struct _reent *reent = sos_task_table[state->op.tid].reent;
       reent->_errno = err;
     }
-    state->handler.callback(state->handler.context, 0);
-    state->handler.callback = 0;
+    handler.callback(handler.context, 0);
   }
 }
 
@@ -125,6 +141,9 @@ int continue_spi_read(void *handle, const mcu_event_t *ignore) {
     state->timeout++;
     if (state->timeout > 5000) {
       // failed to read the data
+      if (state->block_count > 1) {
+        stop_transmission(handle);
+      }
       deassert_chip_select(handle);
       state_callback(handle, EIO, -2);
       return 0;
@@ -138,12 +157,22 @@ int continue_spi_read(void *handle, const mcu_event_t *ignore) {
     int err = 0;
     spi_transfer(handle, 0, state->cmd, CMD_FRAME_SIZE); // gobble up the CRC
     checksum = (state->cmd[0] << 8) + state->cmd[1];
-    checksum_calc = mcu_calc_crc16(
-      0x0000, 0x1021, (const uint8_t *)state->buf, (size_t) * (state->nbyte));
+    checksum_calc = sos_crc16_ccitt(0, block_buffer(state), BLOCK_SIZE);
     if (checksum != checksum_calc) {
       sos_debug_printf("Bad checksum 0x%04X != 0x%04X\n", checksum, checksum_calc);
       *(state->nbyte) = -1;
       err = EINVAL;
+    } else if (state->block + 1 < state->block_count) {
+      // the next block follows the CRC -- its token may already be in cmd
+      state->block++;
+      state->timeout = 0;
+      state->cmd[0] = 0xFF;
+      state->cmd[1] = 0xFF;
+      return try_read(handle, 0);
+    }
+
+    if (state->block_count > 1) {
+      stop_transmission(handle);
     }
 
     // execute the callback
@@ -157,11 +186,12 @@ int try_read(const devfs_handle_t *handle, int first) {
   int ret;
   const drive_sdspi_config_t *config = handle->config;
   drive_sdspi_state_t *state = handle->state;
-  state->count = parse_data(
-    (uint8_t *)state->buf, *(state->nbyte), -1, SDSPI_START_BLOCK_TOKEN, state->cmd);
+  char *buf = block_buffer(state);
+  state->count =
+    parse_data((uint8_t *)buf, BLOCK_SIZE, -1, SDSPI_START_BLOCK_TOKEN, state->cmd);
   if (state->count >= 0) {
-    state->op.nbyte = *(state->nbyte) - state->count;
-    state->op.buf = (void *)&(state->buf[state->count]);
+    state->op.nbyte = BLOCK_SIZE - state->count;
+    state->op.buf = buf + state->count;
   } else {
     state->op.nbyte = CMD_FRAME_SIZE;
     state->op.buf = state->cmd;
@@ -189,54 +219,10 @@ int try_read(const devfs_handle_t *handle, int first) {
 
 int drive_sdspi_read(const devfs_handle_t *handle, devfs_async_t *rop) {
   // first write the header command
-  drive_sdspi_state_t *state = handle->state;
-  drive_sdspi_r1_t r1;
-  u32 loc;
-
-  if (rop->nbyte != BLOCK_SIZE) {
-    return SYSFS_SET_RETURN(EINVAL);
-  }
-
-  if (is_busy(handle) != 0) {
-    return SYSFS_SET_RETURN(EBUSY);
-  }
-
-  state->handler.context = rop->handler.context;
-  state->handler.callback = rop->handler.callback;
-  state->nbyte = &(rop->nbyte);
-  state->buf = rop->buf;
-  state->timeout = 0;
-  state->op.tid = rop->tid;
-
-  if (is_sdsc(handle)) {
-    loc = rop->loc * BLOCK_SIZE;
-  } else {
-    loc = rop->loc;
-  }
-
-  r1 = exec_cmd_r1(handle, SDSPI_CMD17_READ_SINGLE_BLOCK, loc, state->cmd);
-  if (r1.u8 != 0x00) {
-    if ((r1.param_error)) {
-      return SYSFS_SET_RETURN(EINVAL);
-    }
-
-    if ((r1.addr_error)) {
-      return SYSFS_SET_RETURN(EINVAL);
-    }
-
-    if ((r1.erase_sequence_error)) {
-      return SYSFS_SET_RETURN(EINVAL);
-    }
-
-    if ((r1.crc_error)) {
-      return SYSFS_SET_RETURN(EINVAL);
-    }
-
-    if ((r1.illegal_command)) {
-      return SYSFS_SET_RETURN(EINVAL);
-    }
-
-    return SYSFS_SET_RETURN(EIO);
+  int result = start_transfer(
+    handle, rop, SDSPI_CMD17_READ_SINGLE_BLOCK, SDSPI_CMD18_READ_MULTIPLE_BLOCK);
+  if (result < 0) {
+    return result;
   }
 
   assert_chip_select(handle);
@@ -252,7 +238,7 @@ int continue_spi_write(void *handle, const mcu_event_t *ignore) {
   uint16_t checksum;
 
   // calculate and write the checksum
-  checksum = mcu_calc_crc16(0x0000, 0x1021, (const uint8_t *)state->buf, *(state->nbyte));
+  checksum = sos_crc16_ccitt(0, block_buffer(state), BLOCK_SIZE);
 
   // finish the write
   state->cmd[0] = checksum >> 8;
@@ -261,26 +247,110 @@ int continue_spi_write(void *handle, const mcu_event_t *ignore) {
   state->cmd[3] = 0xFF;
   state->cmd[4] = 0xFF;
   spi_transfer(handle, state->cmd, state->cmd, 5); // send dummy CRC
+
+  if ((state->cmd[2] & 0x1F) != 0x05) {
+    // data was not accepted
+    return finish_write(handle, EIO);
+  }
+
+  if (state->block_count > 1) {
+    // the card programs the block before it takes the next one (or the stop token)
+    state->timeout = 0;
+    if (poll_ready(handle) == 0) {
+      return 1;
+    }
+    return finish_write(handle, EIO);
+  }
+
+  // data was accepted -- the card is busy (I_DRIVE_ISBUSY) while it programs the block
+  return finish_write(handle, 0);
+}
+
+int continue_spi_ready(void *handle, const mcu_event_t *ignore) {
+  MCU_UNUSED_ARGUMENT(ignore);
+  drive_sdspi_state_t *state = ((const devfs_handle_t *)handle)->state;
+
+  // the card holds DO low while it is programming
+  if (state->cmd[CMD_FRAME_SIZE - 1] != 0xFF) {
+    state->timeout++;
+    if ((state->timeout < BUSY_TIMEOUT) && (poll_ready(handle) == 0)) {
+      return 1;
+    }
+    return finish_write(handle, EIO);
+  }
+
+  if (state->block + 1 < state->block_count) {
+    state->block++;
+    if (write_block(handle) == 0) {
+      return 1;
+    }
+    return finish_write(handle, EIO);
+  }
+
+  return finish_write(handle, 0);
+}
+
+int finish_write(const devfs_handle_t *handle, int err) {
+  drive_sdspi_state_t *state = handle->state;
+
+  if (state->block_count > 1) {
+    // end the multiple block write -- the card is busy (I_DRIVE_ISBUSY) until it
+    // finishes
+    state->cmd[0] = SDSPI_STOP_TRAN_TOKEN;
+    state->cmd[1] = 0xFF;
+    spi_transfer(handle, state->cmd, 0, 2);
+  }
   deassert_chip_select(handle);
 
-  if ((state->cmd[2] & 0x1F) == 0x05) {
-    // data was accepted
+  if (err == 0) {
     state_callback(handle, 0, *(state->nbyte));
   } else {
-    // data was not accepted
-    state_callback(handle, EIO, -1);
+    state_callback(handle, err, -1);
   }
-
   return 0;
 }
 
-int drive_sdspi_write(const devfs_handle_t *handle, devfs_async_t *wop) {
+int write_block(const devfs_handle_t *handle) {
   const drive_sdspi_config_t *config = handle->config;
   drive_sdspi_state_t *state = handle->state;
+
+  state->cmd[0] = 0xFF; // busy byte
+  state->cmd[1] = state->block_count > 1 ? SDSPI_START_BLOCK_WRITE_MULTIPLE_TOKEN
+                                         : SDSPI_START_BLOCK_TOKEN;
+  spi_transfer(handle, state->cmd, 0, 2);
+
+  state->op.nbyte = BLOCK_SIZE;
+  state->op.buf = block_buffer(state);
+  state->op.handler.context = (void *)handle;
+  state->op.handler.callback = continue_spi_write;
+
+  return config->device.driver.write(&config->device.handle, &(state->op));
+}
+
+int drive_sdspi_write(const devfs_handle_t *handle, devfs_async_t *wop) {
+  int result = start_transfer(
+    handle, wop, SDSPI_CMD24_WRITE_SINGLE_BLOCK, SDSPI_CMD25_WRITE_MULTIPLE_BLOCK);
+  if (result < 0) {
+    return result;
+  }
+
+  assert_chip_select(handle);
+  cortexm_delay_us(LONG_DELAY);
+
+  return write_block(handle);
+}
+
+int start_transfer(
+  const devfs_handle_t *handle,
+  devfs_async_t *async,
+  u8 single_cmd,
+  u8 multiple_cmd) {
+  drive_sdspi_state_t *state = handle->state;
   drive_sdspi_r1_t r1;
   u32 loc;
 
-  if (wop->nbyte != BLOCK_SIZE) {
+  // any number of whole blocks -- more than one uses a multiple block command
+  if ((async->nbyte < BLOCK_SIZE) || (async->nbyte % BLOCK_SIZE)) {
     return SYSFS_SET_RETURN(EINVAL);
   }
 
@@ -289,41 +359,43 @@ int drive_sdspi_write(const devfs_handle_t *handle, devfs_async_t *wop) {
     return SYSFS_SET_RETURN(EBUSY);
   }
 
-  state->handler.context = wop->handler.context;
-  state->handler.callback = wop->handler.callback;
-  state->nbyte = &(wop->nbyte);
-  state->buf = wop->buf;
+  state->handler.context = async->handler.context;
+  state->handler.callback = async->handler.callback;
+  state->nbyte = &(async->nbyte);
+  state->buf = async->buf;
   state->timeout = 0;
+  state->block = 0;
+  state->block_count = async->nbyte / BLOCK_SIZE;
+  state->op.tid = async->tid;
 
   if (is_sdsc(handle)) {
-    loc = wop->loc * BLOCK_SIZE;
+    loc = async->loc * BLOCK_SIZE;
   } else {
-    loc = wop->loc;
+    loc = async->loc;
+  }
+
+  if ((state->block_count > 1) && (multiple_cmd == SDSPI_CMD25_WRITE_MULTIPLE_BLOCK)) {
+    // let the card pre-erase the blocks (this is only a hint so errors are ignored)
+    r1 = exec_cmd_r1(handle, SDSPI_CMD55_APP_CMD, 0, state->cmd);
+    if (r1.u8 == 0x00) {
+      exec_cmd_r1(
+        handle, SDSPI_ACMD23_SET_WR_BLK_ERASE_COUNT, state->block_count, state->cmd);
+    }
   }
 
-  r1 = exec_cmd_r1(handle, SDSPI_CMD24_WRITE_SINGLE_BLOCK, loc, state->cmd);
+  r1 = exec_cmd_r1(
+    handle, state->block_count > 1 ? multiple_cmd : single_cmd, loc, state->cmd);
   if (r1.u8 != 0x00) {
-    if ((r1.addr_error) || (r1.param_error)) {
+    if (
+      (r1.param_error) || (r1.addr_error) || (r1.erase_sequence_error)
+      || (r1.crc_error) || (r1.illegal_command)) {
       return SYSFS_SET_RETURN(EINVAL);
     }
 
     return SYSFS_SET_RETURN(EIO);
   }
 
-  state->cmd[0] = 0xFF; // busy byte
-  state->cmd[1] = SDSPI_START_BLOCK_TOKEN;
-
-  assert_chip_select(handle);
-  cortexm_delay_us(LONG_DELAY);
-  spi_transfer(handle, state->cmd, 0, 2);
-
-  state->op.nbyte = wop->nbyte;
-  state->op.buf = wop->buf;
-  state->op.handler.context = (void *)handle;
-  state->op.handler.callback = continue_spi_write;
-  state->op.tid = wop->tid;
-
-  return config->device.driver.write(&config->device.handle, &(state->op));
+  return 0;
 }
 
 int drive_sdspi_ioctl(const devfs_handle_t *handle, int request, void *ctl) {
@@ -588,6 +660,39 @@ int is_busy(const devfs_handle_t *handle) {
   return (c == 0x00);
 }
 
+int poll_ready(const devfs_handle_t *handle) {
+  // clock out one frame from the SPI interrupt rather than spinning on I_SPI_SWAP
+  const drive_sdspi_config_t *config = handle->config;
+  drive_sdspi_state_t *state = handle->state;
+  state->op.nbyte = CMD_FRAME_SIZE;
+  state->op.buf = state->cmd;
+  state->op.handler.context = (void *)handle;
+  state->op.handler.callback = continue_spi_ready;
+  return config->device.driver.read(&config->device.handle, &(state->op));
+}
+
+void stop_transmission(const devfs_handle_t *handle) {
+  uint8_t buffer[CMD_FRAME_SIZE];
+  memset(buffer, 0xFF, CMD_FRAME_SIZE);
+  buffer[0] = 0x40 | SDSPI_CMD12_STOP_TRANSMISSION;
+  buffer[1] = 0;
+  buffer[2] = 0;
+  buffer[3] = 0;
+  buffer[4] = 0;
+  buffer[5] = (sos_crc7(0, buffer, 5) << 1) | 1;
+
+  // the card is still sending data so the R1 can't be picked out of the
+  // response the way send_cmd() does -- the R1b busy that follows is reported by
+  // I_DRIVE_ISBUSY (and the next read or write fails with EBUSY until it ends)
+  assert_chip_select(handle);
+  spi_transfer(handle, buffer, 0, CMD_FRAME_SIZE);
+  deassert_chip_select(handle);
+}
+
+char *block_buffer(const drive_sdspi_state_t *state) {
+  return (char *)state->buf + state->block * BLOCK_SIZE;
+}
+
 int get_status(const devfs_handle_t *handle, uint8_t *buf) {
   drive_sdspi_r_t resp;
   int ret;
@@ -645,7 +750,7 @@ int send_cmd(const devfs_handle_t *handle, uint8_t cmd, uint32_t arg, uint8_t *r
   buffer[2] = arg >> 16;
   buffer[3] = arg >> 8;
   buffer[4] = arg;
-  buffer[5] = mcu_calc_crc7(0, 0x09, buffer, 5);
+  buffer[5] = (sos_crc7(0, buffer, 5) << 1) | 1;
 
   resp.r1.crc_error = 1;
 
@@ -804,7 +909,6 @@ exec_cmd_r1(const devfs_handle_t *handle, uint8_t cmd, uint32_t arg, uint8_t *r)
   }
   drive_sdspi_r_t ret;
   send_cmd(handle, cmd, arg, response);
-  memset(r, 0xFF, sizeof(drive_sdspi_r_t));
   if (parse_response(response, 1, &ret, 0) == false) {
     memset(&ret, 0xFF, sizeof(drive_sdspi_r_t));
   }
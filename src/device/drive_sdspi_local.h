@@ -11,7 +11,7 @@
 
 #define SDSPI_START_BLOCK_TOKEN 0xFE
 #define SDSPI_START_BLOCK_WRITE_MULTIPLE_TOKEN 0xFC
-#define SDSPI_STOP_TRAN_TOKEN 0xFB
+#define SDSPI_STOP_TRAN_TOKEN 0xFD
 
 #define SDSPI_CMD0_GO_IDLE_STATE 0
 #define SDSPI_CMD1_SEND_OP_COND 1
@@ -31,6 +31,7 @@
 #define SDSPI_CMD38_ERASE 38
 
 
+#define SDSPI_ACMD23_SET_WR_BLK_ERASE_COUNT 23
 #define SDSPI_ACMD41_SD_SEND_OP_COND 41
 
 #define SDSPI_CMD55_APP_CMD 55
@@ -14,44 +14,29 @@ char *ffifo_get_frame(const ffifo_config_t *cfgp, u16 frame) {
 }
 
 void ffifo_inc_tail(ffifo_state_t *state, u16 count) {
-  state->atomic_position.access.tail++;
-  if (state->atomic_position.access.tail == count) {
-    state->atomic_position.access.tail = 0;
+  if (!ring_is_empty(&state->ring)) {
+    ring_consume(&state->ring, count, 1);
   }
 }
 
 void ffifo_inc_head(ffifo_state_t *state, u16 count) {
-  state->atomic_position.access.head++;
-  if (state->atomic_position.access.head == count) {
-    state->atomic_position.access.head = 0;
-  }
-
-  // this marks the ffifo as full by setting tail to count
-  if (state->atomic_position.access.head == state->atomic_position.access.tail) {
-    state->atomic_position.access.tail = count;
+  // the frame at the head has been written -- it replaces the oldest frame when full
+  if (ring_is_full(&state->ring, count)) {
+    ring_drop(&state->ring, count, 1);
   }
+  ring_produce(&state->ring, count, 1);
 }
 
 int ffifo_is_write_ok(ffifo_state_t *state, u16 count, int writeblock) {
-  int ret = 1;
-  fifo_atomic_position_t atomic_postion;
-  atomic_postion.atomic_access =
-    state->atomic_position.atomic_access; // cppcheck-suppress[unreadVariable]
-  if (atomic_postion.access.tail == count) {
+  if (ring_is_full(&state->ring, count)) {
     if (writeblock) {
       // cannot write anymore data at this time
-      ret = 0;
-    } else {
-      // OK to write but it will cause an overflow
-      if (state->o_flags & FIFO_FLAG_IS_READ_BUSY) {
-        state->o_flags |= FIFO_FLAG_IS_WRITE_WHILE_READ_BUSY;
-      }
-      ffifo_set_overflow(state, 1);
+      return 0;
     }
+    // OK to write but it will cause an overflow
+    ffifo_set_overflow(state, 1);
   }
-
-  // return OK or not to write: 1 = OK, 0 = write is blocked
-  return ret;
+  return 1;
 }
 
 int ffifo_is_writeblock(ffifo_state_t *state) {
@@ -59,10 +44,11 @@ int ffifo_is_writeblock(ffifo_state_t *state) {
 }
 
 void ffifo_set_writeblock(ffifo_state_t *state, int value) {
+  // o_flags is shared with the interrupt that sets the overflow flag
   if (value) {
-    state->o_flags |= FIFO_FLAG_SET_WRITEBLOCK;
+    __atomic_fetch_or(&state->o_flags, FIFO_FLAG_SET_WRITEBLOCK, __ATOMIC_RELAXED);
   } else {
-    state->o_flags &= ~FIFO_FLAG_SET_WRITEBLOCK;
+    __atomic_fetch_and(&state->o_flags, ~FIFO_FLAG_SET_WRITEBLOCK, __ATOMIC_RELAXED);
   }
 }
 
@@ -72,18 +58,18 @@ int ffifo_is_overflow(ffifo_state_t *state) {
 
 void ffifo_set_overflow(ffifo_state_t *state, int value) {
   if (value) {
-    state->o_flags |= FIFO_FLAG_IS_OVERFLOW;
+    __atomic_fetch_or(&state->o_flags, FIFO_FLAG_IS_OVERFLOW, __ATOMIC_RELAXED);
   } else {
-    state->o_flags &= ~FIFO_FLAG_IS_OVERFLOW;
+    __atomic_fetch_and(&state->o_flags, ~FIFO_FLAG_IS_OVERFLOW, __ATOMIC_RELAXED);
   }
 }
 
 void *ffifo_get_head(const ffifo_config_t *config, ffifo_state_t *state) {
-  return config->buffer + (state->atomic_position.access.head * config->frame_size);
+  return ffifo_get_frame(config, ring_head_offset(&state->ring, config->frame_count));
 }
 
 void *ffifo_get_tail(const ffifo_config_t *config, ffifo_state_t *state) {
-  return config->buffer + (state->atomic_position.access.tail * config->frame_size);
+  return ffifo_get_frame(config, ring_tail_offset(&state->ring, config->frame_count));
 }
 
 int ffifo_read_buffer(
@@ -91,52 +77,15 @@ int ffifo_read_buffer(
   ffifo_state_t *state,
   char *buf,
   int len) {
-  int i;
-  u16 count = config->frame_count;
-  u16 frame_size = config->frame_size;
-  char *frame;
-  fifo_atomic_position_t atomic_position;
-  int read_was_clobbered = 0;
-  for (i = 0; i < len; i += frame_size) {
-
-    state->o_flags |= FIFO_FLAG_IS_READ_BUSY;
-    atomic_position.atomic_access =
-      state->atomic_position.atomic_access; // cppcheck-suppress[unreadVariable]
-
-    if (atomic_position.access.head != atomic_position.access.tail) {
-
-      if (atomic_position.access.tail == count) {
-        atomic_position.access.tail = atomic_position.access.head;
-      }
-
-      frame = ffifo_get_frame(config, atomic_position.access.tail);
-      memcpy(buf, frame, frame_size);
-      atomic_position.access.tail++;
-      if (atomic_position.access.tail == count) {
-        atomic_position.access.tail = 0;
-      }
-
-      // an interrupt here before the tail is assigned will cause a problem
-      state->atomic_position.access.tail = atomic_position.access.tail;
-      // an interrupt here is OK because the write can write to the open spot
-      if (state->o_flags & FIFO_FLAG_IS_WRITE_WHILE_READ_BUSY) {
-        read_was_clobbered = 1;
-        // if the read was clobbered the buffer is full
-        state->atomic_position.access.tail = frame_size;
-      }
-      state->o_flags &= ~(FIFO_FLAG_IS_WRITE_WHILE_READ_BUSY | FIFO_FLAG_IS_READ_BUSY);
-
-      if (read_was_clobbered) {
-        return i;
-      }
-
-      buf += frame_size;
-    } else {
-      state->o_flags &= ~(FIFO_FLAG_IS_WRITE_WHILE_READ_BUSY | FIFO_FLAG_IS_READ_BUSY);
-      break;
-    }
+  const u16 frame_size = config->frame_size;
+  if (len < frame_size) {
+    return 0;
   }
-  return i; // number of bytes read
+
+  const u32 frames = ring_read(
+    &state->ring, config->frame_count, frame_size, config->buffer, buf,
+    len / frame_size);
+  return frames * frame_size; // number of bytes read
 }
 
 int ffifo_write_buffer(
@@ -144,31 +93,29 @@ int ffifo_write_buffer(
   ffifo_state_t *state,
   const char *buf,
   int len) {
-  int i;
-  u16 frame_count = config->frame_count;
-  u16 frame_size = config->frame_size;
-  void *frame;
-  int writeblock = ffifo_is_writeblock(state);
-  for (i = 0; i < len; i += frame_size) {
-    if (ffifo_is_write_ok(state, frame_count, writeblock)) {
-      state->o_flags |= FIFO_FLAG_IS_WRITE_BUSY;
-      frame = ffifo_get_frame(config, state->atomic_position.access.head);
-      memcpy(frame, buf, frame_size);
-
-      // don't inc head until the data is copied
-      ffifo_inc_head(state, frame_count);
-      buf += frame_size;
-      state->o_flags &= ~FIFO_FLAG_IS_WRITE_BUSY;
-
-    } else {
-      break;
-    }
+  const u16 frame_size = config->frame_size;
+  if (len < frame_size) {
+    return 0;
+  }
+
+  const u32 frame_count = len / frame_size;
+  if (ffifo_is_writeblock(state)) {
+    const u32 frames = ring_write(
+      &state->ring, config->frame_count, frame_size, config->buffer, buf, frame_count);
+    return frames * frame_size; // number of bytes written
+  }
+
+  // OK to write but the oldest frames are overwritten if they don't fit
+  if (ring_write_overwrite(
+        &state->ring, config->frame_count, frame_size, config->buffer, buf,
+        frame_count)) {
+    ffifo_set_overflow(state, 1);
   }
-  return i; // number of frames written
+  return frame_count * frame_size;
 }
 
 void ffifo_flush(ffifo_state_t *state) {
-  state->atomic_position.atomic_access = 0;
+  ring_flush(&state->ring);
   ffifo_set_overflow(state, 0);
 }
 
@@ -178,25 +125,26 @@ int ffifo_getinfo(
   ffifo_state_t *state) {
   info->frame_count = config->frame_count;
   info->frame_size = config->frame_size;
-  fifo_atomic_position_t atomic_position;
-  atomic_position.atomic_access =
-    state->atomic_position.atomic_access; // cppcheck-suppress[unreadVariable]
-
-  if (atomic_position.access.tail == config->frame_count) {
-    info->frame_count_ready = info->frame_count;
-  } else if (atomic_position.access.head >= atomic_position.access.tail) {
-    info->frame_count_ready = atomic_position.access.head - atomic_position.access.tail;
-  } else {
-    info->frame_count_ready =
-      info->frame_count - atomic_position.access.tail + atomic_position.access.head;
-  }
-
-  info->o_flags = state->o_flags;
-  state->o_flags &= ~FIFO_FLAG_IS_OVERFLOW; // clear the overflow since it has been read
+  info->frame_count_ready = ring_count(&state->ring, config->frame_count);
+  // clear the overflow since it has been read
+  info->o_flags =
+    __atomic_fetch_and(&state->o_flags, ~FIFO_FLAG_IS_OVERFLOW, __ATOMIC_RELAXED);
   return 0;
 }
 
+int ffifo_poll(const ffifo_config_t *config, ffifo_state_t *state) {
+  int o_flags = DEVFS_POLL_FLAG_IS_SUPPORTED;
+  if (ring_count(&state->ring, config->frame_count)) {
+    o_flags |= DEVFS_POLL_FLAG_IS_READ_READY;
+  }
+  if (ring_free(&state->ring, config->frame_count) || !ffifo_is_writeblock(state)) {
+    o_flags |= DEVFS_POLL_FLAG_IS_WRITE_READY;
+  }
+  return o_flags;
+}
+
 void ffifo_data_received(const ffifo_config_t *handle, ffifo_state_t *state) {
+  devfs_poll_notify();
   if (state->transfer_handler.read != NULL) {
     int bytes_read;
     if (
@@ -221,6 +169,7 @@ void ffifo_cancel_async_write(ffifo_state_t *state) {
 }
 
 void ffifo_data_transmitted(const ffifo_config_t *config, ffifo_state_t *state) {
+  devfs_poll_notify();
   if (state->transfer_handler.write != NULL) {
     int bytes_written;
     if (
@@ -305,6 +254,13 @@ int ffifo_ioctl_local(
   case I_FFIFO_GETINFO:
     ffifo_getinfo(info, config, state);
     return 0;
+  case I_DEVFS_POLL:
+    return ffifo_poll(config, state);
+  case I_FFIFO_ACQUIREREAD:
+  case I_FFIFO_RELEASEREAD:
+  case I_FFIFO_ACQUIREWRITE:
+  case I_FFIFO_RELEASEWRITE:
+    return ffifo_access_frames_local(config, state, request, ctl, 1);
   case I_FFIFO_INIT:
     state->transfer_handler.read = NULL;
     state->transfer_handler.write = NULL;
@@ -328,6 +284,56 @@ int ffifo_ioctl_local(
   return SYSFS_SET_RETURN(EINVAL);
 }
 
+int ffifo_access_frames_local(
+  const ffifo_config_t *config,
+  ffifo_state_t *state,
+  int request,
+  ffifo_frames_t *frames,
+  int allow_callback) {
+  u32 position;
+  u32 frame_count;
+  int result;
+
+  switch (request) {
+  case I_FFIFO_ACQUIREREAD:
+    frame_count =
+      ring_acquire_read(&state->ring, config->frame_count, frames->frame_count, &position);
+    break;
+  case I_FFIFO_ACQUIREWRITE:
+    frame_count = ring_acquire_write(
+      &state->ring, config->frame_count, frames->frame_count, &position);
+    break;
+  case I_FFIFO_RELEASEREAD:
+    result = ring_release_read(
+      &state->ring, config->frame_count, frames->position, frames->frame_count);
+    if (result <= 0) {
+      return SYSFS_SET_RETURN(result < 0 ? EINVAL : ECANCELED);
+    }
+    if (allow_callback) {
+      // see if anything needs to write the FIFO
+      ffifo_data_transmitted(config, state);
+    }
+    return 0;
+  case I_FFIFO_RELEASEWRITE:
+    result = ring_release_write(
+      &state->ring, config->frame_count, frames->position, frames->frame_count);
+    if (result <= 0) {
+      return SYSFS_SET_RETURN(result < 0 ? EINVAL : ECANCELED);
+    }
+    if (allow_callback) {
+      ffifo_data_received(config, state);
+    }
+    return 0;
+  default:
+    return SYSFS_SET_RETURN(EINVAL);
+  }
+
+  frames->position = position;
+  frames->frame_count = frame_count;
+  frames->buffer = ffifo_get_frame(config, ring_offset(position, config->frame_count));
+  return frame_count;
+}
+
 int ffifo_read_local(
   const ffifo_config_t *config,
   ffifo_state_t *state,
@@ -346,9 +352,7 @@ int ffifo_read_local(
       config, state, async->buf,
       async->nbyte); // see if there are bytes in the buffer
     if (bytes_read == 0) {
-      if (
-        (async->flags & O_NONBLOCK)
-        || (state->atomic_position.access.tail == config->frame_count)) {
+      if (async->flags & O_NONBLOCK) {
         bytes_read = SYSFS_SET_RETURN(EAGAIN);
       }
     } else if ((bytes_read > 0) && allow_callback) {
@@ -9,43 +9,29 @@
 #include "sos/events.h"
 
 void fifo_inc_tail(fifo_state_t *state, int size) {
-  state->atomic_position.access.tail++;
-  if (state->atomic_position.access.tail == size) {
-    state->atomic_position.access.tail = 0;
+  if (!ring_is_empty(&state->ring)) {
+    ring_consume(&state->ring, size, 1);
   }
 }
 
 void fifo_inc_head(fifo_state_t *state, int size) {
-  state->atomic_position.access.head++;
-  if (state->atomic_position.access.head == size) {
-    state->atomic_position.access.head = 0;
-  }
-
-  if (state->atomic_position.access.head == state->atomic_position.access.tail) {
-    // set tail to size when full
-    state->atomic_position.access.tail = size;
+  // the byte at the head has been written -- it replaces the oldest byte when full
+  if (ring_is_full(&state->ring, size)) {
+    ring_drop(&state->ring, size, 1);
   }
+  ring_produce(&state->ring, size, 1);
 }
 
 int fifo_is_write_ok(fifo_state_t *state, u16 size, int writeblock) {
-  int ret = 1;
-
-  if (state->atomic_position.access.tail == size) { // the tail is set to size when the
-                                                    // buffer is full
-    if (writeblock || (state->o_flags & FIFO_FLAG_IS_READ_BUSY)) {
+  if (ring_is_full(&state->ring, size)) {
+    if (writeblock) {
       // cannot write anymore data at this time
-      ret = 0;
-    } else {
-      // OK to write but it will cause an overflow
-      if (state->o_flags & FIFO_FLAG_IS_READ_BUSY) {
-        state->o_flags |= FIFO_FLAG_IS_WRITE_WHILE_READ_BUSY;
-      }
-      fifo_set_overflow(state, 1);
+      return 0;
     }
+    // OK to write but it will cause an overflow
+    fifo_set_overflow(state, 1);
   }
-
-  // return OK or not to write: 1 = OK, 0 = write is blocked
-  return ret;
+  return 1;
 }
 
 int fifo_is_writeblock(fifo_state_t *state) {
@@ -53,10 +39,11 @@ int fifo_is_writeblock(fifo_state_t *state) {
 }
 
 void fifo_set_writeblock(fifo_state_t *state, int value) {
+  // o_flags is shared with the interrupt that sets the overflow flag
   if (value) {
-    state->o_flags |= FIFO_FLAG_SET_WRITEBLOCK;
+    __atomic_fetch_or(&state->o_flags, FIFO_FLAG_SET_WRITEBLOCK, __ATOMIC_RELAXED);
   } else {
-    state->o_flags &= ~FIFO_FLAG_SET_WRITEBLOCK;
+    __atomic_fetch_and(&state->o_flags, ~FIFO_FLAG_SET_WRITEBLOCK, __ATOMIC_RELAXED);
   }
 }
 
@@ -66,9 +53,9 @@ int fifo_is_overflow(fifo_state_t *state) {
 
 void fifo_set_overflow(fifo_state_t *state, int value) {
   if (value) {
-    state->o_flags |= FIFO_FLAG_IS_OVERFLOW;
+    __atomic_fetch_or(&state->o_flags, FIFO_FLAG_IS_OVERFLOW, __ATOMIC_RELAXED);
   } else {
-    state->o_flags &= ~FIFO_FLAG_IS_OVERFLOW;
+    __atomic_fetch_and(&state->o_flags, ~FIFO_FLAG_IS_OVERFLOW, __ATOMIC_RELAXED);
   }
 }
 
@@ -77,49 +64,11 @@ int fifo_read_buffer(
   fifo_state_t *state,
   char *buf,
   int nbyte) {
-  int i;
-  u16 size = config->size;
-  int read_was_clobbered = 0;
-  char *dest_buffer = config->buffer;
-  fifo_atomic_position_t atomic_position;
-  for (i = 0; i < nbyte; i++) {
-
-    state->o_flags |= FIFO_FLAG_IS_READ_BUSY;
-    atomic_position.atomic_access =
-      state->atomic_position
-        .atomic_access; // cppcheck-suppress[unreadVariable] read as union
-
-    if (atomic_position.access.head != atomic_position.access.tail) {
-      if (atomic_position.access.tail == size) {
-        // buffer is full -- restore tail position
-        atomic_position.access.tail = atomic_position.access.head;
-      }
-      buf[i] = dest_buffer[atomic_position.access.tail];
-      atomic_position.access.tail++;
-      if (atomic_position.access.tail == size) {
-        atomic_position.access.tail = 0;
-      }
-      // an interrupt here before the tail is assigned will cause a problem
-      state->atomic_position.access.tail = atomic_position.access.tail;
-      // an interrupt here is OK because the write can write to the open spot
-      if (state->o_flags & FIFO_FLAG_IS_WRITE_WHILE_READ_BUSY) {
-        read_was_clobbered = 1;
-        // if the read was clobbered the buffer is full
-        state->atomic_position.access.tail = size;
-      }
-
-      state->o_flags &= ~(FIFO_FLAG_IS_WRITE_WHILE_READ_BUSY | FIFO_FLAG_IS_READ_BUSY);
-
-      if (read_was_clobbered) {
-        return i;
-      }
-
-    } else {
-      state->o_flags &= ~(FIFO_FLAG_IS_WRITE_WHILE_READ_BUSY | FIFO_FLAG_IS_READ_BUSY);
-      break;
-    }
+  if (nbyte <= 0) {
+    return 0;
   }
-  return i; // number of bytes read
+  // number of bytes read
+  return ring_read(&state->ring, config->size, 1, config->buffer, buf, nbyte);
 }
 
 int fifo_write_buffer(
@@ -128,26 +77,43 @@ int fifo_write_buffer(
   const char *buf,
   int nbyte,
   int non_blocking) {
-  int i;
-  int size = cfgp->size;
   int writeblock = 1;
   if (non_blocking == 0) {
     writeblock = fifo_is_writeblock(state);
   }
-  for (i = 0; i < nbyte; i++) {
-    if (fifo_is_write_ok(state, size, writeblock)) {
-      cfgp->buffer[state->atomic_position.access.head] = buf[i];
-      fifo_inc_head(state, size);
-    } else {
-      break;
-    }
+
+  if (nbyte <= 0) {
+    return 0;
   }
-  return i; // number of bytes written
+
+  if (writeblock) {
+    // number of bytes written
+    return ring_write(&state->ring, cfgp->size, 1, cfgp->buffer, buf, nbyte);
+  }
+
+  // OK to write but the oldest data is overwritten if it doesn't fit
+  if (ring_write_overwrite(&state->ring, cfgp->size, 1, cfgp->buffer, buf, nbyte)) {
+    fifo_set_overflow(state, 1);
+  }
+  return nbyte;
+}
+
+int fifo_push_buffer(
+  const fifo_config_t *config,
+  fifo_state_t *state,
+  const char *buf,
+  int nbyte) {
+  if (nbyte <= 0) {
+    return 0;
+  }
+  if (ring_write_overwrite(&state->ring, config->size, 1, config->buffer, buf, nbyte)) {
+    fifo_set_overflow(state, 1);
+  }
+  return nbyte;
 }
 
 void fifo_flush(fifo_state_t *state) {
-  state->atomic_position.access.head = 0;
-  state->atomic_position.access.tail = 0;
+  ring_flush(&state->ring);
   fifo_set_overflow(state, 0);
 }
 
@@ -156,25 +122,28 @@ void fifo_getinfo(fifo_info_t *info, const fifo_config_t *config, fifo_state_t *
   info->o_flags =
     FIFO_FLAG_SET_WRITEBLOCK | FIFO_FLAG_IS_OVERFLOW | FIFO_FLAG_INIT | FIFO_FLAG_EXIT;
   info->size = config->size;
+  info->size_ready = ring_count(&state->ring, config->size);
+  // read and clear the overflow flag in one operation
+  info->overflow =
+    (__atomic_fetch_and(&state->o_flags, ~FIFO_FLAG_IS_OVERFLOW, __ATOMIC_RELAXED)
+     & FIFO_FLAG_IS_OVERFLOW)
+    != 0;
+}
 
-  fifo_atomic_position_t atomic_position;
-  // grab head and tail atomically in case the operation is interrupted
-  atomic_position.atomic_access =
-    state->atomic_position.atomic_access; // cppcheck-suppress[unreadVariable]
-
-  if (atomic_position.access.tail == config->size) { // check to see if buffer is full
-    info->size_ready = config->size;
-  } else if (atomic_position.access.head >= atomic_position.access.tail) {
-    info->size_ready = atomic_position.access.head - atomic_position.access.tail;
-  } else {
-    info->size_ready =
-      config->size - atomic_position.access.tail + atomic_position.access.head;
+int fifo_poll(const fifo_config_t *config, fifo_state_t *state) {
+  int o_flags = DEVFS_POLL_FLAG_IS_SUPPORTED;
+  if (ring_count(&state->ring, config->size)) {
+    o_flags |= DEVFS_POLL_FLAG_IS_READ_READY;
   }
-  info->overflow = fifo_is_overflow(state);
-  fifo_set_overflow(state, 0);
+  // without writeblock, writes never block (the oldest data is overwritten)
+  if (ring_free(&state->ring, config->size) || !fifo_is_writeblock(state)) {
+    o_flags |= DEVFS_POLL_FLAG_IS_WRITE_READY;
+  }
+  return o_flags;
 }
 
 void fifo_data_received(const fifo_config_t *config, fifo_state_t *state) {
+  devfs_poll_notify();
   if (state->transfer_handler.read != 0) {
     int bytes_read;
     if (
@@ -199,6 +168,7 @@ void fifo_cancel_async_write(fifo_state_t *state) {
 }
 
 int fifo_data_transmitted(const fifo_config_t *cfgp, fifo_state_t *state) {
+  devfs_poll_notify();
   if (state->transfer_handler.write != NULL) {
     int bytes_written;
     if (
@@ -269,6 +239,8 @@ int fifo_ioctl_local(
   case I_FIFO_GETINFO:
     fifo_getinfo(ctl, config, state);
     return 0;
+  case I_DEVFS_POLL:
+    return fifo_poll(config, state);
   case I_MCU_SETACTION:
 
     if (action->handler.callback == 0) {
@@ -335,9 +307,7 @@ int fifo_read_local(
     config, state, async->buf,
     async->nbyte); // see if there are bytes in the buffer
   if (bytes_read == 0) {
-    if (
-      (async->flags & O_NONBLOCK)
-      || (state->atomic_position.access.tail == config->size)) {
+    if (async->flags & O_NONBLOCK) {
       bytes_read = SYSFS_SET_RETURN(EAGAIN);
     }
   } else if ((bytes_read > 0) && allow_callback) {
@@ -27,20 +27,17 @@ int i2s_event_write_complete(void * context, const mcu_event_t * event){
 
     nbyte = state->tx.i2s_async.result;
 
-    if( ffifo_state->atomic_position.access.head == ffifo_state->atomic_position.access.tail ){
+    if( ring_is_empty(&ffifo_state->ring) ){
         //no data to read -- send a zero frame
         memset(state->tx.i2s_async.buf, 0, nbyte);
     } else {
         state->tx.access_count++;
 
         //increment the tail for the frame that was written
-        if( ffifo_state->atomic_position.access.tail == config->tx.frame_count ){
-            ffifo_state->atomic_position.access.tail = ffifo_state->atomic_position.access.head;
-        }
-        ffifo_inc_tail(ffifo_state, config->tx.frame_count);
+        ring_consume(&ffifo_state->ring, config->tx.frame_count, 1);
 
-        if( ffifo_state->atomic_position.access.tail == 0 ){
-            state->tx.i2s_async.buf = config->rx.buffer;
+        if( ring_tail_offset(&ffifo_state->ring, config->tx.frame_count) == 0 ){
+            state->tx.i2s_async.buf = config->tx.buffer;
         } else {
             state->tx.i2s_async.buf += nbyte;
         }
@@ -69,17 +66,16 @@ int i2s_event_data_ready(void * context, const mcu_event_t * event){
     }
 
     //increment the head for the frame received
-    if( ffifo_state->atomic_position.access.tail == config->rx.frame_count ){
-        if( ffifo_state->o_flags & FIFO_FLAG_IS_READ_BUSY ){
-            ffifo_state->o_flags |= FIFO_FLAG_IS_WRITE_WHILE_READ_BUSY;
-        }
-        ffifo_state->o_flags |= FIFO_FLAG_IS_OVERFLOW;
+    if( ring_is_full(&ffifo_state->ring, config->rx.frame_count) ){
+        //the hardware has overwritten the oldest frame
+        ffifo_set_overflow(ffifo_state, 1);
+        ring_drop(&ffifo_state->ring, config->rx.frame_count, 1);
     }
-    ffifo_inc_head(&state->rx.ffifo, config->rx.frame_count);
+    ring_produce(&ffifo_state->ring, config->rx.frame_count, 1);
 
     state->rx.access_count++;
 
-    if( ffifo_state->atomic_position.access.head == 0 ){
+    if( ring_head_offset(&ffifo_state->ring, config->rx.frame_count) == 0 ){
         state->rx.i2s_async.buf = config->rx.buffer;
     } else {
         state->rx.i2s_async.buf += config->rx.frame_size;
@@ -153,7 +149,7 @@ int i2s_ffifo_ioctl(const devfs_handle_t * handle, int request, void * ctl){
             ffifo_flush(&(state->tx.ffifo));
 
             //ffifo is empty so the head must be incremented on start
-            ffifo_inc_head(&state->tx.ffifo, config->tx.frame_count);
+            ring_produce(&state->tx.ffifo.ring, config->tx.frame_count, 1);
             memset(state->tx.i2s_async.buf, 0, state->tx.i2s_async.nbyte);
 
             //start writing data to the I2S -- zeros are written if there is no data in the fifo
@@ -215,6 +211,16 @@ int i2s_ffifo_ioctl(const devfs_handle_t * handle, int request, void * ctl){
         info->rx.error = state->rx.error;
         return 0;
 
+    case I_FFIFO_ACQUIREREAD:
+    case I_FFIFO_RELEASEREAD:
+        //no callback -- the FIFO is written by the I2S
+        return ffifo_access_frames_local(&(config->rx), &(state->rx.ffifo), request, ctl, 0);
+
+    case I_FFIFO_ACQUIREWRITE:
+    case I_FFIFO_RELEASEWRITE:
+        //no callback -- the FIFO is read by the I2S
+        return ffifo_access_frames_local(&(config->tx), &(state->tx.ffifo), request, ctl, 0);
+
     case I_I2S_FFIFO_SETACTION:
     case I_I2S_SETACTION:
     case I_MCU_SETACTION:
@@ -5,12 +5,70 @@
 #include "cortexm/cortexm.h"
 #include "cortexm/task.h"
 #include "sos/debug.h"
+#include "sos/sos.h"
 #include <errno.h>
 #include <fcntl.h>
 #include <string.h>
 
 static int event_write_complete(void *context, const mcu_event_t *event);
 static int event_data_ready(void *context, const mcu_event_t *event);
+static int is_cache_aligned(const ffifo_config_t *config);
+static void invalidate_received_frames(const ffifo_config_t *config, u32 o_events);
+static void clean_written_frames(const ffifo_config_t *config, u32 frame, u32 count);
+
+int is_cache_aligned(const ffifo_config_t *config) {
+#if defined SCB_CCR_DC_Msk
+  if ((SCB->CCR & SCB_CCR_DC_Msk) == 0) {
+    // no data cache -- no alignment needed
+    return 1;
+  }
+#endif
+  // each half must start and end on a cache line so that invalidating the half
+  // the DMA just wrote can't discard data in the other half (or outside the buffer)
+  const u32 mask = STREAM_FFIFO_CACHE_LINE_SIZE - 1;
+  const u32 half_size = (config->frame_count / 2) * config->frame_size;
+  const u32 size = config->frame_count * config->frame_size;
+  return (((u32)config->buffer & mask) == 0) && ((half_size & mask) == 0)
+         && ((size & mask) == 0);
+}
+
+void invalidate_received_frames(const ffifo_config_t *config, u32 o_events) {
+  if (!is_cache_aligned(config)) {
+    // a line shared with other data can't be invalidated -- see START
+    return;
+  }
+
+  // only the half that the DMA just finished is invalidated
+  const u32 half_size = (config->frame_count / 2) * config->frame_size;
+  if (o_events & MCU_EVENT_FLAG_LOW) {
+    sos_config.cache.invalidate_data_block(config->buffer, half_size);
+  } else if (o_events & MCU_EVENT_FLAG_HIGH) {
+    sos_config.cache.invalidate_data_block(config->buffer + half_size, half_size);
+  } else {
+    sos_config.cache.invalidate_data_block(
+      config->buffer, config->frame_count * config->frame_size);
+  }
+}
+
+void clean_written_frames(const ffifo_config_t *config, u32 frame, u32 count) {
+  if (!is_cache_aligned(config)) {
+    return;
+  }
+
+  // writes the frames to memory before the DMA reads them (may wrap once)
+  u32 contiguous = config->frame_count - frame;
+  if (contiguous > count) {
+    contiguous = count;
+  }
+  if (contiguous) {
+    sos_config.cache.clean_data_block(
+      ffifo_get_frame(config, frame), contiguous * config->frame_size);
+  }
+  if (count > contiguous) {
+    sos_config.cache.clean_data_block(
+      config->buffer, (count - contiguous) * config->frame_size);
+  }
+}
 
 int event_write_complete(void *context, const mcu_event_t *event) {
   const devfs_handle_t *handle = context;
@@ -33,36 +91,37 @@ int event_write_complete(void *context, const mcu_event_t *event) {
   }
 
   // check for underflow
-  if (
-    ffifo_state->atomic_position.access.tail
-    != config->tx.frame_count) { // buffer should be full when this event fires -- if not
-                                 // fill it with zeros
-    char frame[config->tx.frame_size];
-    ffifo_state->o_flags |= FIFO_FLAG_IS_OVERFLOW;
-    memset(frame, 0, config->tx.frame_size);
-    while (ffifo_state->atomic_position.access.tail != config->tx.frame_count) {
-      // if buffer is not full -- make it full of zeros -- what happens if application is
-      // writing while this write -- interrupt priority?
-      ffifo_write_buffer(&config->tx, ffifo_state, frame, config->tx.frame_size);
+  ring_t *ring = &ffifo_state->ring;
+  u32 available = ring_free(ring, config->tx.frame_count);
+  if (available) {
+    // buffer should be full when this event fires -- if not fill it with zeros. If
+    // the application is writing while this happens, it will see the head move and
+    // retry at the new head
+    const u32 frame = ring_head_offset(ring, config->tx.frame_count);
+    u32 contiguous = config->tx.frame_count - frame;
+    if (contiguous > available) {
+      contiguous = available;
     }
+    ffifo_set_overflow(ffifo_state, 1);
+    memset(ffifo_get_frame(&config->tx, frame), 0, contiguous * config->tx.frame_size);
+    memset(config->tx.buffer, 0, (available - contiguous) * config->tx.frame_size);
+    clean_written_frames(&config->tx, frame, available);
+    ring_produce(ring, config->tx.frame_count, available);
   }
 
   for (u32 frames = 0; frames < frame_count; frames++) {
     state->tx.access_count++;
     // increment the tail for the frame that was written
-    if (ffifo_state->atomic_position.access.tail == config->tx.frame_count) {
-      ffifo_state->atomic_position.access.tail = ffifo_state->atomic_position.access.head;
-    }
-    ffifo_inc_tail(ffifo_state, config->tx.frame_count);
+    ring_consume(ring, config->tx.frame_count, 1);
 
 #if 0
     // this should never print anything -- can be used for debugging
     if (event->o_events & MCU_EVENT_FLAG_LOW) {
-      if (ffifo_state->atomic_position.access.head != 0) {
+      if (ring_head_offset(ring, config->tx.frame_count) != 0) {
         sos_debug_printf("head not zero 0x%lX\n", ffifo_state->o_flags);
       }
     } else {
-      if (ffifo_state->atomic_position.access.head == 0) {
+      if (ring_head_offset(ring, config->tx.frame_count) == 0) {
         sos_debug_printf("head is zero\n");
       }
     }
@@ -99,15 +158,11 @@ int event_data_ready(void *context, const mcu_event_t *event) {
   }
 
   // check for overflow
-  if (
-    ffifo_state->atomic_position.access.tail
-    != ffifo_state->atomic_position.access.head) { // buffer should be empty
-    if (ffifo_state->o_flags & FIFO_FLAG_IS_READ_BUSY) {
-      ffifo_state->o_flags |= FIFO_FLAG_IS_WRITE_WHILE_READ_BUSY;
-    }
-    ffifo_state->o_flags |= FIFO_FLAG_IS_OVERFLOW;
-    ffifo_state->atomic_position.access.tail =
-      ffifo_state->atomic_position.access.head; // forces the buffer to be empty
+  ring_t *ring = &ffifo_state->ring;
+  if (!ring_is_empty(ring)) { // buffer should be empty
+    ffifo_set_overflow(ffifo_state, 1);
+    // forces the buffer to be empty -- a read in progress will see the tail move
+    ring_drop(ring, config->rx.frame_count, config->rx.frame_count);
   }
 
   // increment the head for the frame received
@@ -116,8 +171,11 @@ int event_data_ready(void *context, const mcu_event_t *event) {
     frame_count >>= 1;
   }
 
+  // discard stale cache lines before the application sees the frames
+  invalidate_received_frames(&config->rx, o_events);
+
   for (u32 frames = 0; frames < frame_count; frames++) {
-    ffifo_inc_head(ffifo_state, config->rx.frame_count);
+    ring_produce(ring, config->rx.frame_count, 1);
     state->rx.access_count++;
     ffifo_data_received(&config->rx, ffifo_state);
   }
@@ -179,6 +237,17 @@ int stream_ffifo_ioctl(const devfs_handle_t *handle, int request, void *ctl) {
       state->o_flags = STREAM_FFIFO_FLAG_START;
 
       sos_debug_log_info(SOS_DEBUG_DEVICE, "Start Stream");
+      // buffers declared before the STREAM_FFIFO_DECLARE_* macros aligned them still
+      // work -- cache maintenance is left to the application as it was then
+      if (config->rx.buffer && !is_cache_aligned(&config->rx)) {
+        sos_debug_log_warning(
+          SOS_DEBUG_DEVICE, "rx buffer halves not cache aligned -- no cache maintenance");
+      }
+      if (config->tx.buffer && !is_cache_aligned(&config->tx)) {
+        sos_debug_log_warning(
+          SOS_DEBUG_DEVICE, "tx buffer halves not cache aligned -- no cache maintenance");
+      }
+
       if (config->rx.buffer) {
         // the application reads the RX buffer the is written by the device and data that
         // is read from hardware
@@ -197,6 +266,8 @@ int stream_ffifo_ioctl(const devfs_handle_t *handle, int request, void *ctl) {
         state->rx.ffifo.transfer_handler.read = 0;
         state->rx.ffifo.transfer_handler.write = 0;
         ffifo_flush(&(state->rx.ffifo));
+        // no dirty lines may be evicted on top of data written by the DMA
+        invalidate_received_frames(&config->rx, 0);
 
         // on the first call the FIFO is full of zeros and returns immediately
         if (config->device.driver.read(&config->device.handle, &(state->rx.async)) < 0) {
@@ -227,17 +298,14 @@ int stream_ffifo_ioctl(const devfs_handle_t *handle, int request, void *ctl) {
         state->tx.ffifo.transfer_handler.write = 0;
         ffifo_flush(&(state->tx.ffifo));
 
-        // ffifo is empty so the head must be incremented on start to be in the middle
-        // There needs to be a for loop here to inc the head to the halfway point in case
-        // tx.frame_count != 2
-        u32 i;
-        for (i = 0; i < config->tx.frame_count / 2; i++) {
-          ffifo_inc_head(&state->tx.ffifo, config->tx.frame_count);
-        }
+        // ffifo is empty so the head must be advanced to the halfway point on start
+        ring_produce(
+          &state->tx.ffifo.ring, config->tx.frame_count, config->tx.frame_count / 2);
         ffifo_set_writeblock(&state->tx.ffifo, 1);
 
         // start writing data to the driver -- zeros comprise the first frame
         memset(state->tx.async.buf, 0, state->tx.async.nbyte);
+        clean_written_frames(&config->tx, 0, config->tx.frame_count);
 
         int result =
           config->device.driver.write(&config->device.handle, &(state->tx.async));
@@ -276,6 +344,53 @@ int stream_ffifo_ioctl(const devfs_handle_t *handle, int request, void *ctl) {
     info->o_status = state->o_flags;
     return 0;
 
+  case I_DEVFS_POLL: {
+    int o_flags = DEVFS_POLL_FLAG_IS_SUPPORTED;
+    if (state->o_flags & STREAM_FFIFO_FLAG_START) {
+      if (config->rx.buffer) {
+        o_flags |= ffifo_poll(&config->rx, &state->rx.ffifo)
+                   & DEVFS_POLL_FLAG_IS_READ_READY;
+      }
+      if (config->tx.buffer) {
+        o_flags |= ffifo_poll(&config->tx, &state->tx.ffifo)
+                   & DEVFS_POLL_FLAG_IS_WRITE_READY;
+      }
+    }
+    return o_flags;
+  }
+
+  case I_FFIFO_ACQUIREREAD:
+  case I_FFIFO_RELEASEREAD:
+    if (config->rx.buffer == 0) {
+      return SYSFS_SET_RETURN(ENOSYS);
+    }
+    if ((state->o_flags & STREAM_FFIFO_FLAG_START) == 0) {
+      return SYSFS_SET_RETURN(EAGAIN);
+    }
+    // no callback -- the FIFO is written by hardware
+    return ffifo_access_frames_local(&(config->rx), &(state->rx.ffifo), request, ctl, 0);
+
+  case I_FFIFO_ACQUIREWRITE:
+  case I_FFIFO_RELEASEWRITE: {
+    if (config->tx.buffer == 0) {
+      return SYSFS_SET_RETURN(ENOSYS);
+    }
+    if ((state->o_flags & STREAM_FFIFO_FLAG_START) == 0) {
+      return SYSFS_SET_RETURN(EAGAIN);
+    }
+    const ffifo_frames_t *frames = ctl;
+    // no callback -- the FIFO is read by hardware
+    int result =
+      ffifo_access_frames_local(&(config->tx), &(state->tx.ffifo), request, ctl, 0);
+    if ((result == 0) && (request == I_FFIFO_RELEASEWRITE)) {
+      // the frames were written in place by the application
+      clean_written_frames(
+        &config->tx, ring_offset(frames->position, config->tx.frame_count),
+        frames->frame_count);
+    }
+    return result;
+  }
+
   case I_STREAM_FFIFO_SETACTION:
   case I_MCU_SETACTION:
 
@@ -327,8 +442,22 @@ int stream_ffifo_write(const devfs_handle_t *handle, devfs_async_t *async) {
     return SYSFS_SET_RETURN(EAGAIN);
   }
 
+  // the underflow fill (interrupt) may also move the head while the frames are
+  // copied -- the frames it fills are cleaned again here which is harmless
+  ring_t *ring = &state->tx.ffifo.ring;
+  const u32 head = ring_load_head(ring);
   // this will never need to execute a callback because the FIFO is read by hardware
-  return ffifo_write_local(&(config->tx), &(state->tx.ffifo), async, 0);
+  int result = ffifo_write_local(&(config->tx), &(state->tx.ffifo), async, 0);
+  u32 count = ring_distance(ring_load_head(ring), head, config->tx.frame_count);
+  if (count > config->tx.frame_count) {
+    count = config->tx.frame_count;
+  }
+
+  if (count) {
+    clean_written_frames(
+      &config->tx, ring_offset(head, config->tx.frame_count), count);
+  }
+  return result;
 }
 
 int stream_ffifo_close(const devfs_handle_t *handle) {
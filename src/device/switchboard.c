@@ -2,8 +2,10 @@
 
 
 #include "device/switchboard.h"
+#include "cortexm/cortexm.h"
 #include "cortexm/task.h"
 #include "sos/debug.h"
+#include "sos/sos.h"
 #include <errno.h>
 #include <fcntl.h>
 #include <stddef.h>
@@ -12,6 +14,14 @@ static int create_connection(
   const switchboard_config_t *config,
   switchboard_state_t *state,
   const switchboard_attr_t *attr);
+static int add_output(
+  const switchboard_config_t *config,
+  switchboard_state_t *state,
+  const switchboard_attr_t *attr);
+static int is_output_used(
+  const switchboard_config_t *config,
+  const switchboard_state_t *state,
+  const devfs_device_t *device);
 static void abort_connection(switchboard_state_t *state);
 static void close_connection(switchboard_state_t *state);
 static int
@@ -32,13 +42,17 @@ static int handle_data_ready(void *context, const mcu_event_t *event);
 static int handle_write_complete(void *context, const mcu_event_t *event);
 static int read_then_write_until_async(switchboard_state_t *state);
 static void complete_read(switchboard_state_t *state, int bytes_read);
-static void complete_write(switchboard_state_t *state);
+static void complete_write(switchboard_state_t *state, u8 output_index);
 static void update_bytes_transferred(
   switchboard_state_t *state,
   switchboard_state_terminal_t *terminal);
-static void switch_input_buffer(switchboard_state_t *state, int bytes_read);
-static void switch_output_buffer(switchboard_state_t *state);
-static int write_to_device(switchboard_state_t *state);
+static void update_stall(switchboard_state_terminal_t *terminal, int is_stalled);
+static void update_writing_flag(switchboard_state_t *state);
+static u8 *get_buffer(const switchboard_state_t *state, u8 index);
+static u8 get_next_index(const switchboard_state_t *state, u8 index);
+static u32 get_milliseconds();
+static int write_to_device(switchboard_state_t *state, u8 output_index);
+static int write_to_devices(switchboard_state_t *state);
 static int check_for_stopped_or_destroyed(switchboard_state_t *state);
 
 int switchboard_open(const devfs_handle_t *handle) {
@@ -51,6 +65,7 @@ int switchboard_ioctl(const devfs_handle_t *handle, int request, void *ctl) {
   switchboard_state_t *state = handle->state;
   switchboard_attr_t *attr = ctl;
   switchboard_info_t *info = ctl;
+  switchboard_output_t *output = ctl;
   mcu_action_t *action = ctl;
   int ret;
   u32 o_flags;
@@ -61,18 +76,40 @@ int switchboard_ioctl(const devfs_handle_t *handle, int request, void *ctl) {
 
   case I_SWITCHBOARD_GETINFO:
     info->o_flags = SWITCHBOARD_FLAG_CONNECT | SWITCHBOARD_FLAG_DISCONNECT
-                    | SWITCHBOARD_FLAG_IS_PERSISTENT;
+                    | SWITCHBOARD_FLAG_IS_PERSISTENT | SWITCHBOARD_FLAG_ADD_OUTPUT;
     info->connection_count = config->connection_count;
     info->connection_buffer_size = config->connection_buffer_size;
     info->transaction_limit = config->transaction_limit;
+    info->buffer_count = config->buffer_count ? config->buffer_count : 2;
+    if (info->buffer_count > SWITCHBOARD_BUFFER_COUNT_MAX) {
+      info->buffer_count = SWITCHBOARD_BUFFER_COUNT_MAX;
+    }
+    info->output_count = SWITCHBOARD_OUTPUT_COUNT;
     return 0;
 
+  case I_SWITCHBOARD_GETOUTPUT:
+    // read() reports the first output -- this reports any of them
+    if (
+      (output->id < config->connection_count) && (state[output->id].o_flags != 0)
+      && (output->output_index < state[output->id].output_count)) {
+      if (
+        get_terminal(
+          config, state[output->id].output + output->output_index, &output->output)
+        < 0) {
+        return SYSFS_SET_RETURN(EIO);
+      }
+      return 0;
+    }
+    return SYSFS_SET_RETURN(EINVAL);
+
   case I_SWITCHBOARD_SETATTR:
     o_flags = attr->o_flags;
     ret = 0;
     if (attr->id < config->connection_count) {
       if (o_flags & SWITCHBOARD_FLAG_CONNECT) {
         ret = create_connection(config, state, attr);
+      } else if (o_flags & SWITCHBOARD_FLAG_ADD_OUTPUT) {
+        ret = add_output(config, state, attr);
       } else if (o_flags & SWITCHBOARD_FLAG_DISCONNECT) {
         ret = destroy_connection(config, state, attr->id);
       } else if (o_flags & SWITCHBOARD_FLAG_CLEAN) {
@@ -119,11 +156,19 @@ int switchboard_read(const devfs_handle_t *handle, devfs_async_t *async) {
           status->nbyte = state[id].nbyte;
         }
 
+        status->output_count = state[id].output_count;
+        status->buffer_count = state[id].buffer_count;
+        if (state[id].o_flags & SWITCHBOARD_FLAG_IS_CONNECTED) {
+          status->duration_ms = get_milliseconds() - state[id].start_ms;
+        } else {
+          status->duration_ms = state[id].duration_ms;
+        }
+
         if (get_terminal(config, &state[id].input, &status->input) < 0) {
           return SYSFS_SET_RETURN(EIO);
         }
 
-        if (get_terminal(config, &state[id].output, &status->output) < 0) {
+        if (get_terminal(config, state[id].output, &status->output) < 0) {
           return SYSFS_SET_RETURN(EIO);
         }
 
@@ -182,36 +227,41 @@ int create_connection(
     return SYSFS_SET_RETURN(ENOENT);
   }
 
-  state[id].output.device = devfs_lookup_device(
+  state[id].output[0].device = devfs_lookup_device(
     config->devfs_list, attr->output.name); // lookup input device from attr->input.name
-  if (state[id].output.device == 0) {
+  if (state[id].output[0].device == 0) {
     memset(state + id, 0, sizeof(switchboard_state_t));
     return SYSFS_SET_RETURN(ENOENT);
   }
 
   // check to see if the input or output is already an active connection
   for (i = 0; i < config->connection_count; i++) {
-    if (i != id) {
-      if ((state[id].input.device == state[i].input.device)) {
-        memset(state + id, 0, sizeof(switchboard_state_t));
-        return SYSFS_SET_RETURN(EBUSY);
-      }
-
-      if (state[id].output.device == state[i].output.device) {
-        memset(state + id, 0, sizeof(switchboard_state_t));
-        return SYSFS_SET_RETURN(EBUSY);
-      }
+    if ((i != id) && (state[id].input.device == state[i].input.device)) {
+      memset(state + id, 0, sizeof(switchboard_state_t));
+      return SYSFS_SET_RETURN(EBUSY);
     }
   }
 
+  if (is_output_used(config, state, state[id].output[0].device)) {
+    memset(state + id, 0, sizeof(switchboard_state_t));
+    return SYSFS_SET_RETURN(EBUSY);
+  }
+
   if (attr->o_flags & SWITCHBOARD_FLAG_SET_TRANSACTION_LIMIT) {
     state[id].transaction_limit = attr->transaction_limit;
   } else {
     state[id].transaction_limit = config->transaction_limit;
   }
 
-  state[id].buffer[0] = config->buffer + id * 2 * config->connection_buffer_size;
-  state[id].buffer[1] = config->buffer + (id * 2 + 1) * config->connection_buffer_size;
+  state[id].buffer_count = config->buffer_count ? config->buffer_count : 2;
+  if (state[id].buffer_count > SWITCHBOARD_BUFFER_COUNT_MAX) {
+    state[id].buffer_count = SWITCHBOARD_BUFFER_COUNT_MAX;
+  }
+  state[id].buffer_size = config->connection_buffer_size;
+  // the ring is sized by config->buffer_count even if fewer buffers are used
+  state[id].buffer = (u8 *)config->buffer
+                     + id * (config->buffer_count ? config->buffer_count : 2)
+                         * config->connection_buffer_size;
 
   state[id].nbyte = attr->nbyte; // total number of bytes to transfer OR packet size for
                                  // persistent connections (must be less than buffer size)
@@ -249,29 +299,34 @@ int create_connection(
   state[id].input.async.loc = attr->input.loc;
   state[id].input.async.handler.callback = handle_data_ready;
   state[id].input.async.handler.context = state + id;
-  state[id].input.async.buf = state[id].buffer[0];
+  state[id].input.async.buf = state[id].buffer;
   state[id].input.async.nbyte = state[id].packet_size;
+  state[id].input.connection = state + id;
 
-  memcpy(&state[id].output.async, &state[id].input.async, sizeof(devfs_async_t));
+  memcpy(&state[id].output[0].async, &state[id].input.async, sizeof(devfs_async_t));
 
   // output is the same except the callback and the location (channel)
-  state[id].output.async.handler.callback = handle_write_complete;
-  state[id].output.async.loc = attr->output.loc;
-  state[id].output.async.flags = O_RDWR;
+  state[id].output[0].async.handler.callback = handle_write_complete;
+  state[id].output[0].async.handler.context = state[id].output;
+  state[id].output[0].async.loc = attr->output.loc;
+  state[id].output[0].async.flags = O_RDWR;
   if (attr->o_flags & SWITCHBOARD_FLAG_IS_OUTPUT_NON_BLOCKING) {
-    state[id].output.async.flags |= O_NONBLOCK;
+    state[id].output[0].async.flags |= O_NONBLOCK;
   }
+  state[id].output[0].connection = state + id;
 
-  if (open_terminal(&state->input) < 0) {
+  if (open_terminal(&state[id].input) < 0) {
     memset(state + id, 0, sizeof(switchboard_state_t));
     return SYSFS_SET_RETURN(EIO);
   }
 
-  if (open_terminal(&state->output) < 0) {
-    close_terminal(&state->input);
+  if (open_terminal(state[id].output) < 0) {
+    close_terminal(&state[id].input);
     memset(state + id, 0, sizeof(switchboard_state_t));
     return SYSFS_SET_RETURN(EIO);
   }
+  state[id].output_count = 1;
+  state[id].start_ms = get_milliseconds();
 
   if (
     update_priority(state[id].input.device, &attr->input, MCU_EVENT_FLAG_DATA_READY)
@@ -281,7 +336,8 @@ int create_connection(
   }
 
   if (
-    update_priority(state[id].output.device, &attr->output, MCU_EVENT_FLAG_WRITE_COMPLETE)
+    update_priority(
+      state[id].output[0].device, &attr->output, MCU_EVENT_FLAG_WRITE_COMPLETE)
     < 0) {
     abort_connection(state + id);
     return SYSFS_SET_RETURN(EIO);
@@ -291,7 +347,7 @@ int create_connection(
   int result;
   sos_debug_log_info(
     SOS_DEBUG_DEVICE, "%d (%p) Starting %s -> %s", id, state + id,
-    state[id].input.device->name, state[id].output.device->name);
+    state[id].input.device->name, state[id].output[0].device->name);
   if ((result = read_then_write_until_async(state + id)) < 0) {
     abort_connection(state + id);
     sos_debug_log_error(
@@ -303,10 +359,92 @@ int create_connection(
   return 0;
 }
 
+int add_output(
+  const switchboard_config_t *config,
+  switchboard_state_t *state,
+  const switchboard_attr_t *attr) {
+  switchboard_state_t *connection = state + attr->id;
+  switchboard_state_terminal_t terminal;
+
+  if ((connection->o_flags & SWITCHBOARD_FLAG_IS_CONNECTED) == 0) {
+    return SYSFS_SET_RETURN(EINVAL);
+  }
+
+  if (connection->output_count == SWITCHBOARD_OUTPUT_COUNT) {
+    return SYSFS_SET_RETURN(ENOSPC);
+  }
+
+  const devfs_device_t *device = devfs_lookup_device(config->devfs_list, attr->output.name);
+  if (device == 0) {
+    return SYSFS_SET_RETURN(ENOENT);
+  }
+
+  if (is_output_used(config, state, device)) {
+    return SYSFS_SET_RETURN(EBUSY);
+  }
+
+  // the new output is set up like the first one
+  switchboard_state_terminal_t *output = connection->output + connection->output_count;
+  memset(&terminal, 0, sizeof(terminal));
+  memcpy(&terminal.async, &connection->output[0].async, sizeof(devfs_async_t));
+  terminal.device = device;
+  terminal.connection = connection;
+  terminal.async.handler.context = output;
+  terminal.async.loc = attr->output.loc;
+  terminal.async.flags = O_RDWR;
+  if (attr->o_flags & SWITCHBOARD_FLAG_IS_OUTPUT_NON_BLOCKING) {
+    terminal.async.flags |= O_NONBLOCK;
+  }
+
+  if (open_terminal(&terminal) < 0) {
+    return SYSFS_SET_RETURN(EIO);
+  }
+
+  if (update_priority(device, &attr->output, MCU_EVENT_FLAG_WRITE_COMPLETE) < 0) {
+    close_terminal(&terminal);
+    return SYSFS_SET_RETURN(EIO);
+  }
+
+  // the connection is running in the background
+  int result = 0;
+  const u32 primask = __get_PRIMASK();
+  cortexm_disable_interrupts();
+  if (connection->o_flags & SWITCHBOARD_FLAG_IS_CONNECTED) {
+    // start with the next buffer the input reads
+    terminal.buffer_index = connection->input.buffer_index;
+    memcpy(output, &terminal, sizeof(terminal));
+    connection->output_count++;
+  } else {
+    result = SYSFS_SET_RETURN(EINVAL);
+  }
+  __set_PRIMASK(primask);
+
+  if (result < 0) {
+    close_terminal(&terminal);
+  }
+  return result;
+}
+
+int is_output_used(
+  const switchboard_config_t *config,
+  const switchboard_state_t *state,
+  const devfs_device_t *device) {
+  for (u16 i = 0; i < config->connection_count; i++) {
+    for (u8 j = 0; j < state[i].output_count; j++) {
+      if (state[i].output[j].device == device) {
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
 void abort_connection(switchboard_state_t *state) {
   if ((state->o_flags & SWITCHBOARD_FLAG_IS_ERROR) == 0) {
     close_terminal(&state->input);
-    close_terminal(&state->output);
+    for (u8 i = 0; i < state->output_count; i++) {
+      close_terminal(state->output + i);
+    }
   }
   memset(state, 0, sizeof(switchboard_state_t));
 }
@@ -345,7 +483,9 @@ int destroy_connection(
 
 void close_connection(switchboard_state_t *state) {
   close_terminal(&state->input);
-  close_terminal(&state->output);
+  for (u8 i = 0; i < state->output_count; i++) {
+    close_terminal(state->output + i);
+  }
 
   // connection is not connected anymore
   state->o_flags &= ~SWITCHBOARD_FLAG_IS_CONNECTED;
@@ -362,9 +502,11 @@ int check_for_stopped_or_destroyed(switchboard_state_t *state) {
     u32 o_events = MCU_EVENT_FLAG_STOP | MCU_EVENT_FLAG_CANCELED;
     sos_debug_log_warning(
       SOS_DEBUG_DEVICE, "Stopping %s -> %s (%d, %d) 0x%lX", state->input.device->name,
-      state->output.device->name, SYSFS_GET_RETURN(state->nbyte),
+      state->output[0].device->name, SYSFS_GET_RETURN(state->nbyte),
       SYSFS_GET_RETURN_ERRNO(state->nbyte), state->o_flags);
 
+    state->duration_ms = get_milliseconds() - state->start_ms;
+
     if (state->o_flags & SWITCHBOARD_FLAG_IS_ERROR) {
       o_events |= MCU_EVENT_FLAG_ERROR;
     }
@@ -390,10 +532,29 @@ int get_terminal(
   switchboard_terminal_t *terminal) {
   terminal->loc = state_terminal->async.loc;
   terminal->bytes_transferred = state_terminal->bytes_transferred;
+  terminal->stall_count = state_terminal->stall_count;
   return devfs_lookup_name(config->devfs_list, state_terminal->device, terminal->name);
 }
 
-// switch happens after data is read
+u8 *get_buffer(const switchboard_state_t *state, u8 index) {
+  return state->buffer + index * state->buffer_size;
+}
+
+u8 get_next_index(const switchboard_state_t *state, u8 index) {
+  index++;
+  return index == state->buffer_count ? 0 : index;
+}
+
+u32 get_milliseconds() { return sos_realtime() / 1000; }
+
+void update_stall(switchboard_state_terminal_t *terminal, int is_stalled) {
+  // count each time the terminal starts waiting
+  if (is_stalled && (terminal->is_stalled == 0) && (terminal->stall_count < 0xffff)) {
+    terminal->stall_count++;
+  }
+  terminal->is_stalled = is_stalled;
+}
+
 int is_ready_to_read_device(switchboard_state_t *state) {
 
   if (state->o_flags & SWITCHBOARD_FLAG_IS_READING_ASYNC) {
@@ -406,68 +567,49 @@ int is_ready_to_read_device(switchboard_state_t *state) {
     return 0;
   }
 
-  int buffer_is_free;
-  if (state->input.async.buf == state->buffer[0]) {
-    buffer_is_free = (state->bytes_in_buffer[0] == 0);
-  } else {
-    buffer_is_free = (state->bytes_in_buffer[1] == 0);
-  }
-
-  if (buffer_is_free == 0) {
-    // sos_debug_root_printf("No buffers\n");
-  }
-
-  return buffer_is_free;
-}
-
-// switch happens after data is written -- so previous buffer will be unused
-void switch_input_buffer(switchboard_state_t *state, int bytes_read) {
-  if (state->input.async.buf == state->buffer[0]) {
-    // the read completed on this buffer -- set the number of bytes read
-    state->bytes_in_buffer[0] = bytes_read;
-    state->input.async.buf = state->buffer[1];
-  } else {
-    state->bytes_in_buffer[1] = bytes_read;
-    state->input.async.buf = state->buffer[0];
-  }
-}
-
-// switch happens after data is written -- so previous buffer will be unused
-void switch_output_buffer(switchboard_state_t *state) {
-  if (state->output.async.buf == state->buffer[0]) {
-    state->bytes_in_buffer[0] = 0; // bytes were written
-    state->output.async.buf = state->buffer[1];
-  } else {
-    state->bytes_in_buffer[1] = 0; // bytes were written
-    state->output.async.buf = state->buffer[0];
-  }
+  // the next buffer is free once every output has written it
+  const int is_ring_full = state->o_pending[state->input.buffer_index] != 0;
+  update_stall(&state->input, is_ring_full);
+  return is_ring_full == 0;
 }
 
-int is_ready_to_write_device(switchboard_state_t *state) {
+int is_ready_to_write_device(switchboard_state_t *state, u8 output_index) {
+  switchboard_state_terminal_t *output = state->output + output_index;
 
-  if (state->o_flags & SWITCHBOARD_FLAG_IS_WRITING_ASYNC) {
+  if (output->is_async) {
     // a write is already in progress
     return 0;
   }
 
-  if ((state->output.async.nbyte < 0) || (state->nbyte < 0)) {
+  if ((output->async.nbyte < 0) || (state->nbyte < 0)) {
     // all writes are complete or an error occurred
     return 0;
   }
 
-  if (state->output.async.buf == state->buffer[0]) {
-    state->output.async.nbyte = state->bytes_in_buffer[0];
-  } else {
-    state->output.async.nbyte = state->bytes_in_buffer[1];
+  const u8 index = output->buffer_index;
+  if ((state->o_pending[index] & (1 << output_index)) == 0) {
+    // the input hasn't filled the next buffer yet
+    update_stall(output, output->bytes_transferred > 0);
+    return 0;
   }
 
-  // there there are bytes in the buffer, then the device is ready to bw written
-  return state->output.async.nbyte > 0;
+  // the buffer has data for this output
+  update_stall(output, 0);
+  output->async.buf = get_buffer(state, index);
+  output->async.nbyte = state->bytes_in_buffer[index];
+  return 1;
 }
 
 void complete_read(switchboard_state_t *state, int bytes_read) {
   update_bytes_transferred(state, &state->input);
-  switch_input_buffer(state, bytes_read);
+  if (bytes_read > 0) {
+    // pass the buffer to all the outputs
+    const u8 index = state->input.buffer_index;
+    state->bytes_in_buffer[index] = bytes_read;
+    state->o_pending[index] = (1 << state->output_count) - 1;
+    state->input.buffer_index = get_next_index(state, index);
+    state->input.async.buf = get_buffer(state, state->input.buffer_index);
+  }
   if (state->input.async.nbyte > 0) {
     state->input.async.nbyte = state->packet_size;
   }
@@ -487,27 +629,44 @@ void update_bytes_transferred(
   }
 }
 
-void complete_write(switchboard_state_t *state) {
-  update_bytes_transferred(state, &state->output);
+void complete_write(switchboard_state_t *state, u8 output_index) {
+  switchboard_state_terminal_t *output = state->output + output_index;
+  update_bytes_transferred(state, output);
+
+  // the buffer is free (ready for read device to write to buffer) once all outputs are
+  // done with it -- outputs complete in their own interrupts (which may preempt each
+  // other) so the bit is cleared with interrupts masked
+  const u32 primask = __get_PRIMASK();
+  cortexm_disable_interrupts();
+  state->o_pending[output->buffer_index] &= ~(1 << output_index);
+  __set_PRIMASK(primask);
+  output->buffer_index = get_next_index(state, output->buffer_index);
+}
 
-  // switches and marks the buffer as unused (ready for read device to write to buffer)
-  switch_output_buffer(state);
+void update_writing_flag(switchboard_state_t *state) {
+  state->o_flags &= ~SWITCHBOARD_FLAG_IS_WRITING_ASYNC;
+  for (u8 i = 0; i < state->output_count; i++) {
+    if (state->output[i].is_async) {
+      state->o_flags |= SWITCHBOARD_FLAG_IS_WRITING_ASYNC;
+    }
+  }
 }
 
-int write_to_device(switchboard_state_t *state) {
+int write_to_device(switchboard_state_t *state, u8 output_index) {
   // start writing the output device
+  switchboard_state_terminal_t *output = state->output + output_index;
   int ret = 0;
 
   if (is_ready_to_write_device(
-        state)) { // is there a buffer with data that needs to be written?
-    ret = state->output.device->driver.write(
-      &state->output.device->handle, &state->output.async);
+        state, output_index)) { // is there a buffer with data that needs to be written?
+    ret = output->device->driver.write(&output->device->handle, &output->async);
     if (ret == 0) {
       // waiting for write
+      output->is_async = 1;
       state->o_flags |= SWITCHBOARD_FLAG_IS_WRITING_ASYNC;
     } else if (ret > 0) {
       // buffer is free
-      complete_write(state);
+      complete_write(state, output_index);
     } else {
       int errno_value;
       errno_value = SYSFS_GET_RETURN_ERRNO(ret);
@@ -523,6 +682,20 @@ int write_to_device(switchboard_state_t *state) {
   return ret;
 }
 
+int write_to_devices(switchboard_state_t *state) {
+  int result = 0;
+  for (u8 i = 0; i < state->output_count; i++) {
+    const int ret = write_to_device(state, i);
+    if (ret < 0) {
+      return ret;
+    }
+    if (ret > 0) {
+      result = ret;
+    }
+  }
+  return result;
+}
+
 int read_from_device(switchboard_state_t *state) {
   // start writing the output device
   int ret = 0;
@@ -601,8 +774,8 @@ int read_then_write_until_async(switchboard_state_t *state) {
 
   do {
     ret = read_from_device(state);
-    if (ret == 0) { // read is either async or both buffers full
-      ret = write_to_device(state);
+    if (ret == 0) { // read is either async or all buffers full
+      ret = write_to_devices(state);
     }
     transactions++;
   } while (ret > 0 && (transactions < state->transaction_limit));
@@ -660,13 +833,16 @@ int handle_data_ready(void *context, const mcu_event_t *event) {
 }
 
 int handle_write_complete(void *context, const mcu_event_t *event) {
-  switchboard_state_t *state = context;
+  switchboard_state_terminal_t *output = context;
+  switchboard_state_t *state = output->connection;
+  const u8 output_index = output - state->output;
   u32 o_events = event->o_events;
 
   // not waiting for ASYNC data to write anymore
-  state->o_flags &= ~SWITCHBOARD_FLAG_IS_WRITING_ASYNC;
+  output->is_async = 0;
+  update_writing_flag(state);
   if (
-    (state->output.async.nbyte < 0)
+    (output->async.nbyte < 0)
     || (o_events & (MCU_EVENT_FLAG_CANCELED | MCU_EVENT_FLAG_ERROR))) {
     // write error occurred -- abort connection
 
@@ -678,17 +854,17 @@ int handle_write_complete(void *context, const mcu_event_t *event) {
       state->o_flags |= SWITCHBOARD_FLAG_IS_CANCELED;
     }
 
-    if (state->output.async.nbyte < 0) {
-      state->nbyte = state->output.async.nbyte;
+    if (output->async.nbyte < 0) {
+      state->nbyte = output->async.nbyte;
     } else {
       state->nbyte = SYSFS_SET_RETURN(EIO);
     }
 
   } else {
-    complete_write(state); // this frees the buffer that was just written
+    complete_write(state, output_index); // this frees the buffer if all outputs are done
 
     // try to start another write operation in case there is a synchronous read delay
-    write_to_device(state);
+    write_to_device(state, output_index);
   }
 
   read_then_write_until_async(state);
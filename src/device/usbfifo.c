@@ -22,7 +22,6 @@ static int cancel_read_action(const devfs_handle_t *handle) {
 }
 
 static int data_received(void *context, const mcu_event_t *data) {
-  int i;
   const devfs_handle_t *handle;
   const usbfifo_config_t *config;
   usbfifo_state_t *state;
@@ -30,7 +29,6 @@ static int data_received(void *context, const mcu_event_t *data) {
   config = handle->config;
   state = handle->state;
   int result;
-  int size = config->fifo.size;
 
   result = state->async_read.result;
 
@@ -39,11 +37,7 @@ static int data_received(void *context, const mcu_event_t *data) {
     if (result > 0) {
 
       // write the new bytes to the buffer
-      for (i = 0; i < result; i++) {
-        config->fifo.buffer[state->fifo.atomic_position.access.head] =
-          config->read_buffer[i];
-        fifo_inc_head(&(state->fifo), size);
-      }
+      fifo_push_buffer(&(config->fifo), &(state->fifo), config->read_buffer, result);
 
       // see if any functions are blocked waiting for data to arrive
       fifo_data_received(&(config->fifo), &(state->fifo));
@@ -94,6 +88,9 @@ int usbfifo_ioctl(const devfs_handle_t *handle, int request, void *ctl) {
   case I_FIFO_GETINFO:
     fifo_getinfo(info, &(config->fifo), &(state->fifo));
     break;
+  case I_DEVFS_POLL:
+    // writes go straight to the USB endpoint
+    return fifo_poll(&(config->fifo), &(state->fifo)) | DEVFS_POLL_FLAG_IS_WRITE_READY;
   case I_USB_SETACTION:
   case I_MCU_SETACTION:
     if (action->handler.callback == 0) {
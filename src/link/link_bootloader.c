@@ -1,14 +1,27 @@
 // Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
 
 #include <stdarg.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
 
 #include <sos/fs/sysfs.h>
 
 #include "link_local.h"
 #include "sos/dev/bootloader.h"
 
+enum { PAGE_STATE_UNCHANGED, PAGE_STATE_CHANGED, PAGE_STATE_ERASED };
+
 static int reset_device(link_transport_mdriver_t *driver, int invoke_bootloader);
+static void load_page(
+  bootloader_writepage_t *wattr,
+  int addr,
+  const void *buf,
+  int nbyte,
+  int page);
+static u32 calc_crc32(const u8 *buffer, u32 nbyte);
+static int get_write_status(link_transport_mdriver_t *driver);
+static int get_elapsed_ms(const struct timeval *start);
 
 int link_bootloader_attr(
   link_transport_mdriver_t *driver,
@@ -257,6 +270,9 @@ int link_writeflash(
   int bytes_written;
   int err;
 
+  struct timeval start;
+  gettimeofday(&start, NULL);
+
   bytes_written = 0;
   wattr.addr = addr;
   page_size = BOOTLOADER_WRITEPAGESIZE;
@@ -287,7 +303,250 @@ int link_writeflash(
 
   } while (bytes_written < nbyte);
 
-  link_debug(LINK_DEBUG_MESSAGE, "Write complete", nbyte);
+  err = get_write_status(driver);
+  if (err < 0) {
+    return err;
+  }
+
+  link_debug(
+    LINK_DEBUG_INFO, "Wrote %d bytes in %d ms", nbyte, get_elapsed_ms(&start));
+
+  return nbyte;
+}
+
+int link_writeflash_compressed(
+  link_transport_mdriver_t *driver,
+  const void *buf,
+  int nbyte) {
+  bootloader_writepage_t wattr;
+  const int bound = LINK_LZ_COMPRESS_BOUND(nbyte);
+  u8 *compressed = malloc(bound);
+  int err;
+
+  if (compressed == NULL) {
+    return -1;
+  }
+
+  struct timeval start;
+  gettimeofday(&start, NULL);
+
+  const int size = link_lz_compress(buf, nbyte, compressed, bound);
+  if (size < 0) {
+    link_error("failed to compress image");
+    free(compressed);
+    return -1;
+  }
+
+  link_debug(LINK_DEBUG_MESSAGE, "Compressed %d bytes to %d", nbyte, size);
+
+  // addr is the location in the compressed data
+  wattr.addr = 0;
+  do {
+    wattr.nbyte = size - wattr.addr;
+    if (wattr.nbyte > BOOTLOADER_WRITEPAGESIZE) {
+      wattr.nbyte = BOOTLOADER_WRITEPAGESIZE;
+    }
+    memcpy(wattr.buf, compressed + wattr.addr, wattr.nbyte);
+
+    link_transport_mastersettimeout(driver, 5000);
+    err = link_ioctl_delay(
+      driver, LINK_BOOTLOADER_FILDES, I_BOOTLOADER_WRITEPAGE_COMPRESSED, &wattr, 0, 0);
+    link_transport_mastersettimeout(driver, 0);
+    if (err < 0) {
+      link_error("I_BOOTLOADER_WRITEPAGE_COMPRESSED failed");
+      free(compressed);
+      return err;
+    }
+
+    wattr.addr += wattr.nbyte;
+  } while ((int)wattr.addr < size);
+
+  free(compressed);
+
+  err = get_write_status(driver);
+  if (err < 0) {
+    return err;
+  }
+
+  link_debug(
+    LINK_DEBUG_INFO, "Wrote %d bytes (%d compressed) in %d ms", nbyte, size,
+    get_elapsed_ms(&start));
+  return nbyte;
+}
+
+int link_writeflash_delta(
+  link_transport_mdriver_t *driver,
+  int addr,
+  const void *buf,
+  int nbyte) {
+  bootloader_page_hash_t hash;
+  bootloader_erase_range_t range;
+  bootloader_writepage_t wattr;
+  int err;
+
+  if (nbyte <= 0) {
+    return -1;
+  }
+
+  const int pages = (nbyte + BOOTLOADER_WRITEPAGESIZE - 1) / BOOTLOADER_WRITEPAGESIZE;
+  u8 *page_state = calloc(pages, 1);
+  if (page_state == NULL) {
+    return -1;
+  }
+
+  struct timeval start;
+  gettimeofday(&start, NULL);
+
+  // find the pages that are different from the flash
+  for (int first = 0; first < pages; first += BOOTLOADER_PAGE_HASH_MAX) {
+    hash.addr = addr + first * BOOTLOADER_WRITEPAGESIZE;
+    hash.count = pages - first;
+    if (hash.count > BOOTLOADER_PAGE_HASH_MAX) {
+      hash.count = BOOTLOADER_PAGE_HASH_MAX;
+    }
+
+    err = link_ioctl_delay(
+      driver, LINK_BOOTLOADER_FILDES, I_BOOTLOADER_GET_PAGE_HASH, &hash, 0, 0);
+    if (err < 0) {
+      link_error("I_BOOTLOADER_GET_PAGE_HASH failed");
+      free(page_state);
+      return err;
+    }
+
+    for (u32 i = 0; i < hash.count; i++) {
+      load_page(&wattr, addr, buf, nbyte, first + i);
+      if (hash.crc[i] != calc_crc32(wattr.buf, BOOTLOADER_WRITEPAGESIZE)) {
+        page_state[first + i] = PAGE_STATE_CHANGED;
+      }
+    }
+  }
+
+  // the first page is held until the signature is verified and the signature
+  // hash ends with the last page
+  page_state[0] = PAGE_STATE_CHANGED;
+  page_state[pages - 1] = PAGE_STATE_CHANGED;
+
+  // erase the sectors that have changed pages
+  for (int i = 0; i < pages; i++) {
+    if (page_state[i] != PAGE_STATE_CHANGED) {
+      continue;
+    }
+
+    range.addr = addr + i * BOOTLOADER_WRITEPAGESIZE;
+    range.nbyte = BOOTLOADER_WRITEPAGESIZE;
+    link_transport_mastersettimeout(driver, 20000);
+    err = link_ioctl_delay(
+      driver, LINK_BOOTLOADER_FILDES, I_BOOTLOADER_ERASE_RANGE, &range, 0, 0);
+    link_transport_mastersettimeout(driver, 0);
+    if (err < 0) {
+      link_error("I_BOOTLOADER_ERASE_RANGE failed");
+      free(page_state);
+      return err;
+    }
+
+    // every page in the erased sectors is written
+    for (int j = 0; j < pages; j++) {
+      const u32 page_addr = addr + j * BOOTLOADER_WRITEPAGESIZE;
+      if (
+        (page_addr < range.addr + range.nbyte)
+        && (page_addr + BOOTLOADER_WRITEPAGESIZE > range.addr)) {
+        page_state[j] = PAGE_STATE_ERASED;
+      }
+    }
+  }
+
+  int written = 0;
+  for (int i = 0; i < pages; i++) {
+    if (page_state[i] == PAGE_STATE_UNCHANGED) {
+      continue;
+    }
+
+    load_page(&wattr, addr, buf, nbyte, i);
+    link_transport_mastersettimeout(driver, 5000);
+    err = link_ioctl_delay(
+      driver, LINK_BOOTLOADER_FILDES, I_BOOTLOADER_WRITEPAGE, &wattr, 0, 0);
+    link_transport_mastersettimeout(driver, 0);
+    if (err < 0) {
+      link_error("I_BOOTLOADER_WRITEPAGE failed");
+      free(page_state);
+      return err;
+    }
+    written++;
+  }
+
+  free(page_state);
+
+  err = get_write_status(driver);
+  if (err < 0) {
+    return err;
+  }
 
+  link_debug(
+    LINK_DEBUG_INFO, "Wrote %d of %d pages in %d ms", written, pages,
+    get_elapsed_ms(&start));
   return nbyte;
 }
+
+int get_write_status(link_transport_mdriver_t *driver) {
+  bootloader_attr_t attr;
+  if (link_bootloader_attr(driver, &attr, 0) < 0) {
+    return -1;
+  }
+
+  if (attr.version < 0x401) {
+    // older bootloaders reply to each page after it is written
+    return 0;
+  }
+
+  // the bootloader replies to each page before writing it so the last page is
+  // only checked here
+  link_transport_mastersettimeout(driver, 5000);
+  const int result = link_ioctl_delay(
+    driver, LINK_BOOTLOADER_FILDES, I_BOOTLOADER_GET_WRITE_STATUS, NULL, 0, 0);
+  link_transport_mastersettimeout(driver, 0);
+  if (result < 0) {
+    link_error("I_BOOTLOADER_GET_WRITE_STATUS failed");
+  }
+  return result;
+}
+
+// end to end time of a write (until the bootloader has written the last page)
+int get_elapsed_ms(const struct timeval *start) {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return (int)((now.tv_sec - start->tv_sec) * 1000
+               + (now.tv_usec - start->tv_usec) / 1000);
+}
+
+void load_page(
+  bootloader_writepage_t *wattr,
+  int addr,
+  const void *buf,
+  int nbyte,
+  int page) {
+  // the same pages as link_writeflash()
+  const int page_size =
+    nbyte < BOOTLOADER_WRITEPAGESIZE ? nbyte : BOOTLOADER_WRITEPAGESIZE;
+  const int offset = page * page_size;
+  int count = nbyte - offset;
+  if (count > page_size) {
+    count = page_size;
+  }
+
+  wattr->addr = addr + offset;
+  wattr->nbyte = page_size;
+  memset(wattr->buf, 0xFF, BOOTLOADER_WRITEPAGESIZE);
+  memcpy(wattr->buf, (const u8 *)buf + offset, count);
+}
+
+u32 calc_crc32(const u8 *buffer, u32 nbyte) {
+  // the same as sos_crc32() on the device
+  u32 crc = 0xffffffff;
+  while (nbyte--) {
+    crc ^= *buffer++;
+    for (int i = 0; i < 8; i++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+  }
+  return ~crc;
+}
@@ -0,0 +1,142 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "link_local.h"
+#include "sos/lz.h"
+
+#define HASH_BITS 12
+
+static int write_count(u8 *dest, int loc, int dest_size, int count);
+static int write_sequence(
+  u8 *dest,
+  int loc,
+  int dest_size,
+  const u8 *literals,
+  int literal_count,
+  int offset,
+  int match_count);
+
+static inline u32 hash(const u8 *src) {
+  const u32 value = src[0] | (src[1] << 8) | (src[2] << 16) | ((u32)src[3] << 24);
+  return (value * 2654435761U) >> (32 - HASH_BITS);
+}
+
+int link_lz_compress(const void *src, int nbyte, void *dest, int dest_size) {
+  const u8 *in = src;
+  u8 *out = dest;
+  sos_lz_header_t header;
+
+  if ((nbyte < 0) || (dest_size < (int)sizeof(header))) {
+    return -1;
+  }
+
+  int *table = malloc((1 << HASH_BITS) * sizeof(int));
+  if (table == NULL) {
+    return -1;
+  }
+  for (int i = 0; i < (1 << HASH_BITS); i++) {
+    table[i] = -1;
+  }
+
+  header.signature = SOS_LZ_SIGNATURE;
+  header.size = nbyte;
+  memcpy(out, &header, sizeof(header));
+
+  int loc = sizeof(header);
+  int anchor = 0;
+  int i = 0;
+  while ((i + SOS_LZ_MATCH_MIN <= nbyte) && (loc >= 0)) {
+    const u32 h = hash(in + i);
+    const int candidate = table[h];
+    table[h] = i;
+
+    if (
+      (candidate < 0) || (i - candidate > SOS_LZ_WINDOW_SIZE)
+      || memcmp(in + candidate, in + i, SOS_LZ_MATCH_MIN)) {
+      i++;
+      continue;
+    }
+
+    int match_count = SOS_LZ_MATCH_MIN;
+    while ((i + match_count < nbyte)
+           && (in[candidate + match_count] == in[i + match_count])) {
+      match_count++;
+    }
+
+    loc = write_sequence(
+      out, loc, dest_size, in + anchor, i - anchor, i - candidate, match_count);
+    i += match_count;
+    anchor = i;
+  }
+
+  // the rest of the data is literals
+  if ((loc >= 0) && (anchor < nbyte)) {
+    loc = write_sequence(out, loc, dest_size, in + anchor, nbyte - anchor, 0, 0);
+  }
+
+  free(table);
+  return loc;
+}
+
+int write_count(u8 *dest, int loc, int dest_size, int count) {
+  while (count >= 255) {
+    if (loc == dest_size) {
+      return -1;
+    }
+    dest[loc++] = 255;
+    count -= 255;
+  }
+  if (loc == dest_size) {
+    return -1;
+  }
+  dest[loc++] = count;
+  return loc;
+}
+
+int write_sequence(
+  u8 *dest,
+  int loc,
+  int dest_size,
+  const u8 *literals,
+  int literal_count,
+  int offset,
+  int match_count) {
+  // match_count is zero for the last sequence
+  const int match_code = match_count ? match_count - SOS_LZ_MATCH_MIN : 0;
+
+  if (loc == dest_size) {
+    return -1;
+  }
+  dest[loc++] = ((literal_count < 15 ? literal_count : 15) << 4)
+                | (match_code < 15 ? match_code : 15);
+
+  if (literal_count >= 15) {
+    loc = write_count(dest, loc, dest_size, literal_count - 15);
+    if (loc < 0) {
+      return -1;
+    }
+  }
+
+  if (loc + literal_count > dest_size) {
+    return -1;
+  }
+  memcpy(dest + loc, literals, literal_count);
+  loc += literal_count;
+
+  if (match_count == 0) {
+    return loc;
+  }
+
+  if (loc + 2 > dest_size) {
+    return -1;
+  }
+  dest[loc++] = offset & 0xff;
+  dest[loc++] = offset >> 8;
+
+  if (match_code >= 15) {
+    return write_count(dest, loc, dest_size, match_code - 15);
+  }
+  return loc;
+}
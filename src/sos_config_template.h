@@ -11,6 +11,7 @@
 #define CONFIG_PTHREAD_MUTEX_PRIO_CEILING 0
 #define CONFIG_PTHREAD_STACK_MIN 128
 #define CONFIG_PTHREAD_DEFAULT_STACK_SIZE 1536
+#define CONFIG_PTHREAD_MUTEX_FAST_PATH 1
 
 // SCHED CONFIGURATION OPTIONS
 #define CONFIG_SCHED_LOWEST_PRIORITY 0
@@ -18,6 +19,8 @@
 #define CONFIG_SCHED_DEFAULT_PRIORITY 0
 // duration is in milliseconds
 #define CONFIG_SCHED_RR_DURATION 10
+// hashed wait queues for mutexes, semaphores and conditions (power of 2)
+#define CONFIG_SCHED_WAIT_QUEUE_COUNT 16
 
 // Task options
 // total number of threads (system and application)
@@ -41,4 +44,24 @@
 
 #define CONFIG_USE_STDIO 1
 
+// CRC tables: 1 for byte-wise, 4 or 8 for slicing (faster, 4 or 8 times the flash)
+#define CONFIG_CRC_SLICE_COUNT 1
+// compute CRC-16 with mcu_calc_crc16() from the MCU port (CRC peripheral)
+#define CONFIG_CRC_IS_MCU 0
+
+// readv()/writev() on devices copy up to this many bytes to the stack so they are
+// one transfer (0 transfers each buffer separately)
+#define CONFIG_DEVFS_VECTOR_BUFFER_SIZE 64
+
+// number of aio_ring_submit() operations that can be in progress system wide
+#define CONFIG_AIO_RING_ENTRY_COUNT 8
+
+// sendfile() allocates two buffers of this size when the source can't be memory
+// mapped (one is read while the other is written)
+#define CONFIG_SENDFILE_BUFFER_SIZE 256
+
+// process_start() remembers the validated headers of this many applications so
+// relaunching one doesn't read the file (0 to disable)
+#define CONFIG_PROCESS_LAUNCH_CACHE_SIZE 4
+
 #endif /* CONFIG_SOS_CONFIG_H */
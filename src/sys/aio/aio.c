@@ -16,6 +16,7 @@
 
 #include "../signal/sig_local.h"
 #include "../unistd/unistd_local.h"
+#include "aio_local.h"
 #include "cortexm/cortexm.h"
 #include "sos/fs/sysfs.h"
 
@@ -288,6 +289,9 @@ int sysfs_aio_data_transfer_callback(void *context, const mcu_event_t *event) {
     aiocbp->async.result = 0;                  // given for aio_error()
   }
 
+  // posts the completion if the operation was started by aio_ring_submit()
+  aio_ring_root_complete(aiocbp);
+
   if (tid >= task_get_total()) {
     // This is not a valid task id
     return 0;
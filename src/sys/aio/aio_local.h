@@ -0,0 +1,13 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef AIO_LOCAL_H_
+#define AIO_LOCAL_H_
+
+#include "aio.h"
+#include <sdk/types.h>
+
+// posts a completed aiocb to the completion queue of its ring (does nothing if
+// the aiocb wasn't started by aio_ring_submit())
+void aio_ring_root_complete(struct aiocb *aiocbp) MCU_ROOT_EXEC_CODE;
+
+#endif /* AIO_LOCAL_H_ */
@@ -0,0 +1,451 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+/*! \addtogroup aio
+ *
+ * @{
+ *
+ */
+
+/*! \file */
+
+#include <errno.h>
+#include <string.h>
+
+#include "config.h"
+
+#include "../scheduler/scheduler_root.h"
+#include "../scheduler/scheduler_timing.h"
+#include "../unistd/unistd_local.h"
+#include "aio_local.h"
+#include "cortexm/cortexm.h"
+#include "sos/fs/devfs.h"
+
+/*! \cond */
+typedef struct {
+  aio_ring_t *ring;
+  struct aiocb *aiocbp; // set when an entry needs to be started in thread mode
+  int count;
+  int error;
+} aio_ring_submit_t;
+
+typedef struct {
+  aio_ring_t *ring;
+  struct mcu_timeval abs_timeout;
+  int count;
+  u8 is_blocked;
+  int error;
+} aio_ring_wait_t;
+
+typedef struct {
+  struct aiocb *aiocbp;
+  int error;
+} aio_ring_fail_t;
+
+typedef struct {
+  struct aiocb *aiocbp;
+  aio_ring_t *ring;
+  // copied when the ring is validated so the completion can't be redirected later
+  struct aiocb **complete_queue;
+  u32 capacity;
+  int tid;
+  int pid;
+} aio_ring_entry_t;
+
+// the ring of each operation in progress is kept here rather than in the aiocb
+static aio_ring_entry_t entry_list[CONFIG_AIO_RING_ENTRY_COUNT] MCU_SYS_MEM;
+static volatile u8 entry_count MCU_SYS_MEM;
+
+static void svcall_submit(void *args) MCU_ROOT_EXEC_CODE;
+static void svcall_wait(void *args) MCU_ROOT_EXEC_CODE;
+static void svcall_fail(void *args) MCU_ROOT_EXEC_CODE;
+static void root_fail(struct aiocb *aiocbp, int error) MCU_ROOT_EXEC_CODE;
+static int root_validate_ring(aio_ring_t *ring) MCU_ROOT_EXEC_CODE;
+static int is_entry_stale(const aio_ring_entry_t *entry) MCU_ROOT_EXEC_CODE;
+static int claim_entry(aio_ring_t *ring, struct aiocb *aiocbp) MCU_ROOT_EXEC_CODE;
+static aio_ring_entry_t *find_entry(const struct aiocb *aiocbp) MCU_ROOT_EXEC_CODE;
+/*! \endcond */
+
+/*! \details This function initializes \a ring to use \a submit_queue and
+ * \a complete_queue which are each arrays of \a capacity aiocb pointers.
+ *
+ * The ring must not have any operations in progress when it is initialized.
+ *
+ * \return Zero on success or -1 with errno (see \ref errno) set to:
+ * - EINVAL: a pointer is NULL or \a capacity is zero or more than 32768
+ */
+int aio_ring_init(
+  aio_ring_t *ring /*! The ring to initialize */,
+  struct aiocb **submit_queue /*! Submission queue memory */,
+  struct aiocb **complete_queue /*! Completion queue memory */,
+  u16 capacity /*! The number of entries in each queue */) {
+  if (
+    (ring == NULL) || (submit_queue == NULL) || (complete_queue == NULL)
+    || (capacity == 0) || (capacity > 32768)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  memset(ring, 0, sizeof(aio_ring_t));
+  ring_init(&ring->submit);
+  ring_init(&ring->complete);
+  ring->submit_queue = submit_queue;
+  ring->complete_queue = complete_queue;
+  ring->capacity = capacity;
+  return 0;
+}
+
+/*! \details This function adds \a aiocbp to the submission queue of \a ring.
+ * The operation is started on the next call to aio_ring_submit().
+ *
+ * \a aiocbp->aio_lio_opcode must be LIO_READ or LIO_WRITE. \a aiocbp must not
+ * be modified until it is returned by aio_ring_get(). No system call is made.
+ *
+ * \return Zero on success or -1 with errno (see \ref errno) set to:
+ * - EBADF: \a aiocbp->aio_fildes is not a valid file descriptor
+ * - EINVAL: \a aiocbp is NULL or the opcode is not LIO_READ or LIO_WRITE
+ * - EAGAIN: the submission queue is full
+ */
+int aio_ring_put(
+  aio_ring_t *ring /*! The ring */, struct aiocb *aiocbp /*! The operation to queue */) {
+  if (
+    (aiocbp == NULL)
+    || ((aiocbp->aio_lio_opcode != LIO_READ) && (aiocbp->aio_lio_opcode != LIO_WRITE))) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  const int fildes = u_fildes_is_bad(aiocbp->aio_fildes);
+  if (fildes < 0) {
+    errno = EBADF;
+    return -1;
+  }
+
+  if (ring_is_full(&ring->submit, ring->capacity)) {
+    errno = EAGAIN;
+    return -1;
+  }
+
+  aiocbp->aio_fildes = fildes;
+  ring->submit_queue[ring_head_offset(&ring->submit, ring->capacity)] = aiocbp;
+  ring_produce(&ring->submit, ring->capacity, 1);
+  return 0;
+}
+
+/*! \details This function starts the operations in the submission queue of
+ * \a ring.
+ *
+ * Operations on devices are all started with a single system call. Operations
+ * on other filesystems are started one at a time. An operation is only started
+ * if there is room to post its completion (operations in progress plus
+ * completions not yet retrieved can't exceed the capacity) and if fewer than
+ * CONFIG_AIO_RING_ENTRY_COUNT ring operations are in progress system wide, so
+ * some operations may remain in the submission queue.
+ *
+ * Operations that fail to start are posted to the completion queue with the
+ * error available from aio_error().
+ *
+ * \return The number of operations taken from the submission queue or -1
+ * with errno (see \ref errno) set to:
+ * - EPERM: \a ring, its queues or a queued aiocb are not in the caller's
+ *   memory (an aiocb that isn't is removed from the queue without being
+ *   started)
+ */
+int aio_ring_submit(aio_ring_t *ring /*! The ring */) {
+  aio_ring_submit_t args;
+  int count = 0;
+  args.ring = ring;
+
+  do {
+    args.count = 0;
+    args.error = 0;
+    cortexm_svcall(svcall_submit, &args);
+    count += args.count;
+    if (args.error) {
+      errno = args.error;
+      return -1;
+    }
+
+    if (args.aiocbp != NULL) {
+      // not a device -- the filesystem needs to start the operation in thread mode
+      if (sysfs_file_aio(get_open_file(args.aiocbp->aio_fildes), args.aiocbp) < 0) {
+        // the filesystem didn't start the operation (svcall_fail() checks whether
+        // the completion was already posted)
+        aio_ring_fail_t fail;
+        fail.aiocbp = args.aiocbp;
+        fail.error = errno;
+        cortexm_svcall(svcall_fail, &fail);
+      }
+    }
+  } while (args.aiocbp != NULL);
+
+  return count;
+}
+
+/*! \details This function retrieves the next completed operation from
+ * \a ring. aio_error() and aio_return() provide the result. No system call is
+ * made.
+ *
+ * \return A pointer to the completed operation or NULL if no operations are
+ * complete
+ */
+struct aiocb *aio_ring_get(aio_ring_t *ring /*! The ring */) {
+  if (ring_is_empty(&ring->complete)) {
+    return NULL;
+  }
+
+  struct aiocb *aiocbp =
+    ring->complete_queue[ring_tail_offset(&ring->complete, ring->capacity)];
+  ring_consume(&ring->complete, ring->capacity, 1);
+  return aiocbp;
+}
+
+/*! \details This function blocks the calling thread until a completion is ready
+ * in \a ring or until \a timeout has elapsed. If \a timeout is NULL, the thread
+ * waits until an operation completes.
+ *
+ * \return The number of completions ready, zero if no operations are in
+ * progress, or -1 with errno (see \ref errno) set to:
+ * - EAGAIN: \a timeout elapsed before any operations completed
+ * - EINTR: the thread received a signal before any operations completed
+ * - EPERM: \a ring or its queues are not in the caller's memory
+ */
+int aio_ring_wait(
+  aio_ring_t *ring /*! The ring */,
+  const struct timespec *timeout /*! The time to wait (relative) or NULL */) {
+  aio_ring_wait_t args;
+  args.ring = ring;
+
+  if (timeout == NULL) {
+    scheduler_timing_convert_timespec(&args.abs_timeout, NULL);
+  } else {
+    struct mcu_timeval now;
+    struct mcu_timeval interval;
+    scheduler_timing_convert_timespec(&interval, timeout);
+    cortexm_svcall(scheduler_timing_svcall_get_realtime, &now);
+    args.abs_timeout = scheduler_timing_add_mcu_timeval(&now, &interval);
+  }
+
+  while (1) {
+    args.error = 0;
+    cortexm_svcall(svcall_wait, &args);
+    if (args.error) {
+      errno = args.error;
+      return -1;
+    }
+
+    if ((args.count > 0) || (args.is_blocked == 0)) {
+      return args.count;
+    }
+
+    const int unblock_type = scheduler_unblock_type(task_get_current());
+    if (unblock_type == SCHEDULER_UNBLOCK_SLEEP) {
+      errno = EAGAIN;
+      return -1;
+    }
+
+    if (unblock_type == SCHEDULER_UNBLOCK_SIGNAL) {
+      errno = EINTR;
+      return -1;
+    }
+  }
+}
+
+/*! \cond */
+void aio_ring_root_complete(struct aiocb *aiocbp) {
+  if (entry_count == 0) {
+    // no ring operations are in progress
+    return;
+  }
+
+  const u32 primask = __get_PRIMASK();
+  cortexm_disable_interrupts();
+  aio_ring_entry_t *entry = find_entry(aiocbp);
+  if (entry == NULL) {
+    // not started by aio_ring_submit() or already posted
+    __set_PRIMASK(primask);
+    return;
+  }
+
+  aio_ring_t *ring = entry->ring;
+  entry->aiocbp = NULL;
+  entry_count--;
+
+  // aio_ring_submit() reserves a slot for every pending operation (the head is in
+  // application memory so the offset is checked before it is used)
+  const u32 offset = ring_head_offset(&ring->complete, entry->capacity);
+  if (offset < entry->capacity) {
+    entry->complete_queue[offset] = aiocbp;
+    ring_produce(&ring->complete, entry->capacity, 1);
+  }
+  if (ring->pending) {
+    ring->pending--;
+  }
+
+  // only search for blocked threads if one is waiting
+  if (ring->is_waiting) {
+    ring->is_waiting = 0;
+    const int priority = scheduler_root_unblock_all(ring, SCHEDULER_UNBLOCK_AIO);
+    scheduler_root_update_on_wake(-1, priority);
+  }
+  __set_PRIMASK(primask);
+}
+
+void svcall_submit(void *args) {
+  CORTEXM_SVCALL_ENTER();
+  aio_ring_submit_t *p = args;
+  aio_ring_t *ring = p->ring;
+  p->aiocbp = NULL;
+
+  if (root_validate_ring(ring) < 0) {
+    p->error = EPERM;
+    return;
+  }
+  const u32 capacity = ring->capacity;
+
+  while (ring_is_empty(&ring->submit) == 0) {
+    const u32 offset = ring_tail_offset(&ring->submit, capacity);
+    if (offset >= capacity) {
+      p->error = EPERM;
+      return;
+    }
+
+    struct aiocb *aiocbp = ring->submit_queue[offset];
+    if (task_validate_memory(aiocbp, sizeof(struct aiocb)) < 0) {
+      // the kernel can't write the result to it so it is never started
+      ring_consume(&ring->submit, capacity, 1);
+      p->error = EPERM;
+      return;
+    }
+
+    cortexm_disable_interrupts();
+    int is_full = ring->pending + ring_count(&ring->complete, capacity) >= capacity;
+    if ((is_full == 0) && (claim_entry(ring, aiocbp) < 0)) {
+      // too many ring operations are in progress -- try again after some complete
+      is_full = 1;
+    }
+    if (is_full == 0) {
+      ring->pending++;
+    }
+    cortexm_enable_interrupts();
+    if (is_full) {
+      return;
+    }
+
+    ring_consume(&ring->submit, capacity, 1);
+    p->count++;
+
+    // the descriptor was checked by aio_ring_put() but may have been closed since
+    const int fildes = aiocbp->aio_fildes;
+    if ((fildes >= OPEN_MAX) || (((u32)get_handle(fildes) & ~(0x01)) == 0)) {
+      root_fail(aiocbp, EBADF);
+    } else if (
+      task_validate_memory((void *)aiocbp->aio_buf, aiocbp->aio_nbytes) < 0) {
+      root_fail(aiocbp, EPERM);
+    } else if (get_fs(fildes)->aio == devfs_aio) {
+      // errors are posted to the completion queue
+      devfs_aio_root_data_transfer(get_handle(fildes), aiocbp);
+    } else {
+      p->aiocbp = aiocbp;
+      return;
+    }
+  }
+}
+
+void svcall_wait(void *args) {
+  CORTEXM_SVCALL_ENTER();
+  aio_ring_wait_t *p = args;
+  aio_ring_t *ring = p->ring;
+  p->is_blocked = 0;
+  p->count = 0;
+
+  if (root_validate_ring(ring) < 0) {
+    p->error = EPERM;
+    return;
+  }
+
+  cortexm_disable_interrupts();
+  p->count = ring_count(&ring->complete, ring->capacity);
+  if ((p->count == 0) && ring->pending) {
+    p->is_blocked = 1;
+    ring->is_waiting = 1;
+    scheduler_timing_root_timedblock(ring, &p->abs_timeout);
+  }
+  cortexm_enable_interrupts();
+}
+
+void svcall_fail(void *args) {
+  CORTEXM_SVCALL_ENTER();
+  aio_ring_fail_t *p = args;
+  if (task_validate_memory(p->aiocbp, sizeof(struct aiocb)) < 0) {
+    return;
+  }
+  cortexm_disable_interrupts();
+  const int is_posted = find_entry(p->aiocbp) == NULL;
+  cortexm_enable_interrupts();
+  if (is_posted == 0) {
+    root_fail(p->aiocbp, p->error);
+  }
+}
+
+void root_fail(struct aiocb *aiocbp, int error) {
+  aiocbp->async.tid = task_get_current();
+  aiocbp->async.result = SYSFS_SET_RETURN_WITH_VALUE(error, 1);
+  sysfs_aio_data_transfer_callback(aiocbp, 0);
+}
+
+// the ring and both of its queues must be in the caller's memory
+int root_validate_ring(aio_ring_t *ring) {
+  if (task_validate_memory(ring, sizeof(aio_ring_t)) < 0) {
+    return -1;
+  }
+  const u32 capacity = ring->capacity;
+  if ((capacity == 0) || (capacity > 32768)) {
+    return -1;
+  }
+  const int size = capacity * sizeof(struct aiocb *);
+  if (
+    (task_validate_memory(ring->submit_queue, size) < 0)
+    || (task_validate_memory(ring->complete_queue, size) < 0)) {
+    return -1;
+  }
+  return 0;
+}
+
+// the thread that submitted the operation is gone (the process exited)
+int is_entry_stale(const aio_ring_entry_t *entry) {
+  return (task_enabled(entry->tid) == 0) || (task_get_pid(entry->tid) != entry->pid);
+}
+
+// called with interrupts disabled
+int claim_entry(aio_ring_t *ring, struct aiocb *aiocbp) {
+  for (u32 i = 0; i < CONFIG_AIO_RING_ENTRY_COUNT; i++) {
+    aio_ring_entry_t *entry = entry_list + i;
+    if (entry->aiocbp == NULL) {
+      entry_count++;
+    } else if (is_entry_stale(entry) == 0) {
+      continue;
+    }
+    entry->aiocbp = aiocbp;
+    entry->ring = ring;
+    entry->complete_queue = ring->complete_queue;
+    entry->capacity = ring->capacity;
+    entry->tid = task_get_current();
+    entry->pid = task_get_pid(entry->tid);
+    return 0;
+  }
+  return -1;
+}
+
+// called with interrupts disabled
+aio_ring_entry_t *find_entry(const struct aiocb *aiocbp) {
+  for (u32 i = 0; i < CONFIG_AIO_RING_ENTRY_COUNT; i++) {
+    aio_ring_entry_t *entry = entry_list + i;
+    if ((entry->aiocbp == aiocbp) && (is_entry_stale(entry) == 0)) {
+      return entry;
+    }
+  }
+  return NULL;
+}
+/*! \endcond */
+
+/*! @} */
@@ -0,0 +1,100 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include "crc_local.h"
+
+#if CONFIG_CRC_IS_MCU
+#include "mcu/crc.h"
+#endif
+
+static u32 calc_reflected32(
+  const u32 (*table)[256],
+  u32 crc,
+  const u8 *buffer,
+  u32 nbyte);
+
+static inline u32 load_le32(const u8 *buffer) {
+  return buffer[0] | (buffer[1] << 8) | (buffer[2] << 16) | ((u32)buffer[3] << 24);
+}
+
+u8 sos_crc7(u8 crc, const void *buffer, u32 nbyte) {
+  const u8 *p = buffer;
+  u8 value = crc << 1;
+  while (nbyte--) {
+    value = crc7_table[value ^ *p++];
+  }
+  return value >> 1;
+}
+
+u16 sos_crc16_ccitt(u16 crc, const void *buffer, u32 nbyte) {
+#if CONFIG_CRC_IS_MCU
+  return mcu_calc_crc16(crc, 0x1021, buffer, nbyte);
+#else
+  const u8 *p = buffer;
+  const u16(*table)[256] = crc16_ccitt_table;
+  u32 value = crc;
+
+#if CONFIG_CRC_SLICE_COUNT == 8
+  while (nbyte >= 8) {
+    value ^= (p[0] << 8) | p[1];
+    value = table[7][value >> 8] ^ table[6][value & 0xff] ^ table[5][p[2]]
+            ^ table[4][p[3]] ^ table[3][p[4]] ^ table[2][p[5]] ^ table[1][p[6]]
+            ^ table[0][p[7]];
+    p += 8;
+    nbyte -= 8;
+  }
+#endif
+
+#if CONFIG_CRC_SLICE_COUNT >= 4
+  while (nbyte >= 4) {
+    value ^= (p[0] << 8) | p[1];
+    value = table[3][value >> 8] ^ table[2][value & 0xff] ^ table[1][p[2]]
+            ^ table[0][p[3]];
+    p += 4;
+    nbyte -= 4;
+  }
+#endif
+
+  while (nbyte--) {
+    value = ((value << 8) & 0xffff) ^ table[0][(value >> 8) ^ *p++];
+  }
+  return value;
+#endif
+}
+
+u32 sos_crc32(u32 crc, const void *buffer, u32 nbyte) {
+  return ~calc_reflected32(crc32_table, ~crc, buffer, nbyte);
+}
+
+u32 sos_crc32c(u32 crc, const void *buffer, u32 nbyte) {
+  return ~calc_reflected32(crc32c_table, ~crc, buffer, nbyte);
+}
+
+u32 calc_reflected32(const u32 (*table)[256], u32 crc, const u8 *buffer, u32 nbyte) {
+#if CONFIG_CRC_SLICE_COUNT == 8
+  while (nbyte >= 8) {
+    crc ^= load_le32(buffer);
+    const u32 next = load_le32(buffer + 4);
+    crc = table[7][crc & 0xff] ^ table[6][(crc >> 8) & 0xff]
+          ^ table[5][(crc >> 16) & 0xff] ^ table[4][crc >> 24] ^ table[3][next & 0xff]
+          ^ table[2][(next >> 8) & 0xff] ^ table[1][(next >> 16) & 0xff]
+          ^ table[0][next >> 24];
+    buffer += 8;
+    nbyte -= 8;
+  }
+#endif
+
+#if CONFIG_CRC_SLICE_COUNT >= 4
+  while (nbyte >= 4) {
+    crc ^= load_le32(buffer);
+    crc = table[3][crc & 0xff] ^ table[2][(crc >> 8) & 0xff]
+          ^ table[1][(crc >> 16) & 0xff] ^ table[0][crc >> 24];
+    buffer += 4;
+    nbyte -= 4;
+  }
+#endif
+
+  while (nbyte--) {
+    crc = (crc >> 8) ^ table[0][(crc ^ *buffer++) & 0xff];
+  }
+  return crc;
+}
@@ -0,0 +1,21 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef CRC_LOCAL_H_
+#define CRC_LOCAL_H_
+
+#include "config.h"
+
+#include "sos/crc.h"
+
+#if (CONFIG_CRC_SLICE_COUNT != 1) && (CONFIG_CRC_SLICE_COUNT != 4)                       \
+  && (CONFIG_CRC_SLICE_COUNT != 8)
+#error "CONFIG_CRC_SLICE_COUNT must be 1, 4 or 8"
+#endif
+
+// crc7 entries are shifted left by one so the CRC stays in the upper 7 bits
+extern const u8 crc7_table[256];
+extern const u16 crc16_ccitt_table[CONFIG_CRC_SLICE_COUNT][256];
+extern const u32 crc32_table[CONFIG_CRC_SLICE_COUNT][256];
+extern const u32 crc32c_table[CONFIG_CRC_SLICE_COUNT][256];
+
+#endif /* CRC_LOCAL_H_ */
@@ -5,9 +5,11 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "../scheduler/scheduler_timing.h"
 #include "cortexm/mpu.h"
 #include "cortexm/task.h"
 #include "sos/debug.h"
+#include "sos/trace.h"
 
 typedef struct {
   int code_size;
@@ -15,6 +17,10 @@ typedef struct {
 } root_load_data_t;
 
 static void svcall_load_data(void *args) MCU_ROOT_EXEC_CODE;
+static void svcall_get_launch_latency(void *args) MCU_ROOT_EXEC_CODE;
+static void copy_words(void *dest, const void *src, u32 size);
+static void zero_words(void *dest, u32 size);
+
 void svcall_load_data(void *args) {
   CORTEXM_SVCALL_ENTER();
   root_load_data_t *p = args;
@@ -39,7 +45,7 @@ void svcall_load_data(void *args) {
 
   //TODO Validate the source and dest values
 
-  memcpy(dest_addr, src_addr, size);
+  copy_words(dest_addr, src_addr, size);
 }
 
 // global_reent but it can't be removed without spinning the application signature
@@ -50,6 +56,85 @@ void crt_load_data(void *global_reent, int code_size, int data_size) {
   cortexm_svcall(svcall_load_data, &args);
 }
 
+// zeroes .bss and the open file table for crt_common() (a word at a time)
+void crt_zero_data(void *dest, int size) {
+  if (size > 0) {
+    zero_words(dest, size);
+  }
+}
+
+// called by crt_common() just before main()
+void crt_trace_launch() {
+  u32 latency;
+  cortexm_svcall(svcall_get_launch_latency, &latency);
+  sos_trace_event(LINK_POSIX_TRACE_LAUNCH, &latency, sizeof(latency));
+}
+
+void svcall_get_launch_latency(void *args) {
+  CORTEXM_SVCALL_ENTER();
+  struct mcu_timeval now;
+  struct mcu_timeval launch = sos_sched_table[task_get_current()].launch;
+  scheduler_timing_root_get_realtime(&now);
+  *(u32 *)args =
+    scheduler_timing_real64usec(&now) - scheduler_timing_real64usec(&launch);
+}
+
+// 4 words per loop so the compiler can use LDM/STM bursts
+void copy_words(void *dest, const void *src, u32 size) {
+  u8 *dest_bytes = dest;
+  const u8 *src_bytes = src;
+  if ((((u32)dest | (u32)src) & 0x03) == 0) {
+    u32 *d = dest;
+    const u32 *s = src;
+    for (; size >= 16; size -= 16) {
+      const u32 a = s[0];
+      const u32 b = s[1];
+      const u32 c = s[2];
+      const u32 e = s[3];
+      d[0] = a;
+      d[1] = b;
+      d[2] = c;
+      d[3] = e;
+      d += 4;
+      s += 4;
+    }
+    for (; size >= 4; size -= 4) {
+      *d++ = *s++;
+    }
+    dest_bytes = (u8 *)d;
+    src_bytes = (const u8 *)s;
+  }
+
+  while (size--) {
+    *dest_bytes++ = *src_bytes++;
+  }
+}
+
+void zero_words(void *dest, u32 size) {
+  u8 *dest_bytes = dest;
+  while (((u32)dest_bytes & 0x03) && size) {
+    *dest_bytes++ = 0;
+    size--;
+  }
+
+  u32 *d = (u32 *)dest_bytes;
+  for (; size >= 16; size -= 16) {
+    d[0] = 0;
+    d[1] = 0;
+    d[2] = 0;
+    d[3] = 0;
+    d += 4;
+  }
+  for (; size >= 4; size -= 4) {
+    *d++ = 0;
+  }
+
+  dest_bytes = (u8 *)d;
+  while (size--) {
+    *dest_bytes++ = 0;
+  }
+}
+
 char ** crt_import_argv(char *path_arg, int *argc) {
   *argc = 0;
 
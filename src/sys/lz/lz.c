@@ -0,0 +1,185 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <string.h>
+
+#include "sos/lz.h"
+
+enum {
+  STATE_HEADER,
+  STATE_TOKEN,
+  STATE_LITERAL_COUNT,
+  STATE_LITERALS,
+  STATE_OFFSET_LOW,
+  STATE_OFFSET_HIGH,
+  STATE_MATCH_COUNT,
+  STATE_MATCH,
+  STATE_COMPLETE
+};
+
+static inline void put_byte(sos_lz_decoder_t *decoder, u8 *dest, u8 value) {
+  *dest = value;
+  decoder->window[decoder->window_loc] = value;
+  decoder->window_loc = (decoder->window_loc + 1) & (SOS_LZ_WINDOW_SIZE - 1);
+}
+
+void sos_lz_decoder_init(sos_lz_decoder_t *decoder) {
+  memset(decoder, 0, sizeof(sos_lz_decoder_t) - SOS_LZ_WINDOW_SIZE);
+  decoder->state = STATE_HEADER;
+}
+
+int sos_lz_is_complete(const sos_lz_decoder_t *decoder) {
+  return decoder->state == STATE_COMPLETE;
+}
+
+int sos_lz_is_compressed(const void *buffer) {
+  sos_lz_header_t header;
+  memcpy(&header, buffer, sizeof(header));
+  return header.signature == SOS_LZ_SIGNATURE;
+}
+
+int sos_lz_decode(
+  sos_lz_decoder_t *decoder,
+  const void *src,
+  u32 *src_size,
+  void *dest,
+  u32 dest_size) {
+  const u8 *in = src;
+  const u32 in_size = *src_size;
+  u32 in_loc = 0;
+  u8 *out = dest;
+  u32 out_loc = 0;
+
+  while (decoder->state != STATE_COMPLETE) {
+    // matches and the end of literals don't need input
+    if (
+      (in_loc == in_size) && (decoder->state != STATE_MATCH)
+      && !((decoder->state == STATE_LITERALS) && (decoder->literal_count == 0))) {
+      break;
+    }
+
+    switch (decoder->state) {
+    case STATE_HEADER:
+      ((u8 *)&decoder->header)[decoder->count++] = in[in_loc++];
+      if (decoder->count == sizeof(sos_lz_header_t)) {
+        if (decoder->header.signature != SOS_LZ_SIGNATURE) {
+          return -1;
+        }
+        decoder->state = decoder->header.size ? STATE_TOKEN : STATE_COMPLETE;
+      }
+      break;
+
+    case STATE_TOKEN: {
+      const u8 token = in[in_loc++];
+      decoder->literal_count = token >> 4;
+      decoder->match_count = token & 0x0f;
+      decoder->state =
+        decoder->literal_count == 15 ? STATE_LITERAL_COUNT : STATE_LITERALS;
+    } break;
+
+    case STATE_LITERAL_COUNT: {
+      const u8 value = in[in_loc++];
+      decoder->literal_count += value;
+      if (value != 255) {
+        decoder->state = STATE_LITERALS;
+      }
+    } break;
+
+    case STATE_LITERALS:
+      if (decoder->literal_count == 0) {
+        // the last sequence doesn't have a match
+        decoder->state =
+          decoder->total == decoder->header.size ? STATE_COMPLETE : STATE_OFFSET_LOW;
+        break;
+      }
+
+      if (decoder->literal_count > decoder->header.size - decoder->total) {
+        return -1;
+      }
+
+      if (out_loc == dest_size) {
+        goto done;
+      }
+
+      {
+        u32 count = decoder->literal_count;
+        if (count > in_size - in_loc) {
+          count = in_size - in_loc;
+        }
+        if (count > dest_size - out_loc) {
+          count = dest_size - out_loc;
+        }
+        decoder->literal_count -= count;
+        decoder->total += count;
+        while (count--) {
+          put_byte(decoder, out + out_loc++, in[in_loc++]);
+        }
+      }
+      break;
+
+    case STATE_OFFSET_LOW:
+      decoder->offset = in[in_loc++];
+      decoder->state = STATE_OFFSET_HIGH;
+      break;
+
+    case STATE_OFFSET_HIGH:
+      decoder->offset |= in[in_loc++] << 8;
+      if (
+        (decoder->offset == 0) || (decoder->offset > SOS_LZ_WINDOW_SIZE)
+        || (decoder->offset > decoder->total)) {
+        return -1;
+      }
+
+      if (decoder->match_count == 15) {
+        decoder->state = STATE_MATCH_COUNT;
+      } else {
+        decoder->match_count += SOS_LZ_MATCH_MIN;
+        decoder->state = STATE_MATCH;
+      }
+      break;
+
+    case STATE_MATCH_COUNT: {
+      const u8 value = in[in_loc++];
+      decoder->match_count += value;
+      if (value != 255) {
+        decoder->match_count += SOS_LZ_MATCH_MIN;
+        decoder->state = STATE_MATCH;
+      }
+    } break;
+
+    case STATE_MATCH:
+      if (decoder->match_count > decoder->header.size - decoder->total) {
+        return -1;
+      }
+
+      if (out_loc == dest_size) {
+        goto done;
+      }
+
+      {
+        u32 count = decoder->match_count;
+        if (count > dest_size - out_loc) {
+          count = dest_size - out_loc;
+        }
+        decoder->match_count -= count;
+        decoder->total += count;
+        // byte by byte because the match can overlap the bytes being written
+        while (count--) {
+          const u8 value =
+            decoder->window
+              [(decoder->window_loc - decoder->offset) & (SOS_LZ_WINDOW_SIZE - 1)];
+          put_byte(decoder, out + out_loc++, value);
+        }
+      }
+
+      if (decoder->match_count == 0) {
+        decoder->state =
+          decoder->total == decoder->header.size ? STATE_COMPLETE : STATE_TOKEN;
+      }
+      break;
+    }
+  }
+
+done:
+  *src_size = in_loc;
+  return out_loc;
+}
@@ -79,6 +79,7 @@
 #include <unistd.h>
 
 #include "../scheduler/scheduler_root.h"
+#include "../name_index/name_index.h"
 #include "../scheduler/scheduler_timing.h"
 #include "mqueue.h"
 #include "sos/debug.h"
@@ -95,7 +96,8 @@
 struct message {
   int prio;
   int size;
-  int age;
+  u16 next; // next message in the same priority bucket or in the free list
+  u16 state; // MQ_MESSAGE_FREE, MQ_MESSAGE_QUEUED, MQ_MESSAGE_LOANED, ...
   //! \todo Add a checksum to the message -- generate on send and check on receive
 };
 
@@ -108,15 +110,34 @@ struct message {
 
 #define MQ_NAME_MAX 23
 
+// priorities 0 to 30 each have a bucket -- higher priorities share the last bucket
+#define MQ_PRIO_BUCKETS 32
+#define MQ_MESSAGE_NONE 0xFFFF
+
+// message states (the table is zeroed when it is allocated)
+#define MQ_MESSAGE_FREE 0
+#define MQ_MESSAGE_QUEUED 1
+#define MQ_MESSAGE_LOANED 2   // from mq_loan() until mq_commit() or mq_release()
+#define MQ_MESSAGE_BORROWED 3 // from mq_receive_borrow() until mq_release()
+
+typedef struct {
+  u16 head; // oldest message (next to be received)
+  u16 tail; // newest message
+} mq_bucket_t;
+
 typedef struct {
   size_t max_size;            // maximum message size
   size_t max_msgs;            // maximum number of messages
-  size_t age;                 // The running age -- 0 is the oldest message
+  size_t count;               // number of messages in the buckets
   int mode;                   // not currently implemented
   char name[MQ_NAME_MAX + 1]; // The name of the queue
   struct message *msg_table;  // a pointer to the message table
   u32 status; // how many tasks are accessing the message queue, other flags
   int pid;
+  u32 bucket_mask; // bit n is set if bucket n has messages
+  u16 free_head;   // first unused message in msg_table
+  u16 resd;
+  mq_bucket_t bucket[MQ_PRIO_BUCKETS];
   pthread_mutex_t mutex;
   pthread_cond_t send_cond;
   pthread_cond_t recv_cond;
@@ -125,22 +146,34 @@ typedef struct {
 typedef struct {
   mq_t mq;
   void *next;
+  name_index_node_t name_node;
 } mq_list_t;
 
+#define MQ_NAME_INDEX_COUNT 8
+
 static mq_list_t *mq_first = NULL;
+static name_index_node_t *mq_name_bucket[MQ_NAME_INDEX_COUNT];
+static name_index_t mq_name_index = {mq_name_bucket, MQ_NAME_INDEX_COUNT};
 
 static int mq_entry_size(const mq_t *mq) { return sizeof(struct message) + mq->max_size; }
 
-static struct message *mq_next_message(const struct message *msg, int entry_size) {
-  const u8 *ptr;
-  ptr = ((const u8*)msg) + entry_size;
-  return (struct message *)ptr;
+static struct message *mq_message(const mq_t *mq, u16 index) {
+  u8 *ptr = (u8 *)mq->msg_table;
+  return (struct message *)(ptr + index * mq_entry_size(mq));
+}
+
+static int mq_bucket_index(int prio) {
+  if (prio < 0) {
+    return 0;
+  }
+  return prio < MQ_PRIO_BUCKETS - 1 ? prio : MQ_PRIO_BUCKETS - 1;
 }
 
 static mq_t *mq_find_named(const char *name) {
-  mq_list_t *entry;
   int pid = task_get_pid(task_get_current());
-  for (entry = mq_first; entry != 0; entry = entry->next) {
+  for (name_index_node_t *node = name_index_first(&mq_name_index, name, MQ_NAME_MAX);
+       node != NULL; node = node->next) {
+    mq_list_t *entry = NAME_INDEX_CONTAINER(node, mq_list_t, name_node);
     if (entry->mq.msg_table != 0) {
       if (strncmp(entry->mq.name, name, sizeof(entry->mq.name) - 1) == 0) {
         const int is_user = (entry->mq.status & MQ_STATUS_USER_MASK) != 0;
@@ -153,20 +186,7 @@ static mq_t *mq_find_named(const char *name) {
   return NULL;
 }
 
-static ssize_t mq_cur_msgs(const mq_t *mq) {
-  ssize_t count = 0;
-
-  struct message *imsg = mq->msg_table;
-  int entry_size = mq_entry_size(mq);
-
-  for (size_t i = 0; i < mq->max_msgs; i++) {
-    if (imsg->size != 0) {
-      count++;
-    }
-    imsg = mq_next_message(imsg, entry_size);
-  }
-  return count;
-}
+static ssize_t mq_cur_msgs(const mq_t *mq) { return mq->count; }
 
 static void *mq_message_data(struct message *msg) {
   void *ptr = msg;
@@ -181,6 +201,8 @@ static mq_t *mq_find_free() {
   for (entry = mq_first; entry != 0; entry = entry->next) {
     last_entry = entry;
     if (entry->mq.msg_table == 0) {
+      // the entry is indexed again when it is named
+      name_index_remove(&mq_name_index, &entry->name_node, entry->mq.name, MQ_NAME_MAX);
       return &entry->mq;
     }
   }
@@ -197,57 +219,111 @@ static mq_t *mq_find_free() {
     last_entry->next = new_entry;
   }
   new_entry->next = 0;
+  new_entry->name_node.next = NULL;
   return &new_entry->mq;
 }
 
+static void mq_free_msg(mq_t *mq, u16 index);
+
 static void mq_init_table(mq_t *mq) {
-  struct message *imsg = mq->msg_table;
-  const int entry_size = mq_entry_size(mq);
-  for (size_t i = 0; i < mq->max_msgs; i++) {
-    imsg->size = 0;
-    imsg = mq_next_message(imsg, entry_size);
-  }
-}
-
-static struct message *mq_find_oldest_highest(const mq_t *mq) {
-  struct message *msg;
-  int max_prio = 0;
-  int max_age = INT_MAX;
-  struct message *imsg = mq->msg_table;
-  int entry_size = mq_entry_size(mq);
-
-  msg = 0;
-  // find the oldest, highest priority message from the queue
-  for (size_t i = 0; i < mq->max_msgs; i++) {
-    if (imsg->size != 0) {
-      if (imsg->prio > max_prio) {
-        max_prio = imsg->prio;
-        max_age = imsg->age;
-        msg = imsg;
-      } else if (imsg->prio == max_prio) {
-        if ((imsg->age < max_age)) {
-          max_prio = imsg->prio;
-          max_age = imsg->age;
-          msg = imsg;
-        }
-      }
+  // messages that are loaned or borrowed stay with their owners
+  mq->free_head = MQ_MESSAGE_NONE;
+  for (int i = mq->max_msgs - 1; i >= 0; i--) {
+    const u16 state = mq_message(mq, i)->state;
+    if ((state != MQ_MESSAGE_LOANED) && (state != MQ_MESSAGE_BORROWED)) {
+      mq_free_msg(mq, i);
     }
-    imsg = mq_next_message(imsg, entry_size);
   }
-  return msg;
+
+  for (int i = 0; i < MQ_PRIO_BUCKETS; i++) {
+    mq->bucket[i].head = MQ_MESSAGE_NONE;
+    mq->bucket[i].tail = MQ_MESSAGE_NONE;
+  }
+  mq->bucket_mask = 0;
+  mq->count = 0;
 }
 
-static struct message *mq_find_free_msg(const mq_t *mq) {
-  struct message *imsg = mq->msg_table;
-  int entry_size = mq_entry_size(mq);
-  for (size_t i = 0; i < mq->max_msgs; i++) {
-    if (imsg->size == 0) {
-      return imsg;
-    }
-    imsg = mq_next_message(imsg, entry_size);
+// returns the highest priority bucket with messages or -1 if the queue is empty
+static int mq_highest_bucket(const mq_t *mq) {
+  if (mq->bucket_mask == 0) {
+    return -1;
   }
+  return 31 - __builtin_clz(mq->bucket_mask);
+}
 
-  return 0;
+// the oldest, highest priority message is the head of the highest bucket
+static u16 mq_find_oldest_highest(const mq_t *mq) {
+  const int bucket = mq_highest_bucket(mq);
+  if (bucket < 0) {
+    return MQ_MESSAGE_NONE;
+  }
+  return mq->bucket[bucket].head;
+}
+
+static void mq_remove_oldest_highest(mq_t *mq) {
+  const int bucket = mq_highest_bucket(mq);
+  mq_bucket_t *b = mq->bucket + bucket;
+  const u16 index = b->head;
+  b->head = mq_message(mq, index)->next;
+  if (b->head == MQ_MESSAGE_NONE) {
+    b->tail = MQ_MESSAGE_NONE;
+    mq->bucket_mask &= ~(1U << bucket);
+  }
+  mq->count--;
+}
+
+static void mq_insert_msg(mq_t *mq, u16 index) {
+  struct message *msg = mq_message(mq, index);
+  const int bucket = mq_bucket_index(msg->prio);
+  mq_bucket_t *b = mq->bucket + bucket;
+
+  msg->next = MQ_MESSAGE_NONE;
+  msg->state = MQ_MESSAGE_QUEUED;
+  mq->count++;
+
+  if (b->head == MQ_MESSAGE_NONE) {
+    b->head = index;
+    b->tail = index;
+    mq->bucket_mask |= (1U << bucket);
+    return;
+  }
+
+  if (mq_message(mq, b->tail)->prio >= msg->prio) {
+    // FIFO within a priority
+    mq_message(mq, b->tail)->next = index;
+    b->tail = index;
+    return;
+  }
+
+  // only the last bucket holds mixed priorities -- keep it sorted
+  u16 previous = MQ_MESSAGE_NONE;
+  u16 current = b->head;
+  while (mq_message(mq, current)->prio >= msg->prio) {
+    previous = current;
+    current = mq_message(mq, current)->next;
+  }
+  msg->next = current;
+  if (previous == MQ_MESSAGE_NONE) {
+    b->head = index;
+  } else {
+    mq_message(mq, previous)->next = index;
+  }
+}
+
+static u16 mq_find_free_msg(mq_t *mq) {
+  const u16 index = mq->free_head;
+  if (index != MQ_MESSAGE_NONE) {
+    mq->free_head = mq_message(mq, index)->next;
+  }
+  return index;
+}
+
+static void mq_free_msg(mq_t *mq, u16 index) {
+  struct message *msg = mq_message(mq, index);
+  msg->size = 0;
+  msg->state = MQ_MESSAGE_FREE;
+  msg->next = mq->free_head;
+  mq->free_head = index;
 }
 
 static int mq_init_mutex(mq_t *mq) {
@@ -293,6 +369,65 @@ static mq_t *mq_get_ptr(mqd_t des) {
   return 0;
 }
 
+// called with mq->mutex locked -- returns MQ_MESSAGE_NONE with errno set on failure
+static u16 mq_wait_free_msg(mq_t *mq, const struct timespec *abs_timeout) {
+  for (;;) {
+    u16 index = mq_find_free_msg(mq);
+
+    if ((index == MQ_MESSAGE_NONE) && ((mq->status & MQ_STATUS_LOOP_MASK) != 0)) {
+      // if mq is full, discard the oldest message
+      index = mq_find_oldest_highest(mq);
+      if (index != MQ_MESSAGE_NONE) {
+        mq_remove_oldest_highest(mq);
+      }
+    }
+
+    if (index != MQ_MESSAGE_NONE) {
+      return index;
+    }
+
+    if (mq->status & MQ_STATUS_NONBLOCK_MASK) {
+      // Non-blocking mode:  return an error
+      errno = EAGAIN;
+      return MQ_MESSAGE_NONE;
+    }
+
+    if (pthread_cond_timedwait(&mq->recv_cond, &mq->mutex, abs_timeout) < 0) {
+      return MQ_MESSAGE_NONE;
+    }
+  }
+}
+
+// called with mq->mutex locked -- the message is left in the queue
+static u16 mq_wait_oldest_highest(mq_t *mq, const struct timespec *abs_timeout) {
+  for (;;) {
+    const u16 index = mq_find_oldest_highest(mq);
+    if (index != MQ_MESSAGE_NONE) {
+      return index;
+    }
+
+    if (mq->status & MQ_STATUS_NONBLOCK_MASK) {
+      errno = EAGAIN;
+      return MQ_MESSAGE_NONE;
+    }
+
+    // wait for a message to be sent
+    if (pthread_cond_timedwait(&mq->send_cond, &mq->mutex, abs_timeout) < 0) {
+      return MQ_MESSAGE_NONE;
+    }
+  }
+}
+
+// converts a pointer from mq_loan() or mq_receive_borrow() to a message index
+static u16 mq_message_index(const mq_t *mq, const void *msg_ptr) {
+  const int entry_size = mq_entry_size(mq);
+  const int offset = (const u8 *)msg_ptr - (const u8 *)mq_message_data(mq->msg_table);
+  if ((offset < 0) || (offset % entry_size) || ((size_t)(offset / entry_size) >= mq->max_msgs)) {
+    return MQ_MESSAGE_NONE;
+  }
+  return offset / entry_size;
+}
+
 typedef struct {
   uint32_t signature;
   uint32_t not_signature;
@@ -402,7 +537,7 @@ int mq_setattr(mqd_t mqdes, const struct mq_attr *mqstat, struct mq_attr *omqsta
  * - ENOMEM:  not enough memory for the queue
  * - EACCES:  permission to create \a name queue is denied
  * - EINVAL: O_CREAT is set and \a attr is not null but \a mq_maxmsg or \a mq_msgsize is
- * less than or equal to zero
+ * less than or equal to zero or \a mq_maxmsg is 65535 or more
  *
  *
  */
@@ -463,7 +598,9 @@ mqd_t mq_open(
     va_end(ap);
 
     // check for valid message attributes
-    if ((attr->mq_maxmsg <= 0) || (attr->mq_msgsize <= 0)) {
+    if (
+      (attr->mq_maxmsg <= 0) || (attr->mq_maxmsg >= MQ_MESSAGE_NONE)
+      || (attr->mq_msgsize <= 0)) {
       errno = EINVAL;
       return -1;
     }
@@ -491,7 +628,6 @@ mqd_t mq_open(
       // aligned
       new_mq->max_size = attr->mq_msgsize;
     }
-    new_mq->age = 0;
 
     const int is_user = strncmp(name, "user", 4) == 0;
 
@@ -507,6 +643,8 @@ mqd_t mq_open(
 
     mq_init_table(new_mq);
     strncpy(new_mq->name, name, sizeof(new_mq->name) - 1);
+    name_index_insert(
+      &mq_name_index, &((mq_list_t *)new_mq)->name_node, new_mq->name, MQ_NAME_MAX);
     break;
 
   case 1:
@@ -610,7 +748,9 @@ void mq_discard(mqd_t mqdes) {
 void mq_flush(mqd_t mqdes) {
   mq_t *mq = mq_get_ptr(mqdes);
   if (mq != NULL) {
+    pthread_mutex_lock(&mq->mutex);
     mq_init_table(mq);
+    pthread_mutex_unlock(&mq->mutex);
   }
 }
 
@@ -672,8 +812,8 @@ ssize_t mq_timedreceive(
   unsigned *msg_prio /*! see \ref mq_receive() */,
   const struct timespec *abs_timeout /*! the absolute timeout value */) {
 
-  struct message *new_msg;
   int size;
+  u16 index;
 
   mq_t *mq = mq_get_ptr(mqdes);
   if (mq == 0) {
@@ -682,45 +822,30 @@ ssize_t mq_timedreceive(
 
   pthread_mutex_lock(&mq->mutex);
 
-  do {
-
-    size = 0;
-    new_msg = mq_find_oldest_highest(mq);
-    if (new_msg != NULL) {
-      // calculate the pointer to the entry
-      // Mark message as retrieved
-      if (msg_len < (size_t)new_msg->size) {
-        // The target buffer is too small to hold the entire message
-        errno = EMSGSIZE;
-        size = -1;
-      } else {
-        // copy the message data
-        memcpy(msg_ptr, mq_message_data(new_msg), new_msg->size);
-        if (msg_prio != NULL) {
-          *(msg_prio) = new_msg->prio;
-        }
-
-        // Remove the message from the queue
-        size = new_msg->size;
-        new_msg->size = 0;
-      }
+  size = -1;
+  index = mq_wait_oldest_highest(mq, abs_timeout);
+  if (index != MQ_MESSAGE_NONE) {
+    struct message *new_msg = mq_message(mq, index);
+    if (msg_len < (size_t)new_msg->size) {
+      // The target buffer is too small to hold the entire message
+      errno = EMSGSIZE;
     } else {
-      if (mq->status & MQ_STATUS_NONBLOCK_MASK) {
-        errno = EAGAIN;
-        size = -1;
-      } else {
-        // wait for a message to be sent
-        if (pthread_cond_timedwait(&mq->send_cond, &mq->mutex, abs_timeout) < 0) {
-          size = -1;
-        }
+      // copy the message data
+      memcpy(msg_ptr, mq_message_data(new_msg), new_msg->size);
+      if (msg_prio != NULL) {
+        *(msg_prio) = new_msg->prio;
       }
-    }
 
-  } while (size == 0); // wait for either a successful receive or an error
+      // Remove the message from the queue
+      size = new_msg->size;
+      mq_remove_oldest_highest(mq);
+      mq_free_msg(mq, index);
+    }
+  }
 
   pthread_mutex_unlock(&mq->mutex);
 
-  if (size > 0) {
+  if (size >= 0) {
     // send a signal that a message
     // to indicate there is space in the queue
     pthread_cond_signal(&mq->recv_cond);
@@ -793,43 +918,22 @@ int mq_timedsend(
     return -1;
   }
 
-  int size = 0;
+  int size = -1;
   pthread_mutex_lock(&mq->mutex);
 
-  do {
-    struct message *new_msg = mq_find_free_msg(mq);
-
-    if (new_msg != NULL) {
-      size = msg_len;
-    } else if ((mq->status & MQ_STATUS_LOOP_MASK) != 0) {
-      // if mq is full, discard the oldest message
-      new_msg = mq_find_oldest_highest(mq);
-      size = msg_len;
-    }
-
-    if (size > 0) {
-      memcpy(mq_message_data(new_msg), msg_ptr, msg_len);
-      new_msg->size = msg_len;
-      new_msg->age = mq->age++;
-      new_msg->prio = msg_prio;
-    } else {
-      if (mq->status & MQ_STATUS_NONBLOCK_MASK) {
-        // Non-blocking mode:  return an error
-        errno = EAGAIN;
-        size = -1;
-      } else {
-        if (pthread_cond_timedwait(&mq->recv_cond, &mq->mutex, abs_timeout) < 0) {
-          size = -1;
-        }
-      }
-    }
-
-    // loop until a message is ready
-  } while (size == 0);
+  const u16 index = mq_wait_free_msg(mq, abs_timeout);
+  if (index != MQ_MESSAGE_NONE) {
+    struct message *new_msg = mq_message(mq, index);
+    memcpy(mq_message_data(new_msg), msg_ptr, msg_len);
+    new_msg->size = msg_len;
+    new_msg->prio = msg_prio;
+    mq_insert_msg(mq, index);
+    size = msg_len;
+  }
 
   pthread_mutex_unlock(&mq->mutex);
 
-  if (size > 0) {
+  if (size >= 0) {
     // signal that there is now a message
     // in the queue
     pthread_cond_signal(&mq->send_cond);
@@ -852,4 +956,178 @@ int mq_trysend(mqd_t mqdes, const char *msg_ptr, size_t msg_len, unsigned msg_pr
   return mq_timedsend(mqdes, msg_ptr, msg_len, msg_prio, &abs_timeout);
 }
 
+/*! \details This function loans an unused message from the queue to the caller
+ * so the message can be written in place rather than copied by mq_send(). The
+ * message is not visible to receivers until it is passed to mq_commit(). A
+ * loaned message that will not be sent is returned with mq_release().
+ *
+ * If no message is free, the thread blocks (like mq_timedsend()) unless O_NONBLOCK
+ * is set or \a abs_timeout expires. If the queue was opened with MQ_FLAGS_LOOP, the
+ * oldest message is discarded to make room.
+ *
+ * \return A pointer to \a mq_msgsize bytes of message data or NULL with errno (see
+ * \ref errno) set to:
+ * - EAGAIN:  no room on the queue and O_NONBLOCK is set in the descriptor flags
+ * - ETIMEDOUT:  \a abs_timeout was exceeded by \a CLOCK_REALTIME
+ * - EACCES:  the queue is not writable
+ * - EBADF: \a mqdes is not a valid message queue descriptor
+ *
+ */
+void *mq_loan(mqd_t mqdes, const struct timespec *abs_timeout) {
+  mq_t *mq = mq_get_ptr(mqdes);
+  if (mq == NULL) {
+    return NULL;
+  }
+
+  if ((mq->status & MQ_STATUS_RDWR_MASK) == 0) {
+    errno = EACCES;
+    return NULL;
+  }
+
+  pthread_mutex_lock(&mq->mutex);
+  const u16 index = mq_wait_free_msg(mq, abs_timeout);
+  if (index != MQ_MESSAGE_NONE) {
+    mq_message(mq, index)->state = MQ_MESSAGE_LOANED;
+  }
+  pthread_mutex_unlock(&mq->mutex);
+
+  if (index == MQ_MESSAGE_NONE) {
+    return NULL;
+  }
+
+  return mq_message_data(mq_message(mq, index));
+}
+
+/*! \details This function queues a message that was loaned with mq_loan(). The
+ * data is not copied. Waiting receivers are notified the same as mq_send().
+ *
+ * \return The message length or -1 with errno (see \ref errno) set to:
+ * - EMSGSIZE:  \a msg_len is greater than \a mq_msgsize
+ * - EINVAL:  \a msg_ptr is not on loan from \a mqdes (or was already committed or
+ *   released)
+ * - EACCES:  the queue is not writable
+ * - EBADF: \a mqdes is not a valid message queue descriptor
+ *
+ */
+int mq_commit(mqd_t mqdes, void *msg_ptr, size_t msg_len, unsigned msg_prio) {
+  mq_t *mq = mq_get_ptr(mqdes);
+  if (mq == NULL) {
+    return -1;
+  }
+
+  if ((mq->status & MQ_STATUS_RDWR_MASK) == 0) {
+    errno = EACCES;
+    return -1;
+  }
+
+  if (mq->max_size < msg_len) {
+    errno = EMSGSIZE;
+    return -1;
+  }
+
+  const u16 index = mq_message_index(mq, msg_ptr);
+  if (index == MQ_MESSAGE_NONE) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  pthread_mutex_lock(&mq->mutex);
+  struct message *new_msg = mq_message(mq, index);
+  if (new_msg->state != MQ_MESSAGE_LOANED) {
+    pthread_mutex_unlock(&mq->mutex);
+    errno = EINVAL;
+    return -1;
+  }
+  new_msg->size = msg_len;
+  new_msg->prio = msg_prio;
+  mq_insert_msg(mq, index);
+  pthread_mutex_unlock(&mq->mutex);
+
+  // signal that there is now a message in the queue
+  pthread_cond_signal(&mq->send_cond);
+  return msg_len;
+}
+
+/*! \details This function removes the oldest, highest priority message from the
+ * queue and gives the caller direct access to the message data. The message stays
+ * in the queue's table (and is not available to senders) until the caller
+ * passes the pointer to mq_release().
+ *
+ * Blocking behavior is the same as mq_timedreceive().
+ *
+ * \return A pointer to the message data or NULL with errno (see \ref errno) set to:
+ * - EAGAIN:  no message on the queue and O_NONBLOCK is set in the descriptor flags
+ * - ETIMEDOUT:  \a abs_timeout was exceeded by \a CLOCK_REALTIME
+ * - EBADF: \a mqdes is not a valid message queue descriptor
+ *
+ */
+const void *mq_receive_borrow(
+  mqd_t mqdes,
+  size_t *msg_len,
+  unsigned *msg_prio,
+  const struct timespec *abs_timeout) {
+  mq_t *mq = mq_get_ptr(mqdes);
+  if (mq == NULL) {
+    return NULL;
+  }
+
+  pthread_mutex_lock(&mq->mutex);
+  const u16 index = mq_wait_oldest_highest(mq, abs_timeout);
+  if (index != MQ_MESSAGE_NONE) {
+    mq_remove_oldest_highest(mq);
+    mq_message(mq, index)->state = MQ_MESSAGE_BORROWED;
+  }
+  pthread_mutex_unlock(&mq->mutex);
+
+  if (index == MQ_MESSAGE_NONE) {
+    return NULL;
+  }
+
+  struct message *new_msg = mq_message(mq, index);
+  if (msg_len != NULL) {
+    *msg_len = new_msg->size;
+  }
+  if (msg_prio != NULL) {
+    *msg_prio = new_msg->prio;
+  }
+  return mq_message_data(new_msg);
+}
+
+/*! \details This function returns a message from mq_receive_borrow() (or an
+ * uncommitted message from mq_loan()) to the queue's free messages and
+ * notifies waiting senders.
+ *
+ * \return Zero on success or -1 with errno (see \ref errno) set to:
+ * - EINVAL:  \a msg_ptr is not borrowed or on loan from \a mqdes (or was already
+ *   released)
+ * - EBADF: \a mqdes is not a valid message queue descriptor
+ *
+ */
+int mq_release(mqd_t mqdes, const void *msg_ptr) {
+  mq_t *mq = mq_get_ptr(mqdes);
+  if (mq == NULL) {
+    return -1;
+  }
+
+  const u16 index = mq_message_index(mq, msg_ptr);
+  if (index == MQ_MESSAGE_NONE) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  pthread_mutex_lock(&mq->mutex);
+  const u16 state = mq_message(mq, index)->state;
+  if ((state != MQ_MESSAGE_LOANED) && (state != MQ_MESSAGE_BORROWED)) {
+    pthread_mutex_unlock(&mq->mutex);
+    errno = EINVAL;
+    return -1;
+  }
+  mq_free_msg(mq, index);
+  pthread_mutex_unlock(&mq->mutex);
+
+  // there is space in the queue
+  pthread_cond_signal(&mq->recv_cond);
+  return 0;
+}
+
 /*! @} */
@@ -0,0 +1,62 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include "name_index.h"
+
+// FNV-1a over at most max characters (the same characters strncmp() compares)
+u32 name_index_hash(const char *name, size_t max) {
+  u32 hash = 2166136261UL;
+  for (size_t i = 0; (i < max) && (name[i] != 0); i++) {
+    hash ^= (u8)name[i];
+    hash *= 16777619UL;
+  }
+  return hash;
+}
+
+// power of 2 with about two entries per bucket
+u16 name_index_bucket_count(int entry_count) {
+  u16 result = 4;
+  while ((result < 256) && (result * 2 < entry_count)) {
+    result <<= 1;
+  }
+  return result;
+}
+
+void name_index_init(name_index_t *index, name_index_node_t **bucket, u16 bucket_count) {
+  index->bucket = bucket;
+  index->bucket_count = bucket_count;
+  for (u16 i = 0; i < bucket_count; i++) {
+    bucket[i] = NULL;
+  }
+}
+
+void name_index_insert(
+  name_index_t *index,
+  name_index_node_t *node,
+  const char *name,
+  size_t max) {
+  name_index_node_t **next =
+    index->bucket + (name_index_hash(name, max) & (index->bucket_count - 1));
+  // append so bucket order matches table order
+  while (*next != NULL) {
+    next = &((*next)->next);
+  }
+  node->next = NULL;
+  *next = node;
+}
+
+void name_index_remove(
+  name_index_t *index,
+  name_index_node_t *node,
+  const char *name,
+  size_t max) {
+  name_index_node_t **next =
+    index->bucket + (name_index_hash(name, max) & (index->bucket_count - 1));
+  while (*next != NULL) {
+    if (*next == node) {
+      *next = node->next;
+      node->next = NULL;
+      return;
+    }
+    next = &((*next)->next);
+  }
+}
@@ -0,0 +1,59 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef NAME_INDEX_NAME_INDEX_H_
+#define NAME_INDEX_NAME_INDEX_H_
+
+#include <sdk/types.h>
+#include <stddef.h>
+
+/*
+ * Hashed index for looking up kernel objects by name (devices, mount
+ * points, message queues, semaphores).
+ *
+ * Nodes are intrusive: dynamic objects embed a name_index_node_t and
+ * static tables (which live in flash) use a node array allocated when
+ * the index is built. Within a bucket, nodes are kept in insertion order
+ * so the first match is the same one a linear scan of the table would find.
+ *
+ * The index only narrows the search. Callers still compare the names of
+ * the nodes in the bucket.
+ */
+
+typedef struct name_index_node {
+  struct name_index_node *next;
+} name_index_node_t;
+
+typedef struct {
+  name_index_node_t **bucket;
+  u16 bucket_count; // must be a power of 2
+} name_index_t;
+
+#define NAME_INDEX_CONTAINER(node, type, member)                                         \
+  ((type *)((u8 *)(node) - offsetof(type, member)))
+
+u32 name_index_hash(const char *name, size_t max);
+u16 name_index_bucket_count(int entry_count);
+
+void name_index_init(name_index_t *index, name_index_node_t **bucket, u16 bucket_count);
+void name_index_insert(
+  name_index_t *index,
+  name_index_node_t *node,
+  const char *name,
+  size_t max);
+void name_index_remove(
+  name_index_t *index,
+  name_index_node_t *node,
+  const char *name,
+  size_t max);
+
+static inline int name_index_is_valid(const name_index_t *index) {
+  return index->bucket != NULL;
+}
+
+// first node in the bucket that \a name hashes to (NULL if empty)
+static inline name_index_node_t *
+name_index_first(const name_index_t *index, const char *name, size_t max) {
+  return index->bucket[name_index_hash(name, max) & (index->bucket_count - 1)];
+}
+
+#endif /* NAME_INDEX_NAME_INDEX_H_ */
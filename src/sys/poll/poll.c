@@ -0,0 +1,346 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+/*! \addtogroup poll
+ *
+ * @{
+ *
+ */
+
+/*! \file */
+
+#include <errno.h>
+#include <string.h>
+
+#include "../scheduler/scheduler_root.h"
+#include "../scheduler/scheduler_timing.h"
+#include "../unistd/unistd_local.h"
+#include "cortexm/cortexm.h"
+#include "poll_local.h"
+#include "sos/fs/devfs.h"
+
+/*! \cond */
+typedef int (*poll_check_t)(void *context);
+
+typedef struct {
+  u32 count;
+  struct mcu_timeval abs_timeout;
+  u8 is_blocked;
+  u8 is_timeout;
+} poll_wait_t;
+
+typedef struct {
+  struct pollfd *fds;
+  nfds_t nfds;
+} poll_list_t;
+
+typedef struct {
+  int maxfdp1;
+  fd_set read;
+  fd_set write;
+  fd_set except;
+  fd_set *readset;
+  fd_set *writeset;
+  fd_set *exceptset;
+} poll_select_t;
+
+// incremented each time a device might have become ready -- also the block object
+static volatile u32 poll_count MCU_SYS_MEM;
+
+static void svcall_get_count(void *args) MCU_ROOT_EXEC_CODE;
+static void svcall_wait(void *args) MCU_ROOT_EXEC_CODE;
+static int wait_ready(poll_check_t check, void *context, int timeout);
+static int check_fildes(int fildes, int events);
+static int check_list(void *context);
+static int check_select(void *context);
+static int is_set(const fd_set *set, int fildes);
+static void set_bit(fd_set *set, int fildes);
+/*! \endcond */
+
+/*! \details This function waits until one of the file descriptors in \a fds
+ * is ready for the requested \a events (POLLIN, POLLOUT, etc) or until
+ * \a timeout milliseconds have passed.
+ *
+ * Devices report readiness using I_DEVFS_POLL. Descriptors on devices (or
+ * filesystems) that don't support I_DEVFS_POLL are always ready. Sockets are
+ * not supported (POLLNVAL) -- use select() with the socket API.
+ *
+ * \return The number of descriptors with non-zero \a revents, zero if
+ * \a timeout expired, or -1 with errno (see \ref errno) set to:
+ * - EINTR: the thread received a signal before any descriptors were ready
+ * - EINVAL: \a fds is NULL and \a nfds is not zero
+ */
+int poll(
+  struct pollfd fds[] /*! The descriptors to check */,
+  nfds_t nfds /*! The number of entries in \a fds */,
+  int timeout /*! Milliseconds to wait (-1 to wait forever, 0 to return immediately) */) {
+  poll_list_t list;
+  scheduler_check_cancellation();
+
+  if ((fds == NULL) && (nfds != 0)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  list.fds = fds;
+  list.nfds = nfds;
+  return wait_ready(check_list, &list, timeout);
+}
+
+/*! \cond */
+int poll_select(
+  int maxfdp1,
+  fd_set *readset,
+  fd_set *writeset,
+  fd_set *exceptset,
+  struct timeval *timeout) {
+  poll_select_t args;
+  int timeout_ms = -1;
+
+  if ((maxfdp1 < 0) || (maxfdp1 > (int)(sizeof(fd_set) * 8))) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // the sets are written with the result so the request is saved
+  memset(&args, 0, sizeof(args));
+  args.maxfdp1 = maxfdp1;
+  if (readset != NULL) {
+    args.read = *readset;
+  }
+  if (writeset != NULL) {
+    args.write = *writeset;
+  }
+  if (exceptset != NULL) {
+    args.except = *exceptset;
+  }
+  args.readset = readset;
+  args.writeset = writeset;
+  args.exceptset = exceptset;
+
+  if (timeout != NULL) {
+    if ((timeout->tv_sec < 0) || (timeout->tv_usec < 0)) {
+      errno = EINVAL;
+      return -1;
+    }
+    timeout_ms = timeout->tv_sec * 1000 + (timeout->tv_usec + 999) / 1000;
+  }
+
+  const int result = wait_ready(check_select, &args, timeout_ms);
+  if (result == 0) {
+    // nothing is ready
+    if (readset != NULL) {
+      memset(readset, 0, sizeof(fd_set));
+    }
+    if (writeset != NULL) {
+      memset(writeset, 0, sizeof(fd_set));
+    }
+    if (exceptset != NULL) {
+      memset(exceptset, 0, sizeof(fd_set));
+    }
+  }
+  return result;
+}
+
+void devfs_poll_notify() {
+  const u32 primask = __get_PRIMASK();
+  cortexm_disable_interrupts();
+  poll_count++;
+  const int priority =
+    scheduler_root_unblock_all((void *)&poll_count, SCHEDULER_UNBLOCK_POLL);
+  scheduler_root_update_on_wake(-1, priority);
+  __set_PRIMASK(primask);
+}
+
+int wait_ready(poll_check_t check, void *context, int timeout) {
+  poll_wait_t args;
+
+  if (timeout < 0) {
+    scheduler_timing_convert_timespec(&args.abs_timeout, NULL);
+  } else {
+    struct timespec interval;
+    struct mcu_timeval now;
+    struct mcu_timeval mcu_interval;
+    interval.tv_sec = timeout / 1000;
+    interval.tv_nsec = (timeout % 1000) * 1000000UL;
+    scheduler_timing_convert_timespec(&mcu_interval, &interval);
+    cortexm_svcall(scheduler_timing_svcall_get_realtime, &now);
+    args.abs_timeout = scheduler_timing_add_mcu_timeval(&now, &mcu_interval);
+  }
+
+  while (1) {
+    // anything that becomes ready after the count is read changes the count
+    // so svcall_wait() won't block
+    cortexm_svcall(svcall_get_count, &args.count);
+    const int result = check(context);
+    if ((result != 0) || (timeout == 0)) {
+      return result;
+    }
+
+    cortexm_svcall(svcall_wait, &args);
+    if (args.is_timeout) {
+      return 0;
+    }
+
+    if (args.is_blocked) {
+      const int unblock_type = scheduler_unblock_type(task_get_current());
+      if (unblock_type == SCHEDULER_UNBLOCK_SIGNAL) {
+        errno = EINTR;
+        return -1;
+      }
+
+      if (unblock_type == SCHEDULER_UNBLOCK_SLEEP) {
+        return check(context);
+      }
+    }
+  }
+}
+
+void svcall_get_count(void *args) {
+  CORTEXM_SVCALL_ENTER();
+  u32 *count = args;
+  *count = poll_count;
+}
+
+void svcall_wait(void *args) {
+  CORTEXM_SVCALL_ENTER();
+  poll_wait_t *p = args;
+  p->is_blocked = 0;
+  p->is_timeout = 0;
+
+  cortexm_disable_interrupts();
+  if (p->count == poll_count) {
+    if (p->abs_timeout.tv_sec != SCHEDULER_TIMEVAL_SEC_INVALID) {
+      struct mcu_timeval now;
+      scheduler_timing_root_get_realtime(&now);
+      if (
+        (now.tv_sec > p->abs_timeout.tv_sec)
+        || ((now.tv_sec == p->abs_timeout.tv_sec)
+            && (now.tv_usec >= p->abs_timeout.tv_usec))) {
+        p->is_timeout = 1;
+      }
+    }
+
+    if (p->is_timeout == 0) {
+      p->is_blocked = 1;
+      scheduler_timing_root_timedblock((void *)&poll_count, &p->abs_timeout);
+    }
+  }
+  cortexm_enable_interrupts();
+}
+
+int check_fildes(int fildes, int events) {
+  if (FILDES_IS_SOCKET(fildes)) {
+    return POLLNVAL;
+  }
+
+  fildes = u_fildes_is_bad(fildes);
+  if (fildes < 0) {
+    return POLLNVAL;
+  }
+
+  // a device that doesn't answer sets errno -- that isn't an error for poll()
+  const int saved_errno = errno;
+  int o_flags = sysfs_file_ioctl(get_open_file(fildes), I_DEVFS_POLL, NULL);
+  errno = saved_errno;
+  if ((o_flags < 0) || ((o_flags & DEVFS_POLL_FLAG_IS_SUPPORTED) == 0)) {
+    o_flags = DEVFS_POLL_FLAG_IS_READ_READY | DEVFS_POLL_FLAG_IS_WRITE_READY;
+  }
+
+  int revents = 0;
+  if (o_flags & DEVFS_POLL_FLAG_IS_READ_READY) {
+    revents |= events & (POLLIN | POLLRDNORM);
+  }
+  if (o_flags & DEVFS_POLL_FLAG_IS_WRITE_READY) {
+    revents |= events & (POLLOUT | POLLWRNORM);
+  }
+  if (o_flags & DEVFS_POLL_FLAG_IS_ERROR) {
+    revents |= POLLERR;
+  }
+  return revents;
+}
+
+int check_list(void *context) {
+  poll_list_t *list = context;
+  int count = 0;
+  for (nfds_t i = 0; i < list->nfds; i++) {
+    struct pollfd *entry = list->fds + i;
+    entry->revents = 0;
+    if (entry->fd >= 0) {
+      entry->revents = check_fildes(entry->fd, entry->events);
+      if (entry->revents) {
+        count++;
+      }
+    }
+  }
+  return count;
+}
+
+int check_select(void *context) {
+  poll_select_t *p = context;
+  fd_set read;
+  fd_set write;
+  fd_set except;
+  int count = 0;
+
+  memset(&read, 0, sizeof(read));
+  memset(&write, 0, sizeof(write));
+  memset(&except, 0, sizeof(except));
+
+  for (int i = 0; i < p->maxfdp1; i++) {
+    int events = 0;
+    if (is_set(&p->read, i)) {
+      events |= POLLIN;
+    }
+    if (is_set(&p->write, i)) {
+      events |= POLLOUT;
+    }
+    if ((events == 0) && (is_set(&p->except, i) == 0)) {
+      continue;
+    }
+
+    const int revents = check_fildes(i, events);
+    if (revents & POLLNVAL) {
+      errno = EBADF;
+      return -1;
+    }
+    if (revents & POLLIN) {
+      set_bit(&read, i);
+      count++;
+    }
+    if (revents & POLLOUT) {
+      set_bit(&write, i);
+      count++;
+    }
+    if ((revents & POLLERR) && is_set(&p->except, i)) {
+      set_bit(&except, i);
+      count++;
+    }
+  }
+
+  if (count) {
+    if (p->readset != NULL) {
+      *p->readset = read;
+    }
+    if (p->writeset != NULL) {
+      *p->writeset = write;
+    }
+    if (p->exceptset != NULL) {
+      *p->exceptset = except;
+    }
+  }
+  return count;
+}
+
+// fd_set is a little endian bit array for both lwIP and the bootstrap definition
+int is_set(const fd_set *set, int fildes) {
+  const u8 *bits = (const u8 *)set;
+  return (bits[fildes >> 3] & (1 << (fildes & 0x07))) != 0;
+}
+
+void set_bit(fd_set *set, int fildes) {
+  u8 *bits = (u8 *)set;
+  bits[fildes >> 3] |= (1 << (fildes & 0x07));
+}
+/*! \endcond */
+
+/*! @} */
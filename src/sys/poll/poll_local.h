@@ -0,0 +1,19 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef POLL_LOCAL_H_
+#define POLL_LOCAL_H_
+
+#include <sys/time.h>
+
+#include "sys/socket.h"
+// after sys/socket.h in case lwIP already defined struct pollfd
+#include "poll.h"
+
+int poll_select(
+  int maxfdp1,
+  fd_set *readset,
+  fd_set *writeset,
+  fd_set *exceptset,
+  struct timeval *timeout);
+
+#endif /* POLL_LOCAL_H_ */
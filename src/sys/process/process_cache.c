@@ -0,0 +1,124 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <string.h>
+
+#include "cortexm/cortexm.h"
+
+#include "../name_index/name_index.h"
+#include "../sysfs/appfs_local.h"
+#include "process_cache.h"
+
+#if CONFIG_PROCESS_LAUNCH_CACHE_SIZE > 0
+
+// longer paths are not cached ("/app/flash/" plus NAME_MAX fits)
+#define PATH_SIZE 48
+
+typedef struct {
+  u32 hash;
+  char path[PATH_SIZE];
+  process_cache_entry_t entry;
+} cache_slot_t;
+
+typedef struct {
+  const char *path;
+  u32 hash;
+  process_cache_entry_t *entry;
+  int result;
+} cache_lookup_t;
+
+typedef struct {
+  const char *path;
+  u32 hash;
+  const process_cache_entry_t *entry;
+} cache_store_t;
+
+static void svcall_lookup(void *args) MCU_ROOT_EXEC_CODE;
+static void svcall_store(void *args) MCU_ROOT_EXEC_CODE;
+static cache_slot_t *find_slot(const char *path, u32 hash) MCU_ROOT_EXEC_CODE;
+
+static cache_slot_t cache[CONFIG_PROCESS_LAUNCH_CACHE_SIZE] MCU_SYS_MEM;
+static u8 cache_next MCU_SYS_MEM;
+
+/*
+ * Returns 0 and copies the entry for path if it is current. Otherwise returns
+ * -1 with entry->generation set to the generation to pass to
+ * process_cache_store() after the header has been read (so an install or
+ * unlink while the file is being read leaves the new entry stale).
+ */
+int process_cache_lookup(const char *path, process_cache_entry_t *entry) {
+  cache_lookup_t args;
+  args.path = path;
+  args.hash = name_index_hash(path, PATH_SIZE);
+  args.entry = entry;
+  cortexm_svcall(svcall_lookup, &args);
+  return args.result;
+}
+
+void process_cache_store(const char *path, const process_cache_entry_t *entry) {
+  if (strnlen(path, PATH_SIZE) == PATH_SIZE) {
+    return;
+  }
+
+  cache_store_t args;
+  args.path = path;
+  args.hash = name_index_hash(path, PATH_SIZE);
+  args.entry = entry;
+  cortexm_svcall(svcall_store, &args);
+}
+
+cache_slot_t *find_slot(const char *path, u32 hash) {
+  for (int i = 0; i < CONFIG_PROCESS_LAUNCH_CACHE_SIZE; i++) {
+    cache_slot_t *slot = cache + i;
+    if ((slot->hash == hash) && (strncmp(slot->path, path, PATH_SIZE) == 0)) {
+      return slot;
+    }
+  }
+  return NULL;
+}
+
+void svcall_lookup(void *args) {
+  CORTEXM_SVCALL_ENTER();
+  cache_lookup_t *p = args;
+  const cache_slot_t *slot = find_slot(p->path, p->hash);
+  if ((slot != NULL) && (slot->entry.generation == appfs_generation)) {
+    *p->entry = slot->entry;
+    p->result = 0;
+  } else {
+    p->entry->generation = appfs_generation;
+    p->result = -1;
+  }
+}
+
+void svcall_store(void *args) {
+  CORTEXM_SVCALL_ENTER();
+  cache_store_t *p = args;
+  if (p->entry->generation != appfs_generation) {
+    // appfs changed while the header was being read
+    return;
+  }
+
+  cache_slot_t *slot = find_slot(p->path, p->hash);
+  if (slot == NULL) {
+    // replace the oldest entry
+    slot = cache + cache_next;
+    cache_next = (cache_next + 1) % CONFIG_PROCESS_LAUNCH_CACHE_SIZE;
+    slot->hash = p->hash;
+    strncpy(slot->path, p->path, PATH_SIZE);
+  }
+  slot->entry = *p->entry;
+}
+
+#else
+
+int process_cache_lookup(const char *path, process_cache_entry_t *entry) {
+  MCU_UNUSED_ARGUMENT(path);
+  MCU_UNUSED_ARGUMENT(entry);
+  return -1;
+}
+
+void process_cache_store(const char *path, const process_cache_entry_t *entry) {
+  MCU_UNUSED_ARGUMENT(path);
+  MCU_UNUSED_ARGUMENT(entry);
+}
+
+#endif
@@ -0,0 +1,34 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef PROCESS_PROCESS_CACHE_H_
+#define PROCESS_PROCESS_CACHE_H_
+
+#include "config.h"
+
+#include "cortexm/task.h"
+
+/*
+ * Launch cache for process_start().
+ *
+ * Entries are keyed by the application path and hold what process_start()
+ * learns from the appfs_file_t header (after it has been validated) so the
+ * next launch of the same path doesn't open or read the file. Only appfs
+ * files are cached. appfs_generation changes when appfs unlinks or installs
+ * a file which makes every entry stale.
+ */
+
+typedef struct {
+  u32 startup /*! startup function */;
+  u32 ram_start /*! data memory (also the process re-entrancy structure) */;
+  u32 o_flags /*! appfs_exec_t o_flags */;
+  u32 generation /*! appfs_generation when the header was read */;
+  task_memories_t mem /*! code and data memories with the MPU types */;
+  u16 mode;
+  u16 uid;
+  u16 gid;
+} process_cache_entry_t;
+
+int process_cache_lookup(const char *path, process_cache_entry_t *entry);
+void process_cache_store(const char *path, const process_cache_entry_t *entry);
+
+#endif /* PROCESS_PROCESS_CACHE_H_ */
@@ -26,15 +26,19 @@
 #include "sos/debug.h"
 #include "sos/fs/devfs.h"
 
+#include "process_cache.h"
 #include "process_start.h"
+#include "sos/fs/appfs.h"
 #include "sos/fs/sysfs.h"
 #include <errno.h>
 #include <fcntl.h>
+#include <sys/stat.h>
 
 #include "../scheduler/scheduler_local.h"
 #include "../sysfs/appfs_local.h"
 
 static int reent_is_free(struct _reent *reent);
+static int read_header(const char *path, process_cache_entry_t *entry);
 
 #if defined UNIQUE_PROCESS_NAMES
 static uint8_t launch_count = 0;
@@ -42,10 +46,8 @@ static uint8_t launch_count = 0;
 
 int process_start(const char *path_arg, char *const envp[]) {
   MCU_UNUSED_ARGUMENT(envp);
-  int fd;
   int err;
-  appfs_file_t startup;
-  task_memories_t mem;
+  process_cache_entry_t entry;
   char *p;
   char *path;
   char *process_path;
@@ -63,56 +65,24 @@ int process_start(const char *path_arg, char *const envp[]) {
 
   size_t len = strnlen(path_arg, ARG_MAX);
 
-  if (access(path, X_OK) < 0) {
-    sos_debug_log_warning(SOS_DEBUG_SYS, "no exec access:%s", path);
-    return -1;
-  }
-
-  // Open the program
   sos_debug_log_info(SOS_DEBUG_SYS, "process_start:%s", path);
-#if SOS_DEBUG
-  usleep(10 * 1000);
-#endif
-  fd = open(path, O_RDONLY);
-  if (fd < 0) {
-    // The open() call set the errno already
-    return -1;
-  }
-
-  // Read the program header
-  err = read(fd, &startup, sizeof(appfs_file_t));
-  if (err != sizeof(appfs_file_t)) {
-    // The read() function sets the errno already
-    close(fd);
-    sos_debug_log_error(SOS_DEBUG_SYS, "failed to read program header");
-    return -1;
-  }
-
-  // verify the signature
-  if (appfs_util_is_executable(&startup.exec) == 0) {
-    errno = ENOEXEC;
-    sos_debug_log_error(SOS_DEBUG_SYS, "not executable");
+  if (process_cache_lookup(path, &entry) < 0) {
+    if (read_header(path, &entry) < 0) {
+      return -1;
+    }
+  } else if (sysfs_access(entry.mode, entry.uid, entry.gid, X_OK) < 0) {
+    // the header is cached but the caller may not be the same user
+    sos_debug_log_warning(SOS_DEBUG_SYS, "no exec access:%s", path);
     return -1;
   }
 
-  mem.code.address = (void *)startup.exec.code_start;
-  mem.code.size = startup.exec.code_size;
-  mem.code.type = appfs_util_get_code_mpu_type(&startup);
-  mem.data.address = (void *)startup.exec.ram_start;
-  mem.data.size = startup.exec.ram_size;
-  mem.data.type = appfs_util_get_data_mpu_type(&startup);
-
   // check to see if the process is already running
-  if (!reent_is_free((void *)startup.exec.ram_start)) {
+  if (!reent_is_free((void *)entry.ram_start)) {
     errno = ENOTSUP;
-    close(fd);
     sos_debug_log_error(SOS_DEBUG_SYS, "already running");
     return -1;
   }
 
-  // The program is loaded and ready to execute
-  close(fd);
-
   // this gets freed in crt_sys.c by the process that is launched
   process_path = _malloc_r(sos_task_table[0].global_reent, len + 1);
   if (process_path == 0) {
@@ -125,18 +95,16 @@ int process_start(const char *path_arg, char *const envp[]) {
   sos_debug_log_info(SOS_DEBUG_SYS, "process start: execute %s", process_path);
 
   int parent_id = task_get_current();
-  u32 options = startup.exec.o_flags;
-
-  if (options & APPFS_FLAG_IS_ORPHAN) {
+  if (entry.o_flags & APPFS_FLAG_IS_ORPHAN) {
     parent_id = 0;
   }
 
   sos_debug_log_info(
-    SOS_DEBUG_SYS, "process start: code:%p data:%p", (void *)startup.exec.startup,
-    (void *)startup.exec.ram_start);
+    SOS_DEBUG_SYS, "process start: code:%p data:%p", (void *)entry.startup,
+    (void *)entry.ram_start);
 
   err = scheduler_create_process(
-    (void *)startup.exec.startup, process_path, &mem, (void *)startup.exec.ram_start,
+    (void *)entry.startup, process_path, &entry.mem, (void *)entry.ram_start,
     parent_id
   );
 
@@ -148,6 +116,68 @@ int process_start(const char *path_arg, char *const envp[]) {
   return err;
 }
 
+int read_header(const char *path, process_cache_entry_t *entry) {
+  appfs_file_t startup;
+  struct stat st;
+  int fd;
+  int err;
+
+  if (access(path, X_OK) < 0) {
+    sos_debug_log_warning(SOS_DEBUG_SYS, "no exec access:%s", path);
+    return -1;
+  }
+
+  // Open the program
+#if SOS_DEBUG
+  usleep(10 * 1000);
+#endif
+  fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    // The open() call set the errno already
+    return -1;
+  }
+
+  // Read the program header
+  err = read(fd, &startup, sizeof(appfs_file_t));
+  if ((err != sizeof(appfs_file_t)) || (fstat(fd, &st) < 0)) {
+    // The read() function sets the errno already
+    close(fd);
+    sos_debug_log_error(SOS_DEBUG_SYS, "failed to read program header");
+    return -1;
+  }
+
+  // The program is loaded and ready to execute
+  close(fd);
+
+  // verify the signature
+  if (appfs_util_is_executable(&startup.exec) == 0) {
+    errno = ENOEXEC;
+    sos_debug_log_error(SOS_DEBUG_SYS, "not executable");
+    return -1;
+  }
+
+  entry->startup = startup.exec.startup;
+  entry->ram_start = startup.exec.ram_start;
+  entry->o_flags = startup.exec.o_flags;
+  entry->mode = st.st_mode;
+  entry->uid = st.st_uid;
+  entry->gid = st.st_gid;
+  memset(&entry->mem, 0, sizeof(entry->mem));
+  entry->mem.code.address = (void *)startup.exec.code_start;
+  entry->mem.code.size = startup.exec.code_size;
+  entry->mem.code.type = appfs_util_get_code_mpu_type(&startup);
+  entry->mem.data.address = (void *)startup.exec.ram_start;
+  entry->mem.data.size = startup.exec.ram_size;
+  entry->mem.data.type = appfs_util_get_data_mpu_type(&startup);
+
+  // appfs tells the cache when files change
+  const sysfs_t *fs = sysfs_find(path, true);
+  if ((fs != NULL) && (fs->open == appfs_open)) {
+    process_cache_store(path, entry);
+  }
+  return 0;
+}
+
 int reent_is_free(struct _reent *reent) {
   int i;
   for (i = 0; i < task_get_total(); i++) {
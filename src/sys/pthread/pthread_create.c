@@ -142,8 +142,9 @@ void svcall_join_thread(void *args) {
   int id = *p;
 
   if (task_enabled(id)) {
-    sos_sched_table[task_get_current()].block_object =
-      (void *)&sos_sched_table[id]; // block on the thread to be joined
+    scheduler_root_set_block_object(
+      task_get_current(),
+      (void *)&sos_sched_table[id]); // block on the thread to be joined
     // If the thread is waiting to be joined, it needs to be activated
     if (sos_sched_table[id].block_object == (void *)&sos_sched_table[id].block_object) {
       scheduler_root_assert_active(id, SCHEDULER_UNBLOCK_PTHREAD_JOINED);
@@ -37,6 +37,12 @@ static void svcall_mutex_trylock(svcall_mutex_trylock_t *args) MCU_ROOT_EXEC_COD
 
 static void root_mutex_block(svcall_mutex_trylock_t *args);
 static void svcall_mutex_unblocked(svcall_mutex_trylock_t *args) MCU_ROOT_EXEC_CODE;
+
+#if CONFIG_PTHREAD_MUTEX_FAST_PATH
+static int mutex_fast_lock(pthread_mutex_t *mutex, int id);
+static int mutex_fast_unlock(pthread_mutex_t *mutex, int id);
+static void svcall_mutex_wake(void *args) MCU_ROOT_EXEC_CODE;
+#endif
 /*! \endcond */
 
 /*! \details This function locks \a mutex.  If \a mutex cannot be locked immediately,
@@ -142,6 +148,13 @@ int pthread_mutex_unlock(pthread_mutex_t *mutex) {
     return -1;
   }
 
+#if CONFIG_PTHREAD_MUTEX_FAST_PATH
+  if (mutex_fast_unlock(mutex, args.id) == 0) {
+    SOS_DEBUG_EXIT_TIMER_SCOPE_AVERAGE(SOS_DEBUG_PTHREAD, pthread_mutex_unlock, 20);
+    return 0;
+  }
+#endif
+
   args.mutex = mutex; // The Mutex
   cortexm_svcall((cortexm_svcall_t)pthread_mutex_svcall_unlock, &args);
   SOS_DEBUG_EXIT_TIMER_SCOPE_AVERAGE(SOS_DEBUG_PTHREAD, pthread_mutex_unlock, 20);
@@ -320,6 +333,12 @@ int mutex_trylock(
     }
   }
 
+#if CONFIG_PTHREAD_MUTEX_FAST_PATH
+  if (mutex_fast_lock(mutex, id) == 0) {
+    return 0;
+  }
+#endif
+
   // Lock the mutex if it is free
   args.id = id;
   args.mutex = mutex;
@@ -350,10 +369,95 @@ int pthread_mutex_force_unlock(pthread_mutex_t *mutex) {
   return 0;
 }
 
+#if CONFIG_PTHREAD_MUTEX_FAST_PATH
+/*
+ * The fast path takes or releases an uncontended mutex in thread mode
+ * using LDREX/STREX on the owner (pthread) field. Any exception between
+ * the LDREX and STREX (including the SVCall of a thread that is about to
+ * block on the mutex) clears the exclusive monitor so the STREX fails and
+ * the operation is retried or handed to the SVCall path.
+ *
+ * The SVCall path is still used when the priority ceiling must elevate
+ * the caller, when the caller's priority needs to be restored on unlock,
+ * or when another task is waiting for the mutex. The wait queue is walked
+ * outside the exclusive access so the LDREX/STREX window is only a
+ * compare; a task that blocks just before the LDREX is woken after the
+ * release.
+ */
+int mutex_fast_lock(pthread_mutex_t *mutex, int id) {
+  volatile u32 *owner = (volatile u32 *)&mutex->pthread;
+
+  if (mutex->prio_ceiling > task_get_priority(id)) {
+    return -1;
+  }
+
+  do {
+    if (__LDREXW(owner) != (u32)-1) {
+      __CLREX();
+      return -1;
+    }
+  } while (__STREXW(id, owner) != 0);
+  __DMB();
+
+  // the owner field is what other threads compare against
+  mutex->pid = task_get_pid(id);
+  mutex->lock = 1;
+  return 0;
+}
+
+int mutex_fast_unlock(pthread_mutex_t *mutex, int id) {
+  volatile u32 *owner = (volatile u32 *)&mutex->pthread;
+
+  if (task_get_priority(id) != sos_sched_table[id].attr.schedparam.sched_priority) {
+    // the priority ceiling elevated the task and must be restored in root mode
+    return -1;
+  }
+
+  const int lock = mutex->lock;
+  do {
+    if (scheduler_get_highest_priority_blocked(mutex) != -1) {
+      // hand the mutex to the waiting task
+      return -1;
+    }
+
+    // a task that blocks between the LDREX and STREX clears the exclusive monitor
+    // with its SVCall so the STREX fails and the wait queue is checked again
+    mutex->lock = 0;
+    __DMB();
+    if (__LDREXW(owner) != (u32)id) {
+      __CLREX();
+      mutex->lock = lock;
+      return -1;
+    }
+    if (__STREXW((u32)-1, owner) == 0) {
+      break;
+    }
+    mutex->lock = lock;
+  } while (1);
+
+  if (scheduler_get_highest_priority_blocked(mutex) != -1) {
+    // a task blocked after the wait queue was checked but before the LDREX
+    pthread_mutex_root_unlock_t args;
+    args.id = id;
+    args.mutex = mutex;
+    cortexm_svcall(svcall_mutex_wake, &args);
+  }
+  return 0;
+}
+
+void svcall_mutex_wake(void *args) {
+  CORTEXM_SVCALL_ENTER();
+  pthread_mutex_root_unlock_t *p = args;
+  if (p->mutex->pthread == -1) {
+    // hands the free mutex to the waiting task (unless another task took it first
+    // and will hand it off when it unlocks)
+    pthread_mutex_root_unlock(p);
+  }
+}
+#endif
+
 void root_mutex_block(svcall_mutex_trylock_t *args) {
-  // block the calling mutex
-  sos_sched_table[args->id].block_object =
-    args->mutex; // Elevate the priority of the task based on prio_ceiling
+  // block the calling mutex (adds the task to the mutex wait queue)
   scheduler_timing_root_timedblock(args->mutex, &args->abs_timeout);
 }
 
@@ -412,7 +516,7 @@ void pthread_mutex_root_unlock(pthread_mutex_root_unlock_t *args) {
 
   // Restore the priority to the task that is unlocking the mutex
   task_set_priority(args->id, sos_sched_table[args->id].attr.schedparam.sched_priority);
-  sos_sched_table[args->id].block_object = NULL;
+  scheduler_root_set_block_object(args->id, NULL);
 
   // check to see if another task is waiting for the mutex
   new_thread = scheduler_get_highest_priority_blocked(args->mutex);
@@ -238,6 +238,11 @@ void svcall_set_scheduling_param(void *args) {
     // Issue #161 -- need to set the effective priority -- not just the prio ceiling
     task_set_priority(id, sos_sched_table[id].attr.schedparam.sched_priority);
 
+    // re-insert a blocked task so its wait queue stays in priority order
+    if (scheduler_wait_queued_asserted(id)) {
+      scheduler_root_set_block_object(id, (void *)sos_sched_table[id].block_object);
+    }
+
     // this won't become effective until the next time the task is run because the RR
     // timer is currently active
     if (p->policy == SCHED_FIFO) {
@@ -209,74 +209,6 @@ void scheduler_root_update_on_wake(int id, int new_priority) {
   task_root_switch_context();
 }
 
-// this is called from user space?
-int scheduler_get_highest_priority_blocked(void *block_object) {
-  int priority;
-  int i;
-  int new_thread;
-  int current_task = task_get_current();
-
-  // check to see if another task is waiting for the mutex
-  priority = CONFIG_SCHED_LOWEST_PRIORITY - 1;
-  new_thread = -1;
-
-  // Issue #139 - blocked mutexes should be awarded in a round robin fashion started with
-  // the current task
-  if (current_task == 0) {
-    current_task++;
-  }
-  i = current_task + 1;
-  if (i == task_get_total()) {
-    i = 1;
-  }
-  do {
-    if (task_enabled(i)) {
-      if (
-        (sos_sched_table[i].block_object == block_object) && (!task_active_asserted(i))) {
-        // it's waiting for the block -- give the block to the highest priority and
-        // waiting longest
-        if (
-          !task_stopped_asserted(i)
-          && (sos_sched_table[i].attr.schedparam.sched_priority > priority)) {
-          //! \todo Find the task that has been waiting the longest time
-          new_thread = i;
-          priority = sos_sched_table[i].attr.schedparam.sched_priority;
-        }
-      }
-    }
-    // Issue #139
-    i++;
-    if (i == task_get_total()) {
-      i = 1;
-    }
-  } while (i != current_task);
-
-  return new_thread;
-}
-// This is only called from SVcall so it is always synchronous -- no re-entrancy issues
-// with it
-int scheduler_root_unblock_all(void *block_object, int unblock_type) {
-  int i;
-  int priority;
-  priority = CONFIG_SCHED_LOWEST_PRIORITY - 1;
-  for (i = 1; i < task_get_total(); i++) {
-    if (task_enabled(i)) {
-      if (
-        (sos_sched_table[i].block_object == block_object) && (!task_active_asserted(i))) {
-        // it's waiting for the semaphore -- give the semaphore to the highest priority
-        // and waiting longest
-        scheduler_root_assert_active(i, unblock_type);
-        if (
-          !task_stopped_asserted(i)
-          && (sos_sched_table[i].attr.schedparam.sched_priority > priority)) {
-          priority = sos_sched_table[i].attr.schedparam.sched_priority;
-        }
-      }
-    }
-  }
-  return priority;
-}
-
 void start_first_thread() {
   pthread_attr_t attr;
   attr.stacksize = sos_config.task.start_stack_size;
@@ -25,7 +25,7 @@
 #include "sos_config.h"
 
 #define SCHEDULER_TASK_FLAG_UNBLOCK_MASK 0x0F // bits 0 to 3 are unblock type
-// 4 is available
+#define SCHEDULER_TASK_FLAG_WAIT_QUEUED 4
 #define SCHEDULER_TASK_FLAG_INUSE 5
 #define SCHEDULER_TASK_FLAG_WAITCHILD 6
 #define SCHEDULER_TASK_FLAG_SIGCAUGHT 7
@@ -53,7 +53,8 @@ typedef enum {
   SCHEDULER_UNBLOCK_MQ,
   SCHEDULER_UNBLOCK_PTHREAD_JOINED,
   SCHEDULER_UNBLOCK_PTHREAD_JOINED_THREAD_COMPLETE,
-  SCHEDULER_UNBLOCK_AIO
+  SCHEDULER_UNBLOCK_AIO,
+  SCHEDULER_UNBLOCK_POLL
 } scheduler_unblock_type_t;
 
 // not used for porting, just needs to be here
@@ -74,7 +75,10 @@ typedef struct {
   };
   pthread_mutex_t *signal_delay_mutex;
   volatile struct mcu_timeval wake;
+  struct mcu_timeval launch; // when the process was created (for the launch trace)
   volatile u16 flags;
+  volatile u8 wait_next; // next task in the block object's wait queue (0 is the end)
+  volatile u8 wait_previous;
   trace_id_t trace_id;
 #if CONFIG_TASK_PROCESS_TIMER_COUNT > 0
   sos_process_timer_t timer[CONFIG_TASK_PROCESS_TIMER_COUNT];
@@ -108,6 +112,9 @@ int scheduler_create_process(void (*p)(char *),
 int scheduler_switch_context(void * args);
 int scheduler_get_highest_priority_blocked(void * block_object);
 
+void scheduler_root_set_block_object(int id, void *block_object) MCU_ROOT_CODE;
+void scheduler_root_wait_queue_remove(int id) MCU_ROOT_CODE;
+
 
 void scheduler_check_cancellation();
 
@@ -130,6 +137,7 @@ static inline int scheduler_sigcaught_asserted(int id){ return sos_sched_table[i
 static inline int scheduler_aiosuspend_asserted(int id){ return sos_sched_table[id].flags & (1<< SCHEDULER_TASK_FLAG_AIOSUSPEND); }
 static inline int scheduler_zombie_asserted(int id){ return sos_sched_table[id].flags & (1<< SCHEDULER_TASK_FLAG_ZOMBIE); }
 static inline int scheduler_authenticated_asserted(int id){ return sos_sched_table[id].flags & (1<< SCHEDULER_TASK_FLAG_AUTHENTICATED); }
+static inline int scheduler_wait_queued_asserted(int id){ return sos_sched_table[id].flags & (1<< SCHEDULER_TASK_FLAG_WAIT_QUEUED); }
 
 static inline volatile int scheduler_unblock_type(int id) MCU_ALWAYS_INLINE;
 volatile int scheduler_unblock_type(int id) {
@@ -66,6 +66,7 @@ void svcall_init_sched_task(init_sched_task_t *task) {
   CORTEXM_SVCALL_ENTER();
   int id = task->tid;
 
+  scheduler_root_wait_queue_remove(id);
   sos_sched_table[id] = (sched_task_t){};
 
   PTHREAD_ATTR_SET_IS_INITIALIZED((&(sos_sched_table[id].attr)), 1);
@@ -101,6 +102,11 @@ void svcall_init_sched_task(init_sched_task_t *task) {
 
   sos_sched_table[id].wake.tv_sec = SCHEDULER_TIMEVAL_SEC_INVALID;
   sos_sched_table[id].wake.tv_usec = 0;
+  {
+    struct mcu_timeval launch;
+    scheduler_timing_root_get_realtime(&launch);
+    sos_sched_table[id].launch = launch;
+  }
   scheduler_root_assert_cancel_enable(id);
   scheduler_root_deassert_cancel_asynchronous(id);
   scheduler_root_assert_active(id, 0);
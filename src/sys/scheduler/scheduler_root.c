@@ -24,7 +24,7 @@ void scheduler_root_assert_active(int id, int unblock_type) {
   scheduler_root_set_unblock_type(id, unblock_type);
   scheduler_root_deassert_aiosuspend(id);
   // Remove all blocks (mutex, timing, etc)
-  sos_sched_table[id].block_object = NULL;
+  scheduler_root_set_block_object(id, NULL);
   sos_sched_table[id].wake.tv_sec = SCHEDULER_TIMEVAL_SEC_INVALID;
   sos_sched_table[id].wake.tv_usec = 0;
 }
@@ -90,6 +90,7 @@ void svcall_activate_thread(svcall_activate_thread_t *args) {
   id = args->id;
   struct _reent *reent;
 
+  scheduler_root_wait_queue_remove(id);
   memset((void *)&sos_sched_table[id], 0, sizeof(sched_task_t));
   memcpy((void *)&(sos_sched_table[id].attr), args->attr, sizeof(pthread_attr_t));
 
@@ -204,8 +205,9 @@ void svcall_wait_joined(void *args) {
   }
 
   if (p->joined == 0) {
-    sos_sched_table[task_get_current()].block_object =
-      (void *)&sos_sched_table[task_get_current()].block_object; // block on self
+    scheduler_root_set_block_object(
+      task_get_current(),
+      (void *)&sos_sched_table[task_get_current()].block_object); // block on self
     scheduler_root_update_on_sleep();
   } else {
     sos_sched_table[task_get_current()].exit_status = p->status;
@@ -228,6 +230,8 @@ void svcall_cleanup(void *args) {
     }
   }
 
+  // clearing the flags below would leave the task linked in its wait queue
+  scheduler_root_wait_queue_remove(task_get_current());
   sos_sched_table[task_get_current()].flags = 0;
   task_root_delete(task_get_current());
   scheduler_root_update_on_sleep();
@@ -78,7 +78,7 @@ void scheduler_timing_root_timedblock(void *block_object, struct mcu_timeval *ab
 
   // Initialization
   id = task_get_current();
-  sos_sched_table[id].block_object = block_object;
+  scheduler_root_set_block_object(id, block_object);
   is_time_to_sleep = 0;
 
   if (abs_time->tv_sec >= sched_usecond_counter) {
@@ -118,6 +118,9 @@ void scheduler_timing_root_timedblock(void *block_object, struct mcu_timeval *ab
   // only sleep if the time hasn't already passed
   if (is_time_to_sleep) {
     scheduler_root_update_on_sleep();
+  } else {
+    // the task keeps running so it must not stay in the wait queue
+    scheduler_root_wait_queue_remove(id);
   }
 }
 
@@ -0,0 +1,146 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+/*! \addtogroup SCHED
+ * @{
+ *
+ */
+
+/*! \file
+ *
+ * Tasks that block on a mutex, semaphore or condition are linked into a wait
+ * queue rather than being found by scanning the whole task table. The queue
+ * links live in `sos_sched_table` (wait_next/wait_previous) so no memory is
+ * needed in the blocking object itself. Queues are selected by hashing the
+ * block object address. Within a queue, tasks are ordered by priority and
+ * then by arrival (FIFO) so the first matching entry is the highest priority
+ * task that has been waiting the longest.
+ *
+ */
+
+#include "config.h"
+
+#include "scheduler_root.h"
+
+#if (CONFIG_SCHED_WAIT_QUEUE_COUNT & (CONFIG_SCHED_WAIT_QUEUE_COUNT - 1)) != 0
+#error "CONFIG_SCHED_WAIT_QUEUE_COUNT must be a power of 2"
+#endif
+
+// task id of the first task in each queue (0 is empty -- task 0 never blocks here)
+static volatile u8 scheduler_wait_queue[CONFIG_SCHED_WAIT_QUEUE_COUNT] MCU_SYS_MEM;
+
+static void root_enqueue(int id) MCU_ROOT_CODE;
+static void root_dequeue(int id) MCU_ROOT_CODE;
+
+static inline volatile u8 *wait_queue_head(const volatile void *block_object) {
+  const u32 value = (u32)block_object;
+  return scheduler_wait_queue
+         + (((value >> 2) ^ (value >> 8)) & (CONFIG_SCHED_WAIT_QUEUE_COUNT - 1));
+}
+
+static inline int wait_queue_priority(int id) {
+  return sos_sched_table[id].attr.schedparam.sched_priority;
+}
+
+void scheduler_root_set_block_object(int id, void *block_object) {
+  // the queues are modified by interrupts (timeouts, device callbacks)
+  const u32 primask = __get_PRIMASK();
+  cortexm_disable_interrupts();
+  root_dequeue(id);
+  sos_sched_table[id].block_object = block_object;
+  if (block_object != NULL && id > 0) {
+    root_enqueue(id);
+  }
+  __set_PRIMASK(primask);
+}
+
+void scheduler_root_wait_queue_remove(int id) {
+  const u32 primask = __get_PRIMASK();
+  cortexm_disable_interrupts();
+  root_dequeue(id);
+  __set_PRIMASK(primask);
+}
+
+// this is called from user space?
+int scheduler_get_highest_priority_blocked(void *block_object) {
+  int i = *wait_queue_head(block_object);
+  while (i != 0) {
+    if (
+      (sos_sched_table[i].block_object == block_object) && task_enabled(i)
+      && !task_active_asserted(i) && !task_stopped_asserted(i)) {
+      // queue order is priority then arrival -- this is the highest priority task
+      // that has been waiting the longest
+      return i;
+    }
+    i = sos_sched_table[i].wait_next;
+  }
+  return -1;
+}
+
+// This is only called from SVcall so it is always synchronous -- no re-entrancy issues
+// with it
+int scheduler_root_unblock_all(void *block_object, int unblock_type) {
+  int priority = CONFIG_SCHED_LOWEST_PRIORITY - 1;
+  int i = *wait_queue_head(block_object);
+  while (i != 0) {
+    // assert active removes the task from the queue
+    const int next = sos_sched_table[i].wait_next;
+    if (
+      (sos_sched_table[i].block_object == block_object) && task_enabled(i)
+      && !task_active_asserted(i)) {
+      scheduler_root_assert_active(i, unblock_type);
+      if (!task_stopped_asserted(i) && (wait_queue_priority(i) > priority)) {
+        priority = wait_queue_priority(i);
+      }
+    }
+    i = next;
+  }
+  return priority;
+}
+
+void root_enqueue(int id) {
+  volatile u8 *head = wait_queue_head(sos_sched_table[id].block_object);
+  const int priority = wait_queue_priority(id);
+  int previous = 0;
+  int next = *head;
+
+  // insert after all tasks of equal or higher priority (FIFO within a priority)
+  while ((next != 0) && (wait_queue_priority(next) >= priority)) {
+    previous = next;
+    next = sos_sched_table[next].wait_next;
+  }
+
+  sos_sched_table[id].wait_previous = previous;
+  sos_sched_table[id].wait_next = next;
+  if (previous == 0) {
+    *head = id;
+  } else {
+    sos_sched_table[previous].wait_next = id;
+  }
+  if (next != 0) {
+    sos_sched_table[next].wait_previous = id;
+  }
+  scheduler_root_assert(id, SCHEDULER_TASK_FLAG_WAIT_QUEUED);
+}
+
+void root_dequeue(int id) {
+  if (!scheduler_wait_queued_asserted(id)) {
+    return;
+  }
+
+  const int previous = sos_sched_table[id].wait_previous;
+  const int next = sos_sched_table[id].wait_next;
+  if (previous == 0) {
+    *wait_queue_head(sos_sched_table[id].block_object) = next;
+  } else {
+    sos_sched_table[previous].wait_next = next;
+  }
+  if (next != 0) {
+    sos_sched_table[next].wait_previous = previous;
+  }
+
+  sos_sched_table[id].wait_previous = 0;
+  sos_sched_table[id].wait_next = 0;
+  scheduler_root_deassert(id, SCHEDULER_TASK_FLAG_WAIT_QUEUED);
+}
+
+/*! @} */
@@ -16,6 +16,7 @@
 #include <string.h>
 #include <unistd.h>
 
+#include "../name_index/name_index.h"
 #include "../scheduler/scheduler_root.h"
 #include "../scheduler/scheduler_timing.h"
 #include "semaphore.h"
@@ -35,8 +36,11 @@ typedef struct {
 typedef struct {
   sem_t sem;
   void *next;
+  name_index_node_t name_node;
 } sem_list_t;
 
+#define SEM_NAME_INDEX_COUNT 8
+
 static void svcall_sem_wait(void *args) MCU_ROOT_EXEC_CODE;
 static void svcall_sem_post(void *args) MCU_ROOT_EXEC_CODE;
 static void svcall_sem_trywait(void *args) MCU_ROOT_EXEC_CODE;
@@ -53,10 +57,13 @@ typedef struct {
 } root_sem_args_t;
 
 static sem_list_t *sem_first = 0;
+static name_index_node_t *sem_name_bucket[SEM_NAME_INDEX_COUNT];
+static name_index_t sem_name_index = {sem_name_bucket, SEM_NAME_INDEX_COUNT};
 
 static sem_t *sem_find_named(const char *name) {
-  sem_list_t *entry;
-  for (entry = sem_first; entry != 0; entry = entry->next) {
+  for (name_index_node_t *node = name_index_first(&sem_name_index, name, SEM_NAME_MAX);
+       node != NULL; node = node->next) {
+    sem_list_t *entry = NAME_INDEX_CONTAINER(node, sem_list_t, name_node);
     if (entry->sem.is_initialized != 0) {
       if (strncmp(entry->sem.name, name, sizeof(entry->sem.name) - 1) == 0) {
         return &entry->sem;
@@ -74,6 +81,9 @@ static sem_t *sem_find_free() {
   for (entry = sem_first; entry != 0; entry = entry->next) {
     last_entry = entry;
     if (entry->sem.is_initialized == 0) {
+      // the entry is indexed again when it is named
+      name_index_remove(
+        &sem_name_index, &entry->name_node, entry->sem.name, SEM_NAME_MAX);
       return &entry->sem;
     }
   }
@@ -89,6 +99,7 @@ static sem_t *sem_find_free() {
     last_entry->next = new_entry;
   }
   new_entry->next = 0;
+  new_entry->name_node.next = NULL;
   return &new_entry->sem;
 }
 /*! \endcond */
@@ -233,6 +244,8 @@ sem_t *sem_open(const char *name, int oflag, ...) {
     new_sem->mode = mode;
     new_sem->pshared = 1;
     strncpy(new_sem->name, name, sizeof(new_sem->name) - 1);
+    name_index_insert(
+      &sem_name_index, &((sem_list_t *)new_sem)->name_node, new_sem->name, SEM_NAME_MAX);
     break;
 
   case 1:
@@ -442,7 +455,6 @@ int sem_wait(sem_t *sem) {
 void svcall_sem_post(void *args) {
   CORTEXM_SVCALL_ENTER();
   int id = *((int *)args);
-  sos_sched_table[id].block_object = NULL;
   scheduler_root_assert_active(id, SCHEDULER_UNBLOCK_SEMAPHORE);
   scheduler_root_update_on_wake(id, task_get_priority(id));
 }
@@ -476,10 +488,9 @@ void svcall_sem_wait(void *args) {
   CORTEXM_SVCALL_ENTER();
   root_sem_args_t *p = args;
 
-  sos_sched_table[task_get_current()].block_object = p->sem;
-
   if (p->sem->value <= 0) {
     // task must be blocked until the semaphore is available
+    scheduler_root_set_block_object(task_get_current(), p->sem);
     scheduler_root_update_on_sleep();
     p->result = -1; // didn't get the semaphore
   } else {
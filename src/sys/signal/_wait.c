@@ -109,6 +109,7 @@ void svcall_check_for_zombie_child(void *args) {
               if (num_zombies == 0) {
                 p->tid = i;
                 p->status = sos_sched_table[i].exit_status;
+                scheduler_root_wait_queue_remove(i);
                 sos_sched_table[i].flags = 0;
                 task_root_delete(i);
               }
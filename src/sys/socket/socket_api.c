@@ -2,6 +2,7 @@
 
 #include <unistd.h>
 
+#include "../poll/poll_local.h"
 #include "../scheduler/scheduler_local.h"
 #include "../unistd/unistd_local.h"
 #include "sos/sos.h"
@@ -160,15 +161,6 @@ int socket(int domain, int type, int protocol) {
   return s | FILDES_SOCKET_FLAG;
 }
 
-int writev(int s, const struct iovec *iov, int iovcnt) {
-  scheduler_check_cancellation();
-  if (FILDES_IS_SOCKET(s)) {
-    return SOS_SOCKET_API()->writev(s & ~FILDES_SOCKET_FLAG, iov, iovcnt);
-  }
-  errno = ENOTSOCK;
-  return -1;
-}
-
 int select(
   int maxfdp1,
   fd_set *readset,
@@ -176,7 +168,11 @@ int select(
   fd_set *exceptset,
   struct timeval *timeout) {
   scheduler_check_cancellation();
-  return SOS_SOCKET_API()->select(maxfdp1, readset, writeset, exceptset, timeout);
+  if (sos_config.socket_api != 0) {
+    return SOS_SOCKET_API()->select(maxfdp1, readset, writeset, exceptset, timeout);
+  }
+  // without a socket API, select() works with devices (see poll())
+  return poll_select(maxfdp1, readset, writeset, exceptset, timeout);
 }
 
 struct hostent *gethostbyname(const char *name) {
@@ -11,6 +11,8 @@
 #include "sos/link.h"
 #include "sos/sos.h"
 
+#include "sysfs/sysfs_local.h"
+
 extern void *link_update(void *args);
 
 static void init_fs();
@@ -67,6 +69,14 @@ void init_fs() {
   i = 0;
   const sysfs_t *sysfs_list = sos_config.fs.rootfs_list;
 
+  // lookups scan the tables if the indexes can't be allocated
+  if (devfs_init_name_index(sos_config.fs.devfs_list) < 0) {
+    sos_debug_log_warning(SOS_DEBUG_SYS, "failed to index devices");
+  }
+  if (sysfs_init_name_index() < 0) {
+    sos_debug_log_warning(SOS_DEBUG_SYS, "failed to index mount paths");
+  }
+
   while (sysfs_isterminator(sysfs_list + i) == 0) {
     SOS_TRACE_MESSAGE(sysfs_list[i].mount_path);
     sos_debug_log_info(SOS_DEBUG_SYS, "init %s", sysfs_list[i].mount_path);
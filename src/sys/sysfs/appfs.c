@@ -26,8 +26,11 @@ static void svcall_ioctl(void *args) MCU_ROOT_CODE;
 static void svcall_init(void *args) MCU_ROOT_CODE;
 static void svcall_read(void *args) MCU_ROOT_CODE;
 static void svcall_close(void *args) MCU_ROOT_CODE;
+static void svcall_unlinked(void *args) MCU_ROOT_CODE;
 static int readdir_rootdir(const void *cfg, int loc, struct dirent *entry);
 
+volatile u32 appfs_generation MCU_SYS_MEM;
+
 static int analyze_path(const char *path, const char **name, int *mem_type) {
   int elements;
 
@@ -300,6 +303,10 @@ int appfs_unlink(const void *cfg, const char *path) {
   get_pageinfo_args.device = device;
   get_pageinfo_args.page_info = page_info;
 
+  // process_start() caches headers -- invalidate them before any page is erased so a
+  // launch can't use a cached header for a file that is being deleted
+  cortexm_svcall(svcall_unlinked, NULL);
+
   // executable files are deleted based on the header file
   if (mem_type == MEM_FLAG_IS_FLASH) {
     int start_page = get_pageinfo_args.page_info.num;
@@ -536,8 +543,16 @@ int appfs_write(
   return SYSFS_SET_RETURN(EROFS);
 }
 
+void svcall_unlinked(void *args) {
+  CORTEXM_SVCALL_ENTER();
+  MCU_UNUSED_ARGUMENT(args);
+  // appfs_generation is in system memory
+  appfs_generation++;
+}
+
 void svcall_close(void *args) {
   CORTEXM_SVCALL_ENTER();
+  appfs_generation++;
   // flash may not be synced with memory because of programming ops
   if (sos_config.cache.enable) {
     sos_config.cache.invalidate_instruction();
@@ -565,6 +580,8 @@ int appfs_close(const void *cfg, void **handle) {
     h->type.install.ecc_api->deinit(&h->type.install.ecc_context);
     h->type.install.sha256_api->deinit(&h->type.install.sha256_context);
 #endif
+    free(h->type.install.lz);
+    free(h->type.install.relocation);
   }
   free(h);
   h = NULL;
@@ -608,6 +625,10 @@ void svcall_ioctl(void *args) {
 
   info = ctl;
   attr = ctl;
+  if (h->is_install) {
+    // INSTALL, CREATE and VERIFY_SIGNATURE change files
+    appfs_generation++;
+  }
   switch (request) {
 
   case I_APPFS_GETVERSION:
@@ -618,6 +639,9 @@ void svcall_ioctl(void *args) {
   case I_APPFS_INSTALL:
     if (!h->is_install) {
       a->result = SYSFS_SET_RETURN(ENOTSUP);
+    } else if (attr->loc & APPFS_INSTALL_LOC_COMPRESSED) {
+      a->result = appfs_util_root_writeinstall_compressed(a->cfg, h, attr);
+      sos_config.cache.invalidate_instruction();
     } else {
 #if CONFIG_APPFS_IS_VERIFY_SIGNATURE
       h->type.install.sha256_api->update(
@@ -758,6 +782,30 @@ void svcall_ioctl(void *args) {
 
 int appfs_ioctl(const void *cfg, void *handle, int request, void *ctl) {
   sysfs_ioctl_t args;
+  appfs_handle_t *h = handle;
+  const appfs_installattr_t *attr = ctl;
+
+  if (
+    (request == I_APPFS_INSTALL) && h->is_install
+    && (attr->loc & APPFS_INSTALL_LOC_COMPRESSED) && (h->type.install.lz == NULL)) {
+    // the decoder is only needed for compressed installs
+    h->type.install.lz = malloc(sizeof(appfs_util_lz_t));
+    if (h->type.install.lz == NULL) {
+      return SYSFS_SET_RETURN(ENOMEM);
+    }
+  }
+
+  if (
+    (request == I_APPFS_INSTALL) && h->is_install
+    && (attr->loc & APPFS_INSTALL_LOC_RELOCATION)
+    && (h->type.install.relocation == NULL)) {
+    // the relocation page is only needed for images with a relocation table
+    h->type.install.relocation = malloc(APPFS_PAGE_SIZE);
+    if (h->type.install.relocation == NULL) {
+      return SYSFS_SET_RETURN(ENOMEM);
+    }
+  }
+
   args.cfg = cfg;
   args.handle = handle;
   args.request = request;
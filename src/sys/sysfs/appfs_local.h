@@ -14,6 +14,13 @@
 #include "sos/debug.h"
 #include "sos/dev/appfs.h"
 #include "sos/fs/sysfs.h"
+#include "sos/lz.h"
+
+typedef struct {
+  sos_lz_decoder_t decoder;
+  u32 loc /*! location of the next compressed byte */;
+  appfs_installattr_t page /*! the decompressed page */;
+} appfs_util_lz_t;
 
 typedef struct {
   u32 code_start /*! the new value */;
@@ -22,6 +29,12 @@ typedef struct {
   u32 data_size;
   u32 rewrite_mask;
   u32 kernel_symbols_total;
+  u32 relocation_loc /*! image location of the relocation page */;
+  u16 relocation_nbyte /*! bytes in the relocation page (0 if none was installed) */;
+  u8 is_relocation_table /*! translate only the words listed in the relocation page */;
+  u8 resd;
+  u8 *relocation /*! allocated (APPFS_PAGE_SIZE) for the first relocation page */;
+  appfs_util_lz_t *lz /*! allocated for compressed installs */;
 #if CONFIG_APPFS_IS_VERIFY_SIGNATURE
   void * sha256_context;
   void * ecc_context;
@@ -31,6 +44,9 @@ typedef struct {
 #endif
 } appfs_util_handle_t;
 
+// changes when a file is installed or unlinked
+extern volatile u32 appfs_generation;
+
 #define APPFS_MEMPAGETYPE_FREE 0
 #define APPFS_MEMPAGETYPE_SYS 1
 #define APPFS_MEMPAGETYPE_USER 2
@@ -117,6 +133,10 @@ int appfs_util_root_writeinstall(
   const devfs_device_t *device,
   appfs_handle_t *h,
   appfs_installattr_t *attr) MCU_ROOT_CODE;
+int appfs_util_root_writeinstall_compressed(
+  const devfs_device_t *device,
+  appfs_handle_t *h,
+  appfs_installattr_t *attr) MCU_ROOT_CODE;
 int appfs_util_root_create(
   const devfs_device_t *device,
   appfs_handle_t *h,
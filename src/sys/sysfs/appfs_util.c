@@ -48,6 +48,14 @@ check_for_free_space(const devfs_device_t *dev, int start_page, int type, int si
   MCU_ROOT_EXEC_CODE;
 
 static u8 calc_checksum(const char *name) MCU_ROOT_EXEC_CODE;
+static int translate_page(
+  const appfs_util_handle_t *install,
+  const appfs_installattr_t *attr,
+  u32 *dest,
+  u32 start) MCU_ROOT_EXEC_CODE;
+static int install_relocation(
+  appfs_util_handle_t *install,
+  const appfs_installattr_t *attr) MCU_ROOT_EXEC_CODE;
 
 u8 calc_checksum(const char *name) {
   int i;
@@ -108,43 +116,123 @@ void appfs_util_svcall_erase_pages(void *args) {
   sos_config.cache.invalidate_data_block((void *)p->start_address, p->size);
 }
 
+static u32
+relocate_value(u32 addr, u32 code_start, u32 data_start, u32 total, s32 *loc) {
+  u32 ret = addr & ~(APPFS_REWRITE_MASK | APPFS_REWRITE_RAM_MASK);
+  if (
+    ((addr & APPFS_REWRITE_KERNEL_ADDR) == APPFS_REWRITE_KERNEL_ADDR)
+    && ((addr - 1) % 4 == 0) // if the value is not aligned, it shouldn't be translated
+  ) {
+    // This is a kernel value
+    ret = (addr & APPFS_REWRITE_KERNEL_ADDR_MASK)
+          >> 2; // convert the address to a table index value
+    if (ret < total) {
+      // get the symbol location from the symbols table
+      if (symbols_table[ret] == 0) {
+        sos_debug_log_error(
+          SOS_DEBUG_APPFS, "symbol at offset %d (%p) is zero", ret, symbols_table + ret);
+        *loc = ret; // this symbol isn't available -- it was removed to save space in
+                    // the MCU flash
+      }
+      return symbols_table[ret];
+    } else {
+      sos_debug_log_error(
+        SOS_DEBUG_APPFS, "location exceeds total for %p (%d)", addr, total);
+      *loc = total;
+      return 0;
+    }
+  } else if (addr & APPFS_REWRITE_RAM_MASK) {
+    ret += data_start;
+  } else {
+    ret += code_start;
+  }
+  return ret;
+}
+
 static u32
 translate_value(u32 addr, u32 mask, u32 code_start, u32 data_start, u32 total, s32 *loc) {
   // check if the value is an address
-  u32 ret = addr;
   *loc = 0;
   if ((addr & APPFS_REWRITE_MASK) == mask) { // matches Text or Data
-    ret = addr & ~(APPFS_REWRITE_MASK | APPFS_REWRITE_RAM_MASK);
-    if (
-      ((addr & APPFS_REWRITE_KERNEL_ADDR) == APPFS_REWRITE_KERNEL_ADDR)
-      && ((addr - 1) % 4 == 0) // if the value is not aligned, it shouldn't be translated
-    ) {
-      // This is a kernel value
-      ret = (addr & APPFS_REWRITE_KERNEL_ADDR_MASK)
-            >> 2; // convert the address to a table index value
-      if (ret < total) {
-        // get the symbol location from the symbols table
-        if (symbols_table[ret] == 0) {
-          sos_debug_log_error(
-            SOS_DEBUG_APPFS, "symbol at offset %d (%p) is zero", ret,
-            symbols_table + ret);
-          *loc = ret; // this symbol isn't available -- it was removed to save space in
-                      // the MCU flash
-        }
-        return symbols_table[ret];
-      } else {
+    return relocate_value(addr, code_start, data_start, total, loc);
+  }
+  return addr;
+}
+
+int translate_page(
+  const appfs_util_handle_t *install,
+  const appfs_installattr_t *attr,
+  u32 *dest,
+  u32 start) {
+  const u32 *src = (const u32 *)attr->buffer;
+  const u32 end = attr->nbyte >> 2;
+  s32 loc_err = 0;
+
+  if (install->is_relocation_table == 0) {
+    // guess which words are addresses using the rewrite mask
+    for (u32 i = start; i < end; i++) {
+      dest[i] = translate_value(
+        src[i], install->rewrite_mask, install->code_start, install->data_start,
+        install->kernel_symbols_total, &loc_err);
+      if (loc_err != 0) {
+        sos_debug_log_error(SOS_DEBUG_APPFS, "Code relocation error %d", loc_err);
+        return SYSFS_SET_RETURN_WITH_VALUE(EIO, loc_err);
+      }
+    }
+    return 0;
+  }
+
+  // only the words listed in the relocation page are translated
+  const u32 offset = (attr->loc - install->relocation_loc) >> 2;
+  if (
+    (attr->loc < install->relocation_loc)
+    || (offset + end > (u32)install->relocation_nbyte * 8)) {
+    sos_debug_log_error(SOS_DEBUG_APPFS, "No relocation page for 0x%lX", attr->loc);
+    return SYSFS_SET_RETURN(EINVAL);
+  }
+
+  memcpy(dest + start, src + start, (end - start) << 2);
+  for (u32 i = start; i < end; i++) {
+    const u32 bit = offset + i;
+    const u8 bits = install->relocation[bit >> 3];
+    if (bits == 0) {
+      // nothing to translate until the next byte of the bitmap
+      i += 0x07 - (bit & 0x07);
+      continue;
+    }
+
+    if (bits & (1 << (bit & 0x07))) {
+      if ((src[i] & APPFS_REWRITE_MASK) != install->rewrite_mask) {
         sos_debug_log_error(
-          SOS_DEBUG_APPFS, "location exceeds total for %p (%d)", addr, total);
-        *loc = total;
-        return 0;
+          SOS_DEBUG_APPFS, "Relocation 0x%lX is not an address", src[i]);
+        return SYSFS_SET_RETURN_WITH_VALUE(EIO, bit);
+      }
+
+      dest[i] = relocate_value(
+        src[i], install->code_start, install->data_start, install->kernel_symbols_total,
+        &loc_err);
+      if (loc_err != 0) {
+        sos_debug_log_error(SOS_DEBUG_APPFS, "Code relocation error %d", loc_err);
+        return SYSFS_SET_RETURN_WITH_VALUE(EIO, loc_err);
       }
-    } else if (addr & APPFS_REWRITE_RAM_MASK) {
-      ret += data_start;
-    } else {
-      ret += code_start;
     }
   }
-  return ret;
+  return 0;
+}
+
+int install_relocation(appfs_util_handle_t *install, const appfs_installattr_t *attr) {
+  const u32 loc = attr->loc & ~APPFS_INSTALL_LOC_RELOCATION;
+  if (
+    (install->relocation == NULL) || (loc % APPFS_RELOCATION_PAGE_SIZE)
+    || (attr->nbyte > APPFS_PAGE_SIZE)) {
+    sos_debug_log_error(SOS_DEBUG_APPFS, "bad relocation page 0x%lX", loc);
+    return SYSFS_SET_RETURN(EINVAL);
+  }
+
+  install->relocation_loc = loc;
+  install->relocation_nbyte = attr->nbyte;
+  memcpy(install->relocation, attr->buffer, attr->nbyte);
+  return attr->nbyte;
 }
 
 u32 find_protectable_addr(
@@ -493,6 +581,11 @@ int appfs_util_root_writeinstall(
     return SYSFS_SET_RETURN(EBADF);
   }
 
+  if (attr->loc & APPFS_INSTALL_LOC_RELOCATION) {
+    // this is a page of the relocation table for the pages that follow
+    return install_relocation(&h->type.install, attr);
+  }
+
   union {
     appfs_file_t file;
     u32 buf[APPFS_PAGE_SIZE / sizeof(u32)];
@@ -650,6 +743,8 @@ int appfs_util_root_writeinstall(
 
     h->type.install.rewrite_mask = (u32)(src.file->exec.code_start) & APPFS_REWRITE_MASK;
     h->type.install.kernel_symbols_total = symbols_total();
+    h->type.install.is_relocation_table =
+      (src.file->exec.o_flags & APPFS_FLAG_IS_RELOCATION_TABLE) != 0;
 
     appfs_ram_root_set(dev, ram_page, ram_size, APPFS_MEMPAGETYPE_SYS);
 
@@ -669,14 +764,10 @@ int appfs_util_root_writeinstall(
     sos_debug_log_info(
       SOS_DEBUG_APPFS, "code startup is translated to at %p", dest.file.exec.startup);
 
-    for (u32 i = sizeof(appfs_file_t) >> 2; i < (attr->nbyte >> 2); i++) {
-      dest.buf[i] = translate_value(
-        src.ptr[i], h->type.install.rewrite_mask, h->type.install.code_start,
-        h->type.install.data_start, h->type.install.kernel_symbols_total, &loc_err);
-      if (loc_err != 0) {
-        sos_debug_log_error(SOS_DEBUG_APPFS, "Code relocation error: %d", loc_err);
-        return SYSFS_SET_RETURN_WITH_VALUE(EIO, loc_err);
-      }
+    const int result =
+      translate_page(&h->type.install, attr, dest.buf, sizeof(appfs_file_t) >> 2);
+    if (result < 0) {
+      return result;
     }
 
 #if CONFIG_APPFS_IS_VERIFY_SIGNATURE
@@ -694,14 +785,9 @@ int appfs_util_root_writeinstall(
       sos_debug_log_error(SOS_DEBUG_APPFS, "word alignment error 0x%X\n", attr->loc);
       return SYSFS_SET_RETURN(EINVAL);
     }
-    for (u32 i = 0; i < (attr->nbyte >> 2); i++) {
-      dest.buf[i] = translate_value(
-        src.ptr[i], h->type.install.rewrite_mask, h->type.install.code_start,
-        h->type.install.data_start, h->type.install.kernel_symbols_total, &loc_err);
-      if (loc_err != 0) {
-        sos_debug_log_error(SOS_DEBUG_APPFS, "Code relocation error %d", loc_err);
-        return SYSFS_SET_RETURN_WITH_VALUE(EIO, loc_err);
-      }
+    const int result = translate_page(&h->type.install, attr, dest.buf, 0);
+    if (result < 0) {
+      return result;
     }
   }
 
@@ -711,6 +797,78 @@ int appfs_util_root_writeinstall(
   return appfs_util_root_mem_write_page(dev, h, attr);
 }
 
+int appfs_util_root_writeinstall_compressed(
+  const devfs_device_t *dev,
+  appfs_handle_t *h,
+  appfs_installattr_t *attr) {
+  if (h->is_install == false) {
+    return SYSFS_SET_RETURN(EBADF);
+  }
+
+  appfs_util_lz_t *lz = h->type.install.lz;
+  const u32 loc = attr->loc & ~APPFS_INSTALL_LOC_COMPRESSED;
+  if ((lz == NULL) || (attr->nbyte > APPFS_PAGE_SIZE)) {
+    return SYSFS_SET_RETURN(EINVAL);
+  }
+
+  if (loc == 0) {
+    sos_lz_decoder_init(&lz->decoder);
+    lz->loc = 0;
+    lz->page.loc = 0;
+    lz->page.nbyte = 0;
+  } else if (loc != lz->loc) {
+    sos_debug_log_error(SOS_DEBUG_APPFS, "compressed data out of order 0x%X", loc);
+    return SYSFS_SET_RETURN(EINVAL);
+  }
+  lz->loc += attr->nbyte;
+
+  const u8 *src = attr->buffer;
+  u32 src_size = attr->nbyte;
+  while ((src_size > 0) && !sos_lz_is_complete(&lz->decoder)) {
+    u32 used = src_size;
+    const int bytes = sos_lz_decode(
+      &lz->decoder, src, &used, lz->page.buffer + lz->page.nbyte,
+      APPFS_PAGE_SIZE - lz->page.nbyte);
+    if (bytes < 0) {
+      sos_debug_log_error(SOS_DEBUG_APPFS, "bad compressed data");
+      return SYSFS_SET_RETURN(EINVAL);
+    }
+    src += used;
+    src_size -= used;
+    lz->page.nbyte += bytes;
+
+    if (
+      (lz->page.nbyte < APPFS_PAGE_SIZE)
+      && !(sos_lz_is_complete(&lz->decoder) && lz->page.nbyte)) {
+      continue;
+    }
+
+    const appfs_file_t *file = (const appfs_file_t *)lz->page.buffer;
+    if (
+      (lz->page.loc == 0) && (lz->page.nbyte >= sizeof(appfs_file_t))
+      && (file->exec.o_flags & APPFS_FLAG_IS_RELOCATION_TABLE)) {
+      // the relocation pages can't be placed in the compressed data
+      return SYSFS_SET_RETURN(ENOTSUP);
+    }
+
+    // the decompressed page is installed (and hashed) like an uncompressed page
+    const u32 page_loc = lz->page.loc;
+    const u32 nbyte = lz->page.nbyte;
+#if CONFIG_APPFS_IS_VERIFY_SIGNATURE
+    h->type.install.sha256_api->update(
+      h->type.install.sha256_context, lz->page.buffer, nbyte);
+#endif
+    const int result = appfs_util_root_writeinstall(dev, h, &lz->page);
+    if (result < 0) {
+      return result;
+    }
+    lz->page.loc = page_loc + nbyte;
+    lz->page.nbyte = 0;
+  }
+
+  return attr->nbyte;
+}
+
 int get_flash_page_type(const devfs_device_t *dev, u32 address, u32 size) {
   appfs_file_t appfs_file;
 
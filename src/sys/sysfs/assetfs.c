@@ -12,16 +12,24 @@
 #include "cortexm/cortexm.h"
 #include "dirent.h"
 #include "sos/fs/sysfs.h"
+#include "sos/lz.h"
 #include "sos/sos.h"
 
 
 #define INVALID_DIR_HANDLE ((void *)0)
 #define VALID_DIR_HANDLE ((void *)0x12345678)
 
+typedef struct {
+  sos_lz_decoder_t decoder;
+  u32 src_loc /*! bytes of compressed data that have been decoded */;
+  u32 src_size;
+} assetfs_lz_t;
+
 typedef struct {
   int ino;
   const void *data;
   u32 size;
+  assetfs_lz_t *lz /*! NULL if the entry isn't compressed */;
   u32 checksum;
 } assetfs_handle_t;
 
@@ -34,6 +42,8 @@ int assetfs_init(const void *config) {
 static int get_directory_entry(const void *cfg, int loc, const assetfs_dirent_t **entry);
 static const assetfs_dirent_t *find_file(const void *cfg, const char *path, int *ino);
 static void assign_stat(int ino, const assetfs_dirent_t *entry, struct stat *st);
+static int is_compressed(const assetfs_dirent_t *entry);
+static int read_compressed(assetfs_handle_t *h, int loc, void *buf, int nbyte);
 
 int assetfs_startup(const void *config) {
   MCU_UNUSED_ARGUMENT(config);
@@ -54,6 +64,14 @@ int assetfs_open(const void *cfg, void **handle, const char *path, int flags, in
     return SYSFS_SET_RETURN(EPERM);
   }
 
+  if (
+    is_compressed(directory_entry)
+    && ((directory_entry->end - directory_entry->start < sizeof(sos_lz_header_t))
+        || (sos_lz_is_compressed((const void *)directory_entry->start) == 0))) {
+    // marked as compressed but the container header is missing
+    return SYSFS_SET_RETURN(EIO);
+  }
+
   assetfs_handle_t *h = malloc(sizeof(assetfs_handle_t));
   if (h == 0) {
     return -1;
@@ -62,6 +80,19 @@ int assetfs_open(const void *cfg, void **handle, const char *path, int flags, in
   h->ino = ino;
   h->data = (const void *)(directory_entry->start);
   h->size = directory_entry->end - directory_entry->start;
+  h->lz = NULL;
+  if (is_compressed(directory_entry)) {
+    // decompressed as it is read
+    h->lz = malloc(sizeof(assetfs_lz_t));
+    if (h->lz == NULL) {
+      free(h);
+      return -1;
+    }
+    sos_lz_decoder_init(&h->lz->decoder);
+    h->lz->src_loc = 0;
+    h->lz->src_size = h->size;
+    h->size = ((const sos_lz_header_t *)h->data)->size;
+  }
   cortexm_assign_zero_sum32(h, sizeof(assetfs_handle_t) / sizeof(u32));
 
   *handle = h;
@@ -95,10 +126,32 @@ int assetfs_read(
   }
   // don't read past the end of the file
 
+  if (h->lz != NULL) {
+    return read_compressed(h, loc, buf, bytes_ready);
+  }
+
   memcpy(buf, (u8 *)h->data + loc, bytes_ready);
   return bytes_ready;
 }
 
+int assetfs_map(const void *cfg, void *handle, int loc, const void **addr) {
+  MCU_UNUSED_ARGUMENT(cfg);
+  assetfs_handle_t *h = handle;
+  if (cortexm_verify_zero_sum32(h, sizeof(assetfs_handle_t) / sizeof(u32)) == 0) {
+    return SYSFS_SET_RETURN(EINVAL);
+  }
+  if (loc < 0) {
+    return SYSFS_SET_RETURN(EINVAL);
+  }
+  if (h->lz != NULL) {
+    // the caller reads compressed entries
+    return SYSFS_SET_RETURN(ENOTSUP);
+  }
+  // the data is in flash so the caller can use it in place
+  *addr = (const u8 *)h->data + loc;
+  return (u32)loc < h->size ? h->size - loc : 0;
+}
+
 int assetfs_ioctl(const void *cfg, void *handle, int request, void *ctl) {
   MCU_UNUSED_ARGUMENT(cfg);
   MCU_UNUSED_ARGUMENT(handle);
@@ -114,7 +167,9 @@ int assetfs_close(const void *cfg, void **handle) {
     if (cortexm_verify_zero_sum32(*handle, sizeof(assetfs_handle_t) / sizeof(u32)) == 0) {
       return SYSFS_SET_RETURN(EINVAL);
     }
-    free(*handle);
+    assetfs_handle_t *h = *handle;
+    free(h->lz);
+    free(h);
     *handle = 0;
   }
   return 0;
@@ -149,13 +204,61 @@ int assetfs_stat(const void *cfg, const char *path, struct stat *st) {
 void assign_stat(int ino, const assetfs_dirent_t *entry, struct stat *st) {
   *st = (struct stat){};
   st->st_size = entry->end - entry->start;
+  if (is_compressed(entry) && (st->st_size >= (off_t)sizeof(sos_lz_header_t))) {
+    st->st_size = ((const sos_lz_header_t *)entry->start)->size;
+  }
   st->st_ino = ino;
-  st->st_mode = entry->mode | S_IFREG;
+  st->st_mode = (entry->mode & ~ASSETFS_MODE_COMPRESSED) | S_IFREG;
   st->st_uid = entry->uid;
   //give the caller the direct address of the data
   st->st_blocks = entry->start;
 }
 
+int is_compressed(const assetfs_dirent_t *entry) {
+  // set by the image builder (ASSETFS_COMPRESSED_ENTRY()) -- the contents are never
+  // used to decide because a plain file may start with the same bytes
+  return (entry->mode & ASSETFS_MODE_COMPRESSED) != 0;
+}
+
+int read_compressed(assetfs_handle_t *h, int loc, void *buf, int nbyte) {
+  assetfs_lz_t *lz = h->lz;
+  const u8 *src = h->data;
+
+  if ((u32)loc < lz->decoder.total) {
+    // reading backwards starts over
+    sos_lz_decoder_init(&lz->decoder);
+    lz->src_loc = 0;
+  }
+
+  int bytes_read = 0;
+  while (bytes_read < nbyte) {
+    // data before loc is decoded into buf and discarded
+    const int is_skip = lz->decoder.total < (u32)loc;
+    u8 *dest = is_skip ? buf : (u8 *)buf + bytes_read;
+    u32 dest_size = nbyte - bytes_read;
+    if (is_skip && (dest_size > loc - lz->decoder.total)) {
+      dest_size = loc - lz->decoder.total;
+    }
+
+    u32 used = lz->src_size - lz->src_loc;
+    const int bytes =
+      sos_lz_decode(&lz->decoder, src + lz->src_loc, &used, dest, dest_size);
+    if (bytes < 0) {
+      return SYSFS_SET_RETURN(EIO);
+    }
+    lz->src_loc += used;
+
+    if (bytes == 0) {
+      // the compressed data ended early
+      break;
+    }
+    if (is_skip == 0) {
+      bytes_read += bytes;
+    }
+  }
+  return bytes_read;
+}
+
 int assetfs_opendir(const void *cfg, void **handle, const char *path) {
   MCU_UNUSED_ARGUMENT(cfg);
   if (strncmp(path, "", PATH_MAX) == 0) {
@@ -3,7 +3,11 @@
 
 #include "sos/fs/sysfs.h"
 #include <errno.h>
+#include <stdlib.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "config.h"
 
 #include "../scheduler/scheduler_local.h"
 #include "../unistd/unistd_fs.h"
@@ -11,7 +15,9 @@
 
 #include "sos/fs/devfs.h"
 
+#include "../name_index/name_index.h"
 #include "devfs_local.h"
+#include "sysfs_local.h"
 
 typedef struct {
   int err;
@@ -23,6 +29,14 @@ static void svcall_open_device(void *args) MCU_ROOT_EXEC_CODE;
 static void svcall_close_device(void *args) MCU_ROOT_EXEC_CODE;
 static int get_total(const devfs_device_t *list);
 static void svcall_ioctl(void *args) MCU_ROOT_EXEC_CODE;
+static int vector_transfer(
+  const void *config,
+  const devfs_device_t *device,
+  int flags,
+  int loc,
+  const struct iovec *iov,
+  int iovcnt,
+  int is_read);
 
 int get_total(const devfs_device_t *list) {
   int total;
@@ -33,9 +47,46 @@ int get_total(const devfs_device_t *list) {
   return total;
 }
 
+// index of sos_config.fs.devfs_list (other lists are scanned)
+static const devfs_device_t *devfs_name_index_list;
+static name_index_node_t *devfs_name_index_node;
+static name_index_t devfs_name_index;
+
+int devfs_init_name_index(const devfs_device_t *list) {
+  const int total = get_total(list);
+  const u16 bucket_count = name_index_bucket_count(total);
+  name_index_node_t **bucket = malloc(
+    bucket_count * sizeof(name_index_node_t *) + total * sizeof(name_index_node_t));
+  if (bucket == NULL) {
+    return -1;
+  }
+
+  devfs_name_index_node = (name_index_node_t *)(bucket + bucket_count);
+  name_index_init(&devfs_name_index, bucket, bucket_count);
+  for (int i = 0; i < total; i++) {
+    name_index_insert(
+      &devfs_name_index, devfs_name_index_node + i, list[i].name, DEVFS_NAME_MAX);
+  }
+  devfs_name_index_list = list;
+  return 0;
+}
+
 const devfs_device_t *
 devfs_lookup_device(const devfs_device_t *list, const char *device_name) {
   int i;
+
+  if ((list == devfs_name_index_list) && name_index_is_valid(&devfs_name_index)) {
+    for (name_index_node_t *node =
+           name_index_first(&devfs_name_index, device_name, DEVFS_NAME_MAX);
+         node != NULL; node = node->next) {
+      i = node - devfs_name_index_node;
+      if (strncmp(device_name, list[i].name, DEVFS_NAME_MAX) == 0) {
+        return &list[i];
+      }
+    }
+    return 0;
+  }
+
   i = 0;
   while (devfs_is_terminator(&(list[i])) == 0) {
     if (strncmp(device_name, list[i].name, DEVFS_NAME_MAX) == 0) {
@@ -207,6 +258,94 @@ int devfs_write(
   return devfs_data_transfer(cfg, handle, flags, loc, (void *)buf, nbyte, 0);
 }
 
+int devfs_readv(
+  const void *config,
+  void *handle,
+  int flags,
+  int loc,
+  const struct iovec *iov,
+  int iovcnt) {
+  return vector_transfer(config, handle, flags, loc, iov, iovcnt, 1);
+}
+
+int devfs_writev(
+  const void *config,
+  void *handle,
+  int flags,
+  int loc,
+  const struct iovec *iov,
+  int iovcnt) {
+  return vector_transfer(config, handle, flags, loc, iov, iovcnt, 0);
+}
+
+int vector_transfer(
+  const void *config,
+  const devfs_device_t *device,
+  int flags,
+  int loc,
+  const struct iovec *iov,
+  int iovcnt,
+  int is_read) {
+
+#if CONFIG_DEVFS_VECTOR_BUFFER_SIZE > 0
+  int nbyte = 0;
+  for (int i = 0; i < iovcnt; i++) {
+    nbyte += iov[i].iov_len;
+  }
+
+  if ((iovcnt > 1) && (nbyte <= CONFIG_DEVFS_VECTOR_BUFFER_SIZE)) {
+    // small buffers (eg a header and payload) are one device transfer (one packet)
+    char buffer[CONFIG_DEVFS_VECTOR_BUFFER_SIZE];
+    int offset = 0;
+    if (is_read == 0) {
+      for (int i = 0; i < iovcnt; i++) {
+        memcpy(buffer + offset, iov[i].iov_base, iov[i].iov_len);
+        offset += iov[i].iov_len;
+      }
+    }
+
+    const int result =
+      devfs_data_transfer(config, device, flags, loc, buffer, nbyte, is_read);
+
+    if (is_read && (result > 0)) {
+      for (int i = 0; (i < iovcnt) && (offset < result); i++) {
+        int bytes = result - offset;
+        if (bytes > (int)iov[i].iov_len) {
+          bytes = iov[i].iov_len;
+        }
+        memcpy(iov[i].iov_base, buffer + offset, bytes);
+        offset += bytes;
+      }
+    }
+    return result;
+  }
+#endif
+
+  int total = 0;
+  for (int i = 0; i < iovcnt; i++) {
+    const int size = iov[i].iov_len;
+    if (size == 0) {
+      continue;
+    }
+
+    const int result =
+      devfs_data_transfer(config, device, flags, loc, iov[i].iov_base, size, is_read);
+    if (result < 0) {
+      return total ? total : result;
+    }
+
+    total += result;
+    if ((flags & O_CHAR) == 0) {
+      loc += result;
+    }
+
+    if (result < size) {
+      break;
+    }
+  }
+  return total;
+}
+
 int devfs_aio(const void *config, void *handle, struct aiocb *aio) {
   return devfs_aio_data_transfer(handle, aio);
 }
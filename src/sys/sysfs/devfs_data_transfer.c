@@ -103,7 +103,8 @@ void svcall_device_data_transfer(void *args) {
   }
 
   // assume the operation is going to block
-  sos_sched_table[task_get_current()].block_object = (u8 *)p->device + p->transfer_type;
+  scheduler_root_set_block_object(
+    task_get_current(), (u8 *)p->device + p->transfer_type);
   if (p->transfer_type == ARGS_TRANSFER_READ) {
     p->result = dev->driver.read(&(dev->handle), &(p->async));
   } else {
@@ -138,7 +139,7 @@ void root_check_op_complete(void *args) {
     } else {
       // p->result is not zero OR nbyte is less than zero-> means:
       // operation happened sychronously -- no need to block
-      sos_sched_table[task_get_current()].block_object = 0;
+      scheduler_root_set_block_object(task_get_current(), NULL);
       p->transfer_type = ARGS_TRANSFER_DONE;
     }
   }
@@ -9,6 +9,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -16,8 +17,15 @@
 #include "sos/debug.h"
 #include "sos/fs/sysfs.h"
 
+#include "../name_index/name_index.h"
+#include "sysfs_local.h"
+
 #define OR_ALLOW_GROUP 0
 
+// mount paths are indexed by their first path element ("/" is indexed as "")
+static name_index_node_t *sysfs_name_index_node;
+static name_index_t sysfs_name_index;
+
 const char sysfs_validset[] =
   "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789-_./";
 const char sysfs_whitespace[] = " \t\r\n";
@@ -99,7 +107,94 @@ const char *sysfs_get_filename(const char *path) {
   return name;
 }
 
+// length of the first element of path (e.g. 3 for "/dev/uart0")
+static int sysfs_first_element(const char *path, const char **element) {
+  int len = 0;
+  if (path[0] == '/') {
+    path++;
+  }
+  *element = path;
+  while ((len < SYSFS_MOUNT_PATH_MAX) && (path[len] != 0) && (path[len] != '/')) {
+    len++;
+  }
+  return len;
+}
+
+static bool sysfs_is_match(
+  const sysfs_t *fs,
+  const char *path,
+  int pathlen,
+  bool needs_parent) {
+  int mountlen = strnlen(fs->mount_path, SYSFS_MOUNT_PATH_MAX);
+  if (strncmp(path, fs->mount_path, mountlen) == 0) {
+    if (
+      (mountlen > 0) && (fs->mount_path[mountlen - 1] != '/') && (path[mountlen] != 0)
+      && (path[mountlen] != '/')) {
+      // match whole path elements only ("/home" does not match "/homer")
+      return false;
+    }
+    if (needs_parent == true) {
+      if ((pathlen > (mountlen + 1)) || (pathlen == 1)) {
+        return true;
+      }
+    } else {
+      return true;
+    }
+  }
+  return false;
+}
+
+// lowest table entry in the bucket of element that matches path
+static const sysfs_t *sysfs_find_indexed(
+  const sysfs_t *best,
+  const char *element,
+  int element_len,
+  const char *path,
+  int pathlen,
+  bool needs_parent) {
+  const sysfs_t *sysfs_list = sos_config.fs.rootfs_list;
+  for (name_index_node_t *node = name_index_first(&sysfs_name_index, element, element_len);
+       node != NULL; node = node->next) {
+    const sysfs_t *fs = sysfs_list + (node - sysfs_name_index_node);
+    if ((best != NULL) && (fs > best)) {
+      // bucket is in table order
+      return best;
+    }
+    if (sysfs_is_match(fs, path, pathlen, needs_parent)) {
+      return fs;
+    }
+  }
+  return best;
+}
+
+int sysfs_init_name_index() {
+  const sysfs_t *sysfs_list = sos_config.fs.rootfs_list;
+  int total = 0;
+  while (sysfs_isterminator(&(sysfs_list[total])) == false) {
+    total++;
+  }
+
+  const u16 bucket_count = name_index_bucket_count(total);
+  name_index_node_t **bucket = malloc(
+    bucket_count * sizeof(name_index_node_t *) + total * sizeof(name_index_node_t));
+  if (bucket == NULL) {
+    return -1;
+  }
+
+  sysfs_name_index_node = (name_index_node_t *)(bucket + bucket_count);
+  name_index_init(&sysfs_name_index, bucket, bucket_count);
+  for (int i = 0; i < total; i++) {
+    const char *element;
+    const int len = sysfs_first_element(sysfs_list[i].mount_path, &element);
+    name_index_insert(&sysfs_name_index, sysfs_name_index_node + i, element, len);
+  }
+  return 0;
+}
+
 /*! \details This finds the filesystem associated with a path.
+ *
+ * Once the name index is built, only mount paths that share the first
+ * element of \a path (or the root mount "/") are compared.
  *
  */
 const sysfs_t *sysfs_find(const char *path, bool needs_parent) {
@@ -108,17 +203,22 @@ const sysfs_t *sysfs_find(const char *path, bool needs_parent) {
   pathlen = strnlen(path, PATH_MAX);
   const sysfs_t *sysfs_list = sos_config.fs.rootfs_list;
 
+  if (name_index_is_valid(&sysfs_name_index)) {
+    const char *element;
+    const int len = sysfs_first_element(path, &element);
+    const sysfs_t *result =
+      sysfs_find_indexed(NULL, element, len, path, pathlen, needs_parent);
+    if (len > 0) {
+      // the root mount can also match
+      result = sysfs_find_indexed(result, "", 0, path, pathlen, needs_parent);
+    }
+    return result;
+  }
+
   i = 0;
   while (sysfs_isterminator(&(sysfs_list[i])) == false) {
-    int mountlen = strnlen(sysfs_list[i].mount_path, SYSFS_MOUNT_PATH_MAX);
-    if (strncmp(path, sysfs_list[i].mount_path, mountlen) == 0) {
-      if (needs_parent == true) {
-        if ((pathlen > (mountlen + 1)) || (pathlen == 1)) {
-          return &sysfs_list[i];
-        }
-      } else {
-        return &sysfs_list[i];
-      }
+    if (sysfs_is_match(sysfs_list + i, path, pathlen, needs_parent)) {
+      return &sysfs_list[i];
     }
     i++;
   }
@@ -4,11 +4,20 @@
 #include "sos/debug.h"
 #include "sos/fs/sysfs.h"
 #include <fcntl.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 extern int
 devfs_open(const void *cfg, void **handle, const char *path, int flags, int mode);
 static void update_loc(sysfs_file_t *file, int adjust);
+static int vector_transfer(
+  const sysfs_t *fs,
+  void *handle,
+  int flags,
+  int loc,
+  const struct iovec *iov,
+  int iovcnt,
+  int is_read);
 
 int sysfs_file_open(sysfs_file_t *file, const char *name, int mode) {
   int ret;
@@ -59,6 +68,94 @@ int sysfs_file_write(sysfs_file_t *file, const void *buf, int nbyte) {
   return bytes;
 }
 
+int sysfs_file_readv(sysfs_file_t *file, const struct iovec *iov, int iovcnt) {
+  const sysfs_t *fs = file->fs;
+  int bytes;
+  if (fs->readv != NULL) {
+    bytes = fs->readv(fs->config, file->handle, file->flags, file->loc, iov, iovcnt);
+  } else {
+    bytes = vector_transfer(fs, file->handle, file->flags, file->loc, iov, iovcnt, 1);
+  }
+  SYSFS_PROCESS_RETURN(bytes);
+  update_loc(file, bytes);
+  return bytes;
+}
+
+int sysfs_file_writev(sysfs_file_t *file, const struct iovec *iov, int iovcnt) {
+  const sysfs_t *fs = file->fs;
+  int bytes;
+  if (fs->writev != NULL) {
+    bytes = fs->writev(fs->config, file->handle, file->flags, file->loc, iov, iovcnt);
+  } else {
+    bytes = vector_transfer(fs, file->handle, file->flags, file->loc, iov, iovcnt, 0);
+  }
+  SYSFS_PROCESS_RETURN(bytes);
+  update_loc(file, bytes);
+  return bytes;
+}
+
+int sysfs_file_pread(sysfs_file_t *file, int loc, void *buf, int nbyte) {
+  const sysfs_t *fs = file->fs;
+  // the file offset is not used or updated
+  int bytes = fs->read(fs->config, file->handle, file->flags, loc, buf, nbyte);
+  SYSFS_PROCESS_RETURN(bytes);
+  return bytes;
+}
+
+int sysfs_file_pwrite(sysfs_file_t *file, int loc, const void *buf, int nbyte) {
+  const sysfs_t *fs = file->fs;
+  int bytes = fs->write(fs->config, file->handle, file->flags, loc, buf, nbyte);
+  SYSFS_PROCESS_RETURN(bytes);
+  return bytes;
+}
+
+int sysfs_file_map(sysfs_file_t *file, int loc, const void **addr) {
+  const sysfs_t *fs = file->fs;
+  if (fs->map == NULL) {
+    errno = ENOTSUP;
+    return -1;
+  }
+  int bytes = fs->map(fs->config, file->handle, loc, addr);
+  SYSFS_PROCESS_RETURN(bytes);
+  return bytes;
+}
+
+int vector_transfer(
+  const sysfs_t *fs,
+  void *handle,
+  int flags,
+  int loc,
+  const struct iovec *iov,
+  int iovcnt,
+  int is_read) {
+  int total = 0;
+  for (int i = 0; i < iovcnt; i++) {
+    const int nbyte = iov[i].iov_len;
+    if (nbyte == 0) {
+      continue;
+    }
+
+    const int bytes =
+      is_read ? fs->read(fs->config, handle, flags, loc, iov[i].iov_base, nbyte)
+              : fs->write(fs->config, handle, flags, loc, iov[i].iov_base, nbyte);
+    if (bytes < 0) {
+      // report the data that was transferred before the error
+      return total ? total : bytes;
+    }
+
+    total += bytes;
+    if ((flags & O_CHAR) == 0) {
+      loc += bytes;
+    }
+
+    if (bytes < nbyte) {
+      // short transfer (end of file or no more data available)
+      break;
+    }
+  }
+  return total;
+}
+
 int sysfs_file_aio(sysfs_file_t *file, void *aiocbp) {
   const sysfs_t *fs = file->fs;
   int ret = fs->aio(fs->config, file->handle, aiocbp);
@@ -0,0 +1,14 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SYSFS_SYSFS_LOCAL_H_
+#define SYSFS_SYSFS_LOCAL_H_
+
+#include "sos/fs/devfs.h"
+#include "sos/fs/sysfs.h"
+
+// build the name indexes for the static tables in sos_config.fs
+// lookups fall back to scanning the table until these are called
+int sysfs_init_name_index();
+int devfs_init_name_index(const devfs_device_t *list);
+
+#endif /* SYSFS_SYSFS_LOCAL_H_ */
@@ -81,6 +81,7 @@ void svcall_stop_threads(int *send_signal) {
   for (i = 1; i < task_get_total(); i++) {
     if (task_get_pid(i) == tmp) {
       if (i != task_get_current()) {
+        scheduler_root_wait_queue_remove(i);
         sos_sched_table[i].flags = 0;
         task_root_delete(i);
       }
@@ -148,6 +149,7 @@ void svcall_zombie_process(int *signal_sent) {
   CORTEXM_SVCALL_ENTER();
   if (*signal_sent == false) {
     // discard this thread immediately
+    scheduler_root_wait_queue_remove(task_get_current());
     sos_sched_table[task_get_current()].flags = 0;
     task_root_delete(task_get_current());
   } else {
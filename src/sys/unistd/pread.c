@@ -0,0 +1,56 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+/*! \addtogroup unistd
+ * @{
+ */
+
+/*! \file */
+
+#include "../scheduler/scheduler_local.h"
+#include "unistd_fs.h"
+#include "unistd_local.h"
+
+/*! \details This function reads \a nbyte bytes from \a fildes at \a offset
+ * to the memory location pointed to by \a buf. The file offset of \a fildes
+ * is not used or changed so threads can share a descriptor without lseek().
+ *
+ * \return The number of bytes read or -1 with errno (see \ref errno) set to:
+ * - EBADF:  \a fildes is bad
+ * - EACCES:  \a fildes is in O_WRONLY mode
+ * - EINVAL:  \a offset is negative
+ * - ESPIPE:  \a fildes is a socket
+ * - EIO:  IO error
+ *
+ */
+ssize_t pread(
+  int fildes /*! The file descriptor returned by \ref open() */,
+  void *buf /*! A pointer to the destination memory */,
+  size_t nbyte /*! The number of bytes to read */,
+  off_t offset /*! The location to read from */) {
+  scheduler_check_cancellation();
+
+  if (FILDES_IS_SOCKET(fildes)) {
+    errno = ESPIPE;
+    return -1;
+  }
+
+  fildes = u_fildes_is_bad(fildes);
+  if (fildes < 0) {
+    errno = EBADF;
+    return -1;
+  }
+
+  if (offset < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if ((get_flags(fildes) & O_ACCMODE) == O_WRONLY) {
+    errno = EACCES;
+    return -1;
+  }
+
+  return sysfs_file_pread(get_open_file(fildes), offset, buf, nbyte);
+}
+
+/*! @} */
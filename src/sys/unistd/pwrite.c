@@ -0,0 +1,55 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+/*! \addtogroup unistd
+ * @{
+ */
+
+/*! \file */
+
+#include "../scheduler/scheduler_local.h"
+#include "unistd_fs.h"
+#include "unistd_local.h"
+
+/*! \details This function writes \a nbyte bytes from \a buf to \a fildes at
+ * \a offset. The file offset of \a fildes is not used or changed.
+ *
+ * \return The number of bytes written or -1 with errno (see \ref errno) set to:
+ * - EBADF:  \a fildes is bad
+ * - EACCES:  \a fildes is in O_RDONLY mode
+ * - EINVAL:  \a offset is negative
+ * - ESPIPE:  \a fildes is a socket
+ * - EIO:  IO error
+ *
+ */
+ssize_t pwrite(
+  int fildes /*! The file descriptor returned by \ref open() */,
+  const void *buf /*! A pointer to the source memory */,
+  size_t nbyte /*! The number of bytes to write */,
+  off_t offset /*! The location to write to */) {
+  scheduler_check_cancellation();
+
+  if (FILDES_IS_SOCKET(fildes)) {
+    errno = ESPIPE;
+    return -1;
+  }
+
+  fildes = u_fildes_is_bad(fildes);
+  if (fildes < 0) {
+    errno = EBADF;
+    return -1;
+  }
+
+  if (offset < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if ((get_flags(fildes) & O_ACCMODE) == O_RDONLY) {
+    errno = EACCES;
+    return -1;
+  }
+
+  return sysfs_file_pwrite(get_open_file(fildes), offset, buf, nbyte);
+}
+
+/*! @} */
@@ -0,0 +1,93 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+/*! \addtogroup unistd
+ * @{
+ */
+
+/*! \file */
+
+#include <limits.h>
+#include <sys/uio.h>
+
+#include "../scheduler/scheduler_local.h"
+#include "sos/sos.h"
+#include "sys/socket.h"
+#include "unistd_fs.h"
+#include "unistd_local.h"
+
+/*! \details This function reads from \a fildes into the \a iovcnt buffers in
+ * \a iov (in order) with one call. The buffers are filled like one read() of
+ * the total size: a short read stops at the buffer where the data ran out.
+ *
+ * Filesystems (and devfs) may provide a vectored read so small buffers are
+ * filled by a single transfer; otherwise each buffer is read in turn.
+ *
+ * \return The number of bytes read or -1 with errno (see \ref errno) set to:
+ * - EBADF:  \a fildes is bad
+ * - EACCES:  \a fildes is in O_WRONLY mode
+ * - EINVAL:  \a iovcnt is not between 1 and IOV_MAX or the total size overflows
+ * - EIO:  IO error
+ * - EAGAIN:  O_NONBLOCK is set for \a fildes and no new data is available
+ *
+ */
+int readv(int fildes, const struct iovec *iov, int iovcnt) {
+  scheduler_check_cancellation();
+
+  if (u_iovec_is_bad(iov, iovcnt)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (FILDES_IS_SOCKET(fildes)) {
+    if (sos_config.socket_api != 0) {
+      int total = 0;
+      for (int i = 0; i < iovcnt; i++) {
+        const int bytes = SOS_SOCKET_API()->read(
+          fildes & ~FILDES_SOCKET_FLAG, iov[i].iov_base, iov[i].iov_len);
+        if (bytes < 0) {
+          return total ? total : bytes;
+        }
+        total += bytes;
+        if (bytes < (int)iov[i].iov_len) {
+          break;
+        }
+      }
+      return total;
+    }
+    errno = EBADF;
+    return -1;
+  }
+
+  fildes = u_fildes_is_bad(fildes);
+  if (fildes < 0) {
+    errno = EBADF;
+    return -1;
+  }
+
+  if ((get_flags(fildes) & O_ACCMODE) == O_WRONLY) {
+    errno = EACCES;
+    return -1;
+  }
+
+  return sysfs_file_readv(get_open_file(fildes), iov, iovcnt);
+}
+
+/*! \cond */
+int u_iovec_is_bad(const struct iovec *iov, int iovcnt) {
+  if ((iov == NULL) || (iovcnt <= 0) || (iovcnt > IOV_MAX)) {
+    return 1;
+  }
+
+  // the total is returned as an int
+  size_t total = 0;
+  for (int i = 0; i < iovcnt; i++) {
+    if (iov[i].iov_len > (size_t)INT_MAX - total) {
+      return 1;
+    }
+    total += iov[i].iov_len;
+  }
+  return 0;
+}
+/*! \endcond */
+
+/*! @} */
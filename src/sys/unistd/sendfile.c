@@ -0,0 +1,268 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+/*! \addtogroup unistd
+ * @{
+ */
+
+/*! \file */
+
+#include "config.h"
+#include <aio.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <sys/sendfile.h>
+
+#include "../scheduler/scheduler_local.h"
+#include "sos/fs/devfs.h"
+#include "sos/sos.h"
+#include "sys/socket.h"
+#include "unistd_fs.h"
+#include "unistd_local.h"
+
+/*! \cond */
+typedef struct {
+  int fildes;         // socket (without FILDES_SOCKET_FLAG) or file descriptor
+  sysfs_file_t *file; // NULL for a socket
+  struct aiocb aiocb; // write in progress when is_async is set
+  u8 is_async;
+} sendfile_out_t;
+
+static int send_mapped(sendfile_out_t *out, sysfs_file_t *in, int loc, int count);
+static int send_buffered(sendfile_out_t *out, sysfs_file_t *in, int loc, int count);
+static int write_out(sendfile_out_t *out, const void *buf, int nbyte);
+static int start_write(sendfile_out_t *out, const void *buf, int nbyte);
+static int finish_write(sendfile_out_t *out);
+/*! \endcond */
+
+/*! \details This function copies up to \a count bytes from \a in_fd to
+ * \a out_fd without passing the data through the caller.
+ *
+ * If \a offset is NULL, the data is read from the file offset of \a in_fd which
+ * is updated. Otherwise, the data is read from \a *offset which is updated and
+ * the file offset of \a in_fd is not changed.
+ *
+ * If the source filesystem has the data in memory (for example, assetfs), it is
+ * written to \a out_fd directly from there. Otherwise, it is read into a buffer
+ * (see CONFIG_SENDFILE_BUFFER_SIZE). When \a out_fd is a device (without
+ * O_NONBLOCK), the buffer is written asynchronously while the next one is
+ * read.
+ *
+ * \return The number of bytes written to \a out_fd or -1 with errno (see \ref
+ * errno) set to:
+ * - EBADF: \a in_fd is not open for reading or \a out_fd is not open for writing
+ * - EINVAL: \a in_fd is a socket or \a offset is negative
+ * - ENOMEM: the buffers could not be allocated
+ * - EIO: IO error
+ * - EAGAIN: O_NONBLOCK is set for \a out_fd and the device is busy
+ *
+ */
+ssize_t sendfile(
+  int out_fd /*! The descriptor to write (may be a socket) */,
+  int in_fd /*! The descriptor to read */,
+  off_t *offset /*! The location to read from or NULL to use the file offset */,
+  size_t count /*! The number of bytes to copy */) {
+  sendfile_out_t out;
+  scheduler_check_cancellation();
+
+  if (FILDES_IS_SOCKET(in_fd)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  in_fd = u_fildes_is_bad(in_fd);
+  if ((in_fd < 0) || ((get_flags(in_fd) & O_ACCMODE) == O_WRONLY)) {
+    errno = EBADF;
+    return -1;
+  }
+
+  memset(&out, 0, sizeof(out));
+  if (FILDES_IS_SOCKET(out_fd)) {
+    if (sos_config.socket_api == 0) {
+      errno = EBADF;
+      return -1;
+    }
+    out.fildes = out_fd & ~FILDES_SOCKET_FLAG;
+  } else {
+    out_fd = u_fildes_is_bad(out_fd);
+    if ((out_fd < 0) || ((get_flags(out_fd) & O_ACCMODE) == O_RDONLY)) {
+      errno = EBADF;
+      return -1;
+    }
+    out.fildes = out_fd;
+    out.file = get_open_file(out_fd);
+    out.is_async =
+      (out.file->fs->aio == devfs_aio) && ((out.file->flags & O_NONBLOCK) == 0);
+  }
+
+  if ((offset != NULL) && (*offset < 0)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (count > INT_MAX) {
+    count = INT_MAX;
+  }
+
+  sysfs_file_t *in = get_open_file(in_fd);
+  const int loc = offset != NULL ? *offset : in->loc;
+  int result = -1;
+  if (in->fs->map != NULL) {
+    result = send_mapped(&out, in, loc, count);
+  }
+  if ((in->fs->map == NULL) || ((result < 0) && (errno == ENOTSUP))) {
+    // not mapped (for example, a compressed assetfs entry)
+    result = send_buffered(&out, in, loc, count);
+  }
+
+  // the next read continues after the last byte that was written
+  if ((result > 0) && ((in->flags & O_CHAR) == 0)) {
+    if (offset != NULL) {
+      *offset = loc + result;
+    } else {
+      in->loc = loc + result;
+    }
+  }
+  return result;
+}
+
+/*! \cond */
+int send_mapped(sendfile_out_t *out, sysfs_file_t *in, int loc, int count) {
+  int sent = 0;
+  while (sent < count) {
+    const void *addr;
+    int nbyte = sysfs_file_map(in, loc + sent, &addr);
+    if (nbyte <= 0) {
+      return sent ? sent : nbyte;
+    }
+    if (nbyte > count - sent) {
+      nbyte = count - sent;
+    }
+
+    // the whole span is written in place
+    const int bytes = write_out(out, addr, nbyte);
+    if (bytes < 0) {
+      return sent ? sent : bytes;
+    }
+    sent += bytes;
+    if (bytes < nbyte) {
+      break;
+    }
+  }
+  return sent;
+}
+
+int send_buffered(sendfile_out_t *out, sysfs_file_t *in, int loc, int count) {
+  const int size = CONFIG_SENDFILE_BUFFER_SIZE;
+  char *buffer = malloc(out->is_async ? size * 2 : size);
+  if (buffer == NULL) {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  int sent = 0;    // bytes written
+  int pending = 0; // bytes in the asynchronous write
+  int result = 0;
+  int index = 0;
+  while (sent + pending < count) {
+    char *buf = buffer + index * size;
+    int nbyte = count - sent - pending;
+    if (nbyte > size) {
+      nbyte = size;
+    }
+
+    // the previous buffer is written while this one is read
+    const int bytes = sysfs_file_pread(in, loc + sent + pending, buf, nbyte);
+    if (bytes <= 0) {
+      result = bytes;
+      break;
+    }
+
+    if (out->is_async) {
+      if (pending) {
+        const int written = finish_write(out);
+        const int is_short = written != pending;
+        pending = 0;
+        if (written < 0) {
+          result = written;
+          break;
+        }
+        sent += written;
+        if (is_short) {
+          break;
+        }
+      }
+
+      if (start_write(out, buf, bytes) < 0) {
+        result = -1;
+        break;
+      }
+      pending = bytes;
+      index ^= 1;
+    } else {
+      const int written = write_out(out, buf, bytes);
+      if (written < 0) {
+        result = written;
+        break;
+      }
+      sent += written;
+      if (written < bytes) {
+        break;
+      }
+    }
+  }
+
+  if (pending) {
+    const int written = finish_write(out);
+    if (written < 0) {
+      result = written;
+    } else {
+      sent += written;
+    }
+  }
+
+  free(buffer);
+  // report the data that was written before an error
+  return sent ? sent : result;
+}
+
+int write_out(sendfile_out_t *out, const void *buf, int nbyte) {
+  if (out->file == NULL) {
+    return SOS_SOCKET_API()->write(out->fildes, buf, nbyte);
+  }
+  return sysfs_file_write(out->file, buf, nbyte);
+}
+
+int start_write(sendfile_out_t *out, const void *buf, int nbyte) {
+  struct aiocb *aiocbp = &out->aiocb;
+  memset(aiocbp, 0, sizeof(struct aiocb));
+  aiocbp->aio_fildes = out->fildes;
+  aiocbp->aio_offset = out->file->loc;
+  aiocbp->aio_buf = (volatile void *)buf;
+  aiocbp->aio_nbytes = nbyte;
+  aiocbp->aio_lio_opcode = LIO_WRITE;
+  aiocbp->aio_sigevent.sigev_notify = SIGEV_NONE;
+  return sysfs_file_aio(out->file, aiocbp);
+}
+
+int finish_write(sendfile_out_t *out) {
+  struct aiocb *const list[1] = {&out->aiocb};
+  // the buffer is reused when this returns so a signal doesn't end the wait
+  while (aio_error(&out->aiocb) == EINPROGRESS) {
+    aio_suspend(list, 1, NULL);
+  }
+
+  const int error = aio_error(&out->aiocb);
+  if (error) {
+    errno = error;
+    return -1;
+  }
+
+  const int bytes = aio_return(&out->aiocb);
+  if ((out->file->flags & O_CHAR) == 0) {
+    out->file->loc += bytes;
+  }
+  return bytes;
+}
+/*! \endcond */
+
+/*! @} */
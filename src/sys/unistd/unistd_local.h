@@ -21,6 +21,8 @@ int u_new_open_file(int start);
 int u_init_stdio(int fildes);
 int u_get_open_file(int fildes);
 int u_fildes_is_bad(int fildes);
+struct iovec;
+int u_iovec_is_bad(const struct iovec *iov, int iovcnt);
 void u_reset_fildes(int fildes);
 
 static inline void *get_handle(int fildes) MCU_ALWAYS_INLINE;
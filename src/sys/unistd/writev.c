@@ -0,0 +1,63 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+/*! \addtogroup unistd
+ * @{
+ */
+
+/*! \file */
+
+#include <sys/uio.h>
+
+#include "../scheduler/scheduler_local.h"
+#include "sos/sos.h"
+#include "sys/socket.h"
+#include "unistd_fs.h"
+#include "unistd_local.h"
+
+/*! \details This function writes the \a iovcnt buffers in \a iov (in order)
+ * to \a fildes with one call, for example, a protocol header and its payload
+ * without copying them together first.
+ *
+ * Filesystems (and devfs) may provide a vectored write so small buffers are
+ * sent to a device in a single transfer; otherwise each buffer is written in
+ * turn (stopping at a short write).
+ *
+ * \return The number of bytes written or -1 with errno (see \ref errno) set to:
+ * - EBADF:  \a fildes is bad
+ * - EACCES:  \a fildes is in O_RDONLY mode
+ * - EINVAL:  \a iovcnt is not between 1 and IOV_MAX or the total size overflows
+ * - EIO:  IO error
+ * - EAGAIN:  O_NONBLOCK is set for \a fildes and the device is busy
+ *
+ */
+int writev(int fildes, const struct iovec *iov, int iovcnt) {
+  scheduler_check_cancellation();
+
+  if (u_iovec_is_bad(iov, iovcnt)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (FILDES_IS_SOCKET(fildes)) {
+    if (sos_config.socket_api != 0) {
+      return SOS_SOCKET_API()->writev(fildes & ~FILDES_SOCKET_FLAG, iov, iovcnt);
+    }
+    errno = EBADF;
+    return -1;
+  }
+
+  fildes = u_fildes_is_bad(fildes);
+  if (fildes < 0) {
+    errno = EBADF;
+    return -1;
+  }
+
+  if ((get_flags(fildes) & O_ACCMODE) == O_RDONLY) {
+    errno = EACCES;
+    return -1;
+  }
+
+  return sysfs_file_writev(get_open_file(fildes), iov, iovcnt);
+}
+
+/*! @} */
@@ -0,0 +1,440 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <errno.h>
+#include <setjmp.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "boot/boot_link.h"
+#include "host.h"
+#include "sos/config.h"
+#include "sos/crc.h"
+#include "sos/dev/bootloader.h"
+#include "sos/link.h"
+
+// The bootloader's update loop (boot_link_update()) installs signed images
+// sent by a simulated host over a simulated link. The flash is mapped at its
+// MCU address because the bootloader uses 32-bit addresses. Programming,
+// erasing, hashing and verifying take simulated time.
+//
+// The link only moves a request while the bootloader reads it (the USB
+// endpoint holds one packet) and the host needs HOST_TURNAROUND_US after a
+// reply before it sends the next request. Replying to a page before it is
+// hashed and programmed hides that turnaround. The earlier synchronous reply
+// is simulated by holding each page's reply until the bootloader reads the
+// next request.
+//
+// Images are checked in flash after each update, a failed page program must
+// be reported on the next page and by the signature check, and the update
+// time is compared for synchronous replies, early replies and compressed
+// pages.
+
+#define FLASH_ADDRESS 0x08000000
+#define FLASH_PAGE_SIZE 2048
+#define FLASH_SIZE (224 * 1024)
+#define PROGRAM_ADDRESS (FLASH_ADDRESS + 32 * 1024)
+#define PUBLIC_KEY_ADDRESS (FLASH_ADDRESS + 1024)
+#define IMAGE_SIZE (128 * 1024)
+
+#define LINK_NS_PER_BYTE 2000
+#define HOST_TURNAROUND_US 1000
+#define FLASH_WRITE_NS_PER_BYTE 3000
+#define FLASH_ERASE_US 20000
+#define HASH_NS_PER_BYTE 500
+#define VERIFY_US 150000
+
+enum { MODE_SYNCHRONOUS, MODE_EARLY_REPLY, MODE_COMPRESSED };
+
+static u8 *flash;
+static u8 image[IMAGE_SIZE];
+static u8 compressed[LINK_LZ_COMPRESS_BOUND(IMAGE_SIZE)];
+// simulated time in nanoseconds
+static u64 device_time;
+static u32 fail_write_address;
+static int verified_count;
+
+static int flash_erase_page(const devfs_handle_t *handle, void *ctl) {
+  const u32 page = (u32)(size_t)ctl;
+  if ((page < (PROGRAM_ADDRESS - FLASH_ADDRESS) / FLASH_PAGE_SIZE)
+      || (page >= FLASH_SIZE / FLASH_PAGE_SIZE)) {
+    // the bootloader's pages can't be erased
+    return -1;
+  }
+  memset(flash + page * FLASH_PAGE_SIZE, 0xff, FLASH_PAGE_SIZE);
+  device_time += FLASH_ERASE_US * 1000ULL;
+  return 0;
+}
+
+static int flash_write_page(const devfs_handle_t *handle, void *ctl) {
+  const bootloader_writepage_t *page = ctl;
+  TEST_ASSERT(page->addr >= PROGRAM_ADDRESS);
+  TEST_ASSERT(page->addr + page->nbyte <= FLASH_ADDRESS + FLASH_SIZE);
+  device_time += (u64)page->nbyte * FLASH_WRITE_NS_PER_BYTE;
+  if (page->addr == fail_write_address) {
+    errno = EIO;
+    return -1;
+  }
+  u8 *dest = flash + page->addr - FLASH_ADDRESS;
+  for (u32 i = 0; i < page->nbyte; i++) {
+    // programming can only clear bits
+    dest[i] &= page->buf[i];
+  }
+  return page->nbyte;
+}
+
+static int flash_get_page_info(const devfs_handle_t *handle, void *ctl) {
+  flash_pageinfo_t *info = ctl;
+  if (info->page >= FLASH_SIZE / FLASH_PAGE_SIZE) {
+    return -1;
+  }
+  info->addr = FLASH_ADDRESS + info->page * FLASH_PAGE_SIZE;
+  info->size = FLASH_PAGE_SIZE;
+  return 0;
+}
+
+// the hash is a CRC of the hashed bytes so the signature only matches if
+// exactly the image was hashed in order
+static u32 hash_crc;
+
+static int hash_init(void **context) { return 0; }
+
+static int hash_start(void *context) {
+  hash_crc = 0;
+  return 0;
+}
+
+static int hash_update(void *context, const unsigned char *input, u32 size) {
+  hash_crc = sos_crc32(hash_crc, input, size);
+  device_time += (u64)size * HASH_NS_PER_BYTE;
+  return 0;
+}
+
+static int hash_finish(void *context, unsigned char *output, u32 size) {
+  memset(output, 0, size);
+  memcpy(output, &hash_crc, sizeof(hash_crc));
+  return 0;
+}
+
+static const crypt_hash_api_t sha_api = {
+  .init = hash_init, .start = hash_start, .update = hash_update, .finish = hash_finish};
+
+static int ecc_init(void **context) { return 0; }
+
+static int ecc_set_key_pair(
+  void *context,
+  const u8 *public_key,
+  u32 public_key_capacity,
+  const u8 *private_key,
+  u32 private_key_capacity) {
+  TEST_ASSERT(public_key == (const u8 *)PUBLIC_KEY_ADDRESS);
+  return 0;
+}
+
+static int ecc_verify(
+  void *context,
+  const u8 *message_hash,
+  u32 hash_size,
+  const u8 *signature,
+  u32 signature_size) {
+  device_time += VERIFY_US * 1000ULL;
+  if (memcmp(message_hash, signature, hash_size)) {
+    return 0;
+  }
+  verified_count++;
+  return 1;
+}
+
+static const crypt_ecc_api_t ecc_api = {
+  .init = ecc_init, .dsa_set_key_pair = ecc_set_key_pair, .dsa_verify = ecc_verify};
+
+static const void *request_api(u32 request) {
+  switch (request) {
+  case CRYPT_SHA256_ROOT_API_REQUEST:
+    return &sha_api;
+  case CRYPT_ECC_ROOT_API_REQUEST:
+    return &ecc_api;
+  }
+  return NULL;
+}
+
+const sos_config_t sos_config = {
+  .sys =
+    {.kernel_request_api = request_api,
+     .secret_key_address = (const void *)PUBLIC_KEY_ADDRESS,
+     .secret_key_size = 64},
+  .boot = {
+    .program_start_address = PROGRAM_ADDRESS,
+    .flash_erase_page = flash_erase_page,
+    .flash_write_page = flash_write_page,
+    .flash_get_page_info = flash_get_page_info}};
+
+// not used by the updates below
+u32 cortexm_get_hardware_id() { return 0; }
+void cortexm_reset(void *args) { TEST_ASSERT(0); }
+char htoc(int nibble) { return "0123456789ABCDEF"[nibble & 0x0f]; }
+void sos_led_root_enable() {}
+void sos_led_root_disable() {}
+
+int mcu_sync_io(
+  const devfs_handle_t *handle,
+  int (*func)(const devfs_handle_t *handle, devfs_async_t *op),
+  int loc,
+  const void *buf,
+  int nbyte,
+  int flags) {
+  TEST_ASSERT(0);
+  return -1;
+}
+
+// the requests the host sends -- a link_op_t followed by the ioctl data
+typedef struct {
+  link_op_t op;
+  const void *data;
+  int data_size;
+  link_reply_t reply;
+} request_t;
+
+#define REQUEST_MAX 512
+
+static request_t requests[REQUEST_MAX];
+static int request_count;
+static int request_current;
+static int request_loc;
+static int mode;
+static u64 host_send_time;
+static u64 reply_time;
+// when the bootloader starts reading the first page (after the erase)
+static u64 erase_done_time;
+static int pending_reply_size;
+static jmp_buf update_done;
+
+static void add_request(int ioctl_request, const void *data, int data_size) {
+  TEST_ASSERT(request_count < REQUEST_MAX);
+  request_t *request = requests + request_count++;
+  memset(request, 0, sizeof(request_t));
+  request->op.ioctl.cmd = LINK_CMD_IOCTL;
+  request->op.ioctl.request = ioctl_request;
+  request->data = data;
+  request->data_size = data_size;
+  TEST_ASSERT(_IOCTL_SIZE(ioctl_request) == data_size);
+}
+
+static int is_page_request(const request_t *request) {
+  return (request->op.ioctl.request == I_BOOTLOADER_WRITEPAGE)
+         || (request->op.ioctl.request == I_BOOTLOADER_WRITEPAGE_COMPRESSED);
+}
+
+int link_transport_slaveread(
+  link_transport_driver_t *driver,
+  void *buf,
+  int nbyte,
+  int (*callback)(void *, void *, int),
+  void *context) {
+  TEST_ASSERT(callback == NULL);
+
+  if (pending_reply_size) {
+    // the synchronous reply goes out once the page is written
+    device_time += (u64)pending_reply_size * LINK_NS_PER_BYTE;
+    reply_time = device_time;
+    pending_reply_size = 0;
+  }
+
+  if (
+    (request_current < 0)
+    || (request_loc
+        == (int)sizeof(link_op_t) + requests[request_current].data_size)) {
+    request_current++;
+    request_loc = 0;
+    if (request_current == request_count) {
+      longjmp(update_done, 1);
+    }
+    host_send_time = reply_time + HOST_TURNAROUND_US * 1000ULL;
+    if (request_current == 1) {
+      erase_done_time = device_time;
+    }
+  }
+
+  const request_t *request = requests + request_current;
+  if (request_loc == 0) {
+    TEST_ASSERT(nbyte == sizeof(link_op_t));
+    memcpy(buf, &request->op, nbyte);
+  } else {
+    TEST_ASSERT(request_loc + nbyte == (int)sizeof(link_op_t) + request->data_size);
+    memcpy(buf, request->data, nbyte);
+  }
+  request_loc += nbyte;
+
+  // the request moves while the bootloader reads it
+  if (device_time < host_send_time) {
+    device_time = host_send_time;
+  }
+  device_time += (u64)nbyte * LINK_NS_PER_BYTE;
+  return nbyte;
+}
+
+int link_transport_slavewrite(
+  link_transport_driver_t *driver,
+  const void *buf,
+  int nbyte,
+  int (*callback)(void *, void *, int),
+  void *context) {
+  TEST_ASSERT(callback == NULL);
+  TEST_ASSERT(nbyte == sizeof(link_reply_t));
+  request_t *request = requests + request_current;
+  memcpy(&request->reply, buf, nbyte);
+  if ((mode == MODE_SYNCHRONOUS) && is_page_request(request)) {
+    pending_reply_size = nbyte;
+    return nbyte;
+  }
+  device_time += (u64)nbyte * LINK_NS_PER_BYTE;
+  reply_time = device_time;
+  return nbyte;
+}
+
+static link_transport_phy_t transport_open(const char *name, const void *options) {
+  return 0;
+}
+
+static void transport_wait(int msec) { device_time += msec * 1000000ULL; }
+
+static link_transport_driver_t driver = {.open = transport_open, .wait = transport_wait};
+
+// runs the bootloader until it has replied to every request
+static void run_update() {
+  request_current = -1;
+  request_loc = 0;
+  pending_reply_size = 0;
+  if (setjmp(update_done) == 0) {
+    boot_link_update(&driver);
+  }
+  TEST_ASSERT(request_current == request_count);
+}
+
+static bootloader_writepage_t pages[REQUEST_MAX];
+static auth_signature_t signature;
+
+static void add_update(int is_compressed) {
+  request_count = 0;
+  add_request(I_BOOTLOADER_ERASE, NULL, 0);
+
+  const u8 *data = is_compressed ? compressed : image;
+  const int size =
+    is_compressed ? link_lz_compress(image, IMAGE_SIZE, compressed, sizeof(compressed))
+                  : IMAGE_SIZE;
+  TEST_ASSERT(size > 0);
+  for (int loc = 0; loc < size; loc += BOOTLOADER_WRITEPAGESIZE) {
+    bootloader_writepage_t *page = pages + loc / BOOTLOADER_WRITEPAGESIZE;
+    // compressed pages are addressed by their offset in the compressed image
+    page->addr = is_compressed ? loc : PROGRAM_ADDRESS + loc;
+    page->nbyte =
+      size - loc < BOOTLOADER_WRITEPAGESIZE ? size - loc : BOOTLOADER_WRITEPAGESIZE;
+    memcpy(page->buf, data + loc, page->nbyte);
+    add_request(
+      is_compressed ? I_BOOTLOADER_WRITEPAGE_COMPRESSED : I_BOOTLOADER_WRITEPAGE, page,
+      sizeof(bootloader_writepage_t));
+  }
+
+  const u32 crc = sos_crc32(0, image, IMAGE_SIZE);
+  memset(&signature, 0, sizeof(signature));
+  memcpy(signature.data, &crc, sizeof(crc));
+  add_request(I_BOOTLOADER_VERIFY_SIGNATURE, &signature, sizeof(signature));
+}
+
+static void check_replies(int error_index) {
+  for (int i = 0; i < request_count; i++) {
+    const link_reply_t *reply = &requests[i].reply;
+    if (error_index && (i > error_index)) {
+      TEST_ASSERT(reply->err == -1);
+      TEST_ASSERT(reply->err_number == EIO);
+    } else {
+      TEST_ASSERT(reply->err >= 0);
+    }
+  }
+}
+
+static void test_update(int is_compressed) {
+  mode = is_compressed ? MODE_COMPRESSED : MODE_EARLY_REPLY;
+  memset(flash + PROGRAM_ADDRESS - FLASH_ADDRESS, 0, IMAGE_SIZE);
+  fail_write_address = 0;
+  verified_count = 0;
+  add_update(is_compressed);
+  run_update();
+  check_replies(0);
+  TEST_ASSERT(verified_count == 1);
+  TEST_ASSERT(memcmp(flash + PROGRAM_ADDRESS - FLASH_ADDRESS, image, IMAGE_SIZE) == 0);
+}
+
+static void test_write_error() {
+  mode = MODE_EARLY_REPLY;
+  verified_count = 0;
+  // the tenth page (request 10 after the erase) can't be programmed
+  fail_write_address = PROGRAM_ADDRESS + 9 * BOOTLOADER_WRITEPAGESIZE;
+  add_update(0);
+  run_update();
+  check_replies(10);
+  TEST_ASSERT(verified_count == 0);
+  // the first page is only written after the signature is verified
+  const u8 *first_page = flash + PROGRAM_ADDRESS - FLASH_ADDRESS;
+  for (int i = 0; i < 256; i++) {
+    TEST_ASSERT(first_page[i] == 0xff);
+  }
+
+  // a new update starts without the error
+  fail_write_address = 0;
+  run_update();
+  check_replies(0);
+  TEST_ASSERT(verified_count == 1);
+  TEST_ASSERT(memcmp(flash + PROGRAM_ADDRESS - FLASH_ADDRESS, image, IMAGE_SIZE) == 0);
+}
+
+static u64 benchmark(int benchmark_mode) {
+  mode = benchmark_mode;
+  fail_write_address = 0;
+  add_update(mode == MODE_COMPRESSED);
+  device_time = 0;
+  reply_time = 0;
+  run_update();
+  check_replies(0);
+
+  // the erase takes the same time in each mode
+  const u64 total = reply_time - erase_done_time;
+  static const char *names[] = {"synchronous replies", "early replies", "compressed"};
+  printf(
+    "%-20s %3d pages %7.1f ms (%5.2f ms per page)\n", names[mode], request_count - 2,
+    total / 1000000.0, total / 1000000.0 / (request_count - 2));
+  return total;
+}
+
+int main() {
+  // the bootloader reads and writes the flash at its MCU address
+  flash = mmap(
+    (void *)FLASH_ADDRESS, FLASH_SIZE, PROT_READ | PROT_WRITE,
+    MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+  TEST_ASSERT(flash == (u8 *)FLASH_ADDRESS);
+  memset(flash, 0xff, FLASH_SIZE);
+
+  // firmware-like data -- common instruction sequences between constants
+  host_srand(48);
+  static u8 sequences[32][16];
+  for (int i = 0; i < 32; i++) {
+    for (int j = 0; j < 16; j++) {
+      sequences[i][j] = host_rand();
+    }
+  }
+  for (int i = 0; i < IMAGE_SIZE; i += 16) {
+    memcpy(image + i, sequences[host_rand() % 32], 16);
+    if (host_rand() % 2) {
+      image[i + host_rand() % 16] = host_rand();
+    }
+  }
+
+  test_update(0);
+  test_update(1);
+  test_write_error();
+
+  const u64 synchronous_time = benchmark(MODE_SYNCHRONOUS);
+  const u64 early_time = benchmark(MODE_EARLY_REPLY);
+  TEST_ASSERT(early_time < synchronous_time);
+  TEST_ASSERT(benchmark(MODE_COMPRESSED) < early_time);
+  return 0;
+}
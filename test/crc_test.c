@@ -0,0 +1,132 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <string.h>
+
+#include "host.h"
+#include "mcu/crc.h"
+#include "sos/crc.h"
+
+// The kernel CRCs (built once for each CONFIG_CRC_SLICE_COUNT) are checked
+// against the published check values and against bit at a time versions for
+// random lengths, alignments and split buffers, then timed.
+
+#define BUFFER_SIZE 4096
+
+static u32 reference_reflected32(u32 polynomial, u32 crc, const u8 *buffer, u32 nbyte) {
+  crc = ~crc;
+  for (u32 i = 0; i < nbyte; i++) {
+    crc ^= buffer[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc & 1) ? (crc >> 1) ^ polynomial : crc >> 1;
+    }
+  }
+  return ~crc;
+}
+
+static u8 reference_crc7(u8 crc, const u8 *buffer, u32 nbyte) {
+  // the MCU port version returns the command byte (with the end bit)
+  return mcu_calc_crc7(crc, 0x09, buffer, nbyte) >> 1;
+}
+
+static u16 reference_crc16_ccitt(u16 crc, const u8 *buffer, u32 nbyte) {
+  return mcu_calc_crc16(crc, 0x1021, buffer, nbyte);
+}
+
+static u32 reference_crc32(u32 crc, const u8 *buffer, u32 nbyte) {
+  return reference_reflected32(0xEDB88320, crc, buffer, nbyte);
+}
+
+static u32 reference_crc32c(u32 crc, const u8 *buffer, u32 nbyte) {
+  return reference_reflected32(0x82F63B78, crc, buffer, nbyte);
+}
+
+static void test_check_values() {
+  const char check[] = "123456789";
+  TEST_ASSERT(sos_crc7(0, check, 9) == 0x75);
+  TEST_ASSERT(sos_crc16_ccitt(0, check, 9) == 0x31C3);
+  TEST_ASSERT(sos_crc32(0, check, 9) == 0xCBF43926);
+  TEST_ASSERT(sos_crc32c(0, check, 9) == 0xE3069283);
+
+  // SD card CMD0 and CMD8 (0x1AA) command bytes
+  const u8 go_idle[5] = {0x40, 0, 0, 0, 0};
+  const u8 send_if_cond[5] = {0x48, 0, 0, 0x01, 0xAA};
+  TEST_ASSERT(((sos_crc7(0, go_idle, 5) << 1) | 1) == 0x95);
+  TEST_ASSERT(((sos_crc7(0, send_if_cond, 5) << 1) | 1) == 0x87);
+
+  // nothing to add
+  TEST_ASSERT(sos_crc32(0x12345678, check, 0) == 0x12345678);
+}
+
+static void test_random_buffers() {
+  static u8 buffer[BUFFER_SIZE + 8];
+  host_srand(37);
+  for (int i = 0; i < (int)sizeof(buffer); i++) {
+    buffer[i] = host_rand();
+  }
+
+  for (int i = 0; i < 20000; i++) {
+    // short buffers exercise the byte-wise tails and misaligned starts
+    const u32 nbyte = (i % 4) ? host_rand() % 64 : host_rand() % BUFFER_SIZE;
+    const u8 *p = buffer + host_rand() % 8;
+    const u32 split = nbyte ? host_rand() % (nbyte + 1) : 0;
+
+    const u8 crc7 = reference_crc7(0, p, nbyte);
+    TEST_ASSERT(sos_crc7(0, p, nbyte) == crc7);
+    TEST_ASSERT(sos_crc7(sos_crc7(0, p, split), p + split, nbyte - split) == crc7);
+
+    const u16 crc16 = reference_crc16_ccitt(0, p, nbyte);
+    TEST_ASSERT(sos_crc16_ccitt(0, p, nbyte) == crc16);
+    TEST_ASSERT(
+      sos_crc16_ccitt(sos_crc16_ccitt(0, p, split), p + split, nbyte - split) == crc16);
+
+    const u32 crc32 = reference_crc32(0, p, nbyte);
+    TEST_ASSERT(sos_crc32(0, p, nbyte) == crc32);
+    TEST_ASSERT(sos_crc32(sos_crc32(0, p, split), p + split, nbyte - split) == crc32);
+
+    const u32 crc32c = reference_crc32c(0, p, nbyte);
+    TEST_ASSERT(sos_crc32c(0, p, nbyte) == crc32c);
+    TEST_ASSERT(sos_crc32c(sos_crc32c(0, p, split), p + split, nbyte - split) == crc32c);
+  }
+}
+
+static volatile u32 benchmark_result;
+
+static void benchmark(const char *name, u32 (*calc)(const u8 *, u32)) {
+  static u8 buffer[512];
+  const int total = 64 * 1024 * 1024;
+  for (int i = 0; i < (int)sizeof(buffer); i++) {
+    buffer[i] = host_rand();
+  }
+
+  const double start = host_get_seconds();
+  for (int i = 0; i < total; i += sizeof(buffer)) {
+    buffer[0] = i;
+    benchmark_result += calc(buffer, sizeof(buffer));
+  }
+  const double seconds = host_get_seconds() - start;
+  printf(
+    "%-10s (%d slice): %8.1f MB/s\n", name, CONFIG_CRC_SLICE_COUNT,
+    total / seconds / 1000000.0);
+}
+
+static u32 calc_crc7(const u8 *buffer, u32 nbyte) { return sos_crc7(0, buffer, nbyte); }
+
+static u32 calc_crc16_ccitt(const u8 *buffer, u32 nbyte) {
+  return sos_crc16_ccitt(0, buffer, nbyte);
+}
+
+static u32 calc_crc32(const u8 *buffer, u32 nbyte) { return sos_crc32(0, buffer, nbyte); }
+
+static u32 calc_crc32c(const u8 *buffer, u32 nbyte) {
+  return sos_crc32c(0, buffer, nbyte);
+}
+
+int main() {
+  test_check_values();
+  test_random_buffers();
+  benchmark("crc7", calc_crc7);
+  benchmark("crc16", calc_crc16_ccitt);
+  benchmark("crc32", calc_crc32);
+  benchmark("crc32c", calc_crc32c);
+  return 0;
+}
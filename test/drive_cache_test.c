@@ -0,0 +1,345 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <string.h>
+
+#include "device/drive_cache.h"
+#include "device/drive_ram.h"
+#include "host.h"
+
+// drive_cache is layered over drive_ram with an artificial latency. The
+// latency drive either completes transfers before returning or from a
+// simulated interrupt, may transfer less than requested and may stay busy
+// after a write (like a flash page program).
+//
+// Random reads, writes and syncs are checked against a copy of the drive,
+// then the same workloads are timed (in simulated time) with and without the
+// cache.
+
+#define DRIVE_SIZE (256 * 1024)
+#define LATENCY_US 200
+#define BYTES_PER_US 4
+
+static u8 ram_memory[DRIVE_SIZE];
+static const drive_ram_config_t ram_config = {.memory = ram_memory, .size = DRIVE_SIZE};
+static const devfs_handle_t ram_handle = {.config = &ram_config};
+
+enum { MODE_SYNC, MODE_CALLBACK, MODE_INTERRUPT, MODE_COUNT };
+
+static int mode;
+static int max_transfer;
+static int busy_after_write;
+static int busy_count;
+static int close_count;
+static devfs_async_t *pending;
+static int is_pending_write;
+// simulated time in microseconds
+static u64 latency_time;
+
+static int latency_open(const devfs_handle_t *handle) { return drive_ram_open(&ram_handle); }
+
+static int latency_close(const devfs_handle_t *handle) {
+  close_count++;
+  return drive_ram_close(&ram_handle);
+}
+
+static int latency_ioctl(const devfs_handle_t *handle, int request, void *ctl) {
+  if (request == I_DRIVE_ISBUSY) {
+    if (pending) {
+      return 1;
+    }
+    if (busy_count > 0) {
+      busy_count--;
+      return 1;
+    }
+    return 0;
+  }
+  return drive_ram_ioctl(&ram_handle, request, ctl);
+}
+
+static int latency_transfer(devfs_async_t *async, int is_write) {
+  TEST_ASSERT(pending == NULL);
+  if (busy_count > 0) {
+    return SYSFS_SET_RETURN(EBUSY);
+  }
+
+  if (max_transfer && (async->nbyte > max_transfer)) {
+    async->nbyte = max_transfer;
+  }
+  const int result = is_write ? drive_ram_write(&ram_handle, async)
+                              : drive_ram_read(&ram_handle, async);
+  latency_time += LATENCY_US + async->nbyte / BYTES_PER_US;
+  if (is_write) {
+    busy_count = busy_after_write;
+  }
+
+  if ((mode == MODE_SYNC) || (result < 0)) {
+    return result;
+  }
+
+  async->nbyte = result;
+  if (mode == MODE_CALLBACK) {
+    // the transfer completes before read() or write() returns
+    async->result = result;
+    devfs_execute_event_handler(
+      &async->handler,
+      is_write ? MCU_EVENT_FLAG_WRITE_COMPLETE : MCU_EVENT_FLAG_DATA_READY, NULL);
+    return 0;
+  }
+
+  pending = async;
+  is_pending_write = is_write;
+  return 0;
+}
+
+static int latency_read(const devfs_handle_t *handle, devfs_async_t *async) {
+  return latency_transfer(async, 0);
+}
+
+static int latency_write(const devfs_handle_t *handle, devfs_async_t *async) {
+  return latency_transfer(async, 1);
+}
+
+// the drive's interrupt -- returns 0 if nothing was pending
+static int latency_interrupt() {
+  if (pending == NULL) {
+    return 0;
+  }
+  devfs_async_t *async = pending;
+  pending = NULL;
+  async->result = async->nbyte;
+  devfs_execute_event_handler(
+    &async->handler,
+    is_pending_write ? MCU_EVENT_FLAG_WRITE_COMPLETE : MCU_EVENT_FLAG_DATA_READY, NULL);
+  return 1;
+}
+
+DRIVE_CACHE_DECLARE_CONFIG_STATE(
+  cache,
+  ((devfs_device_t){
+    .driver =
+      {.open = latency_open,
+       .ioctl = latency_ioctl,
+       .read = latency_read,
+       .write = latency_write,
+       .close = latency_close}}),
+  512,
+  16,
+  4,
+  2);
+
+static const devfs_handle_t cache_handle = {.config = &cache_config, .state = &cache_state};
+
+static const devfs_device_t cache_device = {
+  .handle = {.config = &cache_config, .state = &cache_state},
+  .driver = {
+    .open = drive_cache_open,
+    .ioctl = drive_cache_ioctl,
+    .read = drive_cache_read,
+    .write = drive_cache_write,
+    .close = drive_cache_close}};
+
+static const devfs_device_t latency_device = {
+  .driver = {
+    .open = latency_open,
+    .ioctl = latency_ioctl,
+    .read = latency_read,
+    .write = latency_write,
+    .close = latency_close}};
+
+static int is_complete;
+
+static int handle_complete(void *context, const mcu_event_t *event) {
+  is_complete = 1;
+  return 0;
+}
+
+static void wait_while_busy(const devfs_device_t *device) {
+  int result;
+  int count = 0;
+  while ((result = device->driver.ioctl(&device->handle, I_DRIVE_ISBUSY, NULL)) > 0) {
+    latency_interrupt();
+    TEST_ASSERT(++count < 100000);
+  }
+  TEST_ASSERT(result == 0);
+}
+
+// what devfs does for a blocking read or write: wait for the completion and
+// retry while the drive is busy
+static int
+transfer_part(const devfs_device_t *device, int loc, u8 *buf, int nbyte, int is_write) {
+  devfs_async_t async;
+  for (int retry = 0; retry < 100; retry++) {
+    memset(&async, 0, sizeof(async));
+    async.tid = 1;
+    async.loc = loc;
+    async.buf = buf;
+    async.nbyte = nbyte;
+    async.handler.callback = handle_complete;
+    is_complete = 0;
+
+    int result = is_write ? device->driver.write(&device->handle, &async)
+                          : device->driver.read(&device->handle, &async);
+    if (result == 0) {
+      int count = 0;
+      while (is_complete == 0) {
+        TEST_ASSERT(latency_interrupt());
+        TEST_ASSERT(++count < 100000);
+      }
+      result = async.result;
+    }
+
+    if ((result < 0) && (SYSFS_GET_RETURN_ERRNO(result) == EBUSY)) {
+      wait_while_busy(device);
+      continue;
+    }
+    return result;
+  }
+  TEST_ASSERT(0);
+  return -1;
+}
+
+static int
+transfer(const devfs_device_t *device, int loc, u8 *buf, int nbyte, int is_write) {
+  int bytes = 0;
+  while (bytes < nbyte) {
+    const int result =
+      transfer_part(device, loc + bytes, buf + bytes, nbyte - bytes, is_write);
+    if (result <= 0) {
+      return result;
+    }
+    bytes += result;
+    // a short transfer can leave the drive busy
+    wait_while_busy(device);
+  }
+  return bytes;
+}
+
+static void sync_cache() {
+  drive_attr_t attr = {.o_flags = DRIVE_FLAG_SYNC};
+  TEST_ASSERT(drive_cache_ioctl(&cache_handle, I_DRIVE_SETATTR, &attr) >= 0);
+  wait_while_busy(&cache_device);
+}
+
+static void close_cache() {
+  close_count = 0;
+  TEST_ASSERT(drive_cache_close(&cache_handle) == 0);
+  int count = 0;
+  while (close_count == 0) {
+    // the drive is closed when the write back finishes
+    if (latency_interrupt() == 0) {
+      drive_cache_ioctl(&cache_handle, I_DRIVE_ISBUSY, NULL);
+    }
+    TEST_ASSERT(++count < 100000);
+  }
+  while (latency_interrupt()) {
+  }
+}
+
+static void test_random_operations() {
+  static u8 model[DRIVE_SIZE];
+  static u8 buffer[8192];
+  host_srand(35);
+  for (int i = 0; i < DRIVE_SIZE; i++) {
+    ram_memory[i] = model[i] = host_rand();
+  }
+
+  for (int round = 0; round < 12; round++) {
+    mode = round % MODE_COUNT;
+    busy_after_write = (round / MODE_COUNT) % 2 ? 2 : 0;
+    max_transfer = (round / MODE_COUNT) > 1 ? 512 * (1 + host_rand() % 3) : 0;
+    TEST_ASSERT(drive_cache_open(&cache_handle) == 0);
+
+    int next = 0;
+    for (int i = 0; i < 2000; i++) {
+      int loc = host_rand() % DRIVE_SIZE;
+      if (host_rand() % 2) {
+        // sequential
+        loc = next;
+      }
+      int nbyte = 1 + host_rand() % sizeof(buffer);
+      if (host_rand() % 2) {
+        nbyte = (nbyte + 511) & ~511;
+      }
+      if (loc + nbyte > DRIVE_SIZE) {
+        nbyte = DRIVE_SIZE - loc;
+      }
+      next = loc + nbyte < DRIVE_SIZE ? loc + nbyte : 0;
+
+      const int op = host_rand() % 10;
+      if (op < 5) {
+        TEST_ASSERT(transfer(&cache_device, loc, buffer, nbyte, 0) == nbyte);
+        TEST_ASSERT(memcmp(buffer, model + loc, nbyte) == 0);
+      } else if (op < 9) {
+        for (int j = 0; j < nbyte; j++) {
+          buffer[j] = host_rand();
+        }
+        TEST_ASSERT(transfer(&cache_device, loc, buffer, nbyte, 1) == nbyte);
+        memcpy(model + loc, buffer, nbyte);
+      } else {
+        sync_cache();
+        TEST_ASSERT(memcmp(ram_memory, model, DRIVE_SIZE) == 0);
+      }
+
+      // some transfers finish while nothing is waiting for them
+      while (pending && (host_rand() % 2)) {
+        latency_interrupt();
+      }
+    }
+
+    // the dirty blocks are written back when the cache is closed
+    close_cache();
+    TEST_ASSERT(memcmp(ram_memory, model, DRIVE_SIZE) == 0);
+  }
+
+  drive_info_t info;
+  TEST_ASSERT(drive_cache_ioctl(&cache_handle, I_DRIVE_GETINFO, &info) == 0);
+  TEST_ASSERT(info.o_flags & DRIVE_FLAG_SYNC);
+  TEST_ASSERT(info.cache_hit_count == cache_state.hit_count);
+  TEST_ASSERT(info.cache_miss_count == cache_state.miss_count);
+  TEST_ASSERT(info.cache_hit_count && info.cache_miss_count);
+}
+
+// 4 KiB sequential reads, 512 byte reads from a small working set and 512 byte
+// writes to the same working set
+static void run_workload(const devfs_device_t *device) {
+  static u8 buffer[4096];
+  for (int loc = 0; loc < DRIVE_SIZE; loc += sizeof(buffer)) {
+    TEST_ASSERT(transfer(device, loc, buffer, sizeof(buffer), 0) == sizeof(buffer));
+  }
+  for (int i = 0; i < 2000; i++) {
+    const int loc = (host_rand() % 64) * 512;
+    TEST_ASSERT(transfer(device, loc, buffer, 512, i % 4 == 0) == 512);
+  }
+}
+
+static void benchmark() {
+  mode = MODE_INTERRUPT;
+  busy_after_write = 0;
+  max_transfer = 0;
+
+  host_srand(1);
+  latency_time = 0;
+  run_workload(&latency_device);
+  const u64 uncached_time = latency_time;
+
+  memset(&cache_state, 0, sizeof(cache_state));
+  TEST_ASSERT(drive_cache_open(&cache_handle) == 0);
+  host_srand(1);
+  latency_time = 0;
+  run_workload(&cache_device);
+  close_cache();
+  const u64 cached_time = latency_time;
+
+  printf(
+    "drive (%dus + %d bytes/us): %llu ms, with cache: %llu ms (%u hits, %u misses)\n",
+    LATENCY_US, BYTES_PER_US, (unsigned long long)uncached_time / 1000,
+    (unsigned long long)cached_time / 1000, cache_state.hit_count,
+    cache_state.miss_count);
+  TEST_ASSERT(cached_time < uncached_time);
+}
+
+int main() {
+  test_random_operations();
+  benchmark();
+  return 0;
+}
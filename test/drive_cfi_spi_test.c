@@ -0,0 +1,501 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <errno.h>
+#include <string.h>
+
+#include "device/drive_cfi.h"
+#include "host.h"
+#include "sos/config.h"
+#include "sos/dev/spi.h"
+
+// drive_cfi_spi talks to a simulated SPI NOR flash through a simulated SPI
+// driver that completes its transfers before read() and write() return. The
+// flash clocks one byte per microsecond (simulated), needs a write enable
+// before each program or erase, ignores nothing while it is idle and expects
+// only status reads while it is busy. Programming can only clear bits.
+//
+// Random erases, page programs, discards and idle periods are checked against
+// a copy of the flash (discarded blocks are undefined), then a file rewrite
+// workload is timed with and without discarding the blocks it frees.
+
+#define FLASH_SIZE (256 * 1024)
+#define PAGE_SIZE 256
+#define BLOCK_SIZE 4096
+#define BLOCK_COUNT (FLASH_SIZE / BLOCK_SIZE)
+#define PROGRAM_US 400
+#define ERASE_US 45000
+#define IDLE_POLL_US 1000
+
+#define OPCODE_WRITE_ENABLE 0x06
+#define OPCODE_PAGE_PROGRAM 0x02
+#define OPCODE_BLOCK_ERASE 0x20
+#define OPCODE_DEVICE_ERASE 0xc7
+#define OPCODE_FAST_READ 0x0b
+#define OPCODE_READ_STATUS 0x05
+#define OPCODE_PROTECT 0x7e
+#define OPCODE_UNPROTECT 0x98
+#define OPCODE_POWER_UP 0xab
+#define OPCODE_POWER_DOWN 0xb9
+#define OPCODE_ENABLE_RESET 0x66
+#define OPCODE_RESET 0x99
+
+#define STATUS_BUSY 0x01
+#define STATUS_WRITE_ENABLE 0x02
+
+typedef struct {
+  int is_selected;
+  int is_write_enabled;
+  u8 opcode;
+  int count;
+  u32 address;
+  u64 busy_end /*! Simulated time (us) when the program or erase ends */;
+  u32 erase_count;
+  u32 program_count;
+} flash_t;
+
+static flash_t flash;
+static u8 flash_memory[FLASH_SIZE];
+// simulated time in microseconds
+static u64 now;
+
+static int flash_is_busy() { return now < flash.busy_end; }
+
+static u8 flash_status() {
+  return (flash_is_busy() ? STATUS_BUSY : 0)
+         | (flash.is_write_enabled ? STATUS_WRITE_ENABLE : 0);
+}
+
+static u8 flash_swap(u8 value) {
+  TEST_ASSERT(flash.is_selected);
+  now++;
+  const int count = flash.count++;
+  if (count == 0) {
+    flash.opcode = value;
+    flash.address = 0;
+    // the flash ignores everything else while it is busy
+    TEST_ASSERT(
+      (flash_is_busy() == 0) || (value == OPCODE_READ_STATUS)
+      || (value == OPCODE_ENABLE_RESET) || (value == OPCODE_RESET));
+    return 0xff;
+  }
+
+  switch (flash.opcode) {
+  case OPCODE_READ_STATUS:
+    return flash_status();
+  case OPCODE_FAST_READ:
+    if (count < 4) {
+      flash.address = (flash.address << 8) | value;
+    } else if (count > 4) {
+      // after the dummy byte
+      return flash_memory[flash.address++ % FLASH_SIZE];
+    }
+    break;
+  case OPCODE_PAGE_PROGRAM:
+  case OPCODE_BLOCK_ERASE:
+    if (count < 4) {
+      flash.address = (flash.address << 8) | value;
+    } else if (flash.opcode == OPCODE_PAGE_PROGRAM) {
+      // the address wraps within the page
+      const u32 page = flash.address & ~(PAGE_SIZE - 1);
+      const u32 offset = (flash.address + count - 4) & (PAGE_SIZE - 1);
+      flash_memory[page + offset] &= value;
+    }
+    break;
+  }
+  return 0xff;
+}
+
+// the command is executed when chip select goes high
+static void flash_execute() {
+  switch (flash.opcode) {
+  case OPCODE_WRITE_ENABLE:
+    flash.is_write_enabled = 1;
+    break;
+
+  case OPCODE_PAGE_PROGRAM:
+    TEST_ASSERT(flash.is_write_enabled);
+    TEST_ASSERT(flash.count > 4);
+    flash.is_write_enabled = 0;
+    flash.busy_end = now + PROGRAM_US;
+    flash.program_count++;
+    break;
+
+  case OPCODE_BLOCK_ERASE:
+    TEST_ASSERT(flash.is_write_enabled);
+    TEST_ASSERT(flash.count == 4);
+    flash.is_write_enabled = 0;
+    memset(flash_memory + (flash.address & ~(BLOCK_SIZE - 1)), 0xff, BLOCK_SIZE);
+    flash.busy_end = now + ERASE_US;
+    flash.erase_count++;
+    break;
+
+  case OPCODE_DEVICE_ERASE:
+    TEST_ASSERT(flash.is_write_enabled);
+    flash.is_write_enabled = 0;
+    memset(flash_memory, 0xff, FLASH_SIZE);
+    flash.busy_end = now + ERASE_US * BLOCK_COUNT / 4;
+    break;
+
+  case OPCODE_PROTECT:
+  case OPCODE_UNPROTECT:
+    flash.is_write_enabled = 0;
+    break;
+  }
+}
+
+static void flash_pio_write(int port, u32 mask, int value) {
+  const int is_selected = value == 0;
+  if (flash.is_selected && !is_selected && flash.count) {
+    flash_execute();
+  }
+  flash.is_selected = is_selected;
+  flash.count = 0;
+}
+
+static void flash_pio_set_attributes(int port, const pio_attr_t *attr) {}
+
+const sos_config_t sos_config = {
+  .sys = {.pio_write = flash_pio_write, .pio_set_attributes = flash_pio_set_attributes}};
+
+// SPI driver -- read() and write() complete before they return
+static int spi_open(const devfs_handle_t *handle) { return 0; }
+static int spi_close(const devfs_handle_t *handle) { return 0; }
+
+static int spi_ioctl(const devfs_handle_t *handle, int request, void *ctl) {
+  switch (request) {
+  case I_SPI_SETATTR:
+    return 0;
+  case I_SPI_SWAP:
+    return flash_swap((ssize_t)ctl);
+  }
+  return SYSFS_SET_RETURN(EINVAL);
+}
+
+static int spi_transfer(devfs_async_t *async, int is_write) {
+  TEST_ASSERT(async->nbyte > 0);
+  u8 *buf = async->buf;
+  for (int i = 0; i < async->nbyte; i++) {
+    if (is_write) {
+      flash_swap(buf[i]);
+    } else {
+      buf[i] = flash_swap(0xff);
+    }
+  }
+  async->result = async->nbyte;
+  devfs_execute_event_handler(
+    &async->handler, is_write ? MCU_EVENT_FLAG_WRITE_COMPLETE : MCU_EVENT_FLAG_DATA_READY,
+    NULL);
+  return 0;
+}
+
+static int spi_read(const devfs_handle_t *handle, devfs_async_t *async) {
+  return spi_transfer(async, 0);
+}
+
+static int spi_write(const devfs_handle_t *handle, devfs_async_t *async) {
+  return spi_transfer(async, 1);
+}
+
+static const devfs_device_t spi_device = {
+  .driver = {
+    .open = spi_open,
+    .ioctl = spi_ioctl,
+    .read = spi_read,
+    .write = spi_write,
+    .close = spi_close}};
+
+static drive_cfi_state_t cfi_state;
+static const drive_cfi_config_t cfi_config = {
+  .serial_device = &spi_device,
+  .info =
+    {.addressable_size = 1,
+     .write_block_size = 1,
+     .num_write_blocks = FLASH_SIZE,
+     .erase_block_size = BLOCK_SIZE,
+     .erase_block_time = ERASE_US,
+     .erase_device_time = ERASE_US * BLOCK_COUNT / 4},
+  .opcode =
+    {.write_enable = OPCODE_WRITE_ENABLE,
+     .page_program = OPCODE_PAGE_PROGRAM,
+     .block_erase = OPCODE_BLOCK_ERASE,
+     .device_erase = OPCODE_DEVICE_ERASE,
+     .fast_read = OPCODE_FAST_READ,
+     .power_up = OPCODE_POWER_UP,
+     .power_down = OPCODE_POWER_DOWN,
+     .enable_reset = OPCODE_ENABLE_RESET,
+     .reset = OPCODE_RESET,
+     .protect = OPCODE_PROTECT,
+     .unprotect = OPCODE_UNPROTECT,
+     .read_busy_status = OPCODE_READ_STATUS,
+     .busy_status_mask = STATUS_BUSY,
+     .page_program_size = PAGE_SIZE},
+  .cs = {.port = 0, .pin = 3}};
+static const devfs_handle_t cfi_handle = {.config = &cfi_config, .state = &cfi_state};
+
+static int is_busy() {
+  const int result = drive_cfi_spi_ioctl(&cfi_handle, I_DRIVE_ISBUSY, NULL);
+  TEST_ASSERT(result >= 0);
+  return result;
+}
+
+static void wait_while_busy() {
+  int count = 0;
+  while (is_busy()) {
+    TEST_ASSERT(++count < 1000000);
+  }
+}
+
+// the caller has nothing to do for a while and polls the drive now and then
+static void idle(int poll_count) {
+  for (int i = 0; i < poll_count; i++) {
+    now += IDLE_POLL_US;
+    is_busy();
+  }
+}
+
+static int setattr(u32 o_flags, u32 start, u32 end) {
+  drive_attr_t attr = {.o_flags = o_flags, .start = start, .end = end};
+  int result;
+  while ((result = drive_cfi_spi_ioctl(&cfi_handle, I_DRIVE_SETATTR, &attr)) < 0) {
+    // a background erase is in progress
+    TEST_ASSERT(SYSFS_GET_RETURN_ERRNO(result) == EBUSY);
+    wait_while_busy();
+  }
+  TEST_ASSERT(result >= 0);
+  wait_while_busy();
+  return result;
+}
+
+static int is_complete;
+
+static int handle_complete(void *context, const mcu_event_t *event) {
+  is_complete = 1;
+  return 0;
+}
+
+// what devfs does for a blocking read or write -- the drive writes up to the
+// end of a page and returns EBUSY while the flash is busy
+static void transfer(u32 loc, u8 *buf, int nbyte, int is_write) {
+  devfs_async_t async;
+  int bytes = 0;
+  int count = 0;
+  while (bytes < nbyte) {
+    memset(&async, 0, sizeof(async));
+    async.tid = 1;
+    async.loc = loc + bytes;
+    async.buf = buf + bytes;
+    async.nbyte = nbyte - bytes;
+    async.handler.callback = handle_complete;
+    is_complete = 0;
+
+    const int result = is_write ? drive_cfi_spi_write(&cfi_handle, &async)
+                                : drive_cfi_spi_read(&cfi_handle, &async);
+    if (result == 0) {
+      TEST_ASSERT(is_complete);
+      TEST_ASSERT(async.result > 0);
+      bytes += async.result;
+    } else {
+      TEST_ASSERT(SYSFS_GET_RETURN_ERRNO(result) == EBUSY);
+    }
+    wait_while_busy();
+    TEST_ASSERT(++count < 1000);
+  }
+}
+
+static u8 model[FLASH_SIZE];
+static u8 is_defined[FLASH_SIZE];
+
+static void test_init() {
+  memset(&flash, 0, sizeof(flash));
+  memset(&cfi_state, 0, sizeof(cfi_state));
+  for (int i = 0; i < FLASH_SIZE; i++) {
+    flash_memory[i] = model[i] = host_rand();
+  }
+  memset(is_defined, 1, sizeof(is_defined));
+
+  TEST_ASSERT(drive_cfi_spi_open(&cfi_handle) == 0);
+  drive_info_t info;
+  TEST_ASSERT(drive_cfi_spi_ioctl(&cfi_handle, I_DRIVE_GETINFO, &info) == 0);
+  TEST_ASSERT(info.o_flags & DRIVE_FLAG_DISCARD_BLOCKS);
+  TEST_ASSERT(info.erase_block_size == BLOCK_SIZE);
+  TEST_ASSERT(setattr(DRIVE_FLAG_INIT, 0, 0) == 0);
+}
+
+static void check(u32 loc, int nbyte) {
+  static u8 buffer[2 * BLOCK_SIZE];
+  transfer(loc, buffer, nbyte, 0);
+  for (int i = 0; i < nbyte; i++) {
+    TEST_ASSERT((is_defined[loc + i] == 0) || (buffer[i] == model[loc + i]));
+  }
+}
+
+static void test_random_operations() {
+  static u8 buffer[2 * BLOCK_SIZE];
+  test_init();
+
+  u32 erase_count = 0;
+  for (int i = 0; i < 4000; i++) {
+    const int op = host_rand() % 16;
+    u32 loc = host_rand() % FLASH_SIZE;
+    int nbyte = 1 + host_rand() % sizeof(buffer);
+    if (loc + nbyte > FLASH_SIZE) {
+      nbyte = FLASH_SIZE - loc;
+    }
+
+    if (op < 4) {
+      check(loc, nbyte);
+    } else if (op < 8) {
+      // like a filesystem, only write to bytes that are known
+      while (nbyte && (is_defined[loc + nbyte - 1] == 0)) {
+        nbyte--;
+      }
+      for (int j = 0; j < nbyte; j++) {
+        if (is_defined[loc + j] == 0) {
+          nbyte = j;
+          break;
+        }
+        buffer[j] = host_rand() | (host_rand() % 2 ? 0 : 0xf0);
+        model[loc + j] &= buffer[j];
+      }
+      if (nbyte) {
+        transfer(loc, buffer, nbyte, 1);
+      }
+    } else if (op < 11) {
+      const u32 start = loc / BLOCK_SIZE * BLOCK_SIZE;
+      TEST_ASSERT(setattr(DRIVE_FLAG_ERASE_BLOCKS, loc, loc) == BLOCK_SIZE);
+      memset(model + start, 0xff, BLOCK_SIZE);
+      memset(is_defined + start, 1, BLOCK_SIZE);
+      erase_count++;
+    } else if (op < 14) {
+      // only whole blocks are discarded
+      const u32 start = (loc + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+      const u32 end = (loc + nbyte) / BLOCK_SIZE * BLOCK_SIZE;
+      setattr(DRIVE_FLAG_DISCARD_BLOCKS, loc, loc + nbyte);
+      if (start < end) {
+        memset(is_defined + start, 0, end - start);
+      }
+    } else {
+      idle(host_rand() % 200);
+    }
+  }
+
+  idle(1000);
+  for (u32 loc = 0; loc < FLASH_SIZE; loc += BLOCK_SIZE) {
+    check(loc, BLOCK_SIZE);
+  }
+  printf(
+    "%u erases requested, %u done by the flash, %u pages programmed\n", erase_count,
+    flash.erase_count, flash.program_count);
+}
+
+static void test_background_erase() {
+  static u8 buffer[BLOCK_SIZE];
+  test_init();
+
+  // four blocks of data are discarded
+  for (u32 block = 4; block < 8; block++) {
+    setattr(DRIVE_FLAG_ERASE_BLOCKS, block * BLOCK_SIZE, block * BLOCK_SIZE);
+    memset(buffer, block, sizeof(buffer));
+    transfer(block * BLOCK_SIZE, buffer, sizeof(buffer), 1);
+  }
+  setattr(DRIVE_FLAG_DISCARD_BLOCKS, 4 * BLOCK_SIZE, 8 * BLOCK_SIZE);
+  TEST_ASSERT(flash_is_busy() == 0);
+  const u32 erase_count = flash.erase_count;
+
+  // the first idle poll starts an erase -- the caller is not kept waiting
+  TEST_ASSERT(is_busy() == 0);
+  TEST_ASSERT(flash_is_busy());
+  TEST_ASSERT(flash.erase_count == erase_count + 1);
+  TEST_ASSERT(is_busy() == 0);
+
+  // until the caller requests something else
+  devfs_async_t async = {
+    .tid = 1, .loc = 0, .buf = buffer, .nbyte = 16, .handler.callback = handle_complete};
+  TEST_ASSERT(SYSFS_GET_RETURN_ERRNO(drive_cfi_spi_read(&cfi_handle, &async)) == EBUSY);
+  drive_attr_t attr = {.o_flags = DRIVE_FLAG_PROTECT};
+  TEST_ASSERT(
+    SYSFS_GET_RETURN_ERRNO(drive_cfi_spi_ioctl(&cfi_handle, I_DRIVE_SETATTR, &attr))
+    == EBUSY);
+  const u64 start = now;
+  TEST_ASSERT(is_busy() == 1);
+  wait_while_busy();
+  TEST_ASSERT(now - start < ERASE_US);
+  TEST_ASSERT(flash_is_busy() == 0);
+
+  // the other blocks are erased while idle
+  idle(4 * ERASE_US / IDLE_POLL_US);
+  TEST_ASSERT(flash.erase_count == erase_count + 4);
+  idle(4 * ERASE_US / IDLE_POLL_US);
+  TEST_ASSERT(flash.erase_count == erase_count + 4);
+
+  // a discarded block is already erased
+  for (u32 block = 4; block < 8; block++) {
+    const u64 erase_start = now;
+    TEST_ASSERT(
+      setattr(DRIVE_FLAG_ERASE_BLOCKS, block * BLOCK_SIZE + 100, 0) == BLOCK_SIZE);
+    TEST_ASSERT(now - erase_start < 100);
+    transfer(block * BLOCK_SIZE, buffer, sizeof(buffer), 0);
+    for (int i = 0; i < BLOCK_SIZE; i++) {
+      TEST_ASSERT(buffer[i] == 0xff);
+    }
+  }
+  TEST_ASSERT(flash.erase_count == erase_count + 4);
+
+  // after a write the block is erased again
+  transfer(4 * BLOCK_SIZE + 10, buffer, 1, 1);
+  setattr(DRIVE_FLAG_ERASE_BLOCKS, 4 * BLOCK_SIZE, 0);
+  TEST_ASSERT(flash.erase_count == erase_count + 5);
+
+  // a written block is not erased in the background
+  setattr(DRIVE_FLAG_DISCARD_BLOCKS, 8 * BLOCK_SIZE, 9 * BLOCK_SIZE);
+  memset(buffer, 0x55, sizeof(buffer));
+  const u8 value = flash_memory[8 * BLOCK_SIZE + 20] & 0x55;
+  transfer(8 * BLOCK_SIZE + 20, buffer, 20, 1);
+  idle(2 * ERASE_US / IDLE_POLL_US);
+  TEST_ASSERT(flash.erase_count == erase_count + 5);
+  TEST_ASSERT(flash_memory[8 * BLOCK_SIZE + 20] == value);
+}
+
+// a file is rewritten to a free block and then the old block is freed (or
+// discarded) -- the application is idle for a while between updates
+static u64 benchmark(int is_discard) {
+  static u8 buffer[BLOCK_SIZE];
+  const int update_count = 64;
+  test_init();
+
+  if (is_discard) {
+    // the free blocks are discarded when the filesystem is mounted
+    setattr(DRIVE_FLAG_DISCARD_BLOCKS, BLOCK_SIZE, 16 * BLOCK_SIZE);
+  }
+
+  u64 write_time = 0;
+  u32 block = 0;
+  for (int i = 0; i < update_count; i++) {
+    const u32 next = (block + 1) % 16;
+    const u64 start = now;
+    setattr(DRIVE_FLAG_ERASE_BLOCKS, next * BLOCK_SIZE, 0);
+    memset(buffer, i, sizeof(buffer));
+    transfer(next * BLOCK_SIZE, buffer, sizeof(buffer), 1);
+    write_time += now - start;
+
+    if (is_discard) {
+      setattr(DRIVE_FLAG_DISCARD_BLOCKS, block * BLOCK_SIZE, (block + 1) * BLOCK_SIZE);
+    }
+    block = next;
+    idle(100);
+  }
+
+  printf(
+    "%-10s %5.1f ms per update (%u erases)\n", is_discard ? "discard:" : "no discard:",
+    write_time / 1000.0 / update_count, flash.erase_count);
+  return write_time;
+}
+
+int main() {
+  host_srand(39);
+  test_random_operations();
+  test_background_erase();
+  const u64 erase_time = benchmark(0);
+  TEST_ASSERT(benchmark(1) < erase_time);
+  return 0;
+}
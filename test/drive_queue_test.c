@@ -0,0 +1,404 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <errno.h>
+#include <string.h>
+
+#include "cortexm/task.h"
+#include "device/drive_queue.h"
+#include "device/drive_ram.h"
+#include "host.h"
+
+// Several tasks do 4KiB reads and writes through drive_queue to a 512 byte
+// block drive over drive_ram that has a command latency, a seek time and a
+// transfer rate in simulated time.
+//
+// drive_queue relies on masking interrupts on one core, so the tasks and the
+// drive's interrupt are simulated from one thread with an event loop rather
+// than run as host threads. Each task owns every task_count'th chunk of the
+// drive and checks what it reads; some tasks give up on a request the way a
+// task interrupted by a signal does.
+//
+// The benchmark compares the time for the same requests with and without the
+// queue (a task that gets EBUSY from the drive tries again later).
+
+#define BLOCK_SIZE 512
+#define CHUNK_SIZE 4096
+#define CHUNK_COUNT 256
+#define DRIVE_SIZE (CHUNK_COUNT * CHUNK_SIZE)
+#define TASK_COUNT_MAX 8
+
+#define COMMAND_US 100
+#define SEEK_US 300
+#define BYTES_PER_US 8
+#define RETRY_US 100
+#define THINK_US 20
+
+static u8 ram_memory[DRIVE_SIZE];
+static const drive_ram_config_t ram_config = {.memory = ram_memory, .size = DRIVE_SIZE};
+static const devfs_handle_t ram_handle = {.config = &ram_config};
+
+// simulated time in microseconds
+static u64 now;
+
+typedef struct {
+  int is_sync /*! Complete before read() or write() returns */;
+  devfs_async_t *pending;
+  int is_pending_write;
+  u64 complete_time;
+  u32 position /*! Block following the last transfer */;
+  u32 transfer_count;
+} latency_drive_t;
+
+static latency_drive_t drive;
+
+static int latency_open(const devfs_handle_t *handle) { return drive_ram_open(&ram_handle); }
+
+static int latency_close(const devfs_handle_t *handle) {
+  return drive_ram_close(&ram_handle);
+}
+
+static void latency_finish(devfs_async_t *async, int is_write, u32 o_events) {
+  // the data moves when the transfer completes
+  devfs_async_t ram_async = *async;
+  ram_async.loc = async->loc * BLOCK_SIZE;
+  const int result = is_write ? drive_ram_write(&ram_handle, &ram_async)
+                              : drive_ram_read(&ram_handle, &ram_async);
+  async->nbyte = result;
+  async->result = result;
+  devfs_execute_event_handler(
+    &async->handler,
+    o_events | (is_write ? MCU_EVENT_FLAG_WRITE_COMPLETE : MCU_EVENT_FLAG_DATA_READY),
+    NULL);
+}
+
+static int latency_interrupt() {
+  devfs_async_t *async = drive.pending;
+  if ((async == NULL) || (drive.complete_time > now)) {
+    return 0;
+  }
+  drive.pending = NULL;
+  latency_finish(async, drive.is_pending_write, 0);
+  return 1;
+}
+
+static int latency_transfer(devfs_async_t *async, int is_write) {
+  if (drive.pending) {
+    return SYSFS_SET_RETURN(EBUSY);
+  }
+  TEST_ASSERT(async->nbyte % BLOCK_SIZE == 0);
+  TEST_ASSERT((async->loc + async->nbyte / BLOCK_SIZE) * BLOCK_SIZE <= DRIVE_SIZE);
+
+  drive.transfer_count++;
+  if (drive.is_sync) {
+    latency_finish(async, is_write, 0);
+    return 0;
+  }
+
+  drive.complete_time = now + COMMAND_US + async->nbyte / BYTES_PER_US;
+  if ((u32)async->loc != drive.position) {
+    drive.complete_time += SEEK_US;
+  }
+  drive.position = async->loc + async->nbyte / BLOCK_SIZE;
+  drive.pending = async;
+  drive.is_pending_write = is_write;
+  return 0;
+}
+
+static int latency_read(const devfs_handle_t *handle, devfs_async_t *async) {
+  return latency_transfer(async, 0);
+}
+
+static int latency_write(const devfs_handle_t *handle, devfs_async_t *async) {
+  return latency_transfer(async, 1);
+}
+
+static int latency_ioctl(const devfs_handle_t *handle, int request, void *ctl) {
+  const mcu_action_t *action = ctl;
+  switch (request) {
+  case I_DRIVE_GETINFO: {
+    drive_info_t *info = ctl;
+    drive_ram_ioctl(&ram_handle, request, ctl);
+    info->addressable_size = BLOCK_SIZE;
+    info->write_block_size = BLOCK_SIZE;
+    info->num_write_blocks = DRIVE_SIZE / BLOCK_SIZE;
+    return 0;
+  }
+  case I_DRIVE_ISBUSY:
+    return drive.pending != NULL;
+  case I_MCU_SETACTION:
+    if ((action->handler.callback == 0) && drive.pending) {
+      // stop using the caller's buffer
+      devfs_async_t *async = drive.pending;
+      drive.pending = NULL;
+      async->nbyte = 0;
+      async->result = SYSFS_SET_RETURN(EINTR);
+      devfs_execute_event_handler(&async->handler, MCU_EVENT_FLAG_CANCELED, NULL);
+    }
+    return 0;
+  }
+  return drive_ram_ioctl(&ram_handle, request, ctl);
+}
+
+static const devfs_device_t latency_device = {
+  .driver = {
+    .open = latency_open,
+    .ioctl = latency_ioctl,
+    .read = latency_read,
+    .write = latency_write,
+    .close = latency_close}};
+
+DRIVE_QUEUE_DECLARE_CONFIG_STATE(
+  queue,
+  ((devfs_device_t){
+    .driver =
+      {.open = latency_open,
+       .ioctl = latency_ioctl,
+       .read = latency_read,
+       .write = latency_write,
+       .close = latency_close}}),
+  TASK_COUNT_MAX,
+  32768);
+
+static const devfs_device_t queue_device = {
+  .handle = {.config = &queue_config, .state = &queue_state},
+  .driver = {
+    .open = drive_queue_open,
+    .ioctl = drive_queue_ioctl,
+    .read = drive_queue_read,
+    .write = drive_queue_write,
+    .close = drive_queue_close}};
+
+enum { TASK_STATE_READY, TASK_STATE_WAITING, TASK_STATE_RETRY };
+
+typedef struct {
+  int tid;
+  devfs_async_t async;
+  u8 buffer[CHUNK_SIZE];
+  int state;
+  u64 wake_time /*! When a ready task starts its next request (or retries) */;
+  int remaining;
+  int chunk;
+  int is_read;
+  int next;
+} test_task_t;
+
+static test_task_t task_array[TASK_COUNT_MAX];
+static int task_count;
+static int is_striped;
+static int is_cancel;
+static const devfs_device_t *device;
+
+// chunk contents as last written (valid is 0 after a write was abandoned)
+static u8 model[DRIVE_SIZE];
+static u8 model_valid[CHUNK_COUNT];
+
+static int handle_complete(void *context, const mcu_event_t *event) {
+  test_task_t *task = context;
+  const int result = task->async.result;
+  TEST_ASSERT(task->state == TASK_STATE_WAITING);
+  TEST_ASSERT(result == CHUNK_SIZE);
+  u8 *expected = model + task->chunk * CHUNK_SIZE;
+  if (task->is_read) {
+    if (model_valid[task->chunk]) {
+      TEST_ASSERT(memcmp(task->buffer, expected, CHUNK_SIZE) == 0);
+    }
+  } else {
+    memcpy(expected, task->buffer, CHUNK_SIZE);
+    model_valid[task->chunk] = 1;
+  }
+  task->state = TASK_STATE_READY;
+  task->remaining--;
+  task->wake_time = now + THINK_US;
+  return 0;
+}
+
+static int handle_abandoned(void *context, const mcu_event_t *event) {
+  // the queue must not touch a request after the caller gave up on it
+  TEST_ASSERT(0);
+  return 0;
+}
+
+static void issue(test_task_t *task) {
+  if (task->state == TASK_STATE_READY) {
+    // a new request (else the last one got EBUSY)
+    const int index = is_striped ? task->next++ : host_rand() % (CHUNK_COUNT / task_count);
+    task->chunk = (index * task_count + task->tid - 1) % CHUNK_COUNT;
+    task->is_read = host_rand() % 2;
+    if (task->is_read == 0) {
+      for (int i = 0; i < CHUNK_SIZE; i++) {
+        task->buffer[i] = host_rand();
+      }
+    }
+  }
+
+  memset(&task->async, 0, sizeof(task->async));
+  task->async.tid = task->tid;
+  task->async.loc = task->chunk * (CHUNK_SIZE / BLOCK_SIZE);
+  task->async.buf = task->buffer;
+  task->async.nbyte = CHUNK_SIZE;
+  task->async.handler.callback = handle_complete;
+  task->async.handler.context = task;
+  task->state = TASK_STATE_WAITING;
+
+  m_task_current = task->tid;
+  const int result = task->is_read ? device->driver.read(&device->handle, &task->async)
+                                   : device->driver.write(&device->handle, &task->async);
+  if (result < 0) {
+    // only the drive without the queue is busy
+    TEST_ASSERT(device == &latency_device);
+    TEST_ASSERT(SYSFS_GET_RETURN_ERRNO(result) == EBUSY);
+    task->state = TASK_STATE_RETRY;
+    task->wake_time = now + RETRY_US;
+    return;
+  }
+
+  if (is_cancel && (task->state == TASK_STATE_WAITING) && (host_rand() % 16 == 0)) {
+    // interrupted by a signal -- devfs detaches the request
+    mcu_action_t action = {
+      .o_events = task->is_read ? MCU_EVENT_FLAG_DATA_READY : MCU_EVENT_FLAG_WRITE_COMPLETE};
+    TEST_ASSERT(device->driver.ioctl(&device->handle, I_MCU_SETACTION, &action) == 0);
+    memset(&task->async, 0, sizeof(task->async));
+    task->async.handler.callback = handle_abandoned;
+    if (task->is_read == 0) {
+      model_valid[task->chunk] = 0;
+    }
+    task->state = TASK_STATE_READY;
+    task->remaining--;
+    task->wake_time = now + THINK_US;
+  }
+}
+
+// runs until every task has done request_count requests -- returns the time taken
+static u64 run(int count, int request_count) {
+  task_count = count;
+  memset(task_array, 0, sizeof(task_array));
+  for (int i = 0; i < task_count; i++) {
+    task_array[i].tid = i + 1;
+    task_array[i].remaining = request_count;
+  }
+  const u64 start = now;
+
+  while (1) {
+    int is_done = 1;
+    int is_issued = 0;
+    u64 next = (u64)-1;
+    for (int i = 0; i < task_count; i++) {
+      test_task_t *task = task_array + i;
+      if (task->remaining == 0) {
+        continue;
+      }
+      is_done = 0;
+      if (task->state == TASK_STATE_WAITING) {
+        continue;
+      }
+      if (task->wake_time <= now) {
+        issue(task);
+        is_issued = 1;
+      } else if (task->wake_time < next) {
+        next = task->wake_time;
+      }
+    }
+
+    if (is_done) {
+      break;
+    }
+    if (is_issued || latency_interrupt()) {
+      continue;
+    }
+
+    if (drive.pending && (drive.complete_time < next)) {
+      next = drive.complete_time;
+    }
+    TEST_ASSERT(next != (u64)-1);
+    now = next;
+  }
+
+  TEST_ASSERT(drive.pending == NULL);
+  TEST_ASSERT(drive_queue_ioctl(&queue_device.handle, I_DRIVE_ISBUSY, NULL) == 0);
+  return now - start;
+}
+
+static void test_queue() {
+  host_srand(38);
+  for (int i = 0; i < DRIVE_SIZE; i++) {
+    ram_memory[i] = model[i] = host_rand();
+  }
+  memset(model_valid, 1, sizeof(model_valid));
+  device = &queue_device;
+  TEST_ASSERT(drive_queue_open(&queue_device.handle) == 0);
+
+  for (int round = 0; round < 16; round++) {
+    drive.is_sync = round % 4 == 0;
+    is_striped = round % 2;
+    is_cancel = round % 3 != 0;
+    const u32 merge_count = queue_state.merge_count;
+    run(1 + round % TASK_COUNT_MAX, 200);
+
+    if (drive.is_sync == 0 && is_striped && (round % TASK_COUNT_MAX) > 1) {
+      // tasks streaming through neighbouring chunks are merged
+      TEST_ASSERT(queue_state.merge_count > merge_count);
+    }
+
+    for (int chunk = 0; chunk < CHUNK_COUNT; chunk++) {
+      if (model_valid[chunk]) {
+        TEST_ASSERT(
+          memcmp(ram_memory + chunk * CHUNK_SIZE, model + chunk * CHUNK_SIZE, CHUNK_SIZE)
+          == 0);
+      }
+    }
+  }
+
+  // attributes wait for the queue to drain
+  drive.is_sync = 0;
+  is_cancel = 0;
+  task_count = 1;
+  task_array[0] = (test_task_t){.tid = 1, .remaining = 1};
+  issue(task_array);
+  drive_attr_t attr = {.o_flags = DRIVE_FLAG_INIT};
+  int result = drive_queue_ioctl(&queue_device.handle, I_DRIVE_SETATTR, &attr);
+  TEST_ASSERT((result < 0) && (SYSFS_GET_RETURN_ERRNO(result) == EBUSY));
+  TEST_ASSERT(drive_queue_ioctl(&queue_device.handle, I_DRIVE_ISBUSY, NULL) == 1);
+  now = drive.complete_time;
+  TEST_ASSERT(latency_interrupt());
+  TEST_ASSERT(task_array[0].remaining == 0);
+  TEST_ASSERT(drive_queue_ioctl(&queue_device.handle, I_DRIVE_SETATTR, &attr) == 0);
+}
+
+static void benchmark(int count, int striped) {
+  drive.is_sync = 0;
+  is_cancel = 0;
+  is_striped = striped;
+  const int request_count = 512 / count;
+
+  host_srand(1);
+  device = &latency_device;
+  drive.transfer_count = 0;
+  const u64 direct_us = run(count, request_count);
+  const u32 direct_transfer_count = drive.transfer_count;
+
+  host_srand(1);
+  device = &queue_device;
+  drive.transfer_count = 0;
+  const u64 queue_us = run(count, request_count);
+
+  const double mbyte = count * request_count * CHUNK_SIZE / 1000000.0;
+  printf(
+    "%d task%s %s: drive %6.1f ms (%4.1f MB/s, %3u transfers), queue %6.1f ms (%4.1f "
+    "MB/s, %3u transfers)\n",
+    count, count > 1 ? "s" : " ", striped ? "striped" : " random", direct_us / 1000.0,
+    mbyte / direct_us * 1000000.0, direct_transfer_count, queue_us / 1000.0,
+    mbyte / queue_us * 1000000.0, drive.transfer_count);
+
+  if (count > 1) {
+    TEST_ASSERT(queue_us < direct_us);
+  }
+}
+
+int main() {
+  test_queue();
+  for (int count = 1; count <= TASK_COUNT_MAX; count *= 2) {
+    benchmark(count, 0);
+    benchmark(count, 1);
+  }
+  return 0;
+}
@@ -0,0 +1,614 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cortexm/task.h"
+#include "device/drive_sdspi.h"
+#include "host.h"
+#include "mcu/crc.h"
+#include "sos/config.h"
+
+// drive_sdspi talks to a simulated SD card (SPI mode) through a simulated SPI
+// driver that completes its transfers from an interrupt. The card checks the
+// command and data CRCs and the tokens, has random access and programming
+// times and is only clocked while chip select is low.
+//
+// An SDHC (block addressed) and an SDSC (byte addressed) card are initialized
+// and then random single and multiple block reads and writes are compared
+// with a copy of the card. The bus time for single block requests is compared
+// with multiple block requests at 25MHz.
+
+#define BLOCK_SIZE 512
+#define CARD_BLOCK_COUNT 2048
+#define CARD_BITRATE 25000000
+
+#define SDSPI_CMD0_GO_IDLE_STATE 0
+#define SDSPI_CMD8_SEND_IF_COND 8
+#define SDSPI_CMD9_SEND_CSD 9
+#define SDSPI_CMD12_STOP_TRANSMISSION 12
+#define SDSPI_CMD13_SD_STATUS 13
+#define SDSPI_CMD16_SET_BLOCKLEN 16
+#define SDSPI_CMD17_READ_SINGLE_BLOCK 17
+#define SDSPI_CMD18_READ_MULTIPLE_BLOCK 18
+#define SDSPI_ACMD23_SET_WR_BLK_ERASE_COUNT 23
+#define SDSPI_CMD24_WRITE_SINGLE_BLOCK 24
+#define SDSPI_CMD25_WRITE_MULTIPLE_BLOCK 25
+#define SDSPI_CMD28_SET_WRITE_PROT 28
+#define SDSPI_ACMD41_SD_SEND_OP_COND 41
+#define SDSPI_CMD55_APP_CMD 55
+#define SDSPI_CMD59_CRC_ON_OFF 59
+
+#define R1_IDLE 0x01
+#define R1_ILLEGAL_COMMAND 0x04
+#define R1_CRC_ERROR 0x08
+#define R1_ADDRESS_ERROR 0x20
+
+enum {
+  CARD_STATE_COMMAND,
+  CARD_STATE_READ_MULTIPLE,
+  CARD_STATE_WRITE_TOKEN,
+  CARD_STATE_WRITE_DATA
+};
+
+typedef struct {
+  int is_sdsc;
+  int is_random_timing;
+  int is_selected;
+  int is_idle;
+  int is_crc_on;
+  int is_app_cmd;
+  int init_count;
+  int state;
+  int is_write_multiple;
+  u32 block;
+  u8 command[6];
+  int command_count;
+  u8 data[BLOCK_SIZE + 2];
+  int data_count;
+  u8 out[2048];
+  int out_head;
+  int out_tail;
+  u64 busy_end /*! Simulated time (ns) when programming ends */;
+  int corrupt_read_count;
+  u32 pre_erase_count;
+  u32 multiple_block_count;
+  u64 byte_count;
+} card_t;
+
+static card_t card;
+static u8 card_memory[CARD_BLOCK_COUNT * BLOCK_SIZE];
+static u8 model[CARD_BLOCK_COUNT * BLOCK_SIZE];
+// simulated time spent in cortexm_delay_us()
+static u64 delay_us;
+
+// the driver's delays plus the bytes clocked
+static u64 get_time_ns() {
+  return delay_us * 1000 + card.byte_count * 8 * 1000000000ULL / CARD_BITRATE;
+}
+
+static int card_latency(int max) {
+  return card.is_random_timing ? host_rand() % (max + 1) : max / 2;
+}
+
+static void card_set_busy(int max_us) {
+  card.busy_end = get_time_ns() + card_latency(max_us) * 1000ULL;
+}
+
+static int card_is_busy() { return get_time_ns() < card.busy_end; }
+
+static void card_push(u8 value) {
+  card.out[card.out_head++ % sizeof(card.out)] = value;
+  TEST_ASSERT(card.out_head - card.out_tail <= (int)sizeof(card.out));
+}
+
+static void card_push_gap(int count) {
+  for (int i = 0; i < count; i++) {
+    card_push(0xff);
+  }
+}
+
+static void card_push_data(const u8 *data, int nbyte, int is_corrupt) {
+  const u16 crc = mcu_calc_crc16(0, 0x1021, data, nbyte) ^ (is_corrupt ? 0x0100 : 0);
+  card_push(0xfe);
+  for (int i = 0; i < nbyte; i++) {
+    card_push(data[i]);
+  }
+  card_push(crc >> 8);
+  card_push(crc);
+}
+
+static void card_push_block() {
+  int is_corrupt = 0;
+  if (card.corrupt_read_count) {
+    card.corrupt_read_count--;
+    is_corrupt = 1;
+  }
+  // the card may be asked for more blocks than it has before the stop command
+  const u32 block = card.block++ % CARD_BLOCK_COUNT;
+  card_push_data(card_memory + block * BLOCK_SIZE, BLOCK_SIZE, is_corrupt);
+}
+
+static int card_get_block(u32 arg, u32 *block) {
+  if (card.is_sdsc) {
+    TEST_ASSERT(arg % BLOCK_SIZE == 0);
+    arg /= BLOCK_SIZE;
+  }
+  *block = arg;
+  return arg < CARD_BLOCK_COUNT;
+}
+
+static void card_execute_command() {
+  const u8 *command = card.command;
+  const u8 index = command[0] & 0x3f;
+  const u32 arg =
+    ((u32)command[1] << 24) | (command[2] << 16) | (command[3] << 8) | command[4];
+  const int is_app_cmd = card.is_app_cmd;
+  u8 r1 = card.is_idle ? R1_IDLE : 0;
+
+  // the host doesn't send commands while the card is busy
+  TEST_ASSERT(card_is_busy() == 0);
+  TEST_ASSERT(command[5] & 0x01);
+
+  // a command ends any transfer
+  card.out_tail = card.out_head;
+  card.state = CARD_STATE_COMMAND;
+  card.is_app_cmd = 0;
+
+  if (
+    (card.is_crc_on || (index == SDSPI_CMD0_GO_IDLE_STATE)
+     || (index == SDSPI_CMD8_SEND_IF_COND))
+    && (mcu_calc_crc7(0, 0x09, command, 5) != command[5])) {
+    // the driver always sends the CRC
+    TEST_ASSERT(0);
+  }
+
+  // N_CR
+  card_push_gap(1 + card_latency(3));
+
+  if (is_app_cmd) {
+    switch (index) {
+    case SDSPI_ACMD23_SET_WR_BLK_ERASE_COUNT:
+      card.pre_erase_count = arg;
+      card_push(r1);
+      return;
+    case SDSPI_ACMD41_SD_SEND_OP_COND:
+      if (++card.init_count == 3) {
+        card.is_idle = 0;
+      }
+      card_push(card.is_idle ? R1_IDLE : 0);
+      return;
+    case SDSPI_CMD13_SD_STATUS: {
+      u8 status[64] = {0};
+      status[10] = 0x90;
+      card_push(r1);
+      card_push(0x00);
+      card_push_gap(card_latency(20));
+      card_push_data(status, sizeof(status), 0);
+      return;
+    }
+    }
+    card_push(r1 | R1_ILLEGAL_COMMAND);
+    return;
+  }
+
+  switch (index) {
+  case SDSPI_CMD0_GO_IDLE_STATE:
+    card.is_idle = 1;
+    card.is_crc_on = 0;
+    card.init_count = 0;
+    card_push(R1_IDLE);
+    return;
+
+  case SDSPI_CMD8_SEND_IF_COND:
+    // R7 echoes the check pattern
+    card_push(r1);
+    card_push(0x00);
+    card_push(0x00);
+    card_push(arg >> 8);
+    card_push(arg);
+    return;
+
+  case SDSPI_CMD9_SEND_CSD: {
+    u8 csd[16] = {0};
+    csd[5] = 0x09;
+    if (card.is_sdsc) {
+      // (C_SIZE + 1) * 2^(C_SIZE_MULT + 2) * 2^READ_BL_LEN
+      const u32 c_size = CARD_BLOCK_COUNT / 512 - 1;
+      const u32 c_size_mult = 7;
+      csd[6] = c_size >> 10;
+      csd[7] = c_size >> 2;
+      csd[8] = (c_size & 0x03) << 6;
+      csd[9] = c_size_mult >> 1;
+      csd[10] = (c_size_mult & 0x01) << 7;
+    } else {
+      // (C_SIZE + 1) * 512KiB
+      const u32 c_size = CARD_BLOCK_COUNT / 1024 - 1;
+      csd[0] = 0x40;
+      csd[7] = c_size >> 16;
+      csd[8] = c_size >> 8;
+      csd[9] = c_size;
+    }
+    card_push(r1);
+    card_push_gap(card_latency(20));
+    card_push_data(csd, sizeof(csd), 0);
+    return;
+  }
+
+  case SDSPI_CMD12_STOP_TRANSMISSION:
+    // a stuff byte then R1b
+    card_push(0xff);
+    card_push(r1);
+    card_set_busy(20);
+    return;
+
+  case SDSPI_CMD16_SET_BLOCKLEN:
+    TEST_ASSERT(arg == BLOCK_SIZE);
+    card_push(r1);
+    return;
+
+  case SDSPI_CMD17_READ_SINGLE_BLOCK:
+  case SDSPI_CMD18_READ_MULTIPLE_BLOCK:
+    if (card_get_block(arg, &card.block) == 0) {
+      card_push(r1 | R1_ADDRESS_ERROR);
+      return;
+    }
+    card_push(r1);
+    // N_AC -- usually longer than a command frame
+    card_push_gap(card_latency(400));
+    card_push_block();
+    if (index == SDSPI_CMD18_READ_MULTIPLE_BLOCK) {
+      card.multiple_block_count++;
+      card.state = CARD_STATE_READ_MULTIPLE;
+    }
+    return;
+
+  case SDSPI_CMD24_WRITE_SINGLE_BLOCK:
+  case SDSPI_CMD25_WRITE_MULTIPLE_BLOCK:
+    if (card_get_block(arg, &card.block) == 0) {
+      card_push(r1 | R1_ADDRESS_ERROR);
+      return;
+    }
+    card_push(r1);
+    card.is_write_multiple = index == SDSPI_CMD25_WRITE_MULTIPLE_BLOCK;
+    card.multiple_block_count += card.is_write_multiple;
+    card.state = CARD_STATE_WRITE_TOKEN;
+    return;
+
+  case SDSPI_CMD28_SET_WRITE_PROT:
+    // SDHC cards don't support write protection groups
+    card_push(card.is_sdsc ? r1 : r1 | R1_ILLEGAL_COMMAND);
+    return;
+
+  case SDSPI_CMD55_APP_CMD:
+    card.is_app_cmd = 1;
+    card_push(r1);
+    return;
+
+  case SDSPI_CMD59_CRC_ON_OFF:
+    card.is_crc_on = arg & 0x01;
+    card_push(r1);
+    return;
+  }
+
+  card_push(r1 | R1_ILLEGAL_COMMAND);
+}
+
+static void card_receive_data(u8 value) {
+  switch (card.state) {
+  case CARD_STATE_WRITE_TOKEN:
+    if (value == 0xff) {
+      return;
+    }
+    if (card.is_write_multiple && (value == 0xfd)) {
+      // stop tran token -- a byte then busy
+      card_push(0xff);
+      card_set_busy(800);
+      card.state = CARD_STATE_COMMAND;
+      return;
+    }
+    // only a start block token (or the stop tran token) may follow
+    TEST_ASSERT(value == (card.is_write_multiple ? 0xfc : 0xfe));
+    card.data_count = 0;
+    card.state = CARD_STATE_WRITE_DATA;
+    return;
+
+  case CARD_STATE_WRITE_DATA:
+    card.data[card.data_count++] = value;
+    if (card.data_count < BLOCK_SIZE + 2) {
+      return;
+    }
+    const u16 crc = (card.data[BLOCK_SIZE] << 8) | card.data[BLOCK_SIZE + 1];
+    // the driver always sends the CRC
+    TEST_ASSERT(crc == mcu_calc_crc16(0, 0x1021, card.data, BLOCK_SIZE));
+    TEST_ASSERT(card.block < CARD_BLOCK_COUNT);
+    memcpy(card_memory + card.block * BLOCK_SIZE, card.data, BLOCK_SIZE);
+    card.block++;
+    // data accepted then busy while the block is programmed
+    card_push(0xe5);
+    card_set_busy(800);
+    card.state = card.is_write_multiple ? CARD_STATE_WRITE_TOKEN : CARD_STATE_COMMAND;
+    return;
+  }
+}
+
+static u8 card_swap(u8 value) {
+  if (card.is_selected == 0) {
+    return 0xff;
+  }
+
+  card.byte_count++;
+
+  u8 result = 0xff;
+  int is_output = 0;
+  if (card.out_tail != card.out_head) {
+    result = card.out[card.out_tail++ % sizeof(card.out)];
+    is_output = 1;
+  } else if (card_is_busy()) {
+    // the card holds DO low while it is busy
+    return 0x00;
+  } else if (card.state == CARD_STATE_READ_MULTIPLE) {
+    card_push_gap(card_latency(400));
+    card_push_block();
+  }
+
+  if ((card.state == CARD_STATE_WRITE_TOKEN) || (card.state == CARD_STATE_WRITE_DATA)) {
+    // the data response and the busy bytes are sent before the next token
+    if (is_output == 0) {
+      card_receive_data(value);
+    }
+    return result;
+  }
+
+  if (card.command_count || ((value & 0xc0) == 0x40)) {
+    card.command[card.command_count++] = value;
+    if (card.command_count == sizeof(card.command)) {
+      card.command_count = 0;
+      card_execute_command();
+    }
+  }
+  return result;
+}
+
+static void card_reset(int is_sdsc) {
+  memset(&card, 0, sizeof(card));
+  card.is_sdsc = is_sdsc;
+  card.is_random_timing = 1;
+  card.is_idle = 1;
+}
+
+static void card_pio_write(int port, u32 mask, int value) {
+  // a new command starts with chip select
+  card.is_selected = value == 0;
+  card.command_count = 0;
+}
+
+static void card_pio_set_attributes(int port, const pio_attr_t *attr) {}
+
+const sos_config_t sos_config = {
+  .sys = {.pio_write = card_pio_write, .pio_set_attributes = card_pio_set_attributes}};
+
+static struct _reent task_reent;
+volatile task_t sos_task_table[2] = {[1] = {.reent = &task_reent}};
+
+void cortexm_delay_us(u32 us) { delay_us += us; }
+
+// SPI driver -- read() and write() complete from spi_interrupt()
+static devfs_async_t *spi_pending;
+static int is_spi_pending_write;
+
+static int spi_open(const devfs_handle_t *handle) { return 0; }
+static int spi_close(const devfs_handle_t *handle) { return 0; }
+
+static int spi_ioctl(const devfs_handle_t *handle, int request, void *ctl) {
+  switch (request) {
+  case I_SPI_SETATTR:
+    return 0;
+  case I_SPI_SWAP:
+    return card_swap((ssize_t)ctl);
+  }
+  return SYSFS_SET_RETURN(EINVAL);
+}
+
+static int spi_transfer(devfs_async_t *async, int is_write) {
+  TEST_ASSERT(spi_pending == NULL);
+  TEST_ASSERT(async->nbyte > 0);
+  spi_pending = async;
+  is_spi_pending_write = is_write;
+  return 0;
+}
+
+static int spi_read(const devfs_handle_t *handle, devfs_async_t *async) {
+  return spi_transfer(async, 0);
+}
+
+static int spi_write(const devfs_handle_t *handle, devfs_async_t *async) {
+  return spi_transfer(async, 1);
+}
+
+static int spi_interrupt() {
+  devfs_async_t *async = spi_pending;
+  if (async == NULL) {
+    return 0;
+  }
+  u8 *buf = async->buf;
+  for (int i = 0; i < async->nbyte; i++) {
+    if (is_spi_pending_write) {
+      card_swap(buf[i]);
+    } else {
+      buf[i] = card_swap(0xff);
+    }
+  }
+  spi_pending = NULL;
+  devfs_execute_event_handler(
+    &async->handler,
+    is_spi_pending_write ? MCU_EVENT_FLAG_WRITE_COMPLETE : MCU_EVENT_FLAG_DATA_READY,
+    NULL);
+  return 1;
+}
+
+static drive_sdspi_state_t sdspi_state;
+static const drive_sdspi_config_t sdspi_config = {
+  .device =
+    {.driver =
+       {.open = spi_open,
+        .ioctl = spi_ioctl,
+        .read = spi_read,
+        .write = spi_write,
+        .close = spi_close}},
+  .cs = {.port = 0, .pin = 5}};
+static const devfs_handle_t sdspi_handle = {.config = &sdspi_config, .state = &sdspi_state};
+
+static int is_complete;
+
+static int handle_complete(void *context, const mcu_event_t *event) {
+  is_complete = 1;
+  return 0;
+}
+
+static void wait_while_busy() {
+  int result;
+  int count = 0;
+  while ((result = drive_sdspi_ioctl(&sdspi_handle, I_DRIVE_ISBUSY, NULL)) > 0) {
+    TEST_ASSERT(++count < 1000);
+  }
+  TEST_ASSERT(result == 0);
+}
+
+// what devfs does for a blocking read or write -- returns the bytes
+// transferred, -1 with the task's errno or the driver's error
+static int transfer(u32 block, u8 *buf, int nbyte, int is_write) {
+  devfs_async_t async;
+  for (int retry = 0; retry < 10; retry++) {
+    memset(&async, 0, sizeof(async));
+    async.tid = 1;
+    async.loc = block;
+    async.buf = buf;
+    async.nbyte = nbyte;
+    async.handler.callback = handle_complete;
+    is_complete = 0;
+
+    const int result = is_write ? drive_sdspi_write(&sdspi_handle, &async)
+                                : drive_sdspi_read(&sdspi_handle, &async);
+    if (result == 0) {
+      int count = 0;
+      while (is_complete == 0) {
+        TEST_ASSERT(spi_interrupt());
+        TEST_ASSERT(++count < 100000);
+      }
+      TEST_ASSERT(spi_pending == NULL);
+      return async.nbyte;
+    }
+
+    if (SYSFS_GET_RETURN_ERRNO(result) != EBUSY) {
+      return result;
+    }
+    // the card is programming the last write
+    wait_while_busy();
+  }
+  TEST_ASSERT(0);
+  return -1;
+}
+
+static void test_init(int is_sdsc) {
+  card_reset(is_sdsc);
+  TEST_ASSERT(drive_sdspi_open(&sdspi_handle) == 0);
+  drive_attr_t attr = {.o_flags = DRIVE_FLAG_INIT};
+  TEST_ASSERT(drive_sdspi_ioctl(&sdspi_handle, I_DRIVE_SETATTR, &attr) == 0);
+  TEST_ASSERT(card.is_idle == 0);
+  TEST_ASSERT(card.is_crc_on);
+
+  drive_info_t info;
+  TEST_ASSERT(drive_sdspi_ioctl(&sdspi_handle, I_DRIVE_GETINFO, &info) == 0);
+  TEST_ASSERT(info.addressable_size == BLOCK_SIZE);
+  TEST_ASSERT(info.num_write_blocks == CARD_BLOCK_COUNT);
+}
+
+static void test_random_operations(int is_sdsc) {
+  static u8 buffer[16 * BLOCK_SIZE];
+  test_init(is_sdsc);
+
+  for (int i = 0; i < 1000; i++) {
+    const int block_count = (host_rand() % 2) ? 1 : 1 + host_rand() % 16;
+    const u32 block = host_rand() % (CARD_BLOCK_COUNT - block_count + 1);
+    const int nbyte = block_count * BLOCK_SIZE;
+    const u32 multiple_block_count = card.multiple_block_count;
+    if (host_rand() % 2) {
+      for (int j = 0; j < nbyte; j++) {
+        buffer[j] = host_rand();
+      }
+      TEST_ASSERT(transfer(block, buffer, nbyte, 1) == nbyte);
+      memcpy(model + block * BLOCK_SIZE, buffer, nbyte);
+      TEST_ASSERT(memcmp(card_memory, model, sizeof(model)) == 0);
+    } else {
+      memset(buffer, 0, nbyte);
+      TEST_ASSERT(transfer(block, buffer, nbyte, 0) == nbyte);
+      TEST_ASSERT(memcmp(buffer, model + block * BLOCK_SIZE, nbyte) == 0);
+    }
+
+    // one command for all the blocks
+    TEST_ASSERT(card.multiple_block_count == multiple_block_count + (block_count > 1));
+  }
+  TEST_ASSERT(card.pre_erase_count > 1);
+
+  // only whole blocks
+  int result = transfer(0, buffer, 100, 0);
+  TEST_ASSERT((result < 0) && (SYSFS_GET_RETURN_ERRNO(result) == EINVAL));
+  result = transfer(0, buffer, BLOCK_SIZE + 1, 1);
+  TEST_ASSERT((result < 0) && (SYSFS_GET_RETURN_ERRNO(result) == EINVAL));
+
+  // a bad CRC fails the read (and stops a multiple block read)
+  for (int block_count = 1; block_count <= 4; block_count++) {
+    card.corrupt_read_count = 1;
+    task_reent._errno = 0;
+    TEST_ASSERT(transfer(10, buffer, block_count * BLOCK_SIZE, 0) == -1);
+    TEST_ASSERT(task_reent._errno == EINVAL);
+    TEST_ASSERT(transfer(10, buffer, block_count * BLOCK_SIZE, 0) == block_count * BLOCK_SIZE);
+    TEST_ASSERT(memcmp(buffer, model + 10 * BLOCK_SIZE, block_count * BLOCK_SIZE) == 0);
+  }
+
+  printf(
+    "%s: %llu bytes clocked, %u multiple block transfers\n",
+    is_sdsc ? "SDSC" : "SDHC", (unsigned long long)card.byte_count,
+    card.multiple_block_count);
+}
+
+static u64 benchmark(int block_count, int is_write) {
+  static u8 buffer[16 * BLOCK_SIZE];
+  const int total = 128;
+  card.is_random_timing = 0;
+  wait_while_busy();
+  const u64 start = get_time_ns();
+  for (int block = 0; block < total; block += block_count) {
+    TEST_ASSERT(
+      transfer(block, buffer, block_count * BLOCK_SIZE, is_write)
+      == block_count * BLOCK_SIZE);
+  }
+  wait_while_busy();
+  const u64 us = (get_time_ns() - start) / 1000;
+  printf(
+    "%s %2d block requests: %6.1f ms (%6.1f KB/s)\n", is_write ? "write" : " read",
+    block_count, us / 1000.0, total * BLOCK_SIZE * 1000.0 / us);
+  return us;
+}
+
+int main() {
+  // CMD0 is always sent with its CRC
+  const u8 go_idle[5] = {0x40, 0, 0, 0, 0};
+  TEST_ASSERT(mcu_calc_crc7(0, 0x09, go_idle, 5) == 0x95);
+
+  host_srand(36);
+  for (int i = 0; i < CARD_BLOCK_COUNT * BLOCK_SIZE; i++) {
+    card_memory[i] = model[i] = host_rand();
+  }
+  test_random_operations(0);
+  test_random_operations(1);
+
+  // bus time with the driver's delays
+  const u64 read_us = benchmark(1, 0);
+  TEST_ASSERT(benchmark(16, 0) < read_us);
+  const u64 write_us = benchmark(1, 1);
+  TEST_ASSERT(benchmark(16, 1) < write_us);
+  return 0;
+}
@@ -0,0 +1,129 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <string.h>
+
+#include "device/fifo.h"
+#include "host.h"
+
+// fifo_read_buffer(), fifo_write_buffer() and fifo_push_buffer() are checked
+// against a simple byte queue, then timed for 1, 64 and 512 byte operations
+
+#define FIFO_SIZE 1000
+#define MODEL_SIZE (64 * 1024)
+
+static char fifo_buffer[FIFO_SIZE];
+static const fifo_config_t fifo_config = {.size = FIFO_SIZE, .buffer = fifo_buffer};
+static fifo_state_t fifo_state;
+
+// bytes written (model_head) and read (model_tail) -- the fifo holds the last
+// model_head - model_tail bytes of model
+static char model[MODEL_SIZE];
+static int model_head;
+static int model_tail;
+static int model_count;
+
+static void model_write(const char *buf, int nbyte, int is_overwrite) {
+  if (!is_overwrite && (nbyte > FIFO_SIZE - model_count)) {
+    nbyte = FIFO_SIZE - model_count;
+  }
+  for (int i = 0; i < nbyte; i++) {
+    model[(model_head + i) % MODEL_SIZE] = buf[i];
+  }
+  model_head += nbyte;
+  model_count += nbyte;
+  if (model_count > FIFO_SIZE) {
+    // the oldest bytes were overwritten
+    model_tail += model_count - FIFO_SIZE;
+    model_count = FIFO_SIZE;
+  }
+}
+
+static void fill(char *buf, int nbyte) {
+  for (int i = 0; i < nbyte; i++) {
+    buf[i] = host_rand();
+  }
+}
+
+static void check_read(int nbyte) {
+  char buf[FIFO_SIZE * 2];
+  const int expected = nbyte < model_count ? nbyte : model_count;
+  const int result = fifo_read_buffer(&fifo_config, &fifo_state, buf, nbyte);
+  TEST_ASSERT(result == expected);
+  for (int i = 0; i < result; i++) {
+    TEST_ASSERT(buf[i] == model[(model_tail + i) % MODEL_SIZE]);
+  }
+  model_tail += result;
+  model_count -= result;
+}
+
+static void test_random_operations() {
+  char buf[FIFO_SIZE * 2];
+  memset(&fifo_state, 0, sizeof(fifo_state));
+  fifo_flush(&fifo_state);
+  host_srand(31);
+
+  for (int i = 0; i < 200000; i++) {
+    // mostly small transfers with a few that are larger than the fifo
+    const int nbyte = (host_rand() % 8) ? host_rand() % 300 : host_rand() % sizeof(buf);
+    switch (host_rand() % 4) {
+    case 0: {
+      // writeblock: only the free space is written
+      fill(buf, nbyte);
+      fifo_set_writeblock(&fifo_state, 1);
+      const int expected = nbyte < FIFO_SIZE - model_count ? nbyte : FIFO_SIZE - model_count;
+      TEST_ASSERT(fifo_write_buffer(&fifo_config, &fifo_state, buf, nbyte, 0) == expected);
+      model_write(buf, nbyte, 0);
+    } break;
+    case 1: {
+      // the oldest data is overwritten and the overflow is reported
+      fill(buf, nbyte);
+      fifo_set_writeblock(&fifo_state, 0);
+      fifo_set_overflow(&fifo_state, 0);
+      const int is_overflow = model_count + nbyte > FIFO_SIZE;
+      TEST_ASSERT(fifo_write_buffer(&fifo_config, &fifo_state, buf, nbyte, 0) == nbyte);
+      TEST_ASSERT(fifo_is_overflow(&fifo_state) == is_overflow);
+      model_write(buf, nbyte, 1);
+    } break;
+    case 2:
+      // receive callbacks always overwrite
+      fill(buf, nbyte);
+      TEST_ASSERT(fifo_push_buffer(&fifo_config, &fifo_state, buf, nbyte) == nbyte);
+      model_write(buf, nbyte, 1);
+      break;
+    case 3:
+      check_read(nbyte);
+      break;
+    }
+
+    fifo_info_t info;
+    fifo_getinfo(&info, &fifo_config, &fifo_state);
+    TEST_ASSERT(info.size_ready == (u32)model_count);
+  }
+
+  check_read(FIFO_SIZE);
+  TEST_ASSERT(model_count == 0);
+}
+
+static void benchmark(int nbyte) {
+  char buf[512];
+  const int total = 16 * 1024 * 1024;
+  memset(&fifo_state, 0, sizeof(fifo_state));
+  fifo_flush(&fifo_state);
+  fill(buf, sizeof(buf));
+
+  const double start = host_get_seconds();
+  for (int i = 0; i < total; i += nbyte) {
+    fifo_write_buffer(&fifo_config, &fifo_state, buf, nbyte, 1);
+    TEST_ASSERT(fifo_read_buffer(&fifo_config, &fifo_state, buf, nbyte) == nbyte);
+  }
+  const double seconds = host_get_seconds() - start;
+  printf("%3d byte operations: %8.1f MB/s\n", nbyte, total / seconds / 1000000.0);
+}
+
+int main() {
+  test_random_operations();
+  benchmark(1);
+  benchmark(64);
+  benchmark(512);
+  return 0;
+}
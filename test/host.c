@@ -0,0 +1,75 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <time.h>
+
+#include "host.h"
+#include "mcu/crc.h"
+#include "mcu/wdt.h"
+#include "sos/events.h"
+
+// kernel services used by the code under test -- devfs handlers are built from
+// src/cortexm/devfs.c
+
+static unsigned int host_rand_state = 1;
+
+// the interrupt mask used by the cmsis shim (include/sos/arch/cmsis)
+u32 host_primask;
+
+// everything runs as one task
+volatile int m_task_current = 1;
+
+void cortexm_disable_interrupts() { host_primask = 1; }
+
+double host_get_seconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1000000000.0;
+}
+
+void host_srand(unsigned int seed) { host_rand_state = seed ? seed : 1; }
+
+unsigned int host_rand() {
+  // xorshift32
+  host_rand_state ^= host_rand_state << 13;
+  host_rand_state ^= host_rand_state >> 17;
+  host_rand_state ^= host_rand_state << 5;
+  return host_rand_state;
+}
+
+void mcu_wdt_root_reset(void *args) {}
+
+// bit at a time versions of the MCU port CRCs (MSB first)
+u8 mcu_calc_crc7(u8 seed, u8 polynomial, const u8 *chr, u32 len) {
+  u8 crc = seed;
+  for (u32 i = 0; i < len; i++) {
+    u8 data = chr[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc <<= 1;
+      if ((data ^ crc) & 0x80) {
+        crc ^= polynomial;
+      }
+      data <<= 1;
+    }
+  }
+  // with the end bit
+  return (crc << 1) | 1;
+}
+
+u16 mcu_calc_crc16(u16 seed, u16 polynomial, const u8 *buffer, u32 nbyte) {
+  u16 crc = seed;
+  for (u32 i = 0; i < nbyte; i++) {
+    crc ^= buffer[i] << 8;
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ polynomial : crc << 1;
+    }
+  }
+  return crc;
+}
+
+void sos_handle_event(int event, void *args) {
+  (void)event;
+  (void)args;
+}
+
+// poll() isn't part of the host tests
+void devfs_poll_notify() {}
@@ -0,0 +1,25 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef TEST_HOST_H_
+#define TEST_HOST_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// fails the test (ctest treats a non-zero exit as a failure)
+#define TEST_ASSERT(expression)                                                          \
+  do {                                                                                   \
+    if (!(expression)) {                                                                 \
+      printf("%s:%d: '%s' failed\n", __FILE__, __LINE__, #expression);                   \
+      exit(1);                                                                           \
+    }                                                                                    \
+  } while (0)
+
+// monotonic time used by the benchmarks
+double host_get_seconds();
+
+// pseudo random numbers that are the same on every host
+void host_srand(unsigned int seed);
+unsigned int host_rand();
+
+#endif /* TEST_HOST_H_ */
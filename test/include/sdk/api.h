@@ -0,0 +1,46 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SDK_API_H_
+#define SDK_API_H_
+
+// host version of the SDK API header -- the crypto APIs only have the
+// functions the kernel calls and a test provides them
+
+#include "types.h"
+
+#define MCU_API_REQUEST_CODE(a, b, c, d) (((a) << 24) | ((b) << 16) | ((c) << 8) | (d))
+
+#define CRYPT_SHA256_ROOT_API_REQUEST MCU_API_REQUEST_CODE('S', '2', '5', '6')
+#define CRYPT_ECC_ROOT_API_REQUEST MCU_API_REQUEST_CODE('E', 'C', 'C', 'R')
+#define CRYPT_AES_ROOT_API_REQUEST MCU_API_REQUEST_CODE('A', 'E', 'S', 'R')
+#define CRYPT_RANDOM_ROOT_API_REQUEST MCU_API_REQUEST_CODE('R', 'N', 'D', 'R')
+
+typedef struct crypt_random_api crypt_random_api_t;
+typedef struct crypt_aes_api crypt_aes_api_t;
+
+typedef struct crypt_hash_api {
+  int (*init)(void **context);
+  void (*deinit)(void **context);
+  int (*start)(void *context);
+  int (*update)(void *context, const unsigned char *input, u32 size);
+  int (*finish)(void *context, unsigned char *output, u32 size);
+} crypt_hash_api_t;
+
+typedef struct crypt_ecc_api {
+  int (*init)(void **context);
+  void (*deinit)(void **context);
+  int (*dsa_set_key_pair)(
+    void *context,
+    const u8 *public_key,
+    u32 public_key_capacity,
+    const u8 *private_key,
+    u32 private_key_capacity);
+  int (*dsa_verify)(
+    void *context,
+    const u8 *message_hash,
+    u32 hash_size,
+    const u8 *signature,
+    u32 signature_size);
+} crypt_ecc_api_t;
+
+#endif /* SDK_API_H_ */
@@ -0,0 +1,127 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SDK_TYPES_H_
+#define SDK_TYPES_H_
+
+// host version of the SDK types used by the kernel headers -- only what the
+// host tests need
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "sos/ioctl.h"
+
+typedef uint8_t u8;
+typedef int8_t s8;
+typedef int8_t i8;
+typedef uint16_t u16;
+typedef int16_t s16;
+typedef uint32_t u32;
+typedef int32_t s32;
+typedef uint64_t u64;
+typedef int64_t s64;
+
+#define MCU_ALIAS(f) __attribute__((weak, alias(#f)))
+#define MCU_WEAK __attribute__((weak))
+#define MCU_UNUSED __attribute__((unused))
+#define MCU_UNUSED_ARGUMENT(x) (void)x
+#define MCU_PACK __attribute__((packed))
+#define MCU_NAKED
+#define MCU_ALIGN(x) __attribute__((aligned(x)))
+#define MCU_ALWAYS_INLINE __attribute__((always_inline))
+#define MCU_NEVER_INLINE __attribute__((noinline))
+
+// there is no privileged mode or system memory on the host
+#define MCU_SYS_MEM
+#define MCU_ROOT_CODE
+#define MCU_PRIV_CODE
+#define MCU_ROOT_EXEC_CODE
+#define MCU_PRIV_EXEC_CODE
+
+typedef struct {
+  u32 o_events;
+  void *data;
+} mcu_event_t;
+
+enum {
+  MCU_EVENT_FLAG_NONE = 0,
+  MCU_EVENT_FLAG_DATA_READY = (1 << 0),
+  MCU_EVENT_FLAG_WRITE_COMPLETE = (1 << 1),
+  MCU_EVENT_FLAG_CANCELED = (1 << 2),
+  MCU_EVENT_FLAG_RISING = (1 << 3),
+  MCU_EVENT_FLAG_FALLING = (1 << 4),
+  MCU_EVENT_FLAG_UNUSED = (1 << 5),
+  MCU_EVENT_FLAG_ERROR = (1 << 6),
+  MCU_EVENT_FLAG_ADDRESSED = (1 << 7),
+  MCU_EVENT_FLAG_OVERFLOW = (1 << 8),
+  MCU_EVENT_FLAG_UNDERRUN = (1 << 9),
+  MCU_EVENT_FLAG_HIGH = (1 << 10),
+  MCU_EVENT_FLAG_LOW = (1 << 11),
+  MCU_EVENT_FLAG_SETUP = (1 << 12),
+  MCU_EVENT_FLAG_STALL = (1 << 13),
+  MCU_EVENT_FLAG_RESET = (1 << 14),
+  MCU_EVENT_FLAG_POWER = (1 << 15),
+  MCU_EVENT_FLAG_SUSPEND = (1 << 16),
+  MCU_EVENT_FLAG_RESUME = (1 << 17),
+  MCU_EVENT_FLAG_DEBUG = (1 << 18),
+  MCU_EVENT_FLAG_WAKEUP = (1 << 19),
+  MCU_EVENT_FLAG_SOF = (1 << 20),
+  MCU_EVENT_FLAG_MATCH = (1 << 21),
+  MCU_EVENT_FLAG_COUNT = (1 << 22)
+};
+
+typedef int (*mcu_callback_t)(void *, const mcu_event_t *);
+
+typedef struct {
+  mcu_callback_t callback;
+  void *context;
+} mcu_event_handler_t;
+
+typedef struct MCU_PACK {
+  u8 channel;
+  s8 prio;
+  u32 o_events;
+  mcu_event_handler_t handler;
+} mcu_action_t;
+
+typedef struct MCU_PACK {
+  u8 port;
+  u8 pin;
+} mcu_pin_t;
+
+typedef struct MCU_PACK {
+  u32 loc;
+  u32 value;
+} mcu_channel_t;
+
+typedef struct {
+  u32 sn[4];
+} mcu_sn_t;
+
+struct mcu_timeval {
+  u32 tv_sec;
+  u32 tv_usec;
+};
+
+// the C library's reentrancy structure -- drivers only set the errno
+struct _reent {
+  int _errno;
+};
+
+// the C library's open file (sysfs_file_t)
+typedef struct {
+  const void *fs;
+  void *handle;
+  int flags;
+  int loc;
+} open_file_t;
+
+#define I_MCU_GETVERSION 0
+#define I_MCU_GETINFO 1
+#define I_MCU_SETATTR 2
+#define I_MCU_SETACTION 3
+#define I_MCU_TOTAL 4
+
+#endif /* SDK_TYPES_H_ */
@@ -0,0 +1,16 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef ARCH_H_
+#define ARCH_H_
+
+// host version of the architecture header
+
+#include <sdk/types.h>
+#include <stdlib.h>
+
+#include "sos/arch/cmsis/cmsis_compiler.h"
+
+#define ARCH_DEFINED 1
+#define ARCH "host"
+
+#endif /* ARCH_H_ */
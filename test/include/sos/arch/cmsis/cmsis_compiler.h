@@ -0,0 +1,26 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SOS_ARCH_CMSIS_COMPILER_H_
+#define SOS_ARCH_CMSIS_COMPILER_H_
+
+// host version of the CMSIS core functions -- there are no interrupts on the host
+// so PRIMASK is just a variable (the tests call the interrupt handlers directly)
+
+#include <sdk/types.h>
+
+extern u32 host_primask;
+
+static inline u32 __get_PRIMASK() { return host_primask; }
+static inline void __set_PRIMASK(u32 value) { host_primask = value; }
+static inline void __disable_irq() { host_primask = 1; }
+static inline void __enable_irq() { host_primask = 0; }
+
+// thread mode is privileged
+static inline u32 __get_CONTROL() { return 0; }
+
+static inline void __DMB() { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+static inline void __DSB() { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+static inline void __ISB() { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+static inline void __NOP() {}
+
+#endif /* SOS_ARCH_CMSIS_COMPILER_H_ */
@@ -0,0 +1,14 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SOS_SYMBOLS_H_
+#define SOS_SYMBOLS_H_
+
+// host version of the kernel symbol table header -- the host tests don't
+// export symbols to applications
+
+#include <string.h>
+
+#include "cortexm/cortexm.h"
+#include "sos/sos.h"
+
+#endif /* SOS_SYMBOLS_H_ */
@@ -0,0 +1,9 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef CONFIG_SOS_CONFIG_H
+#define CONFIG_SOS_CONFIG_H
+
+// board configuration for the host tests -- src/config.h provides the defaults
+// and a test can pass others as compile definitions
+
+#endif /* CONFIG_SOS_CONFIG_H */
@@ -0,0 +1,4 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// the toolchain's C library locks are pthread mutexes
+#include <pthread.h>
@@ -0,0 +1,253 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <string.h>
+
+#include "host.h"
+#include "sos/dev/bootloader.h"
+#include "sos/link.h"
+#include "sos/lz.h"
+
+// Images packed with link_lz_compress() are decoded by sos_lz_decode() with
+// the input and output split at random, for random, zero filled, text-like and
+// firmware-like data, including repeats that are further back than the match
+// window. Truncated and corrupted streams must not write past the output
+// buffer. Then the compression ratio and speed are measured for firmware-like
+// data and the test executable, decoding one bootloader page at a time.
+
+#define DATA_SIZE (256 * 1024)
+#define BENCHMARK_SIZE (1024 * 1024)
+#define LINK_BYTES_PER_SECOND 1000000
+
+enum { KIND_RANDOM, KIND_ZERO, KIND_TEXT, KIND_FIRMWARE, KIND_FAR, KIND_COUNT };
+
+static u8 data[BENCHMARK_SIZE];
+static u8 compressed[LINK_LZ_COMPRESS_BOUND(BENCHMARK_SIZE)];
+static u8 decoded[BENCHMARK_SIZE + 64];
+static sos_lz_decoder_t decoder;
+
+static void fill(u8 *buffer, int nbyte, int kind) {
+  static const char *words[] = {"the",    "stratify", "kernel", "device", "driver",
+                                "flash",  "page",     "image",  "install", "appfs",
+                                "signal", "thread",   "mutex",  "\n",      "0x20000000"};
+  static u8 functions[32][24];
+  for (int i = 0; i < 32; i++) {
+    for (int j = 0; j < 24; j++) {
+      functions[i][j] = host_rand();
+    }
+  }
+
+  int loc = 0;
+  while (loc < nbyte) {
+    u8 chunk[64];
+    int count = 0;
+    switch (kind) {
+    case KIND_RANDOM:
+      chunk[count++] = host_rand();
+      break;
+    case KIND_ZERO:
+      // long runs with the odd byte in between
+      count = 1 + host_rand() % 64;
+      memset(chunk, 0, count);
+      if (host_rand() % 8 == 0) {
+        chunk[0] = host_rand();
+      }
+      break;
+    case KIND_TEXT: {
+      const char *word = words[host_rand() % (sizeof(words) / sizeof(words[0]))];
+      count = strlen(word);
+      memcpy(chunk, word, count);
+      chunk[count++] = ' ';
+    } break;
+    case KIND_FIRMWARE:
+      if (host_rand() % 8) {
+        // a common instruction sequence, sometimes with a different register or
+        // immediate
+        count = 8 + host_rand() % 17;
+        memcpy(chunk, functions[host_rand() % 32], count);
+        if (host_rand() % 2) {
+          chunk[host_rand() % count] = host_rand();
+        }
+      } else {
+        // constants and literal pools
+        count = 1 + host_rand() % 40;
+        for (int i = 0; i < count; i++) {
+          chunk[i] = host_rand();
+        }
+      }
+      break;
+    case KIND_FAR:
+      // 2KB of random data repeated -- further back than the window
+      count = 1;
+      chunk[0] = loc < 2048 ? host_rand() : buffer[loc - 2048];
+      break;
+    }
+
+    if (count > nbyte - loc) {
+      count = nbyte - loc;
+    }
+    memcpy(buffer + loc, chunk, count);
+    loc += count;
+  }
+}
+
+static int compress(const u8 *src, int nbyte) {
+  const int result =
+    link_lz_compress(src, nbyte, compressed, LINK_LZ_COMPRESS_BOUND(nbyte));
+  TEST_ASSERT(result >= (int)sizeof(sos_lz_header_t));
+  TEST_ASSERT(result <= LINK_LZ_COMPRESS_BOUND(nbyte));
+  return result;
+}
+
+// decodes with the input and output split into random sizes and returns the
+// number of bytes written (or -1) and the input used
+static int decode(int compressed_size, int dest_size, int max_chunk, int *src_used) {
+  sos_lz_decoder_init(&decoder);
+  int in_loc = 0;
+  int out_loc = 0;
+  int count = 0;
+  while (sos_lz_is_complete(&decoder) == 0) {
+    u32 in_size = 1 + host_rand() % max_chunk;
+    if (in_size > compressed_size - in_loc) {
+      in_size = compressed_size - in_loc;
+    }
+    u32 out_size = 1 + host_rand() % max_chunk;
+    if (out_size > dest_size - out_loc) {
+      out_size = dest_size - out_loc;
+    }
+
+    const int result =
+      sos_lz_decode(&decoder, compressed + in_loc, &in_size, decoded + out_loc, out_size);
+    if (result < 0) {
+      return -1;
+    }
+    TEST_ASSERT(result <= out_size);
+    TEST_ASSERT(in_size <= compressed_size - in_loc);
+    in_loc += in_size;
+    out_loc += result;
+    if ((in_size == 0) && (result == 0)) {
+      // the stream is truncated or doesn't fit
+      break;
+    }
+    TEST_ASSERT(++count < 10000000);
+  }
+  *src_used = in_loc;
+  return out_loc;
+}
+
+static void test_round_trip() {
+  host_srand(46);
+  for (int i = 0; i < 400; i++) {
+    const int kind = i % KIND_COUNT;
+    // small images exercise the end of the stream
+    const int nbyte = (i % 3) ? host_rand() % 64 : host_rand() % DATA_SIZE;
+    fill(data, nbyte, kind);
+
+    const int compressed_size = compress(data, nbyte);
+    if ((kind == KIND_ZERO) || (kind == KIND_TEXT)) {
+      TEST_ASSERT((nbyte < 4096) || (compressed_size < nbyte / 2));
+    }
+
+    memset(decoded, 0xaa, sizeof(decoded));
+    int src_used;
+    TEST_ASSERT(
+      decode(compressed_size, sizeof(decoded), i % 2 ? 16 : 2048, &src_used) == nbyte);
+    TEST_ASSERT(sos_lz_is_complete(&decoder));
+    TEST_ASSERT(src_used == compressed_size);
+    TEST_ASSERT(memcmp(decoded, data, nbyte) == 0);
+    // nothing is written after the image
+    TEST_ASSERT(decoded[nbyte] == 0xaa);
+
+    // the destination must hold the whole stream
+    if (compressed_size > (int)sizeof(sos_lz_header_t) + 1) {
+      TEST_ASSERT(link_lz_compress(data, nbyte, compressed, compressed_size - 1) == -1);
+    }
+  }
+}
+
+static void test_invalid_streams() {
+  host_srand(4600);
+  const int nbyte = 8192;
+  fill(data, nbyte, KIND_FIRMWARE);
+  const int compressed_size = compress(data, nbyte);
+  int src_used;
+
+  // not a compressed image
+  compressed[0] ^= 0xff;
+  TEST_ASSERT(sos_lz_is_compressed(compressed) == 0);
+  TEST_ASSERT(decode(compressed_size, nbyte, 64, &src_used) == -1);
+  compressed[0] ^= 0xff;
+  TEST_ASSERT(sos_lz_is_compressed(compressed));
+
+  // truncated
+  for (int i = 0; i < 100; i++) {
+    const int size = host_rand() % compressed_size;
+    TEST_ASSERT(decode(size, nbyte, 64, &src_used) < nbyte);
+    TEST_ASSERT(sos_lz_is_complete(&decoder) == 0);
+  }
+
+  // corrupted -- the decoder stays within the output buffer (checked by the
+  // sanitizer) and within the size in the header
+  for (int i = 0; i < 2000; i++) {
+    const int loc = sizeof(sos_lz_header_t) + host_rand() % (compressed_size - 8);
+    const u8 value = compressed[loc];
+    compressed[loc] = host_rand();
+    const int result = decode(compressed_size, sizeof(decoded), 256, &src_used);
+    TEST_ASSERT(result <= nbyte);
+    compressed[loc] = value;
+  }
+  TEST_ASSERT(decode(compressed_size, nbyte, 64, &src_used) == nbyte);
+  TEST_ASSERT(src_used == compressed_size);
+  TEST_ASSERT(memcmp(decoded, data, nbyte) == 0);
+}
+
+static void benchmark(const char *name, const u8 *image, int nbyte) {
+  const double compress_start = host_get_seconds();
+  const int compressed_size = compress(image, nbyte);
+  const double compress_seconds = host_get_seconds() - compress_start;
+
+  // like the bootloader -- one page at a time as the image arrives
+  sos_lz_decoder_init(&decoder);
+  const double decode_start = host_get_seconds();
+  int in_loc = 0;
+  int out_loc = 0;
+  while (sos_lz_is_complete(&decoder) == 0) {
+    u32 in_size = compressed_size - in_loc;
+    const int result = sos_lz_decode(
+      &decoder, compressed + in_loc, &in_size, decoded + out_loc,
+      BOOTLOADER_WRITEPAGESIZE);
+    TEST_ASSERT(result >= 0);
+    in_loc += in_size;
+    out_loc += result;
+  }
+  const double decode_seconds = host_get_seconds() - decode_start;
+  TEST_ASSERT(out_loc == nbyte);
+  TEST_ASSERT(memcmp(decoded, image, nbyte) == 0);
+
+  printf(
+    "%-9s %7d -> %7d bytes (%4.1f%%), compress %6.1f MB/s, decode %6.1f MB/s, "
+    "link %5.0f -> %5.0f ms\n",
+    name, nbyte, compressed_size, compressed_size * 100.0 / nbyte,
+    nbyte / compress_seconds / 1000000.0, nbyte / decode_seconds / 1000000.0,
+    nbyte * 1000.0 / LINK_BYTES_PER_SECOND,
+    compressed_size * 1000.0 / LINK_BYTES_PER_SECOND);
+}
+
+int main(int argc, char *argv[]) {
+  test_round_trip();
+  test_invalid_streams();
+
+  host_srand(1);
+  fill(data, BENCHMARK_SIZE, KIND_FIRMWARE);
+  benchmark("firmware", data, BENCHMARK_SIZE);
+  fill(data, BENCHMARK_SIZE, KIND_RANDOM);
+  benchmark("random", data, BENCHMARK_SIZE);
+
+  // real machine code (for the host rather than the MCU)
+  FILE *executable = fopen(argv[0], "rb");
+  if (executable != NULL) {
+    const int nbyte = fread(data, 1, BENCHMARK_SIZE, executable);
+    fclose(executable);
+    benchmark("lz_test", data, nbyte);
+  }
+  return 0;
+}
@@ -0,0 +1,157 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+#include "device/ring.h"
+#include "host.h"
+
+// A producer and a consumer thread move a numbered stream of elements through
+// one ring (built with the thread sanitizer). Each side picks random transfer
+// sizes and switches between the copy API and the in-place acquire/release
+// API. The consumer checks that every element arrives once and in order.
+//
+// The producer side resync calls (ring_drop() and ring_write_overwrite()) are
+// checked from one thread first.
+
+#define ELEMENT_COUNT 400000
+#define CAPACITY_MAX 1024
+
+typedef struct {
+  u32 sequence;
+  u32 check;
+} element_t;
+
+static ring_t ring;
+static u32 capacity;
+static element_t ring_buffer[CAPACITY_MAX];
+
+static element_t make_element(u32 sequence) {
+  element_t element = {.sequence = sequence, .check = ~sequence * 2654435761u};
+  return element;
+}
+
+static int is_element(const element_t *element, u32 sequence) {
+  const element_t expected = make_element(sequence);
+  return memcmp(element, &expected, sizeof(expected)) == 0;
+}
+
+static void *producer(void *args) {
+  unsigned int seed = (unsigned int)(uintptr_t)args;
+  element_t buffer[CAPACITY_MAX];
+  u32 sequence = 0;
+
+  while (sequence < ELEMENT_COUNT) {
+    seed = seed * 1103515245 + 12345;
+    u32 count = 1 + (seed >> 8) % capacity;
+    if (count > ELEMENT_COUNT - sequence) {
+      count = ELEMENT_COUNT - sequence;
+    }
+    if (seed & 0x80000000) {
+      // copy into the ring
+      for (u32 i = 0; i < count; i++) {
+        buffer[i] = make_element(sequence + i);
+      }
+      sequence += ring_write(
+        &ring, capacity, sizeof(element_t), (char *)ring_buffer, buffer, count);
+    } else {
+      // fill the ring in place
+      u32 index;
+      const u32 available = ring_acquire_write(&ring, capacity, count, &index);
+      const u32 offset = ring_offset(index, capacity);
+      for (u32 i = 0; i < available; i++) {
+        ring_buffer[offset + i] = make_element(sequence + i);
+      }
+      TEST_ASSERT(ring_release_write(&ring, capacity, index, available) == 1);
+      sequence += available;
+    }
+    if ((seed & 0xf) == 0) {
+      sched_yield();
+    }
+  }
+  return NULL;
+}
+
+static void *consumer(void *args) {
+  unsigned int seed = (unsigned int)(uintptr_t)args;
+  element_t buffer[CAPACITY_MAX];
+  u32 sequence = 0;
+
+  while (sequence < ELEMENT_COUNT) {
+    seed = seed * 1103515245 + 12345;
+    const u32 count = 1 + (seed >> 8) % capacity;
+    if (seed & 0x80000000) {
+      const u32 result = ring_read(
+        &ring, capacity, sizeof(element_t), (const char *)ring_buffer, buffer, count);
+      for (u32 i = 0; i < result; i++) {
+        TEST_ASSERT(is_element(buffer + i, sequence + i));
+      }
+      sequence += result;
+    } else {
+      u32 index;
+      const u32 ready = ring_acquire_read(&ring, capacity, count, &index);
+      const u32 offset = ring_offset(index, capacity);
+      for (u32 i = 0; i < ready; i++) {
+        TEST_ASSERT(is_element(ring_buffer + offset + i, sequence + i));
+      }
+      TEST_ASSERT(ring_release_read(&ring, capacity, index, ready) == 1);
+      sequence += ready;
+    }
+    if ((seed & 0xf) == 0) {
+      sched_yield();
+    }
+  }
+  return NULL;
+}
+
+static void fuzz(u32 capacity_value, unsigned int seed) {
+  pthread_t producer_thread;
+  capacity = capacity_value;
+  ring_init(&ring);
+
+  TEST_ASSERT(
+    pthread_create(&producer_thread, NULL, producer, (void *)(uintptr_t)seed) == 0);
+  consumer((void *)(uintptr_t)(seed * 7 + 1));
+  TEST_ASSERT(pthread_join(producer_thread, NULL) == 0);
+  TEST_ASSERT(ring_is_empty(&ring));
+  printf("capacity %4u: %d elements\n", capacity, ELEMENT_COUNT);
+}
+
+static void test_resync() {
+  char buffer[10];
+  char result[32];
+  ring_init(&ring);
+
+  TEST_ASSERT(ring_write(&ring, 10, 1, buffer, "abcdefgh", 8) == 8);
+  // only 2 fit -- 3 of the oldest are dropped
+  TEST_ASSERT(ring_write_overwrite(&ring, 10, 1, buffer, "12345", 5) == 3);
+  TEST_ASSERT(ring_read(&ring, 10, 1, buffer, result, sizeof(result)) == 10);
+  TEST_ASSERT(memcmp(result, "defgh12345", 10) == 0);
+
+  // only the newest 10 are kept
+  TEST_ASSERT(ring_write_overwrite(&ring, 10, 1, buffer, "0123456789ABC", 13) == 3);
+  TEST_ASSERT(ring_count(&ring, 10) == 10);
+  TEST_ASSERT(ring_is_full(&ring, 10));
+  TEST_ASSERT(ring_read(&ring, 10, 1, buffer, result, sizeof(result)) == 10);
+  TEST_ASSERT(memcmp(result, "3456789ABC", 10) == 0);
+
+  // a drop while the consumer holds elements in place fails the release
+  u32 index;
+  TEST_ASSERT(ring_write(&ring, 10, 1, buffer, "abcd", 4) == 4);
+  TEST_ASSERT(ring_acquire_read(&ring, 10, 0, &index) == 4);
+  TEST_ASSERT(ring_drop(&ring, 10, 2) == 2);
+  TEST_ASSERT(ring_release_read(&ring, 10, index, 4) == 0);
+  TEST_ASSERT(ring_read(&ring, 10, 1, buffer, result, sizeof(result)) == 2);
+  TEST_ASSERT(memcmp(result, "cd", 2) == 0);
+  TEST_ASSERT(ring_drop(&ring, 10, 5) == 0);
+}
+
+int main() {
+  test_resync();
+  fuzz(1, 1);
+  fuzz(3, 2);
+  fuzz(64, 3);
+  fuzz(1000, 4);
+  return 0;
+}